@@ -0,0 +1,529 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <thread> // std::thread::hardware_concurrency
+#include <bx/allocator.h>
+#include <bx/cpu.h>
+#include <bx/file.h>
+#include <bx/hash.h>
+#include <bx/readerwriter.h>
+#include <bx/thread.h>
+#include <bx/timer.h>
+#include <ssvg/ssvg.h>
+
+bx::DefaultAllocator g_Allocator;
+
+struct PathStats
+{
+	uint32_t m_NumPaths;
+	uint32_t m_NumCommands;
+	uint32_t m_NumPackedPaths;
+	uint32_t m_UnpackedSize;
+	uint32_t m_PackedSize;
+};
+
+uint8_t* loadFile(const bx::FilePath& filePath)
+{
+	bx::Error err;
+	bx::FileReader reader;
+	if (!reader.open(filePath, &err)) {
+		return nullptr;
+	}
+
+	int32_t fileSize = (int32_t)reader.seek(0, bx::Whence::End);
+	reader.seek(0, bx::Whence::Begin);
+
+	uint8_t* buffer = (uint8_t*)BX_ALLOC(&g_Allocator, fileSize + 1);
+	reader.read(buffer, fileSize, &err);
+	buffer[fileSize] = 0;
+
+	reader.close();
+
+	return buffer;
+}
+
+void collectPathStats(const ssvg::ShapeList* shapeList, PathStats* stats)
+{
+	const uint32_t numShapes = shapeList->m_NumShapes;
+	for (uint32_t i = 0; i < numShapes; ++i) {
+		const ssvg::Shape* shape = shapeList->m_Shapes[i];
+		if (shape->m_Type == ssvg::ShapeType::Group) {
+			collectPathStats(&shape->m_ShapeList, stats);
+		} else if (shape->m_Type == ssvg::ShapeType::Path) {
+			const ssvg::Path* path = &shape->m_Path;
+			stats->m_NumPaths++;
+			stats->m_NumCommands += path->m_NumCommands;
+			if (path->m_Packed) {
+				stats->m_NumPackedPaths++;
+				stats->m_PackedSize += path->m_PackedSize;
+			} else {
+				stats->m_UnpackedSize += path->m_Capacity * sizeof(ssvg::PathCmd);
+			}
+		}
+	}
+}
+
+// Returns the number of decoded commands so the loop can't be optimized away.
+uint32_t iteratePaths(const ssvg::ShapeList* shapeList)
+{
+	uint32_t n = 0;
+
+	const uint32_t numShapes = shapeList->m_NumShapes;
+	for (uint32_t i = 0; i < numShapes; ++i) {
+		const ssvg::Shape* shape = shapeList->m_Shapes[i];
+		if (shape->m_Type == ssvg::ShapeType::Group) {
+			n += iteratePaths(&shape->m_ShapeList);
+		} else if (shape->m_Type == ssvg::ShapeType::Path) {
+			ssvg::PathIterator iter;
+			ssvg::pathIterInit(&iter, &shape->m_Path);
+			while (ssvg::pathIterNext(&iter)) {
+				++n;
+			}
+		}
+	}
+
+	return n;
+}
+
+double toMsec(int64_t deltaTime)
+{
+	return ((double)deltaTime * 1000.0) / (double)bx::getHPFrequency();
+}
+
+bool benchPaths(const char* svgSource, uint32_t loadFlags, const ssvg::ShapeAttributes* baseAttrs, uint32_t numIterations)
+{
+	int64_t startTime = bx::getHPCounter();
+	ssvg::Image* img = ssvg::imageLoad(svgSource, loadFlags, baseAttrs, nullptr);
+	const int64_t loadTime = bx::getHPCounter() - startTime;
+	if (!img) {
+		printf("(x) Failed to parse svg file.\n");
+		return false;
+	}
+
+	PathStats stats;
+	bx::memSet(&stats, 0, sizeof(PathStats));
+	collectPathStats(&img->m_ShapeList, &stats);
+
+	uint32_t numDecoded = 0;
+	startTime = bx::getHPCounter();
+	for (uint32_t i = 0; i < numIterations; ++i) {
+		numDecoded += iteratePaths(&img->m_ShapeList);
+	}
+	const int64_t iterTime = bx::getHPCounter() - startTime;
+
+	float bounds[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	startTime = bx::getHPCounter();
+	for (uint32_t i = 0; i < numIterations; ++i) {
+		ssvg::shapeListCalcBounds(&img->m_ShapeList, &bounds[0]);
+	}
+	const int64_t boundsTime = bx::getHPCounter() - startTime;
+
+	bx::SizerWriter sizer;
+	startTime = bx::getHPCounter();
+	ssvg::imageSave(img, &sizer);
+	const int64_t saveTime = bx::getHPCounter() - startTime;
+
+	const double iterMsec = toMsec(iterTime);
+	printf("- Paths: %u (%u packed), commands: %u\n", stats.m_NumPaths, stats.m_NumPackedPaths, stats.m_NumCommands);
+	printf("- Path memory: %u bytes (%u unpacked + %u packed)\n", stats.m_UnpackedSize + stats.m_PackedSize, stats.m_UnpackedSize, stats.m_PackedSize);
+	printf("- Load: %g msec\n", toMsec(loadTime));
+	printf("- Iterate: %g msec/iter (%g Mcmds/sec)\n", iterMsec / numIterations, iterMsec > 0.0 ? (double)numDecoded / (iterMsec * 1000.0) : 0.0);
+	printf("- Bounds: %g msec/iter {%g, %g, %g, %g}\n", toMsec(boundsTime) / numIterations, bounds[0], bounds[1], bounds[2], bounds[3]);
+	printf("- Save: %g msec (%d bytes)\n", toMsec(saveTime), (int)sizer.seek(0, bx::Whence::Current));
+
+	ssvg::imageDestroy(img);
+
+	return true;
+}
+
+// Each worker allocates a list of shapes, hands it to the next worker and frees the list it got
+// from the previous one, so with more than one thread all frees are cross-thread.
+struct PoolStressWorker
+{
+	ssvg::Context* m_Context;
+	ssvg::ShapeList* volatile* m_Mailboxes;
+	uint32_t m_ID;
+	uint32_t m_NumThreads;
+	uint32_t m_NumRounds;
+	uint32_t m_NumShapesPerRound;
+	uint32_t m_NumAllocs;
+	uint32_t m_NumFrees;
+};
+
+int32_t poolStressThread(bx::Thread* thread, void* userData)
+{
+	BX_UNUSED(thread);
+
+	PoolStressWorker* worker = (PoolStressWorker*)userData;
+	const uint32_t nextID = (worker->m_ID + 1) % worker->m_NumThreads;
+
+	for (uint32_t i = 0; i < worker->m_NumRounds; ++i) {
+		ssvg::ShapeList* shapeList = (ssvg::ShapeList*)BX_ALLOC(&g_Allocator, sizeof(ssvg::ShapeList));
+		bx::memSet(shapeList, 0, sizeof(ssvg::ShapeList));
+		shapeList->m_Context = worker->m_Context;
+
+		for (uint32_t j = 0; j < worker->m_NumShapesPerRound; ++j) {
+			ssvg::shapeListAllocShape(shapeList, ssvg::ShapeType::Rect, nullptr);
+		}
+		worker->m_NumAllocs += worker->m_NumShapesPerRound;
+
+		ssvg::ShapeList* prevList = (ssvg::ShapeList*)bx::atomicExchangePtr((void**)&worker->m_Mailboxes[nextID], shapeList);
+		if (prevList) {
+			// NOTE: Only happens if the next worker hasn't picked up the previous list yet.
+			worker->m_NumFrees += prevList->m_NumShapes;
+			ssvg::shapeListFree(prevList);
+			BX_FREE(&g_Allocator, prevList);
+		}
+
+		ssvg::ShapeList* recvList = (ssvg::ShapeList*)bx::atomicExchangePtr((void**)&worker->m_Mailboxes[worker->m_ID], nullptr);
+		if (recvList) {
+			worker->m_NumFrees += recvList->m_NumShapes;
+			ssvg::shapeListFree(recvList);
+			BX_FREE(&g_Allocator, recvList);
+		}
+	}
+
+	ssvg::contextDetachThread(worker->m_Context);
+
+	return 0;
+}
+
+void benchAttributePool(uint32_t maxThreads, uint32_t numRounds, uint32_t numShapesPerRound)
+{
+	ssvg::Context* ctx = ssvg::contextCreate(&g_Allocator);
+
+	double singleThreadRate = 0.0;
+	for (uint32_t numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+		PoolStressWorker workers[SSVG_CONFIG_CONTEXT_MAX_THREADS];
+		bx::Thread threads[SSVG_CONFIG_CONTEXT_MAX_THREADS];
+		ssvg::ShapeList* volatile mailboxes[SSVG_CONFIG_CONTEXT_MAX_THREADS];
+		bx::memSet((void*)&mailboxes[0], 0, sizeof(mailboxes));
+
+		const int64_t startTime = bx::getHPCounter();
+		for (uint32_t i = 0; i < numThreads; ++i) {
+			PoolStressWorker* worker = &workers[i];
+			worker->m_Context = ctx;
+			worker->m_Mailboxes = &mailboxes[0];
+			worker->m_ID = i;
+			worker->m_NumThreads = numThreads;
+			worker->m_NumRounds = numRounds;
+			worker->m_NumShapesPerRound = numShapesPerRound;
+			worker->m_NumAllocs = 0;
+			worker->m_NumFrees = 0;
+
+			threads[i].init(poolStressThread, worker);
+		}
+
+		uint64_t numOps = 0;
+		for (uint32_t i = 0; i < numThreads; ++i) {
+			threads[i].shutdown();
+
+			numOps += workers[i].m_NumAllocs + workers[i].m_NumFrees;
+		}
+		const int64_t totalTime = bx::getHPCounter() - startTime;
+
+		// Lists nobody picked up are freed on the main thread.
+		for (uint32_t i = 0; i < numThreads; ++i) {
+			ssvg::ShapeList* shapeList = mailboxes[i];
+			if (shapeList) {
+				numOps += shapeList->m_NumShapes;
+				ssvg::shapeListFree(shapeList);
+				BX_FREE(&g_Allocator, shapeList);
+			}
+		}
+
+		const double msec = toMsec(totalTime);
+		const double rate = msec > 0.0 ? (double)numOps / (msec * 1000.0) : 0.0;
+		if (numThreads == 1) {
+			singleThreadRate = rate;
+		}
+
+		printf("- Threads: %2u, %g msec, %g Mops/sec (x%.2f)\n", numThreads, msec, rate, singleThreadRate > 0.0 ? rate / singleThreadRate : 0.0);
+	}
+
+	ssvg::contextDestroy(ctx);
+}
+
+void benchBatchLoad(const char* svgSource, const ssvg::ShapeAttributes* baseAttrs, uint32_t maxThreads, uint32_t numDocuments)
+{
+	ssvg::Context* ctx = ssvg::contextCreate(&g_Allocator);
+
+	const char** xmlStrs = (const char**)BX_ALLOC(&g_Allocator, sizeof(const char*) * numDocuments);
+	ssvg::Image** images = (ssvg::Image**)BX_ALLOC(&g_Allocator, sizeof(ssvg::Image*) * numDocuments);
+	for (uint32_t i = 0; i < numDocuments; ++i) {
+		xmlStrs[i] = svgSource;
+	}
+
+	for (uint32_t numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+		ssvg::ImageLoadBatchStats stats;
+		ssvg::imageLoadBatch(xmlStrs, numDocuments, 0, baseAttrs, ctx, nullptr, numThreads, images, nullptr, &stats);
+
+		printf("- Threads: %2u, %g msec, %g images/sec, %g MB/sec (%u failed)\n", stats.m_NumThreads, stats.m_TimeMsec, stats.m_ImagesPerSec, stats.m_MBytesPerSec, stats.m_NumFailed);
+
+		for (uint32_t i = 0; i < numDocuments; ++i) {
+			if (images[i]) {
+				ssvg::imageDestroy(images[i]);
+			}
+		}
+	}
+
+	BX_FREE(&g_Allocator, images);
+	BX_FREE(&g_Allocator, xmlStrs);
+
+	ssvg::contextDestroy(ctx);
+}
+
+// Builds a single wide document by repeating the children of svgSource's <svg> element numCopies times.
+char* createWideDocument(const char* svgSource, uint32_t numCopies, uint32_t* docLen)
+{
+	const char* svgTag = strstr(svgSource, "<svg");
+	const char* bodyBegin = svgTag ? strchr(svgTag, '>') : nullptr;
+	const char* bodyEnd = bodyBegin ? strstr(bodyBegin, "</svg>") : nullptr;
+	if (!bodyEnd) {
+		return nullptr;
+	}
+	++bodyBegin;
+
+	const uint32_t headerLen = (uint32_t)(bodyBegin - svgSource);
+	const uint32_t bodyLen = (uint32_t)(bodyEnd - bodyBegin);
+	*docLen = headerLen + bodyLen * numCopies + 6;
+
+	char* doc = (char*)BX_ALLOC(&g_Allocator, *docLen + 1);
+	char* ptr = doc;
+	bx::memCopy(ptr, svgSource, headerLen);
+	ptr += headerLen;
+	for (uint32_t i = 0; i < numCopies; ++i) {
+		bx::memCopy(ptr, bodyBegin, bodyLen);
+		ptr += bodyLen;
+	}
+	bx::memCopy(ptr, "</svg>", 6);
+	doc[*docLen] = '\0';
+
+	return doc;
+}
+
+void benchParallelLoad(const char* svgSource, const ssvg::ShapeAttributes* baseAttrs, uint32_t maxThreads, uint32_t numCopies, uint32_t numIterations)
+{
+	uint32_t docLen = 0;
+	char* doc = createWideDocument(svgSource, numCopies, &docLen);
+	if (!doc) {
+		printf("(x) Failed to find the <svg> element.\n");
+		return;
+	}
+
+	ssvg::Context* ctx = ssvg::contextCreate(&g_Allocator);
+
+	for (uint32_t numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+		uint32_t numShapes = 0;
+		bool failed = false;
+
+		const int64_t startTime = bx::getHPCounter();
+		for (uint32_t i = 0; i < numIterations; ++i) {
+			ssvg::Image* img = ssvg::imageLoadParallel(doc, 0, baseAttrs, ctx, nullptr, numThreads, nullptr);
+			if (!img) {
+				failed = true;
+				break;
+			}
+
+			numShapes = img->m_ShapeList.m_NumShapes;
+			ssvg::imageDestroy(img);
+		}
+		const double timeSec = (double)(bx::getHPCounter() - startTime) / (double)bx::getHPFrequency();
+
+		if (failed) {
+			printf("(x) Failed to load the document with %u threads.\n", numThreads);
+			break;
+		}
+
+		printf("- Threads: %2u, %g msec/image, %g MB/sec (%u KB, %u top-level shapes)\n", numThreads, timeSec * 1000.0 / numIterations, ((double)docLen * numIterations / (1024.0 * 1024.0)) / timeSec, docLen >> 10, numShapes);
+	}
+
+	ssvg::contextDestroy(ctx);
+
+	BX_FREE(&g_Allocator, doc);
+}
+
+// Each thread count gets its own built-in scheduler. The bounds are compared against the
+// single-threaded ones to make sure the result doesn't depend on the number of threads.
+void benchBounds(const char* svgSource, const ssvg::ShapeAttributes* baseAttrs, uint32_t maxThreads, uint32_t numCopies, uint32_t numIterations)
+{
+	uint32_t docLen = 0;
+	char* doc = createWideDocument(svgSource, numCopies, &docLen);
+	if (!doc) {
+		printf("(x) Failed to find the <svg> element.\n");
+		return;
+	}
+
+	float refBounds[4];
+	double refMsec = 0.0;
+	for (uint32_t numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+		ssvg::SchedulerI* scheduler = numThreads > 1 ? ssvg::schedulerCreate(&g_Allocator, numThreads - 1) : nullptr;
+		ssvg::Context* ctx = ssvg::contextCreate(&g_Allocator);
+		ssvg::contextSetScheduler(ctx, scheduler);
+
+		ssvg::Image* img = ssvg::imageLoad(doc, 0, baseAttrs, ctx);
+		if (!img) {
+			printf("(x) Failed to load the document.\n");
+		} else {
+			float bounds[4];
+			const int64_t startTime = bx::getHPCounter();
+			for (uint32_t i = 0; i < numIterations; ++i) {
+				if (scheduler) {
+					ssvg::shapeListCalcBoundsParallel(&img->m_ShapeList, &bounds[0]);
+				} else {
+					ssvg::shapeListCalcBounds(&img->m_ShapeList, &bounds[0]);
+				}
+			}
+			const double msec = toMsec(bx::getHPCounter() - startTime) / numIterations;
+
+			if (numThreads == 1) {
+				bx::memCopy(&refBounds[0], &bounds[0], sizeof(float) * 4);
+				refMsec = msec;
+			}
+
+			const bool identical = bx::memCmp(&refBounds[0], &bounds[0], sizeof(float) * 4) == 0;
+			printf("- Threads: %2u, %g msec/iter, speedup %.2fx {%g, %g, %g, %g}%s\n", numThreads, msec, msec > 0.0 ? refMsec / msec : 0.0, bounds[0], bounds[1], bounds[2], bounds[3], identical ? "" : " (x) MISMATCH");
+
+			ssvg::imageDestroy(img);
+		}
+
+		ssvg::contextDestroy(ctx);
+		if (scheduler) {
+			ssvg::schedulerDestroy(scheduler);
+		}
+	}
+
+	BX_FREE(&g_Allocator, doc);
+}
+
+// Hashes everything written to it, to compare outputs without keeping them around.
+class HashWriter : public bx::WriterI
+{
+public:
+	HashWriter()
+		: m_Size(0)
+	{
+		m_Hash.begin();
+	}
+
+	virtual int32_t write(const void* data, int32_t size, bx::Error* err) override
+	{
+		BX_UNUSED(err);
+		m_Hash.add(data, size);
+		m_Size += size;
+		return size;
+	}
+
+	bx::HashMurmur2A m_Hash;
+	uint64_t m_Size;
+};
+
+void benchSave(const char* svgSource, const ssvg::ShapeAttributes* baseAttrs, uint32_t maxThreads, uint32_t numCopies, uint32_t numIterations)
+{
+	uint32_t docLen = 0;
+	char* doc = createWideDocument(svgSource, numCopies, &docLen);
+	if (!doc) {
+		printf("(x) Failed to find the <svg> element.\n");
+		return;
+	}
+
+	uint32_t refHash = 0;
+	double refMsec = 0.0;
+	for (uint32_t numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+		ssvg::SchedulerI* scheduler = numThreads > 1 ? ssvg::schedulerCreate(&g_Allocator, numThreads - 1) : nullptr;
+		ssvg::Context* ctx = ssvg::contextCreate(&g_Allocator);
+		ssvg::contextSetScheduler(ctx, scheduler);
+
+		ssvg::Image* img = ssvg::imageLoad(doc, 0, baseAttrs, ctx);
+		if (!img) {
+			printf("(x) Failed to load the document.\n");
+		} else {
+			uint32_t hash = 0;
+			uint64_t size = 0;
+			const int64_t startTime = bx::getHPCounter();
+			for (uint32_t i = 0; i < numIterations; ++i) {
+				HashWriter writer;
+				if (scheduler) {
+					ssvg::imageSaveParallel(img, &writer);
+				} else {
+					ssvg::imageSave(img, &writer);
+				}
+
+				hash = writer.m_Hash.end();
+				size = writer.m_Size;
+			}
+			const double msec = toMsec(bx::getHPCounter() - startTime) / numIterations;
+
+			if (numThreads == 1) {
+				refHash = hash;
+				refMsec = msec;
+			}
+
+			printf("- Threads: %2u, %g msec/iter, speedup %.2fx (%u bytes)%s\n", numThreads, msec, msec > 0.0 ? refMsec / msec : 0.0, (uint32_t)size, hash == refHash ? "" : " (x) MISMATCH");
+
+			ssvg::imageDestroy(img);
+		}
+
+		ssvg::contextDestroy(ctx);
+		if (scheduler) {
+			ssvg::schedulerDestroy(scheduler);
+		}
+	}
+
+	BX_FREE(&g_Allocator, doc);
+}
+
+int main(int argc, char** argv)
+{
+	const char* filename = argc > 1 ? argv[1] : "./Ghostscript_Tiger.svg";
+	const uint32_t numIterations = 100;
+
+	ssvg::ShapeAttributes defaultAttrs;
+	bx::memSet(&defaultAttrs, 0, sizeof(ssvg::ShapeAttributes));
+	defaultAttrs.m_StrokeWidth = 1.0f;
+	defaultAttrs.m_StrokeMiterLimit = 4.0f;
+	defaultAttrs.m_StrokeOpacity = 1.0f;
+	defaultAttrs.m_StrokePaint.m_Type = ssvg::PaintType::None;
+	defaultAttrs.m_StrokeLineCap = ssvg::LineCap::Butt;
+	defaultAttrs.m_StrokeLineJoin = ssvg::LineJoin::Miter;
+	defaultAttrs.m_FillOpacity = 1.0f;
+	defaultAttrs.m_FillPaint.m_Type = ssvg::PaintType::None;
+	ssvg::transformIdentity(&defaultAttrs.m_Transform[0]);
+
+	ssvg::initLib(&g_Allocator);
+
+	uint8_t* svgFileBuffer = loadFile(bx::FilePath(filename));
+	if (!svgFileBuffer) {
+		printf("(x) Failed to load \"%s\".\n", filename);
+		return 1;
+	}
+
+	printf("Unpacked paths \"%s\"...\n", filename);
+	benchPaths((const char*)svgFileBuffer, 0, &defaultAttrs, numIterations);
+
+	printf("Packed paths \"%s\" (scale: %g)...\n", filename, SSVG_CONFIG_PATH_PACK_SCALE);
+	benchPaths((const char*)svgFileBuffer, ssvg::ImageLoadFlags::PackPaths, &defaultAttrs, numIterations);
+
+	const uint32_t maxThreads = bx::max<uint32_t>(std::thread::hardware_concurrency(), 1);
+
+	printf("Batch load \"%s\"...\n", filename);
+	benchBatchLoad((const char*)svgFileBuffer, &defaultAttrs, bx::min<uint32_t>(maxThreads, SSVG_CONFIG_CONTEXT_MAX_THREADS), 200);
+
+	printf("Parallel load, %u x \"%s\" in a single document...\n", 64, filename);
+	benchParallelLoad((const char*)svgFileBuffer, &defaultAttrs, bx::min<uint32_t>(maxThreads, SSVG_CONFIG_CONTEXT_MAX_THREADS), 64, 10);
+
+	printf("Bounds, %u x \"%s\" in a single document...\n", 64, filename);
+	benchBounds((const char*)svgFileBuffer, &defaultAttrs, bx::min<uint32_t>(maxThreads, SSVG_CONFIG_CONTEXT_MAX_THREADS / 2), 64, 20);
+
+	printf("Save, %u x \"%s\" in a single document...\n", 64, filename);
+	benchSave((const char*)svgFileBuffer, &defaultAttrs, bx::min<uint32_t>(maxThreads, SSVG_CONFIG_CONTEXT_MAX_THREADS / 2), 64, 5);
+
+	BX_FREE(&g_Allocator, svgFileBuffer);
+
+	printf("Shape alloc/free, shared context...\n");
+	benchAttributePool(bx::min<uint32_t>(maxThreads, SSVG_CONFIG_CONTEXT_MAX_THREADS), 2000, 256);
+
+	ssvg::shutdownLib();
+
+	return 0;
+}
@@ -0,0 +1,422 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <bx/allocator.h>
+#include <bx/cpu.h>
+#include <bx/file.h>
+#include <bx/filepath.h>
+#include <bx/readerwriter.h>
+#include <bx/string.h>
+#include <bx/timer.h>
+#include <ssvg/ssvg.h>
+
+bx::DefaultAllocator g_Allocator;
+
+struct ConvertStage
+{
+	enum Enum : uint32_t
+	{
+		Read = 0,
+		Parse,
+		Normalize,
+		Save,
+
+		Count
+	};
+};
+
+static const char* kStageNames[ConvertStage::Count] = {
+	"Read",
+	"Parse",
+	"Normalize",
+	"Save"
+};
+
+struct ConvertOptions
+{
+	const char* m_OutputDir;  // NOTE: nullptr if m_DryRun
+	uint32_t m_LoadFlags;
+	uint32_t m_NumThreads;    // NOTE: 0 uses all CPUs
+	bool m_PackPaths;
+	bool m_DryRun;            // NOTE: Files are serialized but not written
+};
+
+struct ConvertJob
+{
+	const ConvertOptions* m_Options;
+	const ssvg::ShapeAttributes* m_BaseAttrs;
+	ssvg::Context* m_Context;
+	bx::FilePath* m_Files;
+	uint32_t m_NumFiles;
+	volatile uint64_t m_StageTicks[ConvertStage::Count]; // NOTE: Summed over all threads
+	volatile uint64_t m_InputBytes;
+	volatile uint64_t m_OutputBytes;
+	volatile uint32_t m_NumConverted;
+	volatile uint32_t m_NumFailed;
+};
+
+double toMsec(int64_t deltaTime)
+{
+	return ((double)deltaTime * 1000.0) / (double)bx::getHPFrequency();
+}
+
+char* loadFile(const bx::FilePath& filePath, uint32_t* size)
+{
+	bx::Error err;
+	bx::FileReader reader;
+	if (!reader.open(filePath, &err)) {
+		return nullptr;
+	}
+
+	int32_t fileSize = (int32_t)reader.seek(0, bx::Whence::End);
+	reader.seek(0, bx::Whence::Begin);
+
+	char* buffer = (char*)BX_ALLOC(&g_Allocator, fileSize + 1);
+	reader.read(buffer, fileSize, &err);
+	buffer[fileSize] = 0;
+
+	reader.close();
+
+	*size = (uint32_t)fileSize;
+
+	return buffer;
+}
+
+bool hasSVGExtension(const bx::FilePath& filePath)
+{
+	const bx::StringView ext = filePath.getExt();
+	return ext.getLength() == 4
+		&& bx::toLower(ext.getPtr()[1]) == 's'
+		&& bx::toLower(ext.getPtr()[2]) == 'v'
+		&& bx::toLower(ext.getPtr()[3]) == 'g'
+		;
+}
+
+void addFile(bx::FilePath** files, uint32_t* numFiles, const bx::StringView& path)
+{
+	*files = (bx::FilePath*)BX_REALLOC(&g_Allocator, *files, sizeof(bx::FilePath) * (*numFiles + 1));
+	bx::memSet(&(*files)[*numFiles], 0, sizeof(bx::FilePath));
+	(*files)[*numFiles].set(path);
+	(*numFiles)++;
+}
+
+// Adds all *.svg files in a directory (not recursive). Returns false if path isn't a directory.
+bool addDirectory(bx::FilePath** files, uint32_t* numFiles, const char* path)
+{
+	bx::Error err;
+	bx::DirectoryReader reader;
+	if (!reader.open(bx::FilePath(path), &err)) {
+		return false;
+	}
+
+	bx::FileInfo fileInfo;
+	while (reader.read(&fileInfo, sizeof(bx::FileInfo), &err) == sizeof(bx::FileInfo)) {
+		if (fileInfo.type != bx::FileType::File || !hasSVGExtension(fileInfo.filePath)) {
+			continue;
+		}
+
+		bx::FilePath filePath(path);
+		filePath.join(fileInfo.filePath.getCPtr());
+		addFile(files, numFiles, filePath.getCPtr());
+	}
+
+	reader.close();
+
+	return true;
+}
+
+// One path per line. Empty lines are skipped.
+bool addFileList(bx::FilePath** files, uint32_t* numFiles, const char* listPath)
+{
+	uint32_t size = 0;
+	char* list = loadFile(bx::FilePath(listPath), &size);
+	if (!list) {
+		return false;
+	}
+
+	const char* ptr = list;
+	const char* end = list + size;
+	while (ptr < end) {
+		const char* lineEnd = ptr;
+		while (lineEnd < end && *lineEnd != '\n' && *lineEnd != '\r') {
+			++lineEnd;
+		}
+
+		if (lineEnd != ptr) {
+			addFile(files, numFiles, bx::StringView(ptr, lineEnd));
+		}
+
+		ptr = lineEnd + 1;
+	}
+
+	BX_FREE(&g_Allocator, list);
+
+	return true;
+}
+
+int compareFileNames(const void* a, const void* b)
+{
+	return bx::strCmpI((*(const bx::FilePath* const*)a)->getFileName(), (*(const bx::FilePath* const*)b)->getFileName());
+}
+
+// Outputs are named after their input's file name, so inputs from different directories with the
+// same name would overwrite each other (or, on different threads, write the same file at the same time).
+// NOTE: Case-insensitive, so the check also holds on case-insensitive file systems.
+bool checkOutputNames(const bx::FilePath* files, uint32_t numFiles)
+{
+	const bx::FilePath** sorted = (const bx::FilePath**)BX_ALLOC(&g_Allocator, sizeof(bx::FilePath*) * numFiles);
+	for (uint32_t i = 0; i < numFiles; ++i) {
+		sorted[i] = &files[i];
+	}
+
+	qsort(sorted, numFiles, sizeof(bx::FilePath*), compareFileNames);
+
+	bool unique = true;
+	for (uint32_t i = 1; i < numFiles; ++i) {
+		if (compareFileNames(&sorted[i - 1], &sorted[i]) == 0) {
+			printf("(x) \"%s\" and \"%s\" would be written to the same output file.\n", sorted[i - 1]->getCPtr(), sorted[i]->getCPtr());
+			unique = false;
+		}
+	}
+
+	BX_FREE(&g_Allocator, sorted);
+
+	return unique;
+}
+
+void packPaths(ssvg::ShapeList* shapeList)
+{
+	const uint32_t numShapes = shapeList->m_NumShapes;
+	for (uint32_t i = 0; i < numShapes; ++i) {
+		ssvg::Shape* shape = shapeList->m_Shapes[i];
+		if (shape->m_Type == ssvg::ShapeType::Group) {
+			packPaths(&shape->m_ShapeList);
+		} else if (shape->m_Type == ssvg::ShapeType::Path) {
+			ssvg::pathPack(&shape->m_Path, SSVG_CONFIG_PATH_PACK_SCALE);
+		}
+	}
+}
+
+bool convertFile(ConvertJob* job, const bx::FilePath& input, uint64_t* stageTicks)
+{
+	const ConvertOptions* options = job->m_Options;
+
+	int64_t startTime = bx::getHPCounter();
+	uint32_t inputSize = 0;
+	char* svg = loadFile(input, &inputSize);
+	stageTicks[ConvertStage::Read] += bx::getHPCounter() - startTime;
+	if (!svg) {
+		printf("(x) Failed to read \"%s\".\n", input.getCPtr());
+		return false;
+	}
+
+	bx::atomicFetchAndAdd<uint64_t>(&job->m_InputBytes, inputSize);
+
+	startTime = bx::getHPCounter();
+	ssvg::ImageLoadError::Enum loadErr = ssvg::ImageLoadError::None;
+	ssvg::Image* img = ssvg::imageLoadWithLimits(svg, options->m_LoadFlags, job->m_BaseAttrs, job->m_Context, nullptr, &loadErr);
+	stageTicks[ConvertStage::Parse] += bx::getHPCounter() - startTime;
+
+	BX_FREE(&g_Allocator, svg);
+
+	if (!img) {
+		printf("(x) Failed to parse \"%s\" (error %u).\n", input.getCPtr(), (uint32_t)loadErr);
+		return false;
+	}
+
+	if (options->m_PackPaths) {
+		startTime = bx::getHPCounter();
+		packPaths(&img->m_ShapeList);
+		stageTicks[ConvertStage::Normalize] += bx::getHPCounter() - startTime;
+	}
+
+	startTime = bx::getHPCounter();
+	bool saved = true;
+	int64_t outputSize = 0;
+	if (options->m_DryRun) {
+		bx::SizerWriter sizer;
+		saved = ssvg::imageSave(img, &sizer);
+		outputSize = sizer.seek(0, bx::Whence::Current);
+	} else {
+		bx::FilePath output(options->m_OutputDir);
+		output.join(input.getFileName());
+
+		bx::Error err;
+		bx::FileWriter writer;
+		if (!writer.open(output, false, &err)) {
+			printf("(x) Failed to open \"%s\" for writing.\n", output.getCPtr());
+			saved = false;
+		} else {
+			saved = ssvg::imageSave(img, &writer);
+			outputSize = writer.seek(0, bx::Whence::Current);
+			writer.close();
+		}
+	}
+	stageTicks[ConvertStage::Save] += bx::getHPCounter() - startTime;
+
+	ssvg::imageDestroy(img);
+
+	if (!saved) {
+		return false;
+	}
+
+	bx::atomicFetchAndAdd<uint64_t>(&job->m_OutputBytes, (uint64_t)outputSize);
+
+	return true;
+}
+
+void convertFiles(uint32_t begin, uint32_t end, void* userData)
+{
+	ConvertJob* job = (ConvertJob*)userData;
+
+	uint64_t stageTicks[ConvertStage::Count] = {};
+	for (uint32_t i = begin; i < end; ++i) {
+		if (convertFile(job, job->m_Files[i], &stageTicks[0])) {
+			bx::atomicFetchAndAdd<uint32_t>(&job->m_NumConverted, 1);
+		} else {
+			bx::atomicFetchAndAdd<uint32_t>(&job->m_NumFailed, 1);
+		}
+	}
+
+	for (uint32_t i = 0; i < ConvertStage::Count; ++i) {
+		bx::atomicFetchAndAdd<uint64_t>(&job->m_StageTicks[i], stageTicks[i]);
+	}
+}
+
+void printUsage()
+{
+	printf("Usage: convert [options] <file.svg | directory>...\n");
+	printf("  -o <dir>            Output directory. Files keep their names, which must be unique\n");
+	printf("  -l <file>           Also convert the files listed in <file> (one per line)\n");
+	printf("  -j <n>              Number of threads (default: all CPUs)\n");
+	printf("  --dry-run           Serialize without writing the output files\n");
+	printf("  --pack-paths        Quantize path coordinates (SSVG_CONFIG_PATH_PACK_SCALE)\n");
+	printf("  --arcs-to-cubics    Convert arcs to cubic beziers\n");
+	printf("  --quads-to-cubics   Convert quadratic beziers to cubic beziers\n");
+	printf("  --polys-to-paths    Convert polygons and polylines to paths\n");
+}
+
+void printStage(const char* name, uint64_t ticks, uint32_t numFiles, uint64_t numBytes)
+{
+	const double msec = toMsec((int64_t)ticks);
+	const double sec = msec / 1000.0;
+	printf("- %-10s %10.2f thread-msec, %10.1f files/s, %8.2f MB/s (per thread)\n"
+		, name
+		, msec
+		, sec > 0.0 ? (double)numFiles / sec : 0.0
+		, sec > 0.0 ? ((double)numBytes / (1024.0 * 1024.0)) / sec : 0.0);
+}
+
+int main(int argc, char** argv)
+{
+	ConvertOptions options;
+	bx::memSet(&options, 0, sizeof(ConvertOptions));
+
+	bx::FilePath* files = nullptr;
+	uint32_t numFiles = 0;
+
+	for (int i = 1; i < argc; ++i) {
+		const bx::StringView arg(argv[i]);
+		if (!bx::strCmp(arg, "-o") && i + 1 < argc) {
+			options.m_OutputDir = argv[++i];
+		} else if (!bx::strCmp(arg, "-l") && i + 1 < argc) {
+			if (!addFileList(&files, &numFiles, argv[++i])) {
+				printf("(x) Failed to read file list \"%s\".\n", argv[i]);
+				return 1;
+			}
+		} else if (!bx::strCmp(arg, "-j") && i + 1 < argc) {
+			options.m_NumThreads = (uint32_t)atoi(argv[++i]);
+		} else if (!bx::strCmp(arg, "--dry-run")) {
+			options.m_DryRun = true;
+		} else if (!bx::strCmp(arg, "--pack-paths")) {
+			options.m_PackPaths = true;
+		} else if (!bx::strCmp(arg, "--arcs-to-cubics")) {
+			options.m_LoadFlags |= ssvg::ImageLoadFlags::ConvertArcToCubicBezier;
+		} else if (!bx::strCmp(arg, "--quads-to-cubics")) {
+			options.m_LoadFlags |= ssvg::ImageLoadFlags::ConvertQuadToCubicBezier;
+		} else if (!bx::strCmp(arg, "--polys-to-paths")) {
+			options.m_LoadFlags |= ssvg::ImageLoadFlags::ConvertPolygonsToPaths | ssvg::ImageLoadFlags::ConvertPolylinesToPaths;
+		} else if (arg.getPtr()[0] == '-') {
+			printUsage();
+			return 1;
+		} else if (!addDirectory(&files, &numFiles, argv[i])) {
+			addFile(&files, &numFiles, arg);
+		}
+	}
+
+	if (numFiles == 0 || (options.m_OutputDir == nullptr && !options.m_DryRun)) {
+		printUsage();
+		BX_FREE(&g_Allocator, files);
+		return 1;
+	}
+
+	if (!options.m_DryRun && !checkOutputNames(files, numFiles)) {
+		BX_FREE(&g_Allocator, files);
+		return 1;
+	}
+
+	ssvg::ShapeAttributes defaultAttrs;
+	bx::memSet(&defaultAttrs, 0, sizeof(ssvg::ShapeAttributes));
+	defaultAttrs.m_StrokeWidth = 1.0f;
+	defaultAttrs.m_StrokeMiterLimit = 4.0f;
+	defaultAttrs.m_StrokeOpacity = 1.0f;
+	defaultAttrs.m_StrokePaint.m_Type = ssvg::PaintType::None;
+	defaultAttrs.m_StrokeLineCap = ssvg::LineCap::Butt;
+	defaultAttrs.m_StrokeLineJoin = ssvg::LineJoin::Miter;
+	defaultAttrs.m_FillOpacity = 1.0f;
+	defaultAttrs.m_FillPaint.m_Type = ssvg::PaintType::None;
+	ssvg::transformIdentity(&defaultAttrs.m_Transform[0]);
+
+	ssvg::initLib(&g_Allocator);
+
+	// NOTE: The thread waiting in parallelFor() converts files too.
+	ssvg::SchedulerI* scheduler = options.m_NumThreads != 0 ? ssvg::schedulerCreate(&g_Allocator, options.m_NumThreads - 1) : nullptr;
+	ssvg::Context* ctx = ssvg::contextCreate(&g_Allocator);
+	ssvg::contextSetScheduler(ctx, scheduler);
+
+	ConvertJob job;
+	bx::memSet(&job, 0, sizeof(ConvertJob));
+	job.m_Options = &options;
+	job.m_BaseAttrs = &defaultAttrs;
+	job.m_Context = ctx;
+	job.m_Files = files;
+	job.m_NumFiles = numFiles;
+
+	const uint32_t numThreads = ssvg::contextGetScheduler(ctx)->getNumThreads();
+
+	const int64_t startTime = bx::getHPCounter();
+	ssvg::contextGetScheduler(ctx)->parallelFor(numFiles, 1, convertFiles, &job);
+	const double totalMsec = toMsec(bx::getHPCounter() - startTime);
+
+	const uint64_t inputBytes = job.m_InputBytes;
+	const uint64_t outputBytes = job.m_OutputBytes;
+	const double totalSec = totalMsec / 1000.0;
+
+	printf("Converted %u files (%u failed) in %g msec on %u threads\n", job.m_NumConverted, job.m_NumFailed, totalMsec, numThreads);
+	for (uint32_t i = 0; i < ConvertStage::Count; ++i) {
+		if (i == ConvertStage::Normalize && !options.m_PackPaths) {
+			continue;
+		}
+
+		printStage(kStageNames[i], job.m_StageTicks[i], numFiles, inputBytes);
+	}
+	printf("- Total      %10.1f files/s, %8.2f MB/s\n"
+		, totalSec > 0.0 ? (double)numFiles / totalSec : 0.0
+		, totalSec > 0.0 ? ((double)inputBytes / (1024.0 * 1024.0)) / totalSec : 0.0);
+	printf("- Input: %llu bytes, output: %llu bytes, saved: %lld bytes (%.1f%%)\n"
+		, (unsigned long long)inputBytes
+		, (unsigned long long)outputBytes
+		, (long long)inputBytes - (long long)outputBytes
+		, inputBytes != 0 ? 100.0 * ((double)inputBytes - (double)outputBytes) / (double)inputBytes : 0.0);
+
+	ssvg::contextDestroy(ctx);
+	if (scheduler) {
+		ssvg::schedulerDestroy(scheduler);
+	}
+
+	ssvg::shutdownLib();
+
+	BX_FREE(&g_Allocator, files);
+
+	return job.m_NumFailed != 0 ? 1 : 0;
+}
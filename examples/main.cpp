@@ -2,10 +2,13 @@
 #include <stdio.h>
 #include <bx/allocator.h>
 #include <bx/file.h>
+#include <bx/math.h>
+#include <bx/thread.h>
 #include <bx/timer.h>
 #include <ssvg/ssvg.h>
 
 bx::DefaultAllocator g_Allocator;
+ssvg::ShapeAttributes g_DefaultAttrs;
 
 uint8_t* loadFile(const bx::FilePath& filePath)
 {
@@ -41,7 +44,7 @@ bool testParser(const char* filename)
 
 	int64_t startTime = bx::getHPCounter();
 	{
-		img = ssvg::imageLoad((char*)svgFileBuffer);
+		img = ssvg::imageLoad((char*)svgFileBuffer, 0, &g_DefaultAttrs, nullptr);
 	}
 	int64_t deltaTime = bx::getHPCounter() - startTime;
 
@@ -85,7 +88,7 @@ bool testBuilder(const char* filename)
 	textAttrs.m_FillPaint.m_ColorABGR = 0xFF000000;
 	textAttrs.m_StrokePaint.m_Type = ssvg::PaintType::None;
 
-	ssvg::Image* img = ssvg::imageCreate();
+	ssvg::Image* img = ssvg::imageCreate(&defaultAttrs, nullptr);
 
 	ssvg::ShapeList* imgShapeList = &img->m_ShapeList;
 
@@ -96,7 +99,7 @@ bool testBuilder(const char* filename)
 
 		// Path
 		uint32_t pathID = ssvg::shapeListAddPath(imgShapeList, &defaultAttrs, nullptr, 0);
-		ssvg::Path* path = &imgShapeList->m_Shapes[pathID].m_Path;
+		ssvg::Path* path = &imgShapeList->m_Shapes[pathID]->m_Path;
 		ssvg::pathMoveTo(path, 0.0f, 0.0f);
 		ssvg::pathLineTo(path, 10.0f, 10.0f);
 		ssvg::pathCubicTo(path, 10.0f, 20.0f, 30.0f, 40.0f, 50.0f, 50.0f);
@@ -111,9 +114,9 @@ bool testBuilder(const char* filename)
 		uint32_t groupID = ssvg::shapeListAddGroup(imgShapeList, &defaultAttrs, nullptr, 0);
 
 		float groupTransform[6] = { 1.0f, 0.0f, 0.0f, 1.0f, 400.0f, 0.0f };
-		bx::memCopy(&imgShapeList->m_Shapes[groupID].m_Attrs.m_Transform[0], &groupTransform[0], sizeof(float) * 6);
+		bx::memCopy(&imgShapeList->m_Shapes[groupID]->m_Attrs->m_Transform[0], &groupTransform[0], sizeof(float) * 6);
 
-		ssvg::ShapeList* groupShapeList = &imgShapeList->m_Shapes[groupID].m_ShapeList;
+		ssvg::ShapeList* groupShapeList = &imgShapeList->m_Shapes[groupID]->m_ShapeList;
 		uint32_t rectID = ssvg::shapeListAddRect(groupShapeList, &defaultAttrs, 100.0f, 100.0f, 200.0f, 200.0f, 0.0f, 0.0f);
 		uint32_t circleID = ssvg::shapeListAddCircle(groupShapeList, &defaultAttrs, 200.0f, 200.0f, 80.0f);
 	}
@@ -134,7 +137,7 @@ bool testBuilder(const char* filename)
 
 		// Transform the group
 		float groupTransform[6] = { 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 400.0f };
-		bx::memCopy(&imgShapeList->m_Shapes[groupID].m_Attrs.m_Transform[0], &groupTransform[0], sizeof(float) * 6);
+		bx::memCopy(&imgShapeList->m_Shapes[groupID]->m_Attrs->m_Transform[0], &groupTransform[0], sizeof(float) * 6);
 	}
 
 	bx::Error err;
@@ -163,7 +166,7 @@ bool testRoundTrip(const char* input, const char* output)
 		return false;
 	}
 
-	ssvg::Image* img = ssvg::imageLoad((char*)svgFileBuffer);
+	ssvg::Image* img = ssvg::imageLoad((char*)svgFileBuffer, 0, &g_DefaultAttrs, nullptr);
 	if (!img) {
 		printf("(x) Failed to parse svg file.\n");
 		return false;
@@ -187,24 +190,197 @@ bool testRoundTrip(const char* input, const char* output)
 	return true;
 }
 
-int main()
+// Handles taken before a list is emptied (which frees its chunks) must not resolve to the shapes
+// allocated in the same slots afterwards.
+bool testShapeHandles()
 {
-	ssvg::ShapeAttributes defaultAttrs;
-	bx::memSet(&defaultAttrs, 0, sizeof(ssvg::ShapeAttributes));
-	defaultAttrs.m_StrokeWidth = 1.0f;
-	defaultAttrs.m_StrokeMiterLimit = 4.0f;
-	defaultAttrs.m_StrokeOpacity = 1.0f;
-	defaultAttrs.m_StrokePaint.m_Type = ssvg::PaintType::None;
-	defaultAttrs.m_StrokePaint.m_ColorABGR = 0x00000000;
-	defaultAttrs.m_StrokeLineCap = ssvg::LineCap::Butt;
-	defaultAttrs.m_StrokeLineJoin = ssvg::LineJoin::Miter;
-	defaultAttrs.m_FillOpacity = 1.0f;
-	defaultAttrs.m_FillPaint.m_Type = ssvg::PaintType::None;
-	defaultAttrs.m_FillPaint.m_ColorABGR = 0x00000000;
-	ssvg::transformIdentity(&defaultAttrs.m_Transform[0]);
-	shapeAttrsSetFontFamily(&defaultAttrs, "sans-serif");
+	printf("Shape handles...\n");
+
+	ssvg::ShapeList shapeList;
+	bx::memSet(&shapeList, 0, sizeof(ssvg::ShapeList));
+
+	ssvg::shapeListAddRect(&shapeList, &g_DefaultAttrs, 0.0f, 0.0f, 10.0f, 10.0f, 0.0f, 0.0f);
+	const ssvg::ShapeHandle oldHandle = ssvg::shapeListGetHandle(&shapeList, 0);
+
+	bool ok = true;
+	const char* emptyFuncs[] = { "shapeListFree", "shapeListShrinkToFit", "shapeListMoveShapes" };
+	for (uint32_t i = 0; i < BX_COUNTOF(emptyFuncs); ++i) {
+		if (i == 0) {
+			ssvg::shapeListFree(&shapeList);
+		} else if (i == 1) {
+			ssvg::shapeListDeleteShape(&shapeList, 0);
+			ssvg::shapeListShrinkToFit(&shapeList);
+		} else {
+			ssvg::ShapeList dst;
+			bx::memSet(&dst, 0, sizeof(ssvg::ShapeList));
+			ssvg::shapeListMoveShapes(&dst, &shapeList);
+			ssvg::shapeListFree(&dst);
+		}
+
+		ssvg::shapeListAddCircle(&shapeList, &g_DefaultAttrs, 5.0f, 5.0f, 5.0f);
+		const ssvg::ShapeHandle newHandle = ssvg::shapeListGetHandle(&shapeList, 0);
+		if (newHandle.m_Slot != oldHandle.m_Slot) {
+			printf("(x) %s: the new shape didn't reuse the old slot.\n", emptyFuncs[i]);
+			ok = false;
+		}
+
+		if (ssvg::shapeListGetShape(&shapeList, oldHandle) != nullptr) {
+			printf("(x) %s: a handle to a freed shape resolved to the new one.\n", emptyFuncs[i]);
+			ok = false;
+		}
+
+		if (ssvg::shapeListGetShape(&shapeList, newHandle) != shapeList.m_Shapes[0]) {
+			printf("(x) %s: the new handle didn't resolve.\n", emptyFuncs[i]);
+			ok = false;
+		}
+	}
+
+	ssvg::shapeListFree(&shapeList);
+
+	return ok;
+}
+
+bool testPathPack()
+{
+	printf("Path packing...\n");
+
+	// Exact within 3 decimals and 2^24 steps, rounded to 1/scale below that, off by an ulp past 2^24
+	// steps and refused at 2^30 steps.
+	const float scale = 1000.0f;
+	const float values[] = { 0.001f, 123.456f, 8192.021f, 16777.215f, 0.0005f, 0.0004f, 20000.001f, 1000000.0f };
+	const float maxErrors[] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.5f / scale, 0.5f / scale, 0.002f, 0.0625f };
+
+	bool ok = true;
+	for (uint32_t i = 0; i < BX_COUNTOF(values); ++i) {
+		ssvg::Path path;
+		bx::memSet(&path, 0, sizeof(ssvg::Path));
+		ssvg::pathMoveTo(&path, values[i], -values[i]);
+		if (!ssvg::pathPack(&path, scale)) {
+			printf("(x) %g: pathPack() failed.\n", values[i]);
+			ok = false;
+		} else {
+			ssvg::PathIterator iter;
+			ssvg::pathIterInit(&iter, &path);
+			const ssvg::PathCmd* cmd = ssvg::pathIterNext(&iter);
+			const float errX = bx::abs(cmd->m_Data[0] - values[i]);
+			const float errY = bx::abs(cmd->m_Data[1] + values[i]);
+			if (errX > maxErrors[i] || errY > maxErrors[i]) {
+				printf("(x) %g: decoded as (%g, %g).\n", values[i], cmd->m_Data[0], cmd->m_Data[1]);
+				ok = false;
+			}
+		}
+		ssvg::pathFree(&path);
+	}
+
+	ssvg::Path path;
+	bx::memSet(&path, 0, sizeof(ssvg::Path));
+	ssvg::pathMoveTo(&path, 0.0f, 0.0f);
+	ssvg::pathLineTo(&path, 1073742.0f, 0.0f);
+	if (ssvg::pathPack(&path, scale) || path.m_Packed || path.m_Commands[1].m_Data[0] != 1073742.0f) {
+		printf("(x) A coordinate past 2^30 steps didn't leave the path unpacked.\n");
+		ok = false;
+	}
+	ssvg::pathFree(&path);
+
+	return ok;
+}
+
+struct RemoteFreeTest
+{
+	ssvg::Context* m_Context;
+	ssvg::Image* m_Image;
+	bool m_FreeBeforeExit; // NOTE: The owner waits for the worker's frees instead of exiting first
+};
+
+static int32_t remoteFreeWorker(bx::Thread* thread, void* userData)
+{
+	BX_UNUSED(thread);
+
+	RemoteFreeTest* test = (RemoteFreeTest*)userData;
+	ssvg::imageDestroy(test->m_Image);
+	test->m_Image = nullptr;
+
+	return 0;
+}
+
+static int32_t remoteFreeOwner(bx::Thread* thread, void* userData)
+{
+	BX_UNUSED(thread);
+
+	RemoteFreeTest* test = (RemoteFreeTest*)userData;
+	test->m_Image = ssvg::imageLoad("<svg><rect width=\"1\" height=\"1\"/><circle r=\"1\"/></svg>", 0, &g_DefaultAttrs, test->m_Context);
+
+	if (test->m_FreeBeforeExit) {
+		bx::Thread worker;
+		worker.init(remoteFreeWorker, test, 0, "remote free worker");
+		worker.shutdown();
+	}
 
-	ssvg::initLib(&g_Allocator, &defaultAttrs);
+	return 0;
+}
+
+bool testRemoteFrees()
+{
+	printf("Remote frees...\n");
+
+	bool ok = true;
+	for (uint32_t i = 0; i < 2; ++i) {
+		ssvg::Context* ctx = ssvg::contextCreate(&g_Allocator);
+
+		// NOTE: The calling thread gets its own cache first, so it doesn't adopt the owner's.
+		ssvg::Image* probe = ssvg::imageLoad("<svg><rect width=\"1\" height=\"1\"/></svg>", 0, &g_DefaultAttrs, ctx);
+
+		RemoteFreeTest test;
+		test.m_Context = ctx;
+		test.m_Image = nullptr;
+		test.m_FreeBeforeExit = i == 0;
+
+		bx::Thread owner;
+		owner.init(remoteFreeOwner, &test, 0, "remote free owner");
+		owner.shutdown();
+
+		if (!test.m_FreeBeforeExit) {
+			bx::Thread worker;
+			worker.init(remoteFreeWorker, &test, 0, "remote free worker");
+			worker.shutdown();
+		}
+
+		ssvg::ImageMemoryUsage usage;
+		ssvg::imageCalcMemoryUsage(probe, &usage, true);
+		if (usage.m_NumAttrPoolBatches != 1) {
+			printf("(x) %s: %u attribute batches left instead of 1.\n", test.m_FreeBeforeExit ? "Freed before the owner exited" : "Freed after the owner exited", usage.m_NumAttrPoolBatches);
+			ok = false;
+		}
+
+		ssvg::imageDestroy(probe);
+		ssvg::contextDestroy(ctx);
+	}
+
+	return ok;
+}
+
+int main()
+{
+	ssvg::initLib(&g_Allocator);
+
+	bx::memSet(&g_DefaultAttrs, 0, sizeof(ssvg::ShapeAttributes));
+	g_DefaultAttrs.m_StrokeWidth = 1.0f;
+	g_DefaultAttrs.m_StrokeMiterLimit = 4.0f;
+	g_DefaultAttrs.m_StrokeOpacity = 1.0f;
+	g_DefaultAttrs.m_StrokePaint.m_Type = ssvg::PaintType::None;
+	g_DefaultAttrs.m_StrokePaint.m_ColorABGR = 0x00000000;
+	g_DefaultAttrs.m_StrokeLineCap = ssvg::LineCap::Butt;
+	g_DefaultAttrs.m_StrokeLineJoin = ssvg::LineJoin::Miter;
+	g_DefaultAttrs.m_FillOpacity = 1.0f;
+	g_DefaultAttrs.m_FillPaint.m_Type = ssvg::PaintType::None;
+	g_DefaultAttrs.m_FillPaint.m_ColorABGR = 0x00000000;
+	ssvg::transformIdentity(&g_DefaultAttrs.m_Transform[0]);
+	ssvg::shapeAttrsSetFontFamily(&g_DefaultAttrs, "sans-serif");
+
+	bool ok = true;
+	ok = testShapeHandles() && ok;
+	ok = testPathPack() && ok;
+	ok = testRemoteFrees() && ok;
 
 	testParser("./Ghostscript_Tiger.svg");
 	testBuilder("./output.svg");
@@ -212,5 +388,7 @@ int main()
 
 	testParser("./tiger.svg");
 
-	return 0;
+	ssvg::shutdownLib();
+
+	return ok ? 0 : 1;
 }
@@ -19,10 +19,40 @@
 #	define SSVG_CONFIG_CLASS_MAX_LEN 0
 #endif
 
+#ifndef SSVG_CONFIG_SHAPE_CHUNK_MIN_SIZE
+#	define SSVG_CONFIG_SHAPE_CHUNK_MIN_SIZE 2
+#endif
+
+#ifndef SSVG_CONFIG_PATH_PACK_SCALE
+#	define SSVG_CONFIG_PATH_PACK_SCALE 1000.0f
+#endif
+
 #ifndef SSVG_CONFIG_MINIFY_PATHS
 #	define SSVG_CONFIG_MINIFY_PATHS 1
 #endif
 
+// Max number of threads which can allocate shapes from a single context through their own cache at the same time.
+// Additional threads share a single, mutex-protected cache (see contextDetachThread()).
+#ifndef SSVG_CONFIG_CONTEXT_MAX_THREADS
+#	define SSVG_CONFIG_CONTEXT_MAX_THREADS 64
+#endif
+
+// Number of worker threads of the built-in scheduler created by contexts without one (see contextSetScheduler()).
+// 0 means one less than the number of CPUs; the thread waiting for the work runs tasks too.
+#ifndef SSVG_CONFIG_SCHEDULER_NUM_THREADS
+#	define SSVG_CONFIG_SCHEDULER_NUM_THREADS 0
+#endif
+
+// Max number of rects an image tracking dirty regions keeps between imageTakeDirtyRegions() calls. Further regions are merged.
+#ifndef SSVG_CONFIG_DIRTY_REGIONS_MAX
+#	define SSVG_CONFIG_DIRTY_REGIONS_MAX 32
+#endif
+
+// Read files with io_uring in imageLoadFiles() (Linux only). Falls back to a reader thread if the ring can't be created.
+#ifndef SSVG_CONFIG_USE_IO_URING
+#	define SSVG_CONFIG_USE_IO_URING 0
+#endif
+
 #if SSVG_CONFIG_DEBUG
 #include <bx/debug.h>
 
@@ -61,6 +91,14 @@ class StringView;
 namespace ssvg
 {
 struct Shape;
+struct ShapeChunk;
+struct Context;
+struct ShapeAttributeCache;
+struct SharedAttributeCache;
+struct ImageSnapshot;
+struct ImageCache;
+struct ImageCacheEntry;
+struct DirtyRegions;
 
 struct BaseProfile
 {
@@ -155,9 +193,24 @@ struct FillRule
 
 struct ShapeList
 {
-	Shape* m_Shapes;
+	Shape** m_Shapes;        // NOTE: Drawing order. Shapes are allocated in chunks and never move until deleted.
+	ShapeChunk** m_Chunks;
 	uint32_t m_NumShapes;
 	uint32_t m_Capacity;
+	uint32_t m_NumChunks;
+	uint32_t m_FirstFreeSlot;
+	uint32_t m_GenerationBase; // NOTE: First generation of new chunks. Survives freeing the chunks, so old handles never match new shapes.
+	Context* m_Context;      // NOTE: nullptr uses the default context (see initLib()). Shapes allocated from the list inherit it.
+	ShapeList* m_ParentList; // NOTE: List holding the group which owns this list. nullptr for top-level lists.
+	DirtyRegions* m_DirtyRegions; // NOTE: Only set on the top-level list of an image tracking dirty regions (see imageTrackDirtyRegions())
+};
+
+// NOTE: Stays valid across growth, reordering and deletion of other shapes in the same list.
+// Deleting the shape itself invalidates all its handles. m_Generation == 0 is an invalid handle.
+struct ShapeHandle
+{
+	uint32_t m_Slot;
+	uint32_t m_Generation;
 };
 
 struct Rect
@@ -198,6 +251,7 @@ struct PointList
 	float* m_Coords;
 	uint32_t m_NumPoints;
 	uint32_t m_Capacity;
+	bx::AllocatorI* m_Allocator;
 };
 
 struct PathCmd
@@ -208,9 +262,23 @@ struct PathCmd
 
 struct Path
 {
-	PathCmd* m_Commands;
+	PathCmd* m_Commands;     // NOTE: nullptr while the path is packed (see pathPack())
+	uint8_t* m_Packed;       // NOTE: Verbs followed by zig-zag varint deltas of the quantized coordinates
 	uint32_t m_NumCommands;
 	uint32_t m_Capacity;
+	uint32_t m_PackedSize;
+	float m_PackedScale;     // NOTE: Quantization steps per unit (coordinate = q / m_PackedScale)
+	bx::AllocatorI* m_Allocator;
+};
+
+// Streams absolute commands out of packed and unpacked paths alike (see pathIterInit()).
+struct PathIterator
+{
+	const Path* m_Path;
+	const uint8_t* m_Ptr;
+	uint32_t m_CmdID;
+	int32_t m_Last[2];
+	PathCmd m_Cmd;
 };
 
 // TODO: alignment-baseline
@@ -220,6 +288,7 @@ struct Text
 	float x;
 	float y;
 	TextAnchor::Enum m_Anchor;
+	bx::AllocatorI* m_Allocator;
 };
 
 // TODO: Gradients
@@ -255,6 +324,14 @@ struct AttribFlags
 	};
 };
 
+// NOTE: Non-owning view into a string. Only used by images loaded with ImageLoadFlags::BorrowStrings.
+// Copies of their shapes (shapeCopy(), shapeListAddShape(), shapeListAddGroup()) get their own, possibly truncated, strings.
+struct StringRef
+{
+	const char* m_Ptr;
+	uint32_t m_Length;
+};
+
 struct ShapeAttributes
 {
 	const ShapeAttributes* m_Parent;
@@ -276,6 +353,9 @@ struct ShapeAttributes
 #if SSVG_CONFIG_CLASS_MAX_LEN
 	char m_Class[SSVG_CONFIG_CLASS_MAX_LEN];
 #endif
+	StringRef m_IDRef;         // NOTE: If m_Ptr != nullptr it overrides m_ID
+	StringRef m_FontFamilyRef; // NOTE: If m_Ptr != nullptr it overrides m_FontFamily
+	StringRef m_ClassRef;      // NOTE: If m_Ptr != nullptr it overrides m_Class (available even if SSVG_CONFIG_CLASS_MAX_LEN == 0)
 };
 
 struct Shape
@@ -283,6 +363,9 @@ struct Shape
 	ShapeType::Enum m_Type;
 	ShapeAttributes* m_Attrs;
 	float m_BoundingRect[4]; // NOTE: Transformation independent axis-aligned bounding rect {minx, miny, maxx, maxy}
+	uint64_t m_Hash;         // NOTE: Cached shapeHash(). 0 if it has to be recomputed (see shapeInvalidateHash()).
+	uint32_t m_SourceOffset; // NOTE: Byte offset of the element in the source XML, relative to the parent group's element (see imageReparse())
+	uint32_t m_SourceLength; // NOTE: 0 if the shape wasn't parsed from XML
 
 	union
 	{
@@ -308,6 +391,108 @@ struct Image
 	BaseProfile::Enum m_BaseProfile;
 	uint16_t m_VerMajor;
 	uint16_t m_VerMinor;
+	const char* m_Source;      // NOTE: Source XML the image's string refs point into (ImageLoadFlags::BorrowStrings). nullptr if the image owns all its strings.
+	char* m_StringPool;        // NOTE: Owned copies of the string refs (see imageDetachSource())
+	Context* m_Context;
+	ImageSnapshot* m_LastSnapshot; // NOTE: Base of the next imageSnapshot(). Unchanged subtrees are shared with it.
+};
+
+// Hands the latest snapshot of an image from one writer thread to any number of reader threads (RCU style).
+// Readers never block. imageSnapshotPublish() waits for readers which are in the middle of
+// imageSnapshotAcquireLatest() (a few instructions) before releasing the previous snapshot. That grace
+// period assumes a single publisher per slot: concurrent imageSnapshotPublish() calls on the same slot
+// can release a snapshot a reader is about to acquire.
+struct ImageSnapshotSlot
+{
+	ImageSnapshot* volatile m_Snapshot;
+	volatile uint32_t m_Epoch;
+	volatile uint32_t m_NumReaders[2]; // NOTE: Indexed by the parity of m_Epoch
+};
+
+struct ImageCacheStats
+{
+	uint64_t m_NumHits;
+	uint64_t m_NumMisses;
+	uint64_t m_NumEvictions;
+	uint64_t m_UsedBytes;  // NOTE: Memory usage (see imageCalcMemoryUsage()) of the cached images
+	uint32_t m_NumEntries;
+};
+
+// All sizes are in bytes and exclude the allocator's own overhead. "Unused" members are the
+// part of the matching total which has been allocated but doesn't hold any data.
+struct ImageMemoryUsage
+{
+	uint64_t m_TotalBytes;           // NOTE: Everything below except the attribute pool
+	uint64_t m_ImageBytes;
+	uint64_t m_ShapeBytes;           // NOTE: Shape chunks, draw order and chunk arrays
+	uint64_t m_ShapeUnusedBytes;
+	uint64_t m_AttrBytes;            // NOTE: One ShapeAttributes per shape
+	uint64_t m_PathBytes;            // NOTE: Path commands and packed paths
+	uint64_t m_PathUnusedBytes;
+	uint64_t m_PointListBytes;
+	uint64_t m_PointListUnusedBytes;
+	uint64_t m_TextBytes;
+	uint64_t m_StringPoolBytes;
+	uint64_t m_AttrPoolBytes;        // NOTE: Attribute batches of the image's context (all threads), shared by all images using it. Only filled in on request.
+	uint64_t m_AttrPoolUnusedBytes;  // NOTE: Free slots across those batches
+	uint32_t m_NumShapes;
+	uint32_t m_NumAttrPoolBatches;
+};
+
+// Column-oriented copy of an image's shape tree (see shapeTablesCreate()). Each ShapeType gets
+// its own table, so batch kernels (bounds, transforms, culling) run over homogeneous arrays.
+struct ShapeTableColumn
+{
+	enum Enum : uint32_t
+	{
+		MinX = 0, // NOTE: World space bounds (see shapeTablesCalcBounds())
+		MinY,
+		MaxX,
+		MaxY,
+
+		FirstTypeColumn
+	};
+};
+
+struct RectColumn { enum Enum : uint32_t { X = ShapeTableColumn::FirstTypeColumn, Y, Width, Height, RX, RY, Count }; };
+struct CircleColumn { enum Enum : uint32_t { CX = ShapeTableColumn::FirstTypeColumn, CY, R, Count }; };
+struct EllipseColumn { enum Enum : uint32_t { CX = ShapeTableColumn::FirstTypeColumn, CY, RX, RY, Count }; };
+struct LineColumn { enum Enum : uint32_t { X1 = ShapeTableColumn::FirstTypeColumn, Y1, X2, Y2, Count }; };
+struct TextColumn { enum Enum : uint32_t { X = ShapeTableColumn::FirstTypeColumn, Y, Count }; };
+
+struct ShapeTableOrder
+{
+	enum Enum : uint32_t
+	{
+		TypeShift = 28,
+		RowMask = (1u << TypeShift) - 1,
+		GroupEnd = 0xFFFFFFFF
+	};
+};
+
+struct ShapeTable
+{
+	float* m_Columns;           // NOTE: Column-major; column c starts at m_Columns[c * m_NumRows] (see ShapeTableColumn and <Type>Column)
+	const Shape** m_Shapes;     // NOTE: Source shape of each row
+	uint32_t* m_TransformID;    // NOTE: World transform of each row (index into ShapeTables::m_Transforms)
+	uint32_t* m_FirstElement;   // NOTE: Polyline/Polygon: first point in ShapeTables::m_Points, Path: first command in ShapeTables::m_Commands, Group: order index of the first child
+	uint32_t* m_NumElements;    // NOTE: Polyline/Polygon: number of points, Path: number of commands, Group: number of order entries up to and including ShapeTableOrder::GroupEnd
+	uint32_t m_NumRows;
+	uint32_t m_NumColumns;
+};
+
+struct ShapeTables
+{
+	ShapeTable m_Tables[ShapeType::NumTypes];
+	uint32_t* m_Order;          // NOTE: Drawing order: (ShapeType << ShapeTableOrder::TypeShift) | row. Group rows are followed by their children and ShapeTableOrder::GroupEnd.
+	float* m_Transforms;        // NOTE: 6 floats per world transform. Transform 0 is the root (identity unless shapeTablesTransform() was called).
+	PathCmd* m_Commands;
+	float* m_Points;
+	uint32_t m_NumOrder;
+	uint32_t m_NumTransforms;
+	uint32_t m_NumCommands;
+	uint32_t m_NumPoints;
+	bx::AllocatorI* m_Allocator;
 };
 
 struct ImageLoadFlags
@@ -320,22 +505,212 @@ struct ImageLoadFlags
 		ConvertArcToCubicBezier = 1 << 3,
 		CalcShapeBounds = 1 << 4,
 		CalcPathConvexity = 1 << 5,
+		BorrowStrings = 1 << 6, // ids, classes and font families point into the source XML, which must outlive the image (see imageDetachSource())
+		// NOTE: Trades iteration speed for memory. pathIterNext() decodes packed commands about 3-4x slower than it
+		// returns unpacked ones (~40-80M vs. ~150-200M commands/sec on the tiger), so paths which are iterated every
+		// frame are better left unpacked (or pathUnpack()ed once they become hot).
+		// Packing is lossy: coordinates are rounded to 1/SSVG_CONFIG_PATH_PACK_SCALE and only round-trip exactly
+		// while |v| * SSVG_CONFIG_PATH_PACK_SCALE < 2^24. Paths with coordinates at or past 2^30 steps stay unpacked.
+		PackPaths = 1 << 7,     // Paths are packed using SSVG_CONFIG_PATH_PACK_SCALE (see pathPack())
+		MemoizeAttributes = 1 << 8, // Repeated style, transform and d values are parsed once per load (and thread)
 	};
 };
 
+// Shape types imageCanonicalize() converts to paths (paths are always converted).
+struct CanonicalizeFlags
+{
+	enum Enum : uint32_t
+	{
+		ConvertRects = 1 << 0,
+		ConvertCircles = 1 << 1,
+		ConvertEllipses = 1 << 2,
+		ConvertLines = 1 << 3,
+		ConvertPolylines = 1 << 4,
+		ConvertPolygons = 1 << 5,
+		ConvertAllShapes = ConvertRects | ConvertCircles | ConvertEllipses | ConvertLines | ConvertPolylines | ConvertPolygons,
+	};
+};
+
+struct ImageLoadError
+{
+	enum Enum : uint32_t
+	{
+		None = 0,
+		InvalidInput,
+		SyntaxError,
+		MaxBytes,        // NOTE: See ImageLoadLimits
+		MaxShapes,
+		MaxPathCommands,
+		MaxDepth,
+		Timeout,
+	};
+};
+
+// NOTE: 0 means unlimited. Limits are checked as the document is parsed so loading stops
+// before the allocations get out of hand.
+struct ImageLoadLimits
+{
+	uint64_t m_MaxBytes;        // NOTE: Estimated memory allocated for shapes, attributes, path commands, points and text
+	uint32_t m_MaxShapes;
+	uint32_t m_MaxPathCommands; // NOTE: Per path
+	uint32_t m_MaxDepth;        // NOTE: Group nesting
+	uint32_t m_MaxTimeMsec;
+};
+
+// A byte range of the source XML replaced by new text (see imageReparse()).
+struct ImageSourceEdit
+{
+	uint32_t m_Offset;    // NOTE: Same in the old and the new source
+	uint32_t m_OldLength; // NOTE: Number of bytes replaced
+	uint32_t m_NewLength; // NOTE: Number of bytes of the new text
+};
+
+struct ImageLoadBatchStats
+{
+	uint64_t m_NumBytes;        // NOTE: Total length of the input documents
+	uint32_t m_NumLoaded;
+	uint32_t m_NumFailed;
+	uint32_t m_NumThreads;
+	float m_TimeMsec;
+	float m_ImagesPerSec;
+	float m_MBytesPerSec;
+};
+
+// NOTE: img is owned by the callee; nullptr if the file failed to load (see error).
+typedef void (*ImageLoadFileCallback)(uint32_t fileID, Image* img, ImageLoadError::Enum error, void* userData);
+
+// NOTE: shapeID is the index of shape in img->m_ShapeList. bounds are in the image's coordinate system.
+typedef void (*ImageLoadShapeCallback)(const Image* img, const Shape* shape, uint32_t shapeID, const float* bounds, void* userData);
+
+typedef void (*TaskFunc)(void* userData);
+typedef void (*ParallelForFunc)(uint32_t begin, uint32_t end, void* userData);
+
+// NOTE: Storage for the scheduler to track the tasks of a group in (e.g. a counter or a handle
+// to a task group of an external job system). Zeroed by the library before the first submit().
+struct TaskGroup
+{
+	uint64_t m_Data[4];
+};
+
+// Interface to the job system all parallel work in the library runs on. Tasks can run on any thread,
+// including the ones blocked in wait() or parallelFor(). Threads running tasks allocate shapes from the
+// context, so at most SSVG_CONFIG_CONTEXT_MAX_THREADS distinct threads should run them.
+struct SchedulerI
+{
+	virtual ~SchedulerI() = 0;
+
+	// Number of threads tasks are spread over, including the calling thread. Used to decide how to split work.
+	virtual uint32_t getNumThreads() = 0;
+
+	virtual void submit(TaskGroup* group, TaskFunc func, void* userData) = 0;
+
+	// Returns once all tasks submitted to group have finished.
+	virtual void wait(TaskGroup* group) = 0;
+
+	// Calls func for consecutive [begin, end) ranges, at most grainSize long, covering [0, count).
+	// Returns once all ranges have been processed.
+	virtual void parallelFor(uint32_t count, uint32_t grainSize, ParallelForFunc func, void* userData) = 0;
+
+	// Called by schedulerDestroy(). Only the built-in pool frees itself; application schedulers are
+	// destroyed by the application.
+	virtual void destroy()
+	{
+		SSVG_CHECK(false, "schedulerDestroy() only destroys schedulers returned by schedulerCreate()");
+	}
+};
+
+inline SchedulerI::~SchedulerI()
+{
+}
+
+// Holds the allocator, the scheduler and the shape attribute pool. Shape attributes are allocated from
+// per-thread caches and can be freed from any thread, so multiple threads can share a context as long as
+// m_Allocator is thread safe and each image is only modified by one thread at a time. Threads
+// using their own context never touch shared state. Images (and everything allocated from them)
+// must be destroyed before their context.
+struct Context
+{
+	bx::AllocatorI* m_Allocator;
+	ShapeAttributeCache* m_AttrCaches[SSVG_CONFIG_CONTEXT_MAX_THREADS];
+	volatile uint32_t m_NumAttrCaches;
+	uint32_t m_ID;
+	SharedAttributeCache* m_SharedAttrCache; // NOTE: Used by threads which find all m_AttrCaches taken
+	Context* m_NextContext;                  // NOTE: List of live contexts, walked when a thread exits
+	SchedulerI* m_Scheduler;                 // NOTE: See contextSetScheduler()
+	SchedulerI* volatile m_DefaultScheduler; // NOTE: Built-in pool, created on first use if m_Scheduler is nullptr
+};
+
+// NOTE: initLib() creates the default context, used by all functions when passed a nullptr context.
 void initLib(bx::AllocatorI* allocator);
 void shutdownLib();
 
-Image* imageLoad(const char* xmlStr, uint32_t flags, const ShapeAttributes* baseAttrs);
+Context* contextCreate(bx::AllocatorI* allocator);
+void contextDestroy(Context* ctx);
+void contextDetachThread(Context* ctx); // NOTE: Hands the calling thread's cache over to other threads. Done automatically when the thread exits.
+void contextSetScheduler(Context* ctx, SchedulerI* scheduler); // NOTE: Call once, before any parallel work. nullptr selects the built-in pool.
+SchedulerI* contextGetScheduler(Context* ctx);
+Context* contextOrDefault(Context* ctx); // NOTE: Returns the default context (see initLib()) if ctx is nullptr.
+bx::AllocatorI* allocatorOrDefault(bx::AllocatorI* allocator); // NOTE: Returns the default context's allocator if allocator is nullptr (e.g. zeroed paths).
+
+// Built-in work-stealing pool. numWorkerThreads == 0 means one less than the number of CPUs (see SSVG_CONFIG_SCHEDULER_NUM_THREADS).
+SchedulerI* schedulerCreate(bx::AllocatorI* allocator, uint32_t numWorkerThreads);
+void schedulerDestroy(SchedulerI* scheduler);
+
+Image* imageLoad(const char* xmlStr, uint32_t flags, const ShapeAttributes* baseAttrs, Context* ctx);
+Image* imageLoadWithLimits(const char* xmlStr, uint32_t flags, const ShapeAttributes* baseAttrs, Context* ctx, const ImageLoadLimits* limits, ImageLoadError::Enum* error);
+Image* imageLoadParallel(const char* xmlStr, uint32_t flags, const ShapeAttributes* baseAttrs, Context* ctx, const ImageLoadLimits* limits, uint32_t numThreads, ImageLoadError::Enum* error);
+bool imageReparse(Image* img, const char* xmlStr, uint32_t flags, const ImageSourceEdit* edit, ImageLoadError::Enum* error); // NOTE: xmlStr is the edited source. Returns false if img has to be reloaded.
+Image* imageLoadProgressive(const char* xmlStr, uint32_t flags, const ShapeAttributes* baseAttrs, Context* ctx, const ImageLoadLimits* limits, ImageLoadShapeCallback callback, void* userData, ImageLoadError::Enum* error);
+uint32_t imageLoadBatch(const char* const* xmlStrs, uint32_t count, uint32_t flags, const ShapeAttributes* baseAttrs, Context* ctx, const ImageLoadLimits* limits, uint32_t numThreads, Image** images, ImageLoadError::Enum* errors, ImageLoadBatchStats* stats);
+uint32_t imageLoadFiles(const char* const* paths, uint32_t count, uint32_t flags, const ShapeAttributes* baseAttrs, Context* ctx, const ImageLoadLimits* limits, uint32_t maxInFlight, ImageLoadFileCallback callback, void* userData);
 bool imageSave(const Image* img, bx::WriterI* writer);
-Image* imageCreate(const ShapeAttributes* baseAttrs);
+bool imageSaveParallel(const Image* img, bx::WriterI* writer); // NOTE: Same output as imageSave(), serialized on the context's scheduler.
+Image* imageCreate(const ShapeAttributes* baseAttrs, Context* ctx);
 void imageDestroy(Image* img);
+void imageDetachSource(Image* img);
+void imageCalcMemoryUsage(const Image* img, ImageMemoryUsage* report, bool attrPool = false); // NOTE: The attribute pool is read unsynchronized. Only pass true while no other thread uses the context.
+void imageCanonicalize(Image* img, uint32_t flags); // NOTE: See CanonicalizeFlags
+
+// Damage tracking for partial repaints. While enabled, the image accumulates the old and new bounds of every
+// shape changed through the shapeList* functions, imageReparse() and imagePatch(), in image space (the space
+// of Image::m_BoundingRect, before the viewBox mapping). In-place edits (attributes, transforms, path commands)
+// have to be bracketed with shapeBeginEdit()/shapeEndEdit(), shapes from shapeListAllocShape() need a
+// shapeEndEdit() once they are filled in. Regions are geometric bounds, so renderers should
+// inflate them by the stroke width and antialiasing. Text has no bounds, so changing a text shape marks the
+// whole image; text inside changed groups isn't covered. Enabling tracking calculates the bounds of all
+// shapes; afterwards group bounds only grow until the next shapeListCalcBounds().
+void imageTrackDirtyRegions(Image* img, bool enable);
+uint32_t imageTakeDirtyRegions(Image* img, float* rects, uint32_t maxRects); // NOTE: rects holds maxRects {minx, miny, maxx, maxy}. Merges regions down to maxRects and clears them.
+void imageAddDirtyRegion(Image* img, const float* rect); // NOTE: nullptr marks the whole image as dirty.
+
+// NOTE: Snapshots are immutable and can be read from any thread. Nodes are allocated from and freed to
+// the context's allocator by whichever thread releases the last reference, so it must be thread safe.
+ImageSnapshot* imageSnapshot(Image* img); // NOTE: Returns a new reference. Must not run concurrently with modifications of img.
+const Image* imageSnapshotGetImage(const ImageSnapshot* snapshot); // NOTE: Read-only. Don't pass it to functions which update bounds.
+ImageSnapshot* imageSnapshotAcquire(ImageSnapshot* snapshot);
+void imageSnapshotRelease(ImageSnapshot* snapshot);
+void imageSnapshotPublish(ImageSnapshotSlot* slot, ImageSnapshot* snapshot); // NOTE: Takes over the reference. One publisher per slot (see ImageSnapshotSlot); nullptr clears the slot.
+ImageSnapshot* imageSnapshotAcquireLatest(ImageSnapshotSlot* slot); // NOTE: Returns a new reference or nullptr.
+
+// Parsed documents keyed by a 128-bit hash of the XML plus the load flags, evicted in LRU order once
+// their memory usage exceeds the budget. All images are loaded with the cache's copy of baseAttrs.
+// Entries are refcounted and stay valid after eviction until released. The cache is thread safe
+// as long as ctx's allocator is. If ctx is nullptr the default context is used.
+ImageCache* imageCacheCreate(Context* ctx, const ShapeAttributes* baseAttrs, uint64_t budget);
+void imageCacheDestroy(ImageCache* cache); // NOTE: Outstanding entries stay valid until released.
+void imageCacheClear(ImageCache* cache);
+void imageCacheSetBudget(ImageCache* cache, uint64_t budget);
+void imageCacheGetStats(ImageCache* cache, ImageCacheStats* stats);
+ImageCacheEntry* imageCacheLoad(ImageCache* cache, const char* xmlStr, uint32_t flags, const ImageLoadLimits* limits, ImageLoadError::Enum* error); // NOTE: Returns a new reference or nullptr. ImageLoadFlags::BorrowStrings is ignored. limits only apply on misses.
+const Image* imageCacheEntryGetImage(const ImageCacheEntry* entry); // NOTE: Read-only. Shared by all holders of the entry. Its shape hashes are precomputed, so imageHash()/shapeHash() only read it.
+ImageCacheEntry* imageCacheEntryAcquire(ImageCacheEntry* entry);
+void imageCacheEntryRelease(ImageCacheEntry* entry);
 
 Shape* shapeListAllocShape(ShapeList* shapeList, ShapeType::Enum type, const ShapeAttributes* parentAttrs);
 void shapeListShrinkToFit(ShapeList* shapeList);
 void shapeListFree(ShapeList* shapeList);
 uint32_t shapeListAddShape(ShapeList* shapeList, const Shape* shape);
-uint32_t shapeListAddGroup(ShapeList* shapeList, const ShapeAttributes* parentAttrs, const Shape* children, uint32_t numChildren);
+uint32_t shapeListAddGroup(ShapeList* shapeList, const ShapeAttributes* parentAttrs, const Shape* const* children, uint32_t numChildren);
 uint32_t shapeListAddRect(ShapeList* shapeList, const ShapeAttributes* parentAttrs, float x, float y, float w, float h, float rx, float ry);
 uint32_t shapeListAddCircle(ShapeList* shapeList, const ShapeAttributes* parentAttrs, float x, float y, float r);
 uint32_t shapeListAddEllipse(ShapeList* shapeList, const ShapeAttributes* parentAttrs, float x, float y, float rx, float ry);
@@ -348,6 +723,12 @@ uint32_t shapeListMoveShapeToBack(ShapeList* shapeList, uint32_t shapeID);
 uint32_t shapeListMoveShapeToFront(ShapeList* shapeList, uint32_t shapeID);
 void shapeListDeleteShape(ShapeList* shapeList, uint32_t shapeID);
 void shapeListCalcBounds(ShapeList* shapeList, float* bounds);
+void shapeListCalcBoundsParallel(ShapeList* shapeList, float* bounds);
+void shapeListReserve(ShapeList* shapeList, uint32_t capacity);
+void shapeListMoveShapes(ShapeList* dst, ShapeList* src);
+ShapeHandle shapeListGetHandle(const ShapeList* shapeList, uint32_t shapeID);
+Shape* shapeListGetShape(const ShapeList* shapeList, ShapeHandle handle);
+uint32_t shapeListFindShape(const ShapeList* shapeList, ShapeHandle handle);
 
 PathCmd* pathAllocCommand(Path* path, PathCmdType::Enum type);
 PathCmd* pathAllocCommands(Path* path, uint32_t n);
@@ -364,6 +745,10 @@ uint32_t pathArcTo(Path* path, float rx, float ry, float xAxisRotation, int larg
 uint32_t pathClose(Path* path);
 void pathCalcBounds(const Path* path, float* bounds);
 void pathConvertCommand(Path* path, uint32_t cmdID, PathCmdType::Enum newType);
+bool pathPack(Path* path, float scale);
+void pathUnpack(Path* path);
+void pathIterInit(PathIterator* iter, const Path* path);
+const PathCmd* pathIterNext(PathIterator* iter);
 
 float* pointListAllocPoints(PointList* ptList, uint32_t n);
 void pointListShrinkToFit(PointList* ptList);
@@ -375,12 +760,46 @@ void pointListCalcBounds(const PointList* ptList, float* bounds);
 void shapeAttrsSetID(ShapeAttributes* attrs, const bx::StringView& id);
 void shapeAttrsSetFontFamily(ShapeAttributes* attrs, const bx::StringView& fontFamily);
 void shapeAttrsSetClass(ShapeAttributes* attrs, const bx::StringView& c);
+bx::StringView shapeAttrsGetID(const ShapeAttributes* attrs); // NOTE: The borrowed string if set (ImageLoadFlags::BorrowStrings), the own one otherwise.
+bx::StringView shapeAttrsGetFontFamily(const ShapeAttributes* attrs);
+bx::StringView shapeAttrsGetClass(const ShapeAttributes* attrs);
 
 void shapeFree(Shape* shape);
 bool shapeCopy(Shape* dst, const Shape* src, bool copyAttrs = true);
 void shapeUpdateBounds(Shape* shape);
+void shapeBeginEdit(Shape* shape, ShapeList* shapeList); // NOTE: Call before modifying a shape in place. Adds its old region if the image tracks dirty regions.
+void shapeEndEdit(Shape* shape, ShapeList* shapeList);   // NOTE: Updates the bounds (of groups from their children's bounds), invalidates the hash and adds the new region.
+void shapeAddDirtyRegion(Shape* shape, ShapeList* shapeList); // NOTE: shapeList is the list holding shape. No-op unless its image tracks dirty regions.
+
+// Structural hashes. Equal hashes mean equal shape types, geometry and attributes. Attributes a shape
+// inherits aren't part of its hash, so equal subtrees are only equivalent under equivalent parents;
+// imageHash() also covers the base attributes. Different representations of the same geometry (e.g.
+// packed and unpacked paths) hash differently. Shape hashes are cached. The shapeList* functions keep
+// the caches up to date; after modifying a shape in place, call shapeInvalidateHash().
+// NOTE: Hashing writes the caches, so it must not run concurrently on shared (e.g. snapshot) shapes.
+uint64_t imageHash(Image* img);
+uint64_t shapeHash(Shape* shape);
+void shapeInvalidateHash(Shape* shape, ShapeList* shapeList); // NOTE: shapeList is the list holding shape. Invalidates the groups above it.
+void shapeListInvalidateHash(ShapeList* shapeList);           // NOTE: Invalidates the groups above shapeList.
+void hash128(const void* data, uint32_t size, uint64_t seed, uint64_t* hash); // NOTE: Not cryptographic
+
+// Binary edit scripts turning image a into image b: copied/moved, modified, inserted and (implicitly) deleted
+// shapes, changed attributes and the changed range of path commands/point lists. Unchanged subtrees are
+// matched by hash, so script size and patching cost scale with the change. imagePatch() only applies
+// scripts made against an image with the same imageHash() and checks the result's hash; on failure img
+// stays valid but has to be reloaded. Patched shapes lose their source ranges (see imageReparse()).
+bool imageDiff(Image* a, Image* b, bx::WriterI* writer);
+bool imagePatch(Image* img, const void* script, uint32_t size);
+
+ShapeTables* shapeTablesCreate(const Image* img); // NOTE: Returns nullptr if a shape type has more than ShapeTableOrder::RowMask shapes or another count exceeds 32 bits.
+void shapeTablesDestroy(ShapeTables* tables);
+float* shapeTablesGetColumn(const ShapeTables* tables, ShapeType::Enum type, uint32_t column);
+void shapeTablesCalcBounds(ShapeTables* tables, float* bounds);
+void shapeTablesTransform(ShapeTables* tables, const float* transform);
+uint32_t shapeTablesCull(const ShapeTables* tables, const float* rect, uint32_t* visibleOrder);
 
 void transformIdentity(float* transform);
+bool transformIsIdentity(const float* transform);
 void transformTranslation(float* transform, float x, float y);
 void transformMultiply(float* a, const float* b);
 void transformTranslate(float* transform, float x, float y);
@@ -3,25 +3,97 @@
 #include <bx/allocator.h>
 #include <bx/string.h>
 #include <bx/math.h>
+#include <bx/cpu.h>
+#include <bx/mutex.h>
+#include <bx/os.h>
 #include <float.h> // FLT_MAX
+#include <stddef.h> // offsetof
 
 namespace ssvg
 {
+struct ShapeAttributeFreeListNode;
+
+// NOTE: m_Attrs must be the first member; shape attributes are freed through their ShapeAttributes pointer.
+struct ShapeAttributeSlot
+{
+	ShapeAttributes m_Attrs;
+	ShapeAttributeFreeListNode* m_Node;
+};
+
+// NOTE: A batch of attribute slots owned by a single thread. Only the owner touches the local free list.
+// Other threads push the slots they free to m_RemoteFirstFreeID, which the owner reclaims once the
+// local list runs dry or it detaches from the context. The padding keeps remote frees off the owner's cache line.
 struct ShapeAttributeFreeListNode
 {
 	ShapeAttributeFreeListNode* m_Next;
 	ShapeAttributeFreeListNode* m_Prev;
-	ShapeAttributes* m_Attrs;
+	ShapeAttributeSlot* m_Slots;
+	ShapeAttributeCache* m_Cache;
 	uint32_t m_NumAttrs;
 	uint32_t m_FirstFreeID;
 	uint32_t m_NumFree;
+	uint8_t m_Padding[BX_CACHE_LINE_SIZE];
+	volatile uint32_t m_RemoteFirstFreeID;
+};
+
+// NOTE: One per thread using the context. Never freed before the context; caches of detached
+// threads (m_ThreadID == 0) are adopted by the next new thread. Detaching moves the batches still
+// in use to the shared cache, so their remote frees don't wait for that thread.
+struct ShapeAttributeCache
+{
+	ShapeAttributeFreeListNode* m_Batches;
+	Context* m_Context;
+	volatile uint32_t m_ThreadID;
+};
+
+// NOTE: Thread ID of the shared cache; no thread matches it, so every free takes the remote path
+// and only allocations, serialized by m_Mutex, touch the local free lists.
+static const uint32_t kSharedAttrCacheThreadID = UINT32_MAX;
+
+struct SharedAttributeCache
+{
+	ShapeAttributeCache m_Cache;
+	bx::Mutex m_Mutex;
+};
+
+// NOTE: Detaches the thread from all live contexts when a thread which allocated or freed shapes exits.
+// Armed on first use, which also registers the destructor with the thread.
+struct ThreadExitHook
+{
+	~ThreadExitHook();
+
+	bool m_Armed;
 };
 
-bx::AllocatorI* s_Allocator = nullptr;
-static ShapeAttributeFreeListNode* s_ShapeAttrFreeListHead = nullptr;
+static Context* s_DefaultContext = nullptr;
+static uint32_t s_NextContextID = 0;
+static Context* s_ContextList = nullptr;
+static bx::Mutex s_ContextListMutex;
+
+// NOTE: The last cache used by the thread. Keyed by context ID because context IDs, unlike
+// context pointers, are never reused.
+static BX_THREAD_LOCAL ShapeAttributeCache* s_LastAttrCache = nullptr;
+static BX_THREAD_LOCAL uint32_t s_LastAttrCacheContextID = 0;
+static BX_THREAD_LOCAL uint32_t s_ThreadID = 0;
+static thread_local ThreadExitHook s_ThreadExitHook;
 
-static ShapeAttributes* shapeAttrsAlloc();
+static ShapeAttributes* shapeAttrsAlloc(Context* ctx);
 static void shapeAttrsFree(ShapeAttributes* attrs);
+static void shapeAttrsDestroyCache(bx::AllocatorI* allocator, ShapeAttributeCache* cache);
+static void shapeAttrsTrimCache(ShapeAttributeCache* cache);
+static void contextDetachThreadCaches(Context* ctx, uint32_t threadID);
+static void pathCalcBoundsRange(const Path* path, uint32_t begin, uint32_t end, float* bounds);
+
+// NOTE: Structs zeroed by the user (e.g. a temporary ShapeList) have no context/allocator.
+Context* contextOrDefault(Context* ctx)
+{
+	return ctx != nullptr ? ctx : s_DefaultContext;
+}
+
+bx::AllocatorI* allocatorOrDefault(bx::AllocatorI* allocator)
+{
+	return allocator != nullptr ? allocator : s_DefaultContext->m_Allocator;
+}
 
 void transformIdentity(float* transform)
 {
@@ -30,6 +102,16 @@ void transformIdentity(float* transform)
 	transform[3] = 1.0f;
 }
 
+bool transformIsIdentity(const float* transform)
+{
+	return transform[0] == 1.0f
+		&& transform[1] == 0.0f
+		&& transform[2] == 0.0f
+		&& transform[3] == 1.0f
+		&& transform[4] == 0.0f
+		&& transform[5] == 0.0f;
+}
+
 void transformTranslation(float* transform, float x, float y)
 {
 	transform[0] = 1.0f;
@@ -80,23 +162,189 @@ void transformBoundingRect(const float* transform, const float* localRect, float
 	globalRect[3] = bx::max<float>(transformedRect[1], transformedRect[3]);
 }
 
-Shape* shapeListAllocShape(ShapeList* shapeList, ShapeType::Enum type, const ShapeAttributes* parentAttrs)
+// Shapes are stored in chunks which are never reallocated, so pointers to shapes stay valid
+// until the shape is deleted. Chunk i holds (SSVG_CONFIG_SHAPE_CHUNK_MIN_SIZE << i) slots, which
+// keeps the unused capacity at the same level as a 2x growing array without moving any shape.
+struct ShapeChunk
+{
+	Shape* m_Shapes;
+	uint32_t* m_Generations;
+	uint32_t m_FirstSlot;
+	uint32_t m_NumSlots;
+};
+
+// Damage accumulated between imageTakeDirtyRegions() calls, in image space.
+struct DirtyRegions
+{
+	float m_Rects[SSVG_CONFIG_DIRTY_REGIONS_MAX][4];
+	uint32_t m_NumRects;
+	bool m_All;
+};
+
+static const uint32_t kShapeSlotInvalid = UINT32_MAX;
+
+inline uint32_t shapeChunkFromSlot(uint32_t slot)
+{
+	return 31 - bx::uint32_cntlz(slot / SSVG_CONFIG_SHAPE_CHUNK_MIN_SIZE + 1);
+}
+
+inline Shape* shapeListGetSlot(const ShapeList* shapeList, uint32_t slot, uint32_t** generation)
+{
+	const ShapeChunk* chunk = shapeList->m_Chunks[shapeChunkFromSlot(slot)];
+	const uint32_t id = slot - chunk->m_FirstSlot;
+	SSVG_CHECK(id < chunk->m_NumSlots, "Invalid shape slot");
+
+	*generation = &chunk->m_Generations[id];
+	return &chunk->m_Shapes[id];
+}
+
+static uint32_t shapeListFindSlot(const ShapeList* shapeList, const Shape* shape)
+{
+	const uint32_t numChunks = shapeList->m_NumChunks;
+	for (uint32_t i = 0; i < numChunks; ++i) {
+		const ShapeChunk* chunk = shapeList->m_Chunks[i];
+		if (shape >= chunk->m_Shapes && shape < chunk->m_Shapes + chunk->m_NumSlots) {
+			return chunk->m_FirstSlot + (uint32_t)(shape - chunk->m_Shapes);
+		}
+	}
+
+	SSVG_CHECK(false, "Shape doesn't belong to this shape list");
+
+	return kShapeSlotInvalid;
+}
+
+static void shapeListAllocChunk(ShapeList* shapeList)
+{
+	bx::AllocatorI* allocator = contextOrDefault(shapeList->m_Context)->m_Allocator;
+
+	const uint32_t chunkID = shapeList->m_NumChunks;
+	const uint32_t numSlots = SSVG_CONFIG_SHAPE_CHUNK_MIN_SIZE << chunkID;
+	const uint32_t firstSlot = SSVG_CONFIG_SHAPE_CHUNK_MIN_SIZE * ((1u << chunkID) - 1);
+
+	const uint32_t shapesOffset = bx::strideAlign(sizeof(ShapeChunk), 16);
+	const uint32_t generationsOffset = shapesOffset + sizeof(Shape) * numSlots;
+	const uint32_t totalSize = generationsOffset + sizeof(uint32_t) * numSlots;
+
+	uint8_t* mem = (uint8_t*)BX_ALLOC(allocator, totalSize);
+	SSVG_CHECK(mem != nullptr, "Failed to allocate shape chunk");
+
+	ShapeChunk* chunk = (ShapeChunk*)mem;
+	chunk->m_Shapes = (Shape*)(mem + shapesOffset);
+	chunk->m_Generations = (uint32_t*)(mem + generationsOffset);
+	chunk->m_FirstSlot = firstSlot;
+	chunk->m_NumSlots = numSlots;
+
+	// Generation 0 is reserved for invalid handles.
+	const uint32_t generation = shapeList->m_GenerationBase != 0 ? shapeList->m_GenerationBase : 1;
+	for (uint32_t i = 0; i < numSlots; ++i) {
+		chunk->m_Generations[i] = generation;
+	}
+
+	// Link all new slots in front of the free list.
+	for (uint32_t i = 0; i < numSlots - 1; ++i) {
+		*(uint32_t*)&chunk->m_Shapes[i] = firstSlot + i + 1;
+	}
+	*(uint32_t*)&chunk->m_Shapes[numSlots - 1] = shapeList->m_FirstFreeSlot;
+	shapeList->m_FirstFreeSlot = firstSlot;
+
+	shapeList->m_Chunks = (ShapeChunk**)BX_REALLOC(allocator, shapeList->m_Chunks, sizeof(ShapeChunk*) * (chunkID + 1));
+	shapeList->m_Chunks[chunkID] = chunk;
+	shapeList->m_NumChunks++;
+}
+
+static void shapeListFreeChunks(ShapeList* shapeList)
+{
+	bx::AllocatorI* allocator = contextOrDefault(shapeList->m_Context)->m_Allocator;
+
+	// NOTE: Chunks allocated later start past every generation handed out so far.
+	uint32_t maxGeneration = shapeList->m_GenerationBase;
+	const uint32_t numChunks = shapeList->m_NumChunks;
+	for (uint32_t i = 0; i < numChunks; ++i) {
+		const ShapeChunk* chunk = shapeList->m_Chunks[i];
+		for (uint32_t j = 0; j < chunk->m_NumSlots; ++j) {
+			maxGeneration = bx::max<uint32_t>(maxGeneration, chunk->m_Generations[j]);
+		}
+
+		BX_FREE(allocator, shapeList->m_Chunks[i]);
+	}
+	BX_FREE(allocator, shapeList->m_Chunks);
+
+	shapeList->m_GenerationBase = maxGeneration == UINT32_MAX ? 1 : maxGeneration + 1;
+
+	shapeList->m_Chunks = nullptr;
+	shapeList->m_NumChunks = 0;
+	shapeList->m_FirstFreeSlot = 0;
+}
+
+// Shapes inherit the context of the list they are allocated from.
+static void shapeSetContext(Shape* shape, Context* ctx)
+{
+	bx::AllocatorI* allocator = ctx->m_Allocator;
+
+	switch (shape->m_Type) {
+	case ShapeType::Group:
+		shape->m_ShapeList.m_Context = ctx;
+		break;
+	case ShapeType::Polyline:
+	case ShapeType::Polygon:
+		shape->m_PointList.m_Allocator = allocator;
+		break;
+	case ShapeType::Path:
+		shape->m_Path.m_Allocator = allocator;
+		break;
+	case ShapeType::Text:
+		shape->m_Text.m_Allocator = allocator;
+		break;
+	default:
+		break;
+	}
+}
+
+// Allocates a slot and appends it to the draw order. The returned shape is uninitialized.
+static Shape* shapeListAllocSlot(ShapeList* shapeList, bx::AllocatorI* allocator)
 {
-	SSVG_CHECK(shapeList->m_NumShapes <= shapeList->m_Capacity, "Trying to expand a read-only shape list?");
+	SSVG_CHECK(shapeList->m_NumShapes <= shapeList->m_Capacity, "Invalid shape list");
 
 	if (shapeList->m_NumShapes + 1 > shapeList->m_Capacity) {
+		// NOTE: Only the draw order array is reallocated. Shapes themselves never move.
 		const uint32_t oldCapacity = shapeList->m_Capacity;
+		const uint32_t newCapacity = oldCapacity ? (oldCapacity * 3) / 2 : 4;
+		shapeList->m_Capacity = bx::max<uint32_t>(newCapacity, oldCapacity + 1);
+		shapeList->m_Shapes = (Shape**)BX_REALLOC(allocator, shapeList->m_Shapes, sizeof(Shape*) * shapeList->m_Capacity);
+	}
+
+	// NOTE: A zeroed shape list has no chunks and m_FirstFreeSlot == 0, which is not a valid slot.
+	if (shapeList->m_NumChunks == 0) {
+		shapeList->m_FirstFreeSlot = kShapeSlotInvalid;
+	}
 
-		// TODO: Since shapes are fairly large objects, check if allocating a constant amount each time
-		// somehow helps.
-		shapeList->m_Capacity = oldCapacity ? (oldCapacity * 3) / 2 : 4;
-		shapeList->m_Shapes = (Shape*)BX_REALLOC(s_Allocator, shapeList->m_Shapes, sizeof(Shape) * shapeList->m_Capacity);
-		bx::memSet(&shapeList->m_Shapes[oldCapacity], 0, sizeof(Shape) * (shapeList->m_Capacity - oldCapacity));
+	if (shapeList->m_FirstFreeSlot == kShapeSlotInvalid) {
+		shapeListAllocChunk(shapeList);
 	}
 
-	Shape* shape = &shapeList->m_Shapes[shapeList->m_NumShapes++];
+	const uint32_t slot = shapeList->m_FirstFreeSlot;
+	uint32_t* generation = nullptr;
+	Shape* shape = shapeListGetSlot(shapeList, slot, &generation);
+	shapeList->m_FirstFreeSlot = *(uint32_t*)shape;
+
+	shapeList->m_Shapes[shapeList->m_NumShapes++] = shape;
+
+	return shape;
+}
+
+Shape* shapeListAllocShape(ShapeList* shapeList, ShapeType::Enum type, const ShapeAttributes* parentAttrs)
+{
+	Context* ctx = contextOrDefault(shapeList->m_Context);
+
+	Shape* shape = shapeListAllocSlot(shapeList, ctx->m_Allocator);
+
+	bx::memSet(shape, 0, sizeof(Shape));
 	shape->m_Type = type;
-	shape->m_Attrs = shapeAttrsAlloc();
+	shapeSetContext(shape, ctx);
+	if (type == ShapeType::Group) {
+		shape->m_ShapeList.m_ParentList = shapeList;
+	}
+	shape->m_Attrs = shapeAttrsAlloc(ctx);
 	bx::memSet(shape->m_Attrs, 0, sizeof(ShapeAttributes));
 	shape->m_Attrs->m_Parent = parentAttrs;
 	shape->m_Attrs->m_Flags = AttribFlags::InheritAll;
@@ -107,49 +355,110 @@ Shape* shapeListAllocShape(ShapeList* shapeList, ShapeType::Enum type, const Sha
 #endif
 	transformIdentity(&shape->m_Attrs->m_Transform[0]);
 
+	shapeListInvalidateHash(shapeList);
+
 	return shape;
 }
 
 void shapeListShrinkToFit(ShapeList* shapeList)
 {
-	SSVG_CHECK(shapeList->m_NumShapes <= shapeList->m_Capacity, "Trying to shrink a read-only shape list?");
+	bx::AllocatorI* allocator = contextOrDefault(shapeList->m_Context)->m_Allocator;
+
+	SSVG_CHECK(shapeList->m_NumShapes <= shapeList->m_Capacity, "Invalid shape list");
 
 	if (!shapeList->m_NumShapes && shapeList->m_Capacity) {
-		BX_FREE(s_Allocator, shapeList->m_Shapes);
+		BX_FREE(allocator, shapeList->m_Shapes);
 		shapeList->m_Shapes = nullptr;
 		shapeList->m_Capacity = 0;
+
+		shapeListFreeChunks(shapeList);
 	} else if (shapeList->m_NumShapes != shapeList->m_Capacity) {
-		shapeList->m_Shapes = (Shape*)BX_REALLOC(s_Allocator, shapeList->m_Shapes, sizeof(Shape) * shapeList->m_NumShapes);
+		shapeList->m_Shapes = (Shape**)BX_REALLOC(allocator, shapeList->m_Shapes, sizeof(Shape*) * shapeList->m_NumShapes);
 		shapeList->m_Capacity = shapeList->m_NumShapes;
 	}
 }
 
 void shapeListFree(ShapeList* shapeList)
 {
-	SSVG_CHECK(shapeList->m_NumShapes <= shapeList->m_Capacity, "Trying to free a read-only shape list?");
+	bx::AllocatorI* allocator = contextOrDefault(shapeList->m_Context)->m_Allocator;
+
+	SSVG_CHECK(shapeList->m_NumShapes <= shapeList->m_Capacity, "Invalid shape list");
 
 	const uint32_t n = shapeList->m_NumShapes;
 	for (uint32_t i = 0; i < n; ++i) {
-		Shape* shape = &shapeList->m_Shapes[i];
+		Shape* shape = shapeList->m_Shapes[i];
 		shapeFree(shape);
 	}
 
-	BX_FREE(s_Allocator, shapeList->m_Shapes);
+	BX_FREE(allocator, shapeList->m_Shapes);
 	shapeList->m_Shapes = nullptr;
 	shapeList->m_Capacity = 0;
 	shapeList->m_NumShapes = 0;
+
+	shapeListFreeChunks(shapeList);
+	shapeListInvalidateHash(shapeList);
+}
+
+// NOTE: The lists of the group's children point to the group's list, so they have to follow it when it moves.
+static void shapeListSetParent(ShapeList* shapeList, ShapeList* parentList)
+{
+	shapeList->m_ParentList = parentList;
+
+	const uint32_t n = shapeList->m_NumShapes;
+	for (uint32_t i = 0; i < n; ++i) {
+		Shape* child = shapeList->m_Shapes[i];
+		if (child->m_Type == ShapeType::Group) {
+			child->m_ShapeList.m_ParentList = shapeList;
+		}
+	}
+}
+
+// Moves all shapes of src to the end of dst and leaves src empty. Unlike shapeListAddShape() no
+// shape data is copied, but pointers and handles to the moved shapes become invalid.
+// NOTE: Both lists must belong to the same context.
+void shapeListMoveShapes(ShapeList* dst, ShapeList* src)
+{
+	Context* ctx = contextOrDefault(dst->m_Context);
+	SSVG_CHECK(ctx == contextOrDefault(src->m_Context), "Shape lists belong to different contexts");
+
+	bx::AllocatorI* allocator = ctx->m_Allocator;
+
+	const uint32_t n = src->m_NumShapes;
+	shapeListReserve(dst, dst->m_NumShapes + n);
+	for (uint32_t i = 0; i < n; ++i) {
+		shapeAddDirtyRegion(src->m_Shapes[i], src);
+
+		Shape* shape = shapeListAllocSlot(dst, allocator);
+		bx::memCopy(shape, src->m_Shapes[i], sizeof(Shape));
+		if (shape->m_Type == ShapeType::Group) {
+			shapeListSetParent(&shape->m_ShapeList, dst);
+		}
+
+		shapeAddDirtyRegion(shape, dst);
+	}
+
+	BX_FREE(allocator, src->m_Shapes);
+	src->m_Shapes = nullptr;
+	src->m_Capacity = 0;
+	src->m_NumShapes = 0;
+
+	shapeListFreeChunks(src);
+
+	shapeListInvalidateHash(dst);
+	shapeListInvalidateHash(src);
 }
 
 void shapeListReserve(ShapeList* shapeList, uint32_t capacity)
 {
+	bx::AllocatorI* allocator = contextOrDefault(shapeList->m_Context)->m_Allocator;
+
 	const uint32_t oldCapacity = shapeList->m_Capacity;
-	if (oldCapacity <= capacity) {
+	if (oldCapacity >= capacity) {
 		return;
 	}
 
 	shapeList->m_Capacity = capacity;
-	shapeList->m_Shapes = (Shape*)BX_REALLOC(s_Allocator, shapeList->m_Shapes, sizeof(Shape) * shapeList->m_Capacity);
-	bx::memSet(&shapeList->m_Shapes[oldCapacity], 0, sizeof(Shape) * (shapeList->m_Capacity - oldCapacity));
+	shapeList->m_Shapes = (Shape**)BX_REALLOC(allocator, shapeList->m_Shapes, sizeof(Shape*) * shapeList->m_Capacity);
 }
 
 uint32_t shapeListMoveShapeToBack(ShapeList* shapeList, uint32_t shapeID)
@@ -159,10 +468,9 @@ uint32_t shapeListMoveShapeToBack(ShapeList* shapeList, uint32_t shapeID)
 		return shapeID;
 	}
 
-	Shape tmp;
-	bx::memCopy(&tmp, &shapeList->m_Shapes[shapeID - 1], sizeof(Shape));
-	bx::memCopy(&shapeList->m_Shapes[shapeID - 1], &shapeList->m_Shapes[shapeID], sizeof(Shape));
-	bx::memCopy(&shapeList->m_Shapes[shapeID], &tmp, sizeof(Shape));
+	bx::swap(shapeList->m_Shapes[shapeID - 1], shapeList->m_Shapes[shapeID]);
+	shapeListInvalidateHash(shapeList);
+	shapeAddDirtyRegion(shapeList->m_Shapes[shapeID - 1], shapeList);
 
 	return shapeID - 1;
 }
@@ -174,10 +482,9 @@ uint32_t shapeListMoveShapeToFront(ShapeList* shapeList, uint32_t shapeID)
 		return shapeID;
 	}
 
-	Shape tmp;
-	bx::memCopy(&tmp, &shapeList->m_Shapes[shapeID + 1], sizeof(Shape));
-	bx::memCopy(&shapeList->m_Shapes[shapeID + 1], &shapeList->m_Shapes[shapeID], sizeof(Shape));
-	bx::memCopy(&shapeList->m_Shapes[shapeID], &tmp, sizeof(Shape));
+	bx::swap(shapeList->m_Shapes[shapeID + 1], shapeList->m_Shapes[shapeID]);
+	shapeListInvalidateHash(shapeList);
+	shapeAddDirtyRegion(shapeList->m_Shapes[shapeID + 1], shapeList);
 
 	return shapeID + 1;
 }
@@ -186,17 +493,78 @@ void shapeListDeleteShape(ShapeList* shapeList, uint32_t shapeID)
 {
 	SSVG_CHECK(shapeID < shapeList->m_NumShapes, "Invalid shape ID");
 
-	shapeFree(&shapeList->m_Shapes[shapeID]);
+	Shape* shape = shapeList->m_Shapes[shapeID];
+	shapeAddDirtyRegion(shape, shapeList);
+	shapeFree(shape);
+
+	// Invalidate all handles to this shape and return its slot to the free list.
+	const uint32_t slot = shapeListFindSlot(shapeList, shape);
+	uint32_t* generation = nullptr;
+	shapeListGetSlot(shapeList, slot, &generation);
+	*generation = *generation == UINT32_MAX ? 1 : *generation + 1;
+	*(uint32_t*)shape = shapeList->m_FirstFreeSlot;
+	shapeList->m_FirstFreeSlot = slot;
 
 	const uint32_t numShapesToMove = shapeList->m_NumShapes - 1 - shapeID;
 	if (numShapesToMove != 0) {
-		bx::memMove(&shapeList->m_Shapes[shapeID], &shapeList->m_Shapes[shapeID + 1], sizeof(Shape) * numShapesToMove);
+		bx::memMove(&shapeList->m_Shapes[shapeID], &shapeList->m_Shapes[shapeID + 1], sizeof(Shape*) * numShapesToMove);
 	}
 
 	shapeList->m_NumShapes--;
+
+	shapeListInvalidateHash(shapeList);
 }
 
-void shapeListCalcBounds(ShapeList* shapeList, float* bounds)
+ShapeHandle shapeListGetHandle(const ShapeList* shapeList, uint32_t shapeID)
+{
+	SSVG_CHECK(shapeID < shapeList->m_NumShapes, "Invalid shape ID");
+
+	ShapeHandle handle;
+	handle.m_Slot = shapeListFindSlot(shapeList, shapeList->m_Shapes[shapeID]);
+
+	uint32_t* generation = nullptr;
+	shapeListGetSlot(shapeList, handle.m_Slot, &generation);
+	handle.m_Generation = *generation;
+
+	return handle;
+}
+
+Shape* shapeListGetShape(const ShapeList* shapeList, ShapeHandle handle)
+{
+	if (handle.m_Generation == 0 || shapeList->m_NumChunks == 0) {
+		return nullptr;
+	}
+
+	const ShapeChunk* lastChunk = shapeList->m_Chunks[shapeList->m_NumChunks - 1];
+	if (handle.m_Slot >= lastChunk->m_FirstSlot + lastChunk->m_NumSlots) {
+		return nullptr;
+	}
+
+	uint32_t* generation = nullptr;
+	Shape* shape = shapeListGetSlot(shapeList, handle.m_Slot, &generation);
+
+	return *generation == handle.m_Generation ? shape : nullptr;
+}
+
+uint32_t shapeListFindShape(const ShapeList* shapeList, ShapeHandle handle)
+{
+	const Shape* shape = shapeListGetShape(shapeList, handle);
+	if (!shape) {
+		return ~0u;
+	}
+
+	const uint32_t numShapes = shapeList->m_NumShapes;
+	for (uint32_t i = 0; i < numShapes; ++i) {
+		if (shapeList->m_Shapes[i] == shape) {
+			return i;
+		}
+	}
+
+	return ~0u;
+}
+
+// NOTE: With updateLeaves == false only the groups are updated, from the current bounds of their children.
+static void shapeListCalcBoundsInternal(ShapeList* shapeList, float* bounds, bool updateLeaves)
 {
 	const uint32_t numShapes = shapeList->m_NumShapes;
 	if (numShapes == 0) {
@@ -209,8 +577,12 @@ void shapeListCalcBounds(ShapeList* shapeList, float* bounds)
 	bounds[2] = -FLT_MAX;
 	bounds[3] = -FLT_MAX;
 	for (uint32_t i = 0; i < numShapes; ++i) {
-		Shape* shape = &shapeList->m_Shapes[i];
-		shapeUpdateBounds(shape);
+		Shape* shape = shapeList->m_Shapes[i];
+		if (shape->m_Type == ShapeType::Group) {
+			shapeListCalcBoundsInternal(&shape->m_ShapeList, &shape->m_BoundingRect[0], updateLeaves);
+		} else if (updateLeaves) {
+			shapeUpdateBounds(shape);
+		}
 
 		// Since this is a group, the child's bounding rect should be transformed using its
 		// transformation matrix before calculating the group's local bounding rect.
@@ -224,14 +596,137 @@ void shapeListCalcBounds(ShapeList* shapeList, float* bounds)
 	}
 }
 
+void shapeListCalcBounds(ShapeList* shapeList, float* bounds)
+{
+	shapeListCalcBoundsInternal(shapeList, bounds, true);
+}
+
+// Either a whole shape (m_CmdEnd == 0) or a range of commands of a large path.
+struct BoundsWorkItem
+{
+	Shape* m_Shape;
+	uint32_t m_CmdBegin;
+	uint32_t m_CmdEnd;
+	float m_Bounds[4];
+};
+
+struct BoundsJob
+{
+	bx::AllocatorI* m_Allocator;
+	BoundsWorkItem* m_Items;
+	uint32_t m_NumItems;
+	uint32_t m_Capacity;
+};
+
+static const uint32_t kBoundsPathRangeSize = 1024;
+static const uint32_t kBoundsItemsPerTask = 32;
+
+static BoundsWorkItem* boundsJobAddItem(BoundsJob* job, Shape* shape, uint32_t cmdBegin, uint32_t cmdEnd)
+{
+	if (job->m_NumItems == job->m_Capacity) {
+		job->m_Capacity = job->m_Capacity ? (job->m_Capacity * 3) / 2 : 256;
+		job->m_Items = (BoundsWorkItem*)BX_REALLOC(job->m_Allocator, job->m_Items, sizeof(BoundsWorkItem) * job->m_Capacity);
+	}
+
+	BoundsWorkItem* item = &job->m_Items[job->m_NumItems++];
+	item->m_Shape = shape;
+	item->m_CmdBegin = cmdBegin;
+	item->m_CmdEnd = cmdEnd;
+
+	return item;
+}
+
+// NOTE: Packed paths can only be decoded front to back, so they are never split.
+static void boundsJobCollect(BoundsJob* job, ShapeList* shapeList)
+{
+	const uint32_t numShapes = shapeList->m_NumShapes;
+	for (uint32_t i = 0; i < numShapes; ++i) {
+		Shape* shape = shapeList->m_Shapes[i];
+		if (shape->m_Type == ShapeType::Group) {
+			boundsJobCollect(job, &shape->m_ShapeList);
+		} else if (shape->m_Type == ShapeType::Path && shape->m_Path.m_Commands != nullptr && shape->m_Path.m_NumCommands > kBoundsPathRangeSize) {
+			const uint32_t numCommands = shape->m_Path.m_NumCommands;
+			for (uint32_t cmd = 0; cmd < numCommands; cmd += kBoundsPathRangeSize) {
+				boundsJobAddItem(job, shape, cmd, bx::min<uint32_t>(cmd + kBoundsPathRangeSize, numCommands));
+			}
+		} else {
+			boundsJobAddItem(job, shape, 0, 0);
+		}
+	}
+}
+
+static void boundsJobRun(uint32_t begin, uint32_t end, void* userData)
+{
+	BoundsJob* job = (BoundsJob*)userData;
+
+	for (uint32_t i = begin; i < end; ++i) {
+		BoundsWorkItem* item = &job->m_Items[i];
+		if (item->m_CmdEnd == 0) {
+			shapeUpdateBounds(item->m_Shape);
+		} else {
+			pathCalcBoundsRange(&item->m_Shape->m_Path, item->m_CmdBegin, item->m_CmdEnd, &item->m_Bounds[0]);
+		}
+	}
+}
+
+// Same as shapeListCalcBounds() but the bounds of the leaf shapes are calculated in parallel on the
+// scheduler of shapeList's context (see contextGetScheduler()), with large paths split into ranges
+// of commands. The work is split the same way whatever the number of threads and partial results
+// are merged in document order, so the result is identical to shapeListCalcBounds().
+void shapeListCalcBoundsParallel(ShapeList* shapeList, float* bounds)
+{
+	Context* ctx = contextOrDefault(shapeList->m_Context);
+	SchedulerI* scheduler = contextGetScheduler(ctx);
+	if (scheduler->getNumThreads() == 1) {
+		shapeListCalcBoundsInternal(shapeList, bounds, true);
+		return;
+	}
+
+	BoundsJob job;
+	bx::memSet(&job, 0, sizeof(BoundsJob));
+	job.m_Allocator = ctx->m_Allocator;
+
+	boundsJobCollect(&job, shapeList);
+
+	scheduler->parallelFor(job.m_NumItems, kBoundsItemsPerTask, boundsJobRun, &job);
+
+	// Merge the ranges of split paths. Ranges of the same path are consecutive.
+	for (uint32_t i = 0; i < job.m_NumItems; ++i) {
+		const BoundsWorkItem* item = &job.m_Items[i];
+		if (item->m_CmdEnd == 0) {
+			continue;
+		}
+
+		float* pathBounds = &item->m_Shape->m_BoundingRect[0];
+		if (item->m_CmdBegin == 0) {
+			bx::memCopy(pathBounds, &item->m_Bounds[0], sizeof(float) * 4);
+		} else {
+			pathBounds[0] = bx::min<float>(pathBounds[0], item->m_Bounds[0]);
+			pathBounds[1] = bx::min<float>(pathBounds[1], item->m_Bounds[1]);
+			pathBounds[2] = bx::max<float>(pathBounds[2], item->m_Bounds[2]);
+			pathBounds[3] = bx::max<float>(pathBounds[3], item->m_Bounds[3]);
+		}
+	}
+
+	BX_FREE(job.m_Allocator, job.m_Items);
+
+	shapeListCalcBoundsInternal(shapeList, bounds, false);
+}
+
 PathCmd* pathAllocCommands(Path* path, uint32_t n)
 {
+	bx::AllocatorI* allocator = allocatorOrDefault(path->m_Allocator);
+
+	if (path->m_Packed) {
+		pathUnpack(path);
+	}
+
 	if (path->m_NumCommands + n > path->m_Capacity) {
 		const uint32_t oldCapacity = path->m_Capacity;
 		const uint32_t newCapacity = oldCapacity ? (oldCapacity * 3) / 2 : 4;
 
 		path->m_Capacity = bx::max<uint32_t>(newCapacity, oldCapacity + n);
-		path->m_Commands = (PathCmd*)BX_REALLOC(s_Allocator, path->m_Commands, sizeof(PathCmd) * path->m_Capacity);
+		path->m_Commands = (PathCmd*)BX_REALLOC(allocator, path->m_Commands, sizeof(PathCmd) * path->m_Capacity);
 		bx::memSet(&path->m_Commands[oldCapacity], 0, sizeof(PathCmd) * (path->m_Capacity - oldCapacity));
 	}
 
@@ -264,205 +759,518 @@ PathCmd* pathInsertCommands(Path* path, uint32_t at, uint32_t n)
 
 void pathShrinkToFit(Path* path)
 {
+	bx::AllocatorI* allocator = allocatorOrDefault(path->m_Allocator);
+
+	if (path->m_Packed) {
+		return;
+	}
+
 	if (!path->m_NumCommands && path->m_Capacity) {
-		BX_FREE(s_Allocator, path->m_Commands);
+		BX_FREE(allocator, path->m_Commands);
 		path->m_Commands = nullptr;
 		path->m_Capacity = 0;
 	} else if (path->m_NumCommands != path->m_Capacity) {
-		path->m_Commands = (PathCmd*)BX_REALLOC(s_Allocator, path->m_Commands, sizeof(PathCmd) * path->m_NumCommands);
+		path->m_Commands = (PathCmd*)BX_REALLOC(allocator, path->m_Commands, sizeof(PathCmd) * path->m_NumCommands);
 		path->m_Capacity = path->m_NumCommands;
 	}
 }
 
 void pathFree(Path* path)
 {
-	BX_FREE(s_Allocator, path->m_Commands);
+	bx::AllocatorI* allocator = allocatorOrDefault(path->m_Allocator);
+
+	BX_FREE(allocator, path->m_Commands);
+	BX_FREE(allocator, path->m_Packed);
 	path->m_Commands = nullptr;
+	path->m_Packed = nullptr;
 	path->m_NumCommands = 0;
 	path->m_Capacity = 0;
+	path->m_PackedSize = 0;
 }
 
-inline uint32_t solveQuad(float a, float b, float c, float* t)
-{
-	if (bx::abs(a) < 1e-5f) {
-		if (bx::abs(b) > 1e-5f) {
-			t[0] = -c / b;
-			return 1;
-		}
-	} else {
-		const float desc = b * b - 4.0f * a * c;
-		if (bx::abs(desc) > 1e-5f) {
-			const float desc_sqrt = bx::sqrt(desc);
-			t[0] = (-b + desc_sqrt) / (2.0f * a);
-			t[1] = (-b - desc_sqrt) / (2.0f * a);
+// Packed path layout (per command):
+// - 1 byte verb: PathCmdType in bits [0, 2], ArcTo large-arc-flag in bit 3 and sweep-flag in bit 4.
+// - Points: zig-zag varint delta of the quantized coordinate from the previous point's coordinate.
+// - ArcTo radii and x-axis-rotation: zig-zag varint of the quantized absolute value.
+static const uint8_t kPathCmdNumPoints[] = {
+	1, // MoveTo
+	1, // LineTo
+	3, // CubicTo
+	2, // QuadraticTo
+	1, // ArcTo
+	0, // ClosePath
+};
 
-			return 2;
-		}
-	}
+static const uint32_t kPathPackedMaxCmdSize = 1 + 7 * 5;
+static const float kPathPackMaxQuantized = 1073741824.0f; // 2^30, so deltas fit in an int32
 
-	return 0;
+inline uint32_t zigZagEncode(int32_t v)
+{
+	return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
 }
 
-inline void evalCubicBezierAt(float t, const float* p0, const float* p1, const float* p2, const float* p3, float* p)
+inline int32_t zigZagDecode(uint32_t v)
 {
-	const float t2 = t * t;
-	const float t3 = t2 * t;
-	const float one_t = 1.0f - t;
-	const float one_t2 = one_t * one_t;
-	const float one_t3 = one_t2 * one_t;
+	return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
 
-	const float a = one_t3;
-	const float b = 3.0f * t * one_t2;
-	const float c = 3.0f * t2 * one_t;
-	const float d = t3;
+inline uint8_t* packVarint(uint8_t* ptr, uint32_t v)
+{
+	while (v >= 0x80) {
+		*ptr++ = (uint8_t)(v | 0x80);
+		v >>= 7;
+	}
+	*ptr++ = (uint8_t)v;
 
-	p[0] = a * p0[0] + b * p1[0] + c * p2[0] + d * p3[0];
-	p[1] = a * p0[1] + b * p1[1] + c * p2[1] + d * p3[1];
+	return ptr;
 }
 
-inline void evalQuadraticBezierAt(float t, const float* p0, const float* p1, const float* p2, float* p)
+inline const uint8_t* unpackVarint(const uint8_t* ptr, uint32_t* v)
 {
-	const float t2 = t * t;
-	const float one_t = 1.0f - t;
-	const float one_t2 = one_t * one_t;
-
-	const float a = one_t2;
-	const float b = 2.0f * one_t * t;
-	const float c = t2;
+	uint32_t res = *ptr++;
+	if (res >= 0x80) {
+		res &= 0x7F;
+
+		uint32_t shift = 7;
+		uint32_t b;
+		do {
+			b = *ptr++;
+			res |= (b & 0x7F) << shift;
+			shift += 7;
+		} while (b >= 0x80);
+	}
 
-	p[0] = a * p0[0] + b * p1[0] + c * p2[0];
-	p[1] = a * p0[1] + b * p1[1] + c * p2[1];
+	*v = res;
+	return ptr;
 }
 
-void pathCalcBounds(const Path* path, float* bounds)
+inline bool packQuantize(float v, float scale, int32_t* q)
 {
-	const uint32_t numCommands = path->m_NumCommands;
-	if (!numCommands) {
-		// No commands -> invalid bounding rect
-		bounds[0] = bounds[1] = FLT_MAX;
-		bounds[2] = bounds[3] = -FLT_MAX;
-		return;
+	// NOTE: The product is rounded in double; in float it already loses the last digit past 2^23 steps.
+	const double s = (double)v * (double)scale;
+	if (!(s > -(double)kPathPackMaxQuantized && s < (double)kPathPackMaxQuantized)) {
+		return false;
 	}
 
-	const PathCmd* cmd = path->m_Commands;
-	SSVG_CHECK(cmd->m_Type == PathCmdType::MoveTo, "First path command must be MoveTo");
-	bounds[0] = bounds[2] = cmd->m_Data[0];
-	bounds[1] = bounds[3] = cmd->m_Data[1];
+	*q = (int32_t)(s < 0.0 ? s - 0.5 : s + 0.5);
+	return true;
+}
 
-	float last[2] = { cmd->m_Data[0], cmd->m_Data[1] };
-	for (uint32_t iCmd = 1; iCmd < numCommands; ++iCmd) {
-		cmd = &path->m_Commands[iCmd];
-
-		switch (cmd->m_Type) {
-		case PathCmdType::MoveTo:
-		case PathCmdType::LineTo:
-			bounds[0] = bx::min<float>(bounds[0], cmd->m_Data[0]);
-			bounds[1] = bx::min<float>(bounds[1], cmd->m_Data[1]);
-			bounds[2] = bx::max<float>(bounds[2], cmd->m_Data[0]);
-			bounds[3] = bx::max<float>(bounds[3], cmd->m_Data[1]);
-
-			last[0] = cmd->m_Data[0];
-			last[1] = cmd->m_Data[1];
-			break;
-		case PathCmdType::CubicTo:
-		{
-			// Bezier end point
-			bounds[0] = bx::min<float>(bounds[0], cmd->m_Data[4]);
-			bounds[1] = bx::min<float>(bounds[1], cmd->m_Data[5]);
-			bounds[2] = bx::max<float>(bounds[2], cmd->m_Data[4]);
-			bounds[3] = bx::max<float>(bounds[3], cmd->m_Data[5]);
-
-			// Extremities
-			for (uint32_t dim = 0; dim < 2; ++dim) {
-				const float c0 = last[dim];
-				const float c1 = cmd->m_Data[dim + 0];
-				const float c2 = cmd->m_Data[dim + 2];
-				const float c3 = cmd->m_Data[dim + 4];
-
-				const float a = 3.0f * (-c0 + 3.0f * (c1 - c2) + c3);
-				const float b = 6.0f * (c0 - 2.0f * c1 + c2);
-				const float c = 3.0f * (c1 - c0);
-
-				float root[2] = { -1.0f, -1.0f }; // Max 2 roots
-				uint32_t numRoots = solveQuad(a, b, c, &root[0]);
-
-				for (uint32_t iRoot = 0; iRoot < numRoots; ++iRoot) {
-					const float t = root[iRoot];
-					if (t > 1e-5f && t < (1.0f - 1e-5f)) {
-						float pos[2];
-						evalCubicBezierAt(t, &last[0], &cmd->m_Data[0], &cmd->m_Data[2], &cmd->m_Data[4], &pos[0]);
-
-						bounds[0] = bx::min<float>(bounds[0], pos[0]);
-						bounds[1] = bx::min<float>(bounds[1], pos[1]);
-						bounds[2] = bx::max<float>(bounds[2], pos[0]);
-						bounds[3] = bx::max<float>(bounds[3], pos[1]);
-					}
+// Quantizes coordinates with the specified number of steps per unit (e.g. 1000 keeps 3 decimal
+// digits). This is lossy: coordinates are rounded to the nearest 1/scale, and only values with at
+// most that many digits and |v * scale| < 2^24 decode to the exact same float. Past 2^24 steps the
+// decoded value can be off by one float ulp of the coordinate. Returns false and leaves the path
+// untouched if |v * scale| reaches 2^30 or the path is too long for a 32-bit packed size.
+bool pathPack(Path* path, float scale)
+{
+	bx::AllocatorI* allocator = allocatorOrDefault(path->m_Allocator);
+
+	if (path->m_Packed) {
+		if (path->m_PackedScale == scale) {
+			return true;
+		}
+
+		pathUnpack(path);
+	}
+
+	const uint32_t numCommands = path->m_NumCommands;
+	if (!numCommands) {
+		return true;
+	}
+
+	// NOTE: The worst case size wraps around in 32 bits at ~119M commands, and the packed size has to fit m_PackedSize.
+	const uint64_t maxPackedSize = (uint64_t)numCommands * kPathPackedMaxCmdSize;
+	if (maxPackedSize > UINT32_MAX) {
+		return false;
+	}
+
+	uint8_t* packed = (uint8_t*)BX_ALLOC(allocator, (size_t)maxPackedSize);
+	if (!packed) {
+		return false;
+	}
+
+	uint8_t* ptr = packed;
+	int32_t last[2] = { 0, 0 };
+	for (uint32_t iCmd = 0; iCmd < numCommands; ++iCmd) {
+		const PathCmd* cmd = &path->m_Commands[iCmd];
+		const PathCmdType::Enum type = cmd->m_Type;
+		SSVG_CHECK(type <= PathCmdType::ClosePath, "Unknown path command");
+
+		const float* data = &cmd->m_Data[0];
+		uint32_t verb = (uint32_t)type;
+		if (type == PathCmdType::ArcTo) {
+			verb |= (data[3] != 0.0f ? 1u : 0u) << 3;
+			verb |= (data[4] != 0.0f ? 1u : 0u) << 4;
+		}
+		*ptr++ = (uint8_t)verb;
+
+		if (type == PathCmdType::ArcTo) {
+			for (uint32_t i = 0; i < 3; ++i) {
+				int32_t q;
+				if (!packQuantize(data[i], scale, &q)) {
+					BX_FREE(allocator, packed);
+					return false;
 				}
+
+				ptr = packVarint(ptr, zigZagEncode(q));
 			}
 
-			last[0] = cmd->m_Data[4];
-			last[1] = cmd->m_Data[5];
+			data = &data[5];
 		}
-		break;
-		case PathCmdType::QuadraticTo:
-			// Bezier end point
-			bounds[0] = bx::min<float>(bounds[0], cmd->m_Data[2]);
-			bounds[1] = bx::min<float>(bounds[1], cmd->m_Data[3]);
-			bounds[2] = bx::max<float>(bounds[2], cmd->m_Data[2]);
-			bounds[3] = bx::max<float>(bounds[3], cmd->m_Data[3]);
 
-			// Extremities
-			for (uint32_t dim = 0; dim < 2; ++dim) {
-				const float c0 = last[dim];
-				const float c1 = cmd->m_Data[dim + 0];
-				const float c2 = cmd->m_Data[dim + 2];
+		const uint32_t numPoints = kPathCmdNumPoints[type];
+		for (uint32_t i = 0; i < numPoints * 2; ++i) {
+			int32_t q;
+			if (!packQuantize(data[i], scale, &q)) {
+				BX_FREE(allocator, packed);
+				return false;
+			}
+
+			ptr = packVarint(ptr, zigZagEncode(q - last[i & 1]));
+			last[i & 1] = q;
+		}
+	}
+
+	const uint32_t packedSize = (uint32_t)(ptr - packed);
+	packed = (uint8_t*)BX_REALLOC(allocator, packed, packedSize);
+
+	BX_FREE(allocator, path->m_Commands);
+	path->m_Commands = nullptr;
+	path->m_Capacity = 0;
+	path->m_Packed = packed;
+	path->m_PackedSize = packedSize;
+	path->m_PackedScale = scale;
+
+	return true;
+}
+
+void pathUnpack(Path* path)
+{
+	bx::AllocatorI* allocator = allocatorOrDefault(path->m_Allocator);
+
+	if (!path->m_Packed) {
+		return;
+	}
+
+	const uint32_t numCommands = path->m_NumCommands;
+	PathCmd* commands = (PathCmd*)BX_ALLOC(allocator, sizeof(PathCmd) * numCommands);
+	bx::memSet(commands, 0, sizeof(PathCmd) * numCommands);
+
+	PathIterator iter;
+	pathIterInit(&iter, path);
+	for (uint32_t iCmd = 0; iCmd < numCommands; ++iCmd) {
+		bx::memCopy(&commands[iCmd], pathIterNext(&iter), sizeof(PathCmd));
+	}
+
+	BX_FREE(allocator, path->m_Packed);
+	path->m_Packed = nullptr;
+	path->m_PackedSize = 0;
+	path->m_Commands = commands;
+	path->m_Capacity = numCommands;
+}
+
+void pathIterInit(PathIterator* iter, const Path* path)
+{
+	iter->m_Path = path;
+	iter->m_Ptr = path->m_Packed;
+	iter->m_CmdID = 0;
+	iter->m_Last[0] = 0;
+	iter->m_Last[1] = 0;
+}
+
+// Returns nullptr after the last command. The returned command is only valid until the next call.
+const PathCmd* pathIterNext(PathIterator* iter)
+{
+	const Path* path = iter->m_Path;
+	if (iter->m_CmdID == path->m_NumCommands) {
+		return nullptr;
+	}
+
+	const uint32_t cmdID = iter->m_CmdID++;
+	if (!path->m_Packed) {
+		return &path->m_Commands[cmdID];
+	}
+
+	// NOTE: Dividing (instead of multiplying by the reciprocal) is what makes decimal
+	// coordinates round-trip exactly.
+	const float scale = path->m_PackedScale;
+	const uint8_t* ptr = iter->m_Ptr;
+	const uint32_t verb = *ptr++;
+	const PathCmdType::Enum type = (PathCmdType::Enum)(verb & 0x07);
+
+	PathCmd* cmd = &iter->m_Cmd;
+	cmd->m_Type = type;
+
+	float* data = &cmd->m_Data[0];
+	if (type == PathCmdType::ArcTo) {
+		for (uint32_t i = 0; i < 3; ++i) {
+			uint32_t v;
+			ptr = unpackVarint(ptr, &v);
+			data[i] = (float)zigZagDecode(v) / scale;
+		}
+		data[3] = (float)((verb >> 3) & 1);
+		data[4] = (float)((verb >> 4) & 1);
+
+		data = &data[5];
+	}
+
+	const uint32_t numPoints = kPathCmdNumPoints[type];
+	for (uint32_t i = 0; i < numPoints; ++i) {
+		uint32_t vx, vy;
+		ptr = unpackVarint(ptr, &vx);
+		ptr = unpackVarint(ptr, &vy);
+		iter->m_Last[0] += zigZagDecode(vx);
+		iter->m_Last[1] += zigZagDecode(vy);
+		data[i * 2 + 0] = (float)iter->m_Last[0] / scale;
+		data[i * 2 + 1] = (float)iter->m_Last[1] / scale;
+	}
+
+	iter->m_Ptr = ptr;
+
+	return cmd;
+}
+
+inline uint32_t solveQuad(float a, float b, float c, float* t)
+{
+	if (bx::abs(a) < 1e-5f) {
+		if (bx::abs(b) > 1e-5f) {
+			t[0] = -c / b;
+			return 1;
+		}
+	} else {
+		const float desc = b * b - 4.0f * a * c;
+		if (bx::abs(desc) > 1e-5f) {
+			const float desc_sqrt = bx::sqrt(desc);
+			t[0] = (-b + desc_sqrt) / (2.0f * a);
+			t[1] = (-b - desc_sqrt) / (2.0f * a);
+
+			return 2;
+		}
+	}
 
-				// dBezier(2,t)/dt = 2 * (a * t + b)
-				const float a = (c2 - c1);
-				const float b = (c1 - c0);
+	return 0;
+}
 
-				if (bx::abs(a) > 1e-5f) {
-					const float t = -b / a;
+inline void evalCubicBezierAt(float t, const float* p0, const float* p1, const float* p2, const float* p3, float* p)
+{
+	const float t2 = t * t;
+	const float t3 = t2 * t;
+	const float one_t = 1.0f - t;
+	const float one_t2 = one_t * one_t;
+	const float one_t3 = one_t2 * one_t;
 
-					if (t > 1e-5f && t < (1.0f - 1e-5f)) {
-						float pos[2];
-						evalQuadraticBezierAt(t, &last[0], &cmd->m_Data[0], &cmd->m_Data[2], &pos[0]);
+	const float a = one_t3;
+	const float b = 3.0f * t * one_t2;
+	const float c = 3.0f * t2 * one_t;
+	const float d = t3;
 
-						bounds[0] = bx::min<float>(bounds[0], pos[0]);
-						bounds[1] = bx::min<float>(bounds[1], pos[1]);
-						bounds[2] = bx::max<float>(bounds[2], pos[0]);
-						bounds[3] = bx::max<float>(bounds[3], pos[1]);
-					}
+	p[0] = a * p0[0] + b * p1[0] + c * p2[0] + d * p3[0];
+	p[1] = a * p0[1] + b * p1[1] + c * p2[1] + d * p3[1];
+}
+
+inline void evalQuadraticBezierAt(float t, const float* p0, const float* p1, const float* p2, float* p)
+{
+	const float t2 = t * t;
+	const float one_t = 1.0f - t;
+	const float one_t2 = one_t * one_t;
+
+	const float a = one_t2;
+	const float b = 2.0f * one_t * t;
+	const float c = t2;
+
+	p[0] = a * p0[0] + b * p1[0] + c * p2[0];
+	p[1] = a * p0[1] + b * p1[1] + c * p2[1];
+}
+
+// Grows bounds by the segment from last to the end point of cmd, including the extremities
+// of curves, and moves last to the end point.
+static void pathCmdExpandBounds(const PathCmd* cmd, float* last, float* bounds)
+{
+	switch (cmd->m_Type) {
+	case PathCmdType::MoveTo:
+	case PathCmdType::LineTo:
+		bounds[0] = bx::min<float>(bounds[0], cmd->m_Data[0]);
+		bounds[1] = bx::min<float>(bounds[1], cmd->m_Data[1]);
+		bounds[2] = bx::max<float>(bounds[2], cmd->m_Data[0]);
+		bounds[3] = bx::max<float>(bounds[3], cmd->m_Data[1]);
+
+		last[0] = cmd->m_Data[0];
+		last[1] = cmd->m_Data[1];
+		break;
+	case PathCmdType::CubicTo:
+	{
+		// Bezier end point
+		bounds[0] = bx::min<float>(bounds[0], cmd->m_Data[4]);
+		bounds[1] = bx::min<float>(bounds[1], cmd->m_Data[5]);
+		bounds[2] = bx::max<float>(bounds[2], cmd->m_Data[4]);
+		bounds[3] = bx::max<float>(bounds[3], cmd->m_Data[5]);
+
+		// Extremities
+		for (uint32_t dim = 0; dim < 2; ++dim) {
+			const float c0 = last[dim];
+			const float c1 = cmd->m_Data[dim + 0];
+			const float c2 = cmd->m_Data[dim + 2];
+			const float c3 = cmd->m_Data[dim + 4];
+
+			const float a = 3.0f * (-c0 + 3.0f * (c1 - c2) + c3);
+			const float b = 6.0f * (c0 - 2.0f * c1 + c2);
+			const float c = 3.0f * (c1 - c0);
+
+			float root[2] = { -1.0f, -1.0f }; // Max 2 roots
+			uint32_t numRoots = solveQuad(a, b, c, &root[0]);
+
+			for (uint32_t iRoot = 0; iRoot < numRoots; ++iRoot) {
+				const float t = root[iRoot];
+				if (t > 1e-5f && t < (1.0f - 1e-5f)) {
+					float pos[2];
+					evalCubicBezierAt(t, &last[0], &cmd->m_Data[0], &cmd->m_Data[2], &cmd->m_Data[4], &pos[0]);
+
+					bounds[0] = bx::min<float>(bounds[0], pos[0]);
+					bounds[1] = bx::min<float>(bounds[1], pos[1]);
+					bounds[2] = bx::max<float>(bounds[2], pos[0]);
+					bounds[3] = bx::max<float>(bounds[3], pos[1]);
 				}
 			}
+		}
 
-			last[0] = cmd->m_Data[2];
-			last[1] = cmd->m_Data[3];
-			break;
-		case PathCmdType::ArcTo:
-			// TODO: Find the true bounds of the arc.
+		last[0] = cmd->m_Data[4];
+		last[1] = cmd->m_Data[5];
+	}
+	break;
+	case PathCmdType::QuadraticTo:
+		// Bezier end point
+		bounds[0] = bx::min<float>(bounds[0], cmd->m_Data[2]);
+		bounds[1] = bx::min<float>(bounds[1], cmd->m_Data[3]);
+		bounds[2] = bx::max<float>(bounds[2], cmd->m_Data[2]);
+		bounds[3] = bx::max<float>(bounds[3], cmd->m_Data[3]);
+
+		// Extremities
+		for (uint32_t dim = 0; dim < 2; ++dim) {
+			const float c0 = last[dim];
+			const float c1 = cmd->m_Data[dim + 0];
+			const float c2 = cmd->m_Data[dim + 2];
+
+			// dBezier(2,t)/dt = 2 * (a * t + b)
+			const float a = (c2 - c1);
+			const float b = (c1 - c0);
+
+			if (bx::abs(a) > 1e-5f) {
+				const float t = -b / a;
+
+				if (t > 1e-5f && t < (1.0f - 1e-5f)) {
+					float pos[2];
+					evalQuadraticBezierAt(t, &last[0], &cmd->m_Data[0], &cmd->m_Data[2], &pos[0]);
+
+					bounds[0] = bx::min<float>(bounds[0], pos[0]);
+					bounds[1] = bx::min<float>(bounds[1], pos[1]);
+					bounds[2] = bx::max<float>(bounds[2], pos[0]);
+					bounds[3] = bx::max<float>(bounds[3], pos[1]);
+				}
+			}
+		}
 
-			// End point
-			bounds[0] = bx::min<float>(bounds[0], cmd->m_Data[5]);
-			bounds[1] = bx::min<float>(bounds[1], cmd->m_Data[6]);
-			bounds[2] = bx::max<float>(bounds[2], cmd->m_Data[5]);
-			bounds[3] = bx::max<float>(bounds[3], cmd->m_Data[6]);
+		last[0] = cmd->m_Data[2];
+		last[1] = cmd->m_Data[3];
+		break;
+	case PathCmdType::ArcTo:
+		// TODO: Find the true bounds of the arc.
 
-			last[0] = cmd->m_Data[5];
-			last[1] = cmd->m_Data[6];
-			break;
-		case PathCmdType::ClosePath:
-			// Noop
-			break;
-		default:
-			SSVG_CHECK(false, "Unknown path command");
+		// End point
+		bounds[0] = bx::min<float>(bounds[0], cmd->m_Data[5]);
+		bounds[1] = bx::min<float>(bounds[1], cmd->m_Data[6]);
+		bounds[2] = bx::max<float>(bounds[2], cmd->m_Data[5]);
+		bounds[3] = bx::max<float>(bounds[3], cmd->m_Data[6]);
+
+		last[0] = cmd->m_Data[5];
+		last[1] = cmd->m_Data[6];
+		break;
+	case PathCmdType::ClosePath:
+		// Noop
+		break;
+	default:
+		SSVG_CHECK(false, "Unknown path command");
+		break;
+	}
+}
+
+// Returns false for commands which don't move the current point (i.e. ClosePath).
+static bool pathCmdGetEndPoint(const PathCmd* cmd, float* pos)
+{
+	uint32_t offset = 0;
+	switch (cmd->m_Type) {
+	case PathCmdType::MoveTo:
+	case PathCmdType::LineTo:
+		offset = 0;
+		break;
+	case PathCmdType::QuadraticTo:
+		offset = 2;
+		break;
+	case PathCmdType::CubicTo:
+		offset = 4;
+		break;
+	case PathCmdType::ArcTo:
+		offset = 5;
+		break;
+	default:
+		return false;
+	}
+
+	pos[0] = cmd->m_Data[offset + 0];
+	pos[1] = cmd->m_Data[offset + 1];
+
+	return true;
+}
+
+void pathCalcBounds(const Path* path, float* bounds)
+{
+	const uint32_t numCommands = path->m_NumCommands;
+	if (!numCommands) {
+		// No commands -> invalid bounding rect
+		bounds[0] = bounds[1] = FLT_MAX;
+		bounds[2] = bounds[3] = -FLT_MAX;
+		return;
+	}
+
+	PathIterator iter;
+	pathIterInit(&iter, path);
+
+	const PathCmd* cmd = pathIterNext(&iter);
+	SSVG_CHECK(cmd->m_Type == PathCmdType::MoveTo, "First path command must be MoveTo");
+	bounds[0] = bounds[2] = cmd->m_Data[0];
+	bounds[1] = bounds[3] = cmd->m_Data[1];
+
+	float last[2] = { cmd->m_Data[0], cmd->m_Data[1] };
+	while ((cmd = pathIterNext(&iter)) != nullptr) {
+		pathCmdExpandBounds(cmd, &last[0], bounds);
+	}
+}
+
+// Bounds of commands [begin, end) of an unpacked path. Merging the bounds of consecutive ranges
+// gives the same result as pathCalcBounds() on the whole path.
+static void pathCalcBoundsRange(const Path* path, uint32_t begin, uint32_t end, float* bounds)
+{
+	SSVG_CHECK(path->m_Commands != nullptr, "Path must be unpacked");
+
+	bounds[0] = bounds[1] = FLT_MAX;
+	bounds[2] = bounds[3] = -FLT_MAX;
+
+	// NOTE: Segments start at the end point of the closest preceding command which has one.
+	float last[2] = { 0.0f, 0.0f };
+	for (uint32_t i = begin; i > 0; --i) {
+		if (pathCmdGetEndPoint(&path->m_Commands[i - 1], &last[0])) {
 			break;
 		}
 	}
+
+	for (uint32_t i = begin; i < end; ++i) {
+		pathCmdExpandBounds(&path->m_Commands[i], &last[0], bounds);
+	}
 }
 
 float* pointListAllocPoints(PointList* ptList, uint32_t n)
 {
+	bx::AllocatorI* allocator = allocatorOrDefault(ptList->m_Allocator);
+
 	SSVG_CHECK(n != 0, "Requested invalid number of points");
 
 	if (ptList->m_NumPoints + n > ptList->m_Capacity) {
@@ -470,7 +1278,7 @@ float* pointListAllocPoints(PointList* ptList, uint32_t n)
 		const uint32_t newCapacity = oldCapacity ? (oldCapacity * 3) / 2 : 8;
 
 		ptList->m_Capacity = bx::max<uint32_t>(newCapacity, oldCapacity + n);
-		ptList->m_Coords = (float*)BX_REALLOC(s_Allocator, ptList->m_Coords, sizeof(float) * 2 * ptList->m_Capacity);
+		ptList->m_Coords = (float*)BX_REALLOC(allocator, ptList->m_Coords, sizeof(float) * 2 * ptList->m_Capacity);
 	}
 
 	float* coords = &ptList->m_Coords[ptList->m_NumPoints << 1];
@@ -481,19 +1289,23 @@ float* pointListAllocPoints(PointList* ptList, uint32_t n)
 
 void pointListShrinkToFit(PointList* ptList)
 {
+	bx::AllocatorI* allocator = allocatorOrDefault(ptList->m_Allocator);
+
 	if (!ptList->m_NumPoints && ptList->m_Capacity) {
-		BX_FREE(s_Allocator, ptList->m_Coords);
+		BX_FREE(allocator, ptList->m_Coords);
 		ptList->m_Coords = nullptr;
 		ptList->m_Capacity = 0;
 	} else if (ptList->m_NumPoints != ptList->m_Capacity) {
-		ptList->m_Coords = (float*)BX_REALLOC(s_Allocator, ptList->m_Coords, sizeof(float) * 2 * ptList->m_NumPoints);
+		ptList->m_Coords = (float*)BX_REALLOC(allocator, ptList->m_Coords, sizeof(float) * 2 * ptList->m_NumPoints);
 		ptList->m_Capacity = ptList->m_NumPoints;
 	}
 }
 
 void pointListFree(PointList* ptList)
 {
-	BX_FREE(s_Allocator, ptList->m_Coords);
+	bx::AllocatorI* allocator = allocatorOrDefault(ptList->m_Allocator);
+
+	BX_FREE(allocator, ptList->m_Coords);
 	ptList->m_Coords = 0;
 	ptList->m_NumPoints = 0;
 	ptList->m_Capacity = 0;
@@ -529,6 +1341,8 @@ void shapeAttrsSetID(ShapeAttributes* attrs, const bx::StringView& value)
 	SSVG_WARN((int32_t)maxLen >= value.getLength(), "id \"%.*s\" truncated to %d characters", value.getLength(), value.getPtr(), maxLen);
 	bx::memCopy(&attrs->m_ID[0], value.getPtr(), maxLen);
 	attrs->m_ID[maxLen] = '\0';
+	attrs->m_IDRef.m_Ptr = nullptr;
+	attrs->m_IDRef.m_Length = 0;
 }
 
 void shapeAttrsSetFontFamily(ShapeAttributes* attrs, const bx::StringView& value)
@@ -537,6 +1351,8 @@ void shapeAttrsSetFontFamily(ShapeAttributes* attrs, const bx::StringView& value
 	SSVG_WARN((int32_t)maxLen >= value.getLength(), "font-family \"%.*s\" truncated to %d characters", value.getLength(), value.getPtr(), maxLen);
 	bx::memCopy(&attrs->m_FontFamily[0], value.getPtr(), maxLen);
 	attrs->m_FontFamily[maxLen] = '\0';
+	attrs->m_FontFamilyRef.m_Ptr = nullptr;
+	attrs->m_FontFamilyRef.m_Length = 0;
 }
 
 void shapeAttrsSetClass(ShapeAttributes* attrs, const bx::StringView& value)
@@ -547,43 +1363,406 @@ void shapeAttrsSetClass(ShapeAttributes* attrs, const bx::StringView& value)
 	bx::memCopy(&attrs->m_Class[0], value.getPtr(), maxLen);
 	attrs->m_Class[maxLen] = '\0';
 #else
-	BX_UNUSED(attrs, value);
+	BX_UNUSED(value);
 #endif
+	attrs->m_ClassRef.m_Ptr = nullptr;
+	attrs->m_ClassRef.m_Length = 0;
+}
+
+// Returns the string ref if set (ImageLoadFlags::BorrowStrings) or the inline string otherwise.
+static bx::StringView stringRefOr(const StringRef& ref, const char* str)
+{
+	return ref.m_Ptr != nullptr
+		? bx::StringView(ref.m_Ptr, (int32_t)ref.m_Length)
+		: bx::StringView(str)
+		;
+}
+
+bx::StringView shapeAttrsGetID(const ShapeAttributes* attrs)
+{
+	return stringRefOr(attrs->m_IDRef, attrs->m_ID);
 }
 
-Image* imageCreate(const ShapeAttributes* baseAttrs)
-{
-	Image* img = (Image*)BX_ALLOC(s_Allocator, sizeof(Image));
-	bx::memSet(img, 0, sizeof(Image));
-	bx::memCopy(&img->m_BaseAttrs, baseAttrs, sizeof(ShapeAttributes));
+bx::StringView shapeAttrsGetFontFamily(const ShapeAttributes* attrs)
+{
+	return stringRefOr(attrs->m_FontFamilyRef, attrs->m_FontFamily);
+}
+
+bx::StringView shapeAttrsGetClass(const ShapeAttributes* attrs)
+{
+#if SSVG_CONFIG_CLASS_MAX_LEN
+	return stringRefOr(attrs->m_ClassRef, attrs->m_Class);
+#else
+	return stringRefOr(attrs->m_ClassRef, "");
+#endif
+}
+
+// Replaces borrowed strings with copies in the attributes' own buffers, truncated like the setters do.
+static void shapeAttrsOwnStrings(ShapeAttributes* attrs)
+{
+	if (attrs->m_IDRef.m_Ptr != nullptr) {
+		shapeAttrsSetID(attrs, bx::StringView(attrs->m_IDRef.m_Ptr, (int32_t)attrs->m_IDRef.m_Length));
+	}
+
+	if (attrs->m_FontFamilyRef.m_Ptr != nullptr) {
+		shapeAttrsSetFontFamily(attrs, bx::StringView(attrs->m_FontFamilyRef.m_Ptr, (int32_t)attrs->m_FontFamilyRef.m_Length));
+	}
+
+	if (attrs->m_ClassRef.m_Ptr != nullptr) {
+		shapeAttrsSetClass(attrs, bx::StringView(attrs->m_ClassRef.m_Ptr, (int32_t)attrs->m_ClassRef.m_Length));
+	}
+}
+
+// NOTE: If ctx is nullptr the default context (see initLib()) is used.
+Image* imageCreate(const ShapeAttributes* baseAttrs, Context* ctx)
+{
+	ctx = contextOrDefault(ctx);
+
+	Image* img = (Image*)BX_ALLOC(ctx->m_Allocator, sizeof(Image));
+	bx::memSet(img, 0, sizeof(Image));
+	img->m_Context = ctx;
+	img->m_ShapeList.m_Context = ctx;
+	bx::memCopy(&img->m_BaseAttrs, baseAttrs, sizeof(ShapeAttributes));
+
+	return img;
+}
+
+void imageDestroy(Image* img)
+{
+	bx::AllocatorI* allocator = img->m_Context->m_Allocator;
+
+	imageSnapshotRelease(img->m_LastSnapshot);
+	imageTrackDirtyRegions(img, false);
+	shapeListFree(&img->m_ShapeList);
+	BX_FREE(allocator, img->m_StringPool);
+	BX_FREE(allocator, img);
+}
+
+// Size of the string pool shapeAttrsDetachStrings() needs for attrs.
+static uint32_t shapeAttrsStringPoolSize(const ShapeAttributes* attrs)
+{
+	const StringRef* refs[] = {
+		&attrs->m_IDRef,
+		&attrs->m_FontFamilyRef,
+		&attrs->m_ClassRef
+	};
+
+	uint32_t size = 0;
+	for (uint32_t i = 0; i < BX_COUNTOF(refs); ++i) {
+		if (refs[i]->m_Ptr != nullptr) {
+			size += refs[i]->m_Length + 1;
+		}
+	}
+
+	return size;
+}
+
+static uint32_t shapeListStringPoolSize(const ShapeList* shapeList)
+{
+	uint32_t size = 0;
+
+	const uint32_t numShapes = shapeList->m_NumShapes;
+	for (uint32_t i = 0; i < numShapes; ++i) {
+		const Shape* shape = shapeList->m_Shapes[i];
+		size += shapeAttrsStringPoolSize(shape->m_Attrs);
+
+		if (shape->m_Type == ShapeType::Group) {
+			size += shapeListStringPoolSize(&shape->m_ShapeList);
+		}
+	}
+
+	return size;
+}
+
+// Copies all borrowed strings of attrs to pool and points the refs at the copies. Returns the number of bytes used.
+static uint32_t shapeAttrsDetachStrings(ShapeAttributes* attrs, char* pool)
+{
+	StringRef* refs[] = {
+		&attrs->m_IDRef,
+		&attrs->m_FontFamilyRef,
+		&attrs->m_ClassRef
+	};
+
+	uint32_t size = 0;
+	for (uint32_t i = 0; i < BX_COUNTOF(refs); ++i) {
+		StringRef* ref = refs[i];
+		if (ref->m_Ptr == nullptr) {
+			continue;
+		}
+
+		bx::memCopy(&pool[size], ref->m_Ptr, ref->m_Length);
+		pool[size + ref->m_Length] = '\0';
+		ref->m_Ptr = &pool[size];
+
+		size += ref->m_Length + 1;
+	}
+
+	return size;
+}
+
+static uint32_t shapeListDetachStrings(ShapeList* shapeList, char* pool)
+{
+	uint32_t size = 0;
+
+	const uint32_t numShapes = shapeList->m_NumShapes;
+	for (uint32_t i = 0; i < numShapes; ++i) {
+		Shape* shape = shapeList->m_Shapes[i];
+		size += shapeAttrsDetachStrings(shape->m_Attrs, &pool[size]);
+
+		if (shape->m_Type == ShapeType::Group) {
+			size += shapeListDetachStrings(&shape->m_ShapeList, &pool[size]);
+		}
+	}
+
+	return size;
+}
+
+void imageDetachSource(Image* img)
+{
+	bx::AllocatorI* allocator = img->m_Context->m_Allocator;
+
+	if (img->m_Source == nullptr) {
+		return;
+	}
+
+	// Copy all borrowed strings into a single block owned by the image.
+	const uint32_t poolSize = 0
+		+ shapeAttrsStringPoolSize(&img->m_BaseAttrs)
+		+ shapeListStringPoolSize(&img->m_ShapeList);
+
+	char* oldPool = img->m_StringPool;
+	char* pool = nullptr;
+	if (poolSize != 0) {
+		pool = (char*)BX_ALLOC(allocator, poolSize);
+
+		const uint32_t baseSize = shapeAttrsDetachStrings(&img->m_BaseAttrs, pool);
+		shapeListDetachStrings(&img->m_ShapeList, &pool[baseSize]);
+	}
+
+	img->m_StringPool = pool;
+	img->m_Source = nullptr;
+
+	BX_FREE(allocator, oldPool);
+}
+
+static void shapeListCalcMemoryUsage(const ShapeList* shapeList, ImageMemoryUsage* report)
+{
+	const uint32_t numShapes = shapeList->m_NumShapes;
+	report->m_NumShapes += numShapes;
+	report->m_AttrBytes += sizeof(ShapeAttributes) * numShapes;
+
+	report->m_ShapeBytes += sizeof(Shape*) * shapeList->m_Capacity;
+	report->m_ShapeBytes += sizeof(ShapeChunk*) * shapeList->m_NumChunks;
+	report->m_ShapeUnusedBytes += sizeof(Shape*) * (shapeList->m_Capacity - numShapes);
+
+	uint32_t numSlots = 0;
+	const uint32_t numChunks = shapeList->m_NumChunks;
+	for (uint32_t i = 0; i < numChunks; ++i) {
+		const uint32_t chunkSlots = shapeList->m_Chunks[i]->m_NumSlots;
+		report->m_ShapeBytes += bx::strideAlign(sizeof(ShapeChunk), 16) + (sizeof(Shape) + sizeof(uint32_t)) * chunkSlots;
+		numSlots += chunkSlots;
+	}
+	report->m_ShapeUnusedBytes += (sizeof(Shape) + sizeof(uint32_t)) * (numSlots - numShapes);
+
+	for (uint32_t i = 0; i < numShapes; ++i) {
+		const Shape* shape = shapeList->m_Shapes[i];
+
+		switch (shape->m_Type) {
+		case ShapeType::Group:
+			shapeListCalcMemoryUsage(&shape->m_ShapeList, report);
+			break;
+		case ShapeType::Polyline:
+		case ShapeType::Polygon:
+		{
+			const PointList* ptList = &shape->m_PointList;
+			report->m_PointListBytes += sizeof(float) * 2 * ptList->m_Capacity;
+			report->m_PointListUnusedBytes += sizeof(float) * 2 * (ptList->m_Capacity - ptList->m_NumPoints);
+		}
+		break;
+		case ShapeType::Path:
+		{
+			const Path* path = &shape->m_Path;
+			if (path->m_Packed) {
+				report->m_PathBytes += path->m_PackedSize;
+			} else {
+				report->m_PathBytes += sizeof(PathCmd) * path->m_Capacity;
+				report->m_PathUnusedBytes += sizeof(PathCmd) * (path->m_Capacity - path->m_NumCommands);
+			}
+		}
+		break;
+		case ShapeType::Text:
+			if (shape->m_Text.m_String) {
+				report->m_TextBytes += bx::strLen(shape->m_Text.m_String) + 1;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+void imageCalcMemoryUsage(const Image* img, ImageMemoryUsage* report, bool attrPool)
+{
+	bx::memSet(report, 0, sizeof(ImageMemoryUsage));
+
+	report->m_ImageBytes = sizeof(Image) + (img->m_ShapeList.m_DirtyRegions ? sizeof(DirtyRegions) : 0);
+	shapeListCalcMemoryUsage(&img->m_ShapeList, report);
+
+	if (img->m_StringPool) {
+		// NOTE: The string pool holds exactly the strings the refs point to (see imageDetachSource()).
+		report->m_StringPoolBytes = 0
+			+ shapeAttrsStringPoolSize(&img->m_BaseAttrs)
+			+ shapeListStringPoolSize(&img->m_ShapeList);
+	}
+
+	report->m_TotalBytes = 0
+		+ report->m_ImageBytes
+		+ report->m_ShapeBytes
+		+ report->m_AttrBytes
+		+ report->m_PathBytes
+		+ report->m_PointListBytes
+		+ report->m_TextBytes
+		+ report->m_StringPoolBytes;
+
+	if (!attrPool) {
+		return;
+	}
+
+	const Context* ctx = img->m_Context;
+	const uint32_t numCaches = bx::min<uint32_t>(ctx->m_NumAttrCaches, SSVG_CONFIG_CONTEXT_MAX_THREADS);
+	for (uint32_t i = 0; i < numCaches; ++i) {
+		const ShapeAttributeCache* cache = ctx->m_AttrCaches[i];
+		if (cache == nullptr) {
+			continue;
+		}
+
+		report->m_AttrPoolBytes += bx::strideAlign(sizeof(ShapeAttributeCache), BX_CACHE_LINE_SIZE);
+
+		// NOTE: Slots freed by other threads and not reclaimed yet aren't counted as unused.
+		const ShapeAttributeFreeListNode* node = cache->m_Batches;
+		while (node) {
+			report->m_NumAttrPoolBatches++;
+			report->m_AttrPoolBytes += sizeof(ShapeAttributeFreeListNode) + sizeof(ShapeAttributeSlot) * node->m_NumAttrs;
+			report->m_AttrPoolUnusedBytes += sizeof(ShapeAttributeSlot) * node->m_NumFree;
+
+			node = node->m_Next;
+		}
+	}
+
+	report->m_AttrPoolBytes += sizeof(SharedAttributeCache);
+
+	const ShapeAttributeFreeListNode* node = ctx->m_SharedAttrCache->m_Cache.m_Batches;
+	while (node) {
+		report->m_NumAttrPoolBatches++;
+		report->m_AttrPoolBytes += sizeof(ShapeAttributeFreeListNode) + sizeof(ShapeAttributeSlot) * node->m_NumAttrs;
+		report->m_AttrPoolUnusedBytes += sizeof(ShapeAttributeSlot) * node->m_NumFree;
+
+		node = node->m_Next;
+	}
+}
+
+void initLib(bx::AllocatorI* allocator)
+{
+	s_DefaultContext = contextCreate(allocator);
+}
+
+void shutdownLib()
+{
+	contextDestroy(s_DefaultContext);
+	s_DefaultContext = nullptr;
+}
+
+// NOTE: Contexts are padded to a cache line so contexts used by different threads never share one.
+Context* contextCreate(bx::AllocatorI* allocator)
+{
+	Context* ctx = (Context*)BX_ALIGNED_ALLOC(allocator, bx::strideAlign(sizeof(Context), BX_CACHE_LINE_SIZE), BX_CACHE_LINE_SIZE);
+	SSVG_CHECK(ctx != nullptr, "Failed to allocate context");
+
+	bx::memSet(ctx, 0, sizeof(Context));
+	ctx->m_Allocator = allocator;
+	ctx->m_ID = bx::atomicInc<uint32_t>(&s_NextContextID);
+
+	SharedAttributeCache* shared = BX_NEW(allocator, SharedAttributeCache);
+	shared->m_Cache.m_Batches = nullptr;
+	shared->m_Cache.m_Context = ctx;
+	shared->m_Cache.m_ThreadID = kSharedAttrCacheThreadID;
+	ctx->m_SharedAttrCache = shared;
+
+	{
+		bx::MutexScope lock(s_ContextListMutex);
+		ctx->m_NextContext = s_ContextList;
+		s_ContextList = ctx;
+	}
+
+	return ctx;
+}
+
+void contextDestroy(Context* ctx)
+{
+	bx::AllocatorI* allocator = ctx->m_Allocator;
+
+	// NOTE: Shut down the worker threads first; they might still hold on to attribute caches.
+	if (ctx->m_DefaultScheduler != nullptr) {
+		schedulerDestroy(ctx->m_DefaultScheduler);
+		ctx->m_DefaultScheduler = nullptr;
+	}
+
+	// NOTE: Exiting threads detach themselves under the same lock, so they can't touch the caches after this.
+	{
+		bx::MutexScope lock(s_ContextListMutex);
+		Context** prev = &s_ContextList;
+		while (*prev != ctx) {
+			prev = &(*prev)->m_NextContext;
+		}
+		*prev = ctx->m_NextContext;
+	}
+
+	const uint32_t numCaches = bx::min<uint32_t>(ctx->m_NumAttrCaches, SSVG_CONFIG_CONTEXT_MAX_THREADS);
+	for (uint32_t i = 0; i < numCaches; ++i) {
+		ShapeAttributeCache* cache = ctx->m_AttrCaches[i];
+		if (cache == nullptr) {
+			continue;
+		}
 
-	return img;
-}
+		shapeAttrsDestroyCache(allocator, cache);
+		BX_ALIGNED_FREE(allocator, cache, BX_CACHE_LINE_SIZE);
+	}
 
-void imageDestroy(Image* img)
-{
-	shapeListFree(&img->m_ShapeList);
-	BX_FREE(s_Allocator, img);
+	shapeAttrsDestroyCache(allocator, &ctx->m_SharedAttrCache->m_Cache);
+	BX_DELETE(allocator, ctx->m_SharedAttrCache);
+
+	if (s_LastAttrCacheContextID == ctx->m_ID) {
+		s_LastAttrCache = nullptr;
+		s_LastAttrCacheContextID = 0;
+	}
+
+	BX_ALIGNED_FREE(allocator, ctx, BX_CACHE_LINE_SIZE);
 }
 
-void initLib(bx::AllocatorI* allocator)
+void contextSetScheduler(Context* ctx, SchedulerI* scheduler)
 {
-	s_Allocator = allocator;
-	s_ShapeAttrFreeListHead = nullptr;
+	ctx = contextOrDefault(ctx);
+	ctx->m_Scheduler = scheduler;
 }
 
-void shutdownLib()
+// Returns the registered scheduler, or the built-in pool, which is created the first time a context
+// without a registered scheduler needs one.
+SchedulerI* contextGetScheduler(Context* ctx)
 {
-	ShapeAttributeFreeListNode* node = s_ShapeAttrFreeListHead;
-	while (node) {
-		ShapeAttributeFreeListNode* next = node->m_Next;
-
-		BX_FREE(s_Allocator, node->m_Attrs);
-		BX_FREE(s_Allocator, node);
+	ctx = contextOrDefault(ctx);
+	if (ctx->m_Scheduler != nullptr) {
+		return ctx->m_Scheduler;
+	}
 
-		node = next;
+	if (ctx->m_DefaultScheduler == nullptr) {
+		SchedulerI* scheduler = schedulerCreate(ctx->m_Allocator, 0);
+		if (bx::atomicCompareAndSwap<SchedulerI*>(&ctx->m_DefaultScheduler, nullptr, scheduler) != nullptr) {
+			// NOTE: Another thread got here first.
+			schedulerDestroy(scheduler);
+		}
 	}
-	s_ShapeAttrFreeListHead = nullptr;
+
+	return ctx->m_DefaultScheduler;
 }
 
 bool shapeCopy(Shape* dst, const Shape* src, bool copyAttrs)
@@ -594,6 +1773,9 @@ bool shapeCopy(Shape* dst, const Shape* src, bool copyAttrs)
 	bx::memCopy(&dst->m_BoundingRect[0], &src->m_BoundingRect[0], sizeof(float) * 4);
 	if (copyAttrs) {
 		bx::memCopy(dst->m_Attrs, src->m_Attrs, sizeof(ShapeAttributes));
+
+		// NOTE: Borrowed strings point into the source's XML, which nothing ties to the copy.
+		shapeAttrsOwnStrings(dst->m_Attrs);
 	}
 
 	switch (type) {
@@ -606,7 +1788,7 @@ bool shapeCopy(Shape* dst, const Shape* src, bool copyAttrs)
 		shapeListReserve(dstShapeList, numShapes);
 
 		for (uint32_t i = 0; i < numShapes; ++i) {
-			const Shape* srcShape = &srcShapeList->m_Shapes[i];
+			const Shape* srcShape = srcShapeList->m_Shapes[i];
 			Shape* dstShape = shapeListAllocShape(dstShapeList, srcShape->m_Type, nullptr);
 			shapeCopy(dstShape, srcShape);
 		}
@@ -637,8 +1819,16 @@ bool shapeCopy(Shape* dst, const Shape* src, bool copyAttrs)
 		const uint32_t numCommands = srcPath->m_NumCommands;
 
 		Path* dstPath = &dst->m_Path;
-		PathCmd* dstCommands = pathAllocCommands(dstPath, numCommands);
-		bx::memCopy(dstCommands, srcPath->m_Commands, sizeof(PathCmd) * numCommands);
+		if (srcPath->m_Packed) {
+			dstPath->m_Packed = (uint8_t*)BX_ALLOC(allocatorOrDefault(dstPath->m_Allocator), srcPath->m_PackedSize);
+			bx::memCopy(dstPath->m_Packed, srcPath->m_Packed, srcPath->m_PackedSize);
+			dstPath->m_PackedSize = srcPath->m_PackedSize;
+			dstPath->m_PackedScale = srcPath->m_PackedScale;
+			dstPath->m_NumCommands = numCommands;
+		} else {
+			PathCmd* dstCommands = pathAllocCommands(dstPath, numCommands);
+			bx::memCopy(dstCommands, srcPath->m_Commands, sizeof(PathCmd) * numCommands);
+		}
 	}
 	break;
 	case ShapeType::Text:
@@ -651,7 +1841,7 @@ bool shapeCopy(Shape* dst, const Shape* src, bool copyAttrs)
 		dstText->m_Anchor = srcText->m_Anchor;
 
 		const uint32_t len = bx::strLen(srcText->m_String);
-		dstText->m_String = (char*)BX_ALLOC(s_Allocator, sizeof(char) * (len + 1));
+		dstText->m_String = (char*)BX_ALLOC(allocatorOrDefault(dstText->m_Allocator), sizeof(char) * (len + 1));
 		bx::memCopy(dstText->m_String, srcText->m_String, len);
 		dstText->m_String[len] = '\0';
 	}
@@ -678,7 +1868,7 @@ void shapeFree(Shape* shape)
 		pointListFree(&shape->m_PointList);
 		break;
 	case ShapeType::Text:
-		BX_FREE(s_Allocator, shape->m_Text.m_String);
+		BX_FREE(allocatorOrDefault(shape->m_Text.m_Allocator), shape->m_Text.m_String);
 		shape->m_Text.m_String = nullptr;
 		break;
 	default:
@@ -739,24 +1929,451 @@ void shapeUpdateBounds(Shape* shape)
 	bx::memCopy(&shape->m_BoundingRect[0], &bounds[0], sizeof(float) * 4);
 }
 
+static inline float rectArea(const float* rect)
+{
+	return (rect[2] - rect[0]) * (rect[3] - rect[1]);
+}
+
+static inline void rectUnion(float* dst, const float* rect)
+{
+	dst[0] = bx::min<float>(dst[0], rect[0]);
+	dst[1] = bx::min<float>(dst[1], rect[1]);
+	dst[2] = bx::max<float>(dst[2], rect[2]);
+	dst[3] = bx::max<float>(dst[3], rect[3]);
+}
+
+static inline bool rectContains(const float* outer, const float* inner)
+{
+	return outer[0] <= inner[0] && outer[1] <= inner[1] && outer[2] >= inner[2] && outer[3] >= inner[3];
+}
+
+static float rectUnionGrowth(const float* a, const float* b)
+{
+	float u[4] = { a[0], a[1], a[2], a[3] };
+	rectUnion(&u[0], b);
+	return rectArea(&u[0]) - rectArea(a) - rectArea(b);
+}
+
+// NOTE: Unlike transformBoundingRect() all 4 corners are transformed, so the result also covers rotated rects.
+static void dirtyTransformRect(const float* transform, const float* localRect, float* globalRect)
+{
+	const float corners[4][2] = {
+		{ localRect[0], localRect[1] },
+		{ localRect[2], localRect[1] },
+		{ localRect[0], localRect[3] },
+		{ localRect[2], localRect[3] }
+	};
+
+	float rect[4] = { FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (uint32_t i = 0; i < 4; ++i) {
+		float pt[2];
+		transformPoint(transform, &corners[i][0], &pt[0]);
+		rect[0] = bx::min<float>(rect[0], pt[0]);
+		rect[1] = bx::min<float>(rect[1], pt[1]);
+		rect[2] = bx::max<float>(rect[2], pt[0]);
+		rect[3] = bx::max<float>(rect[3], pt[1]);
+	}
+
+	bx::memCopy(globalRect, &rect[0], sizeof(float) * 4);
+}
+
+// Drops rects covered by others. Once the list is full, the new rect is merged into the one it grows the least.
+static void dirtyRegionsAdd(DirtyRegions* dirty, const float* rect)
+{
+	// NOTE: Also rejects NaNs and the inverted bounds of empty groups. Single points (e.g. new shapes
+	// without geometry) don't cover any pixels.
+	if (dirty->m_All || !(rect[0] <= rect[2] && rect[1] <= rect[3]) || (rect[0] == rect[2] && rect[1] == rect[3])) {
+		return;
+	}
+
+	for (uint32_t i = 0; i < dirty->m_NumRects; ) {
+		if (rectContains(&dirty->m_Rects[i][0], rect)) {
+			return;
+		}
+
+		if (rectContains(rect, &dirty->m_Rects[i][0])) {
+			bx::memCopy(&dirty->m_Rects[i][0], &dirty->m_Rects[--dirty->m_NumRects][0], sizeof(float) * 4);
+		} else {
+			++i;
+		}
+	}
+
+	if (dirty->m_NumRects < SSVG_CONFIG_DIRTY_REGIONS_MAX) {
+		bx::memCopy(&dirty->m_Rects[dirty->m_NumRects++][0], rect, sizeof(float) * 4);
+		return;
+	}
+
+	uint32_t best = 0;
+	float bestGrowth = FLT_MAX;
+	for (uint32_t i = 0; i < dirty->m_NumRects; ++i) {
+		const float growth = rectUnionGrowth(&dirty->m_Rects[i][0], rect);
+		if (growth < bestGrowth) {
+			bestGrowth = growth;
+			best = i;
+		}
+	}
+
+	rectUnion(&dirty->m_Rects[best][0], rect);
+}
+
+void imageTrackDirtyRegions(Image* img, bool enable)
+{
+	bx::AllocatorI* allocator = img->m_Context->m_Allocator;
+
+	ShapeList* shapeList = &img->m_ShapeList;
+	if (!enable) {
+		BX_FREE(allocator, shapeList->m_DirtyRegions);
+		shapeList->m_DirtyRegions = nullptr;
+		return;
+	}
+
+	if (shapeList->m_DirtyRegions) {
+		return;
+	}
+
+	shapeList->m_DirtyRegions = (DirtyRegions*)BX_ALLOC(allocator, sizeof(DirtyRegions));
+	bx::memSet(shapeList->m_DirtyRegions, 0, sizeof(DirtyRegions));
+
+	// Regions are made of the shapes' bounds, so they have to be up to date.
+	shapeListCalcBounds(shapeList, &img->m_BoundingRect[0]);
+}
+
+uint32_t imageTakeDirtyRegions(Image* img, float* rects, uint32_t maxRects)
+{
+	SSVG_CHECK(maxRects != 0, "Invalid number of rects");
+
+	DirtyRegions* dirty = img->m_ShapeList.m_DirtyRegions;
+	if (!dirty || maxRects == 0) {
+		return 0;
+	}
+
+	if (dirty->m_All) {
+		rects[0] = -FLT_MAX;
+		rects[1] = -FLT_MAX;
+		rects[2] = FLT_MAX;
+		rects[3] = FLT_MAX;
+		dirty->m_All = false;
+		dirty->m_NumRects = 0;
+		return 1;
+	}
+
+	// Merge the pair which grows the covered area the least until the rects fit.
+	while (dirty->m_NumRects > maxRects) {
+		uint32_t bestA = 0;
+		uint32_t bestB = 1;
+		float bestGrowth = FLT_MAX;
+		for (uint32_t a = 0; a < dirty->m_NumRects; ++a) {
+			for (uint32_t b = a + 1; b < dirty->m_NumRects; ++b) {
+				const float growth = rectUnionGrowth(&dirty->m_Rects[a][0], &dirty->m_Rects[b][0]);
+				if (growth < bestGrowth) {
+					bestGrowth = growth;
+					bestA = a;
+					bestB = b;
+				}
+			}
+		}
+
+		rectUnion(&dirty->m_Rects[bestA][0], &dirty->m_Rects[bestB][0]);
+		bx::memCopy(&dirty->m_Rects[bestB][0], &dirty->m_Rects[--dirty->m_NumRects][0], sizeof(float) * 4);
+	}
+
+	const uint32_t numRects = dirty->m_NumRects;
+	bx::memCopy(rects, &dirty->m_Rects[0][0], sizeof(float) * 4 * numRects);
+	dirty->m_NumRects = 0;
+
+	return numRects;
+}
+
+void imageAddDirtyRegion(Image* img, const float* rect)
+{
+	DirtyRegions* dirty = img->m_ShapeList.m_DirtyRegions;
+	if (!dirty) {
+		return;
+	}
+
+	if (!rect) {
+		dirty->m_All = true;
+		dirty->m_NumRects = 0;
+		return;
+	}
+
+	dirtyRegionsAdd(dirty, rect);
+}
+
+// Transforms the shape's bounds up to image space. Groups on the way grow to cover them, so they stay
+// conservative without recalculating the bounds of all their children.
+void shapeAddDirtyRegion(Shape* shape, ShapeList* shapeList)
+{
+	const ShapeList* topList = shapeList;
+	while (topList->m_ParentList) {
+		topList = topList->m_ParentList;
+	}
+
+	DirtyRegions* dirty = topList->m_DirtyRegions;
+	if (!dirty) {
+		return;
+	}
+
+	// NOTE: Text has no bounds yet (see shapeUpdateBounds()).
+	if (shape->m_Type == ShapeType::Text) {
+		dirty->m_All = true;
+		dirty->m_NumRects = 0;
+		return;
+	}
+
+	float rect[4];
+	dirtyTransformRect(&shape->m_Attrs->m_Transform[0], &shape->m_BoundingRect[0], &rect[0]);
+
+	while (shapeList->m_ParentList) {
+		Shape* group = (Shape*)((uint8_t*)shapeList - offsetof(Shape, m_ShapeList));
+		rectUnion(&group->m_BoundingRect[0], &rect[0]);
+		dirtyTransformRect(&group->m_Attrs->m_Transform[0], &rect[0], &rect[0]);
+		shapeList = shapeList->m_ParentList;
+	}
+
+	// NOTE: The top-level list is the first member of its image.
+	Image* img = (Image*)((uint8_t*)shapeList - offsetof(Image, m_ShapeList));
+	rectUnion(&img->m_BoundingRect[0], &rect[0]);
+
+	dirtyRegionsAdd(dirty, &rect[0]);
+}
+
+void shapeBeginEdit(Shape* shape, ShapeList* shapeList)
+{
+	shapeAddDirtyRegion(shape, shapeList);
+}
+
+void shapeEndEdit(Shape* shape, ShapeList* shapeList)
+{
+	if (shape->m_Type == ShapeType::Group) {
+		shapeListCalcBoundsInternal(&shape->m_ShapeList, &shape->m_BoundingRect[0], false);
+	} else {
+		shapeUpdateBounds(shape);
+	}
+
+	shapeInvalidateHash(shape, shapeList);
+	shapeAddDirtyRegion(shape, shapeList);
+}
+
+static uint32_t getThreadID()
+{
+	if (s_ThreadID == 0) {
+		s_ThreadID = bx::getTid();
+	}
+
+	return s_ThreadID;
+}
+
+// Returns the calling thread's cache, creating it on first use. Caches are only ever appended
+// to the context, so looking one up doesn't need a lock. Returns the shared cache if all slots are taken.
+static ShapeAttributeCache* shapeAttrsGetCache(Context* ctx)
+{
+	if (s_LastAttrCacheContextID == ctx->m_ID) {
+		return s_LastAttrCache;
+	}
+
+	const uint32_t threadID = getThreadID();
+
+	ShapeAttributeCache* cache = nullptr;
+	const uint32_t numCaches = bx::min<uint32_t>(ctx->m_NumAttrCaches, SSVG_CONFIG_CONTEXT_MAX_THREADS);
+	for (uint32_t i = 0; i < numCaches; ++i) {
+		ShapeAttributeCache* c = ctx->m_AttrCaches[i];
+		if (c != nullptr && c->m_ThreadID == threadID) {
+			cache = c;
+			break;
+		}
+	}
+
+	for (uint32_t i = 0; i < numCaches && cache == nullptr; ++i) {
+		ShapeAttributeCache* c = ctx->m_AttrCaches[i];
+		if (c != nullptr && c->m_ThreadID == 0 && bx::atomicCompareAndSwap<uint32_t>(&c->m_ThreadID, 0, threadID) == 0) {
+			cache = c;
+		}
+	}
+
+	if (cache == nullptr) {
+		uint32_t id = ctx->m_NumAttrCaches;
+		while (id < SSVG_CONFIG_CONTEXT_MAX_THREADS) {
+			const uint32_t prevID = bx::atomicCompareAndSwap<uint32_t>(&ctx->m_NumAttrCaches, id, id + 1);
+			if (prevID == id) {
+				break;
+			}
+
+			id = prevID;
+		}
+
+		if (id >= SSVG_CONFIG_CONTEXT_MAX_THREADS) {
+			// NOTE: Not remembered, so the thread adopts a cache once another thread detaches.
+			return &ctx->m_SharedAttrCache->m_Cache;
+		}
+
+		cache = (ShapeAttributeCache*)BX_ALIGNED_ALLOC(ctx->m_Allocator, bx::strideAlign(sizeof(ShapeAttributeCache), BX_CACHE_LINE_SIZE), BX_CACHE_LINE_SIZE);
+		SSVG_CHECK(cache != nullptr, "Failed to allocate shape attribute cache");
+
+		cache->m_Batches = nullptr;
+		cache->m_Context = ctx;
+		cache->m_ThreadID = threadID;
+
+		// NOTE: Other threads only read m_ThreadID, so publishing the pointer after a barrier is enough.
+		bx::writeBarrier();
+		ctx->m_AttrCaches[id] = cache;
+	}
+
+	s_LastAttrCache = cache;
+	s_LastAttrCacheContextID = ctx->m_ID;
+	s_ThreadExitHook.m_Armed = true;
+
+	return cache;
+}
+
+// NOTE: Called by the thread itself. Its caches' remote frees are reclaimed and the batches still in
+// use are adopted by the shared cache, which is swept as well, so frees from threads which outlive
+// the owner are eventually returned too.
+static void contextDetachThreadCaches(Context* ctx, uint32_t threadID)
+{
+	ShapeAttributeCache* cache = nullptr;
+	const uint32_t numCaches = bx::min<uint32_t>(ctx->m_NumAttrCaches, SSVG_CONFIG_CONTEXT_MAX_THREADS);
+	for (uint32_t i = 0; i < numCaches; ++i) {
+		ShapeAttributeCache* c = ctx->m_AttrCaches[i];
+		if (c != nullptr && c->m_ThreadID == threadID) {
+			cache = c;
+			break;
+		}
+	}
+
+	SharedAttributeCache* shared = ctx->m_SharedAttrCache;
+	{
+		bx::MutexScope lock(shared->m_Mutex);
+
+		if (cache != nullptr) {
+			shapeAttrsTrimCache(cache);
+
+			ShapeAttributeFreeListNode* last = nullptr;
+			for (ShapeAttributeFreeListNode* node = cache->m_Batches; node != nullptr; node = node->m_Next) {
+				// NOTE: Frees racing with this read either pointer; neither cache matches their thread, so both push remotely.
+				bx::atomicExchangePtr((void**)&node->m_Cache, &shared->m_Cache);
+				last = node;
+			}
+
+			if (last != nullptr) {
+				last->m_Next = shared->m_Cache.m_Batches;
+				if (shared->m_Cache.m_Batches != nullptr) {
+					shared->m_Cache.m_Batches->m_Prev = last;
+				}
+				shared->m_Cache.m_Batches = cache->m_Batches;
+				cache->m_Batches = nullptr;
+			}
+		}
+
+		shapeAttrsTrimCache(&shared->m_Cache);
+	}
+
+	if (cache != nullptr) {
+		// NOTE: Full barrier; the adopting thread sees the emptied cache.
+		bx::atomicCompareAndSwap<uint32_t>(&cache->m_ThreadID, threadID, 0);
+	}
+}
+
+void contextDetachThread(Context* ctx)
+{
+	ctx = contextOrDefault(ctx);
+
+	contextDetachThreadCaches(ctx, getThreadID());
+
+	if (s_LastAttrCacheContextID == ctx->m_ID) {
+		s_LastAttrCache = nullptr;
+		s_LastAttrCacheContextID = 0;
+	}
+}
+
+ThreadExitHook::~ThreadExitHook()
+{
+	if (!m_Armed) {
+		return;
+	}
+
+	bx::MutexScope lock(s_ContextListMutex);
+	for (Context* ctx = s_ContextList; ctx != nullptr; ctx = ctx->m_NextContext) {
+		contextDetachThreadCaches(ctx, s_ThreadID);
+	}
+}
+
 static ShapeAttributes* shapeAttrsAllocFromNode(ShapeAttributeFreeListNode* node)
 {
 	SSVG_CHECK(node->m_FirstFreeID != UINT32_MAX, "No free slot in free list node. This function shouldn't have been called");
 
-	ShapeAttributes* attrs = &node->m_Attrs[node->m_FirstFreeID];
-	const uint32_t nextFreeID = *(uint32_t*)attrs;
+	ShapeAttributeSlot* slot = &node->m_Slots[node->m_FirstFreeID];
+	const uint32_t nextFreeID = *(uint32_t*)slot;
 
 	node->m_FirstFreeID = nextFreeID;
 	node->m_NumFree--;
 
-	return attrs;
+	return &slot->m_Attrs;
+}
+
+// Moves the slots freed by other threads to the local free list. Returns false if there were none.
+// NOTE: Remote frees only push and the owner always takes the whole list, so there's no ABA problem.
+static bool shapeAttrsReclaimRemote(ShapeAttributeFreeListNode* node)
+{
+	uint32_t firstID = node->m_RemoteFirstFreeID;
+	while (firstID != UINT32_MAX) {
+		const uint32_t prevID = bx::atomicCompareAndSwap<uint32_t>(&node->m_RemoteFirstFreeID, firstID, UINT32_MAX);
+		if (prevID == firstID) {
+			break;
+		}
+
+		firstID = prevID;
+	}
+
+	if (firstID == UINT32_MAX) {
+		return false;
+	}
+
+	uint32_t lastID = firstID;
+	uint32_t numReclaimed = 1;
+	uint32_t nextID = *(uint32_t*)&node->m_Slots[lastID];
+	while (nextID != UINT32_MAX) {
+		lastID = nextID;
+		nextID = *(uint32_t*)&node->m_Slots[lastID];
+		++numReclaimed;
+	}
+
+	*(uint32_t*)&node->m_Slots[lastID] = node->m_FirstFreeID;
+	node->m_FirstFreeID = firstID;
+	node->m_NumFree += numReclaimed;
+
+	return true;
+}
+
+static void shapeAttrsFreeBatch(ShapeAttributeCache* cache, ShapeAttributeFreeListNode* node)
+{
+	bx::AllocatorI* allocator = cache->m_Context->m_Allocator;
+
+	BX_FREE(allocator, node->m_Slots);
+
+	ShapeAttributeFreeListNode* prev = node->m_Prev;
+	ShapeAttributeFreeListNode* next = node->m_Next;
+	if (prev) {
+		prev->m_Next = next;
+	}
+	if (next) {
+		next->m_Prev = prev;
+	}
+
+	if (cache->m_Batches == node) {
+		cache->m_Batches = next;
+	}
+
+	BX_FREE(allocator, node);
 }
 
-static ShapeAttributes* shapeAttrsAlloc()
+static ShapeAttributes* shapeAttrsAllocFromCache(ShapeAttributeCache* cache)
 {
 	static const uint32_t kNumShapeAttributesPerBatch = 1024;
 
-	ShapeAttributeFreeListNode* node = s_ShapeAttrFreeListHead;
+	Context* ctx = cache->m_Context;
+
+	ShapeAttributeFreeListNode* node = cache->m_Batches;
 	while (node) {
 		if (node->m_FirstFreeID != UINT32_MAX) {
 			return shapeAttrsAllocFromNode(node);
@@ -765,67 +2382,139 @@ static ShapeAttributes* shapeAttrsAlloc()
 		node = node->m_Next;
 	}
 
-	node = (ShapeAttributeFreeListNode*)BX_ALLOC(s_Allocator, sizeof(ShapeAttributeFreeListNode));
+	// NOTE: Batches which turn out to be completely free (e.g. all the shapes of an image loaded on
+	// this thread were destroyed on another one) are released, except the one used for this allocation.
+	ShapeAttributeFreeListNode* freeNode = nullptr;
+	node = cache->m_Batches;
+	while (node) {
+		ShapeAttributeFreeListNode* next = node->m_Next;
+		if (shapeAttrsReclaimRemote(node)) {
+			if (freeNode == nullptr) {
+				freeNode = node;
+			} else if (node->m_NumFree == node->m_NumAttrs) {
+				shapeAttrsFreeBatch(cache, node);
+			}
+		}
+
+		node = next;
+	}
+
+	if (freeNode != nullptr) {
+		return shapeAttrsAllocFromNode(freeNode);
+	}
+
+	bx::AllocatorI* allocator = ctx->m_Allocator;
+
+	node = (ShapeAttributeFreeListNode*)BX_ALLOC(allocator, sizeof(ShapeAttributeFreeListNode));
 	SSVG_CHECK(node != nullptr, "Failed to allocate shape attributes");
 
-	node->m_Attrs = (ShapeAttributes*)BX_ALLOC(s_Allocator, sizeof(ShapeAttributes) * kNumShapeAttributesPerBatch);
+	node->m_Slots = (ShapeAttributeSlot*)BX_ALLOC(allocator, sizeof(ShapeAttributeSlot) * kNumShapeAttributesPerBatch);
+	node->m_Cache = cache;
 	node->m_NumAttrs = kNumShapeAttributesPerBatch;
-	node->m_Next = s_ShapeAttrFreeListHead;
+	node->m_Next = cache->m_Batches;
 	node->m_Prev = nullptr;
 	node->m_NumFree = kNumShapeAttributesPerBatch;
+	node->m_RemoteFirstFreeID = UINT32_MAX;
 
 	node->m_FirstFreeID = 0;
-	for (uint32_t i = 0; i < kNumShapeAttributesPerBatch - 1; ++i) {
-		*(uint32_t*)&node->m_Attrs[i] = i + 1;
+	for (uint32_t i = 0; i < kNumShapeAttributesPerBatch; ++i) {
+		*(uint32_t*)&node->m_Slots[i] = i + 1;
+		node->m_Slots[i].m_Node = node;
 	}
-	*(uint32_t*)&node->m_Attrs[kNumShapeAttributesPerBatch - 1] = UINT32_MAX;
+	*(uint32_t*)&node->m_Slots[kNumShapeAttributesPerBatch - 1] = UINT32_MAX;
 
-	if (s_ShapeAttrFreeListHead != nullptr) {
-		s_ShapeAttrFreeListHead->m_Prev = node;
+	if (cache->m_Batches != nullptr) {
+		cache->m_Batches->m_Prev = node;
 	}
-	s_ShapeAttrFreeListHead = node;
-		
+	cache->m_Batches = node;
+
 	return shapeAttrsAllocFromNode(node);
 }
 
-static void shapeAttrsFree(ShapeAttributes* attrs)
+static ShapeAttributes* shapeAttrsAlloc(Context* ctx)
+{
+	ShapeAttributeCache* cache = shapeAttrsGetCache(ctx);
+
+	SharedAttributeCache* shared = ctx->m_SharedAttrCache;
+	if (cache != &shared->m_Cache) {
+		return shapeAttrsAllocFromCache(cache);
+	}
+
+	bx::MutexScope lock(shared->m_Mutex);
+	return shapeAttrsAllocFromCache(cache);
+}
+
+// Reclaims the remote frees of all the cache's batches and releases the ones which turn out to be
+// completely free. Must be called by the owner (or with the shared cache's mutex held).
+static void shapeAttrsTrimCache(ShapeAttributeCache* cache)
 {
-	// Find the free list node attrs belongs to
-	ShapeAttributeFreeListNode* node = s_ShapeAttrFreeListHead;
+	ShapeAttributeFreeListNode* node = cache->m_Batches;
 	while (node) {
-		if (attrs >= node->m_Attrs && attrs < node->m_Attrs + node->m_NumAttrs) {
-			break;
+		ShapeAttributeFreeListNode* next = node->m_Next;
+		if (shapeAttrsReclaimRemote(node) && node->m_NumFree == node->m_NumAttrs) {
+			shapeAttrsFreeBatch(cache, node);
 		}
 
-		node = node->m_Next;
+		node = next;
+	}
+}
+
+static void shapeAttrsDestroyCache(bx::AllocatorI* allocator, ShapeAttributeCache* cache)
+{
+	ShapeAttributeFreeListNode* node = cache->m_Batches;
+	while (node) {
+		ShapeAttributeFreeListNode* next = node->m_Next;
+
+		shapeAttrsReclaimRemote(node);
+		SSVG_WARN(node->m_NumFree == node->m_NumAttrs, "%u shape attributes outlive their context", node->m_NumAttrs - node->m_NumFree);
+
+		BX_FREE(allocator, node->m_Slots);
+		BX_FREE(allocator, node);
+
+		node = next;
 	}
 
-	SSVG_CHECK(node != nullptr, "Shape attributes not allocated via the free list (double deallocation?)");
+	cache->m_Batches = nullptr;
+}
+
+// NOTE: Each slot points back to its batch and each batch to its owner, so attributes can be freed
+// from any thread without knowing which context they were allocated from.
+static void shapeAttrsFree(ShapeAttributes* attrs)
+{
+	ShapeAttributeSlot* slot = (ShapeAttributeSlot*)attrs;
+	ShapeAttributeFreeListNode* node = slot->m_Node;
+	SSVG_CHECK(node != nullptr, "Shape attributes not allocated via the free list");
 
-	const uint32_t id = (uint32_t)(attrs - node->m_Attrs);
+	const uint32_t id = (uint32_t)(slot - node->m_Slots);
 	SSVG_CHECK(id < node->m_NumAttrs, "Index out of bounds");
 
-	*(uint32_t*)attrs = node->m_FirstFreeID;
-	node->m_FirstFreeID = id;
+	ShapeAttributeCache* cache = node->m_Cache;
+	if (cache->m_ThreadID != getThreadID()) {
+		// NOTE: Sweeps the shared cache when this thread exits (see contextDetachThreadCaches()).
+		s_ThreadExitHook.m_Armed = true;
 
-	node->m_NumFree++;
-	if (node->m_NumFree == node->m_NumAttrs) {
-		BX_FREE(s_Allocator, node->m_Attrs);
+		// NOTE: The batch can't go away while this slot is allocated, so it's safe to push to it.
+		uint32_t firstID = node->m_RemoteFirstFreeID;
+		for (;;) {
+			*(uint32_t*)slot = firstID;
 
-		ShapeAttributeFreeListNode* prev = node->m_Prev;
-		ShapeAttributeFreeListNode* next = node->m_Next;
-		if (prev) {
-			prev->m_Next = next;
-		}
-		if (next) {
-			next->m_Prev = prev;
-		}
+			const uint32_t prevID = bx::atomicCompareAndSwap<uint32_t>(&node->m_RemoteFirstFreeID, firstID, id);
+			if (prevID == firstID) {
+				break;
+			}
 
-		if (s_ShapeAttrFreeListHead == node) {
-			s_ShapeAttrFreeListHead = next;
+			firstID = prevID;
 		}
 
-		BX_FREE(s_Allocator, node);
+		return;
+	}
+
+	*(uint32_t*)slot = node->m_FirstFreeID;
+	node->m_FirstFreeID = id;
+
+	node->m_NumFree++;
+	if (node->m_NumFree == node->m_NumAttrs) {
+		shapeAttrsFreeBatch(cache, node);
 	}
 }
 } // namespace svg
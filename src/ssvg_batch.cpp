@@ -0,0 +1,138 @@
+#include <ssvg/ssvg.h>
+#include <bx/bx.h>
+#include <bx/cpu.h>
+#include <bx/string.h>
+#include <bx/timer.h>
+
+namespace ssvg
+{
+struct ImageLoadBatch
+{
+	const char* const* m_XMLStrs;
+	Image** m_Images;
+	ImageLoadError::Enum* m_Errors;
+	const ShapeAttributes* m_BaseAttrs;
+	Context* m_Context;
+	const ImageLoadLimits* m_Limits;
+	uint32_t m_Count;
+	uint32_t m_Flags;
+	volatile uint32_t m_NextID;
+};
+
+// NOTE: Padded so workers don't share cache lines while updating their counters.
+struct ImageLoadBatchWorker
+{
+	ImageLoadBatch* m_Batch;
+	uint64_t m_NumBytes;
+	uint32_t m_NumLoaded;
+	uint32_t m_NumFailed;
+	uint8_t m_Padding[BX_CACHE_LINE_SIZE];
+};
+
+// Documents are handed out one at a time so a few large documents don't leave the rest
+// of the workers idle.
+static void imageLoadBatchWork(ImageLoadBatchWorker* worker)
+{
+	ImageLoadBatch* batch = worker->m_Batch;
+
+	for (;;) {
+		const uint32_t id = bx::atomicFetchAndAdd<uint32_t>(&batch->m_NextID, 1);
+		if (id >= batch->m_Count) {
+			break;
+		}
+
+		const char* xmlStr = batch->m_XMLStrs[id];
+
+		ImageLoadError::Enum err = ImageLoadError::None;
+		Image* img = imageLoadWithLimits(xmlStr, batch->m_Flags, batch->m_BaseAttrs, batch->m_Context, batch->m_Limits, &err);
+
+		batch->m_Images[id] = img;
+		if (batch->m_Errors) {
+			batch->m_Errors[id] = err;
+		}
+
+		worker->m_NumBytes += xmlStr != nullptr ? bx::strLen(xmlStr) : 0;
+		if (img) {
+			worker->m_NumLoaded++;
+		} else {
+			worker->m_NumFailed++;
+		}
+	}
+}
+
+static void imageLoadBatchTask(void* userData)
+{
+	imageLoadBatchWork((ImageLoadBatchWorker*)userData);
+}
+
+// Loads count documents as numThreads tasks on ctx's scheduler (see contextGetScheduler()). Each task
+// allocates shape attributes from the cache of the thread it runs on, so ctx's allocator must be thread safe.
+// images[i] is nullptr if document i failed to load; errors[i] holds the reason. Returns the number of loaded images.
+// NOTE: numThreads == 0 uses all the scheduler's threads. limits, errors and stats can be nullptr.
+// If ctx is nullptr the default context is used.
+uint32_t imageLoadBatch(const char* const* xmlStrs, uint32_t count, uint32_t flags, const ShapeAttributes* baseAttrs, Context* ctx, const ImageLoadLimits* limits, uint32_t numThreads, Image** images, ImageLoadError::Enum* errors, ImageLoadBatchStats* stats)
+{
+	const int64_t startTime = bx::getHPCounter();
+
+	SchedulerI* scheduler = contextGetScheduler(ctx);
+	if (numThreads == 0) {
+		numThreads = scheduler->getNumThreads();
+	}
+
+	numThreads = bx::min<uint32_t>(numThreads, SSVG_CONFIG_CONTEXT_MAX_THREADS);
+	numThreads = bx::max<uint32_t>(bx::min<uint32_t>(numThreads, count), 1);
+
+	ImageLoadBatch batch;
+	batch.m_XMLStrs = xmlStrs;
+	batch.m_Images = images;
+	batch.m_Errors = errors;
+	batch.m_BaseAttrs = baseAttrs;
+	batch.m_Context = ctx;
+	batch.m_Limits = limits;
+	batch.m_Count = count;
+	batch.m_Flags = flags;
+	batch.m_NextID = 0;
+
+	ImageLoadBatchWorker workers[SSVG_CONFIG_CONTEXT_MAX_THREADS];
+	bx::memSet(&workers[0], 0, sizeof(ImageLoadBatchWorker) * numThreads);
+	for (uint32_t i = 0; i < numThreads; ++i) {
+		workers[i].m_Batch = &batch;
+	}
+
+	if (numThreads == 1) {
+		imageLoadBatchWork(&workers[0]);
+	} else {
+		TaskGroup group;
+		bx::memSet(&group, 0, sizeof(TaskGroup));
+
+		for (uint32_t i = 0; i < numThreads; ++i) {
+			scheduler->submit(&group, imageLoadBatchTask, &workers[i]);
+		}
+
+		scheduler->wait(&group);
+	}
+
+	uint32_t numLoaded = 0;
+	uint32_t numFailed = 0;
+	uint64_t numBytes = 0;
+	for (uint32_t i = 0; i < numThreads; ++i) {
+		numLoaded += workers[i].m_NumLoaded;
+		numFailed += workers[i].m_NumFailed;
+		numBytes += workers[i].m_NumBytes;
+	}
+
+	if (stats) {
+		const float timeSec = (float)((double)(bx::getHPCounter() - startTime) / (double)bx::getHPFrequency());
+
+		stats->m_NumBytes = numBytes;
+		stats->m_NumLoaded = numLoaded;
+		stats->m_NumFailed = numFailed;
+		stats->m_NumThreads = numThreads;
+		stats->m_TimeMsec = timeSec * 1000.0f;
+		stats->m_ImagesPerSec = timeSec > 0.0f ? (float)count / timeSec : 0.0f;
+		stats->m_MBytesPerSec = timeSec > 0.0f ? (float)((double)numBytes / (1024.0 * 1024.0)) / timeSec : 0.0f;
+	}
+
+	return numLoaded;
+}
+} // namespace ssvg
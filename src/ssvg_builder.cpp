@@ -1,5 +1,6 @@
 #include <ssvg/ssvg.h>
 #include <bx/bx.h>
+#include <bx/allocator.h>
 #include <bx/string.h>
 #include <bx/math.h>
 
@@ -7,7 +8,11 @@ BX_PRAGMA_DIAGNOSTIC_IGNORED_GCC("-Wmaybe-uninitialized")
 
 namespace ssvg
 {
+// NOTE: |delta angle| <= 2*pi is split into segments of at most 90 degrees (+1 for rounding).
+static const uint32_t kArcMaxCubics = 5;
+
 static void convertArcToBezier(Path* path, uint32_t cmdID, const float* arcToArgs, const float* lastPt);
+static uint32_t arcToCubics(const float* arcToArgs, const float* lastPt, PathCmd* cmds);
 
 uint32_t shapeListAddShape(ShapeList* shapeList, const Shape* shape)
 {
@@ -20,11 +25,12 @@ uint32_t shapeListAddShape(ShapeList* shapeList, const Shape* shape)
 
 	shapeCopy(newShape, shape, true);
 	shapeUpdateBounds(newShape);
+	shapeAddDirtyRegion(newShape, shapeList);
 
 	return shapeList->m_NumShapes - 1;
 }
 
-uint32_t shapeListAddGroup(ShapeList* shapeList, const ShapeAttributes* parentAttrs, const Shape* children, uint32_t numChildren)
+uint32_t shapeListAddGroup(ShapeList* shapeList, const ShapeAttributes* parentAttrs, const Shape* const* children, uint32_t numChildren)
 {
 	Shape* group = shapeListAllocShape(shapeList, ShapeType::Group, parentAttrs);
 	if (!group) {
@@ -32,18 +38,18 @@ uint32_t shapeListAddGroup(ShapeList* shapeList, const ShapeAttributes* parentAt
 	}
 
 	if (children && numChildren) {
-		// Create a temp group on the stack and use shapeCopy()
-		Shape tmpGroup;
-		bx::memSet(&tmpGroup, 0, sizeof(Shape));
-		tmpGroup.m_Type = ShapeType::Group;
-		tmpGroup.m_ShapeList.m_Shapes = (Shape*)children; // NOTE: Casting a const to not-const should be ok in this case since the tmpGroup is passed as const to shapeCopy().
-		tmpGroup.m_ShapeList.m_NumShapes = numChildren;
-		tmpGroup.m_ShapeList.m_Capacity = 0; // capacity < count == list is read-only (should assert in debug mode if you try to alloc/shrink the list).
+		ShapeList* groupShapeList = &group->m_ShapeList;
+		shapeListReserve(groupShapeList, numChildren);
 
-		shapeCopy(group, &tmpGroup, false);
+		for (uint32_t i = 0; i < numChildren; ++i) {
+			const Shape* child = children[i];
+			Shape* dstChild = shapeListAllocShape(groupShapeList, child->m_Type, nullptr);
+			shapeCopy(dstChild, child);
+		}
 	}
 
 	shapeUpdateBounds(group);
+	shapeAddDirtyRegion(group, shapeList);
 
 	return shapeList->m_NumShapes - 1;
 }
@@ -63,6 +69,7 @@ uint32_t shapeListAddRect(ShapeList* shapeList, const ShapeAttributes* parentAtt
 	rect->m_Rect.ry = ry;
 
 	shapeUpdateBounds(rect);
+	shapeAddDirtyRegion(rect, shapeList);
 
 	return shapeList->m_NumShapes - 1;
 }
@@ -79,6 +86,7 @@ uint32_t shapeListAddCircle(ShapeList* shapeList, const ShapeAttributes* parentA
 	circle->m_Circle.r = r;
 
 	shapeUpdateBounds(circle);
+	shapeAddDirtyRegion(circle, shapeList);
 
 	return shapeList->m_NumShapes - 1;
 }
@@ -96,6 +104,7 @@ uint32_t shapeListAddEllipse(ShapeList* shapeList, const ShapeAttributes* parent
 	ellipse->m_Ellipse.ry = ry;
 
 	shapeUpdateBounds(ellipse);
+	shapeAddDirtyRegion(ellipse, shapeList);
 
 	return shapeList->m_NumShapes - 1;
 }
@@ -113,6 +122,7 @@ uint32_t shapeListAddLine(ShapeList* shapeList, const ShapeAttributes* parentAtt
 	line->m_Line.y2 = y2;
 
 	shapeUpdateBounds(line);
+	shapeAddDirtyRegion(line, shapeList);
 
 	return shapeList->m_NumShapes - 1;
 }
@@ -130,6 +140,7 @@ uint32_t shapeListAddPolyline(ShapeList* shapeList, const ShapeAttributes* paren
 	}
 
 	shapeUpdateBounds(polyline);
+	shapeAddDirtyRegion(polyline, shapeList);
 
 	return shapeList->m_NumShapes - 1;
 }
@@ -147,6 +158,7 @@ uint32_t shapeListAddPolygon(ShapeList* shapeList, const ShapeAttributes* parent
 	}
 
 	shapeUpdateBounds(polygon);
+	shapeAddDirtyRegion(polygon, shapeList);
 
 	return shapeList->m_NumShapes - 1;
 }
@@ -170,6 +182,7 @@ uint32_t shapeListAddPath(ShapeList* shapeList, const ShapeAttributes* parentAtt
 	}
 
 	shapeUpdateBounds(path);
+	shapeAddDirtyRegion(path, shapeList);
 
 	return shapeList->m_NumShapes - 1;
 }
@@ -199,6 +212,7 @@ uint32_t shapeListAddText(ShapeList* shapeList, const ShapeAttributes* parentAtt
 	}
 
 	shapeUpdateBounds(text);
+	shapeAddDirtyRegion(text, shapeList);
 
 	return shapeList->m_NumShapes - 1;
 }
@@ -301,6 +315,10 @@ void pathConvertCommand(Path* path, uint32_t cmdID, PathCmdType::Enum newType)
 {
 	SSVG_CHECK(cmdID < path->m_NumCommands, "Invalid command ID");
 
+	if (path->m_Packed) {
+		pathUnpack(path);
+	}
+
 	if (cmdID == 0) {
 		SSVG_CHECK(newType == PathCmdType::MoveTo, "Cannot convert 1st command to other than MoveTo");
 		return;
@@ -415,17 +433,371 @@ void pathConvertCommand(Path* path, uint32_t cmdID, PathCmdType::Enum newType)
 	}
 }
 
+// Shapes converted by imageCanonicalize(). m_List is the list holding m_Shape.
+struct CanonicalizeItem
+{
+	Shape* m_Shape;
+	ShapeList* m_List;
+	bool m_Changed;
+};
+
+struct CanonicalizeJob
+{
+	bx::AllocatorI* m_Allocator;
+	CanonicalizeItem* m_Items;
+	uint32_t m_NumItems;
+	uint32_t m_Capacity;
+	uint32_t m_Flags;
+};
+
+static const uint32_t kCanonicalizeItemsPerTask = 16;
+
+// Magic constant for approximating a quarter of a circle with a cubic.
+static const float kKappa90 = 0.5522847493f;
+
+static bool canonicalizeShapeSelected(const Shape* shape, uint32_t flags)
+{
+	switch (shape->m_Type) {
+	case ShapeType::Rect:
+		return (flags & CanonicalizeFlags::ConvertRects) != 0;
+	case ShapeType::Circle:
+		return (flags & CanonicalizeFlags::ConvertCircles) != 0;
+	case ShapeType::Ellipse:
+		return (flags & CanonicalizeFlags::ConvertEllipses) != 0;
+	case ShapeType::Line:
+		return (flags & CanonicalizeFlags::ConvertLines) != 0;
+	case ShapeType::Polyline:
+		return (flags & CanonicalizeFlags::ConvertPolylines) != 0;
+	case ShapeType::Polygon:
+		return (flags & CanonicalizeFlags::ConvertPolygons) != 0;
+	case ShapeType::Path:
+		return shape->m_Path.m_NumCommands != 0;
+	default:
+		break;
+	}
+
+	return false;
+}
+
+static void canonicalizeJobCollect(CanonicalizeJob* job, ShapeList* shapeList)
+{
+	const uint32_t numShapes = shapeList->m_NumShapes;
+	for (uint32_t i = 0; i < numShapes; ++i) {
+		Shape* shape = shapeList->m_Shapes[i];
+		if (shape->m_Type == ShapeType::Group) {
+			canonicalizeJobCollect(job, &shape->m_ShapeList);
+		} else if (canonicalizeShapeSelected(shape, job->m_Flags)) {
+			if (job->m_NumItems == job->m_Capacity) {
+				job->m_Capacity = job->m_Capacity ? (job->m_Capacity * 3) / 2 : 256;
+				job->m_Items = (CanonicalizeItem*)BX_REALLOC(job->m_Allocator, job->m_Items, sizeof(CanonicalizeItem) * job->m_Capacity);
+			}
+
+			CanonicalizeItem* item = &job->m_Items[job->m_NumItems++];
+			item->m_Shape = shape;
+			item->m_List = shapeList;
+			item->m_Changed = false;
+		}
+	}
+}
+
+static PathCmd* canonicalizeEmit(PathCmd* cmd, PathCmdType::Enum type, float x1, float y1, float x2 = 0.0f, float y2 = 0.0f, float x3 = 0.0f, float y3 = 0.0f)
+{
+	cmd->m_Type = type;
+	cmd->m_Data[0] = x1;
+	cmd->m_Data[1] = y1;
+	cmd->m_Data[2] = x2;
+	cmd->m_Data[3] = y2;
+	cmd->m_Data[4] = x3;
+	cmd->m_Data[5] = y3;
+	cmd->m_Data[6] = 0.0f;
+
+	return cmd + 1;
+}
+
+// Returns the number of commands written to cmds. cmds must have room for at least 10 commands.
+static uint32_t canonicalizeRect(const Rect* rect, PathCmd* cmds)
+{
+	const float x = rect->x;
+	const float y = rect->y;
+	const float w = rect->width;
+	const float h = rect->height;
+
+	// NOTE: A missing rx/ry can't be told apart from 0, so the other radius is used (as if it was auto).
+	float rx = rect->rx != 0.0f ? rect->rx : rect->ry;
+	float ry = rect->ry != 0.0f ? rect->ry : rect->rx;
+	rx = bx::clamp<float>(bx::abs(rx), 0.0f, bx::abs(w) * 0.5f);
+	ry = bx::clamp<float>(bx::abs(ry), 0.0f, bx::abs(h) * 0.5f);
+
+	PathCmd* cmd = cmds;
+	if (rx < 1e-6f || ry < 1e-6f) {
+		cmd = canonicalizeEmit(cmd, PathCmdType::MoveTo, x, y);
+		cmd = canonicalizeEmit(cmd, PathCmdType::LineTo, x + w, y);
+		cmd = canonicalizeEmit(cmd, PathCmdType::LineTo, x + w, y + h);
+		cmd = canonicalizeEmit(cmd, PathCmdType::LineTo, x, y + h);
+	} else {
+		const float kx = rx * (1.0f - kKappa90);
+		const float ky = ry * (1.0f - kKappa90);
+		cmd = canonicalizeEmit(cmd, PathCmdType::MoveTo, x + rx, y);
+		cmd = canonicalizeEmit(cmd, PathCmdType::LineTo, x + w - rx, y);
+		cmd = canonicalizeEmit(cmd, PathCmdType::CubicTo, x + w - kx, y, x + w, y + ky, x + w, y + ry);
+		cmd = canonicalizeEmit(cmd, PathCmdType::LineTo, x + w, y + h - ry);
+		cmd = canonicalizeEmit(cmd, PathCmdType::CubicTo, x + w, y + h - ky, x + w - kx, y + h, x + w - rx, y + h);
+		cmd = canonicalizeEmit(cmd, PathCmdType::LineTo, x + rx, y + h);
+		cmd = canonicalizeEmit(cmd, PathCmdType::CubicTo, x + kx, y + h, x, y + h - ky, x, y + h - ry);
+		cmd = canonicalizeEmit(cmd, PathCmdType::LineTo, x, y + ry);
+		cmd = canonicalizeEmit(cmd, PathCmdType::CubicTo, x, y + ky, x + kx, y, x + rx, y);
+	}
+	cmd = canonicalizeEmit(cmd, PathCmdType::ClosePath, 0.0f, 0.0f);
+
+	return (uint32_t)(cmd - cmds);
+}
+
+// Returns the number of commands written to cmds. cmds must have room for at least 6 commands.
+static uint32_t canonicalizeEllipse(float cx, float cy, float rx, float ry, PathCmd* cmds)
+{
+	const float kx = rx * kKappa90;
+	const float ky = ry * kKappa90;
+
+	PathCmd* cmd = cmds;
+	cmd = canonicalizeEmit(cmd, PathCmdType::MoveTo, cx + rx, cy);
+	cmd = canonicalizeEmit(cmd, PathCmdType::CubicTo, cx + rx, cy + ky, cx + kx, cy + ry, cx, cy + ry);
+	cmd = canonicalizeEmit(cmd, PathCmdType::CubicTo, cx - kx, cy + ry, cx - rx, cy + ky, cx - rx, cy);
+	cmd = canonicalizeEmit(cmd, PathCmdType::CubicTo, cx - rx, cy - ky, cx - kx, cy - ry, cx, cy - ry);
+	cmd = canonicalizeEmit(cmd, PathCmdType::CubicTo, cx + kx, cy - ry, cx + rx, cy - ky, cx + rx, cy);
+	cmd = canonicalizeEmit(cmd, PathCmdType::ClosePath, 0.0f, 0.0f);
+
+	return (uint32_t)(cmd - cmds);
+}
+
+// Rebuilds the path into a new exact-sized array if it has commands other than MoveTo, LineTo,
+// CubicTo and ClosePath. Returns false if the path was left as is.
+static bool canonicalizePath(Path* path)
+{
+	uint32_t maxCommands = 0;
+	bool canonical = true;
+
+	PathIterator iter;
+	pathIterInit(&iter, path);
+	const PathCmd* cmd = nullptr;
+	while ((cmd = pathIterNext(&iter)) != nullptr) {
+		if (cmd->m_Type == PathCmdType::ArcTo) {
+			maxCommands += kArcMaxCubics;
+			canonical = false;
+		} else {
+			maxCommands++;
+			canonical = canonical && cmd->m_Type != PathCmdType::QuadraticTo;
+		}
+	}
+
+	if (canonical) {
+		pathShrinkToFit(path);
+		return false;
+	}
+
+	bx::AllocatorI* allocator = allocatorOrDefault(path->m_Allocator);
+	PathCmd* commands = (PathCmd*)BX_ALLOC(allocator, sizeof(PathCmd) * maxCommands);
+	PathCmd* dst = commands;
+
+	// NOTE: Commands are always absolute. The current point of a ClosePath is the start of the subpath.
+	float last[2] = { 0.0f, 0.0f };
+	float start[2] = { 0.0f, 0.0f };
+
+	pathIterInit(&iter, path);
+	while ((cmd = pathIterNext(&iter)) != nullptr) {
+		switch (cmd->m_Type) {
+		case PathCmdType::MoveTo:
+			start[0] = cmd->m_Data[0];
+			start[1] = cmd->m_Data[1];
+			// fallthrough
+		case PathCmdType::LineTo:
+			last[0] = cmd->m_Data[0];
+			last[1] = cmd->m_Data[1];
+			dst = canonicalizeEmit(dst, cmd->m_Type, last[0], last[1]);
+			break;
+		case PathCmdType::CubicTo:
+			dst = canonicalizeEmit(dst, PathCmdType::CubicTo, cmd->m_Data[0], cmd->m_Data[1], cmd->m_Data[2], cmd->m_Data[3], cmd->m_Data[4], cmd->m_Data[5]);
+			last[0] = cmd->m_Data[4];
+			last[1] = cmd->m_Data[5];
+			break;
+		case PathCmdType::QuadraticTo: {
+			const float cx = cmd->m_Data[0];
+			const float cy = cmd->m_Data[1];
+			const float x = cmd->m_Data[2];
+			const float y = cmd->m_Data[3];
+
+			const float c1x = last[0] + (2.0f / 3.0f) * (cx - last[0]);
+			const float c1y = last[1] + (2.0f / 3.0f) * (cy - last[1]);
+			const float c2x = x + (2.0f / 3.0f) * (cx - x);
+			const float c2y = y + (2.0f / 3.0f) * (cy - y);
+
+			dst = canonicalizeEmit(dst, PathCmdType::CubicTo, c1x, c1y, c2x, c2y, x, y);
+			last[0] = x;
+			last[1] = y;
+		}
+			break;
+		case PathCmdType::ArcTo:
+			dst += arcToCubics(&cmd->m_Data[0], &last[0], dst);
+			last[0] = cmd->m_Data[5];
+			last[1] = cmd->m_Data[6];
+			break;
+		case PathCmdType::ClosePath:
+			dst = canonicalizeEmit(dst, PathCmdType::ClosePath, 0.0f, 0.0f);
+			last[0] = start[0];
+			last[1] = start[1];
+			break;
+		default:
+			SSVG_CHECK(false, "Unknown command type");
+		}
+	}
+
+	const uint32_t newNumCommands = (uint32_t)(dst - commands);
+	if (newNumCommands != maxCommands) {
+		commands = (PathCmd*)BX_REALLOC(allocator, commands, sizeof(PathCmd) * newNumCommands);
+	}
+
+	pathFree(path);
+	path->m_Commands = commands;
+	path->m_NumCommands = newNumCommands;
+	path->m_Capacity = newNumCommands;
+
+	return true;
+}
+
+// NOTE: Runs on the scheduler's threads. Each item is a different shape so they can be modified
+// without locking; the allocator is thread safe (see Context).
+static void canonicalizeJobRun(uint32_t begin, uint32_t end, void* userData)
+{
+	CanonicalizeJob* job = (CanonicalizeJob*)userData;
+
+	for (uint32_t i = begin; i < end; ++i) {
+		CanonicalizeItem* item = &job->m_Items[i];
+		Shape* shape = item->m_Shape;
+
+		if (shape->m_Type == ShapeType::Path) {
+			item->m_Changed = canonicalizePath(&shape->m_Path);
+			continue;
+		}
+
+		PathCmd stackCmds[10];
+		PathCmd* cmds = &stackCmds[0];
+		uint32_t numCmds = 0;
+		bool closed = false;
+
+		switch (shape->m_Type) {
+		case ShapeType::Rect:
+			numCmds = canonicalizeRect(&shape->m_Rect, cmds);
+			break;
+		case ShapeType::Circle:
+			numCmds = canonicalizeEllipse(shape->m_Circle.cx, shape->m_Circle.cy, shape->m_Circle.r, shape->m_Circle.r, cmds);
+			break;
+		case ShapeType::Ellipse:
+			numCmds = canonicalizeEllipse(shape->m_Ellipse.cx, shape->m_Ellipse.cy, shape->m_Ellipse.rx, shape->m_Ellipse.ry, cmds);
+			break;
+		case ShapeType::Line:
+			canonicalizeEmit(&cmds[0], PathCmdType::MoveTo, shape->m_Line.x1, shape->m_Line.y1);
+			canonicalizeEmit(&cmds[1], PathCmdType::LineTo, shape->m_Line.x2, shape->m_Line.y2);
+			numCmds = 2;
+			break;
+		case ShapeType::Polygon:
+			closed = true;
+			// fallthrough
+		case ShapeType::Polyline: {
+			const PointList* ptList = &shape->m_PointList;
+			const uint32_t numPoints = ptList->m_NumPoints;
+			if (numPoints != 0) {
+				numCmds = numPoints + (closed ? 1 : 0);
+				cmds = (PathCmd*)BX_ALLOC(job->m_Allocator, sizeof(PathCmd) * numCmds);
+
+				const float* coords = ptList->m_Coords;
+				PathCmd* cmd = canonicalizeEmit(cmds, PathCmdType::MoveTo, coords[0], coords[1]);
+				for (uint32_t iPt = 1; iPt < numPoints; ++iPt) {
+					cmd = canonicalizeEmit(cmd, PathCmdType::LineTo, coords[iPt * 2 + 0], coords[iPt * 2 + 1]);
+				}
+
+				if (closed) {
+					canonicalizeEmit(cmd, PathCmdType::ClosePath, 0.0f, 0.0f);
+				}
+			}
+
+			pointListFree(&shape->m_PointList);
+		}
+			break;
+		default:
+			SSVG_CHECK(false, "Unexpected shape type");
+			break;
+		}
+
+		// NOTE: m_Path shares its memory with the other shape types.
+		Path* path = &shape->m_Path;
+		bx::memSet(path, 0, sizeof(Path));
+		path->m_Allocator = job->m_Allocator;
+		path->m_NumCommands = numCmds;
+		path->m_Capacity = numCmds;
+		if (cmds != &stackCmds[0]) {
+			path->m_Commands = cmds;
+		} else if (numCmds != 0) {
+			path->m_Commands = (PathCmd*)BX_ALLOC(job->m_Allocator, sizeof(PathCmd) * numCmds);
+			bx::memCopy(path->m_Commands, cmds, sizeof(PathCmd) * numCmds);
+		}
+
+		shape->m_Type = ShapeType::Path;
+		item->m_Changed = true;
+	}
+}
+
+// Converts all paths (and the shape types selected by flags) to MoveTo, LineTo, CubicTo and ClosePath
+// commands on the scheduler of img's context (see contextGetScheduler()). Converted paths get a new
+// exact-sized command array; packed paths are only unpacked if they have to be converted.
+// NOTE: Bounds aren't updated (see shapeListCalcBounds()).
+void imageCanonicalize(Image* img, uint32_t flags)
+{
+	Context* ctx = img->m_Context;
+
+	CanonicalizeJob job;
+	bx::memSet(&job, 0, sizeof(CanonicalizeJob));
+	job.m_Allocator = ctx->m_Allocator;
+	job.m_Flags = flags;
+
+	canonicalizeJobCollect(&job, &img->m_ShapeList);
+
+	contextGetScheduler(ctx)->parallelFor(job.m_NumItems, kCanonicalizeItemsPerTask, canonicalizeJobRun, &job);
+
+	for (uint32_t i = 0; i < job.m_NumItems; ++i) {
+		const CanonicalizeItem* item = &job.m_Items[i];
+		if (item->m_Changed) {
+			shapeInvalidateHash(item->m_Shape, item->m_List);
+		}
+	}
+
+	BX_FREE(job.m_Allocator, job.m_Items);
+}
+
 static float nsvg__vecang(float ux, float uy, float vx, float vy)
 {
 	const float umag = bx::sqrt(ux * ux + uy * uy);
 	const float vmag = bx::sqrt(vx * vx + vy * vy);
 	const float u_dot_v = ux * vx + uy * vy;
 	const float r = bx::clamp<float>(u_dot_v / (umag * vmag), -1.0f, 1.0f);
-	return bx::sign(ux * vy - uy * vx) * bx::acos(r);
+	// NOTE: Opposite vectors (half circles) must give pi, not 0 (bx::sign(0.0f) is 0).
+	const float sign = (ux * vy < uy * vx) ? -1.0f : 1.0f;
+	return sign * bx::acos(r);
 }
 
-// nsvg__pathArcTo(NSVGparser* p, float* cpx, float* cpy, float* args, int rel)
 static void convertArcToBezier(Path* path, uint32_t cmdID, const float* arcToArgs, const float* lastPt)
+{
+	PathCmd cmds[kArcMaxCubics];
+	const uint32_t numCmds = arcToCubics(arcToArgs, lastPt, &cmds[0]);
+	if (numCmds > 1) {
+		pathInsertCommands(path, cmdID + 1, numCmds - 1);
+	}
+
+	bx::memCopy(&path->m_Commands[cmdID], &cmds[0], sizeof(PathCmd) * numCmds);
+}
+
+// Writes the cubics approximating the arc (or a single LineTo if it's degenerate) to cmds and
+// returns their number (at most kArcMaxCubics).
+// nsvg__pathArcTo(NSVGparser* p, float* cpx, float* cpy, float* args, int rel)
+static uint32_t arcToCubics(const float* arcToArgs, const float* lastPt, PathCmd* cmds)
 {
 	// Ported from canvg (https://code.google.com/p/canvg/)
 	float rx = bx::abs(arcToArgs[0]);                    // x radius
@@ -443,11 +815,11 @@ static void convertArcToBezier(Path* path, uint32_t cmdID, const float* arcToArg
 	float d = bx::sqrt(dx * dx + dy * dy);
 	if (d < 1e-6f || rx < 1e-6f || ry < 1e-6f) {
 		// The arc degenerates to a line
-		PathCmd* cmd = &path->m_Commands[cmdID];
-		cmd->m_Type = PathCmdType::LineTo;
-		cmd->m_Data[0] = x2;
-		cmd->m_Data[1] = y2;
-		return;
+		bx::memSet(cmds, 0, sizeof(PathCmd));
+		cmds->m_Type = PathCmdType::LineTo;
+		cmds->m_Data[0] = x2;
+		cmds->m_Data[1] = y2;
+		return 1;
 	}
 
 	const float sinrx = bx::sin(rotx);
@@ -522,14 +894,9 @@ static void convertArcToBezier(Path* path, uint32_t cmdID, const float* arcToArg
 	float ptanx = 0.0f;
 	float ptany = 0.0f;
 
-	PathCmd* nextCmd = nullptr;
-	if (ndivs > 1) {
-		PathCmd* newCommands = pathInsertCommands(path, cmdID + 1, ndivs - 1);
-		nextCmd = newCommands - 1; // Replace existing command.
-	} else {
-		nextCmd = &path->m_Commands[cmdID];
-	}
+	SSVG_CHECK(ndivs >= 1 && ndivs <= (int)kArcMaxCubics, "Invalid number of arc segments");
 
+	PathCmd* nextCmd = cmds;
 	for (int i = 0; i <= ndivs; i++) {
 		const float a = a1 + da * ((float)i / (float)ndivs);
 		dx = bx::cos(a);
@@ -553,6 +920,7 @@ static void convertArcToBezier(Path* path, uint32_t cmdID, const float* arcToArg
 			nextCmd->m_Data[3] = y - tany;
 			nextCmd->m_Data[4] = x;
 			nextCmd->m_Data[5] = y;
+			nextCmd->m_Data[6] = 0.0f;
 			++nextCmd;
 		}
 
@@ -561,5 +929,7 @@ static void convertArcToBezier(Path* path, uint32_t cmdID, const float* arcToArg
 		ptanx = tanx;
 		ptany = tany;
 	}
+
+	return (uint32_t)ndivs;
 }
 }
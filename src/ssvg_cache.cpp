@@ -0,0 +1,339 @@
+#include <ssvg/ssvg.h>
+#include <bx/bx.h>
+#include <bx/allocator.h>
+#include <bx/cpu.h>
+#include <bx/mutex.h>
+#include <bx/string.h>
+
+namespace ssvg
+{
+struct ImageCacheEntry
+{
+	Image* m_Image;
+	bx::AllocatorI* m_Allocator;
+	ImageCacheEntry* m_NextInBucket;
+	ImageCacheEntry* m_PrevLRU;  // NOTE: Towards the most recently used entry
+	ImageCacheEntry* m_NextLRU;  // NOTE: Towards the least recently used entry
+	uint64_t m_Hash[2];
+	uint32_t m_Size;
+	uint32_t m_Flags;
+	uint64_t m_NumBytes;         // NOTE: Charged against the cache's budget
+	volatile uint32_t m_RefCount; // NOTE: The cache holds one reference while the entry is in it
+};
+
+struct ImageCache
+{
+	bx::Mutex m_Mutex;
+	Context* m_Context;
+	ShapeAttributes m_BaseAttrs;
+	ImageCacheEntry** m_Buckets;
+	uint32_t m_BucketMask;
+	ImageCacheEntry* m_LRUHead;
+	ImageCacheEntry* m_LRUTail;
+	uint64_t m_Budget;
+	ImageCacheStats m_Stats;
+};
+
+static const uint32_t kImageCacheMinBuckets = 64;
+
+static inline uint32_t imageCacheBucket(const ImageCache* cache, const uint64_t* hash)
+{
+	return (uint32_t)hash[0] & cache->m_BucketMask;
+}
+
+static ImageCacheEntry* imageCacheFind(ImageCache* cache, const uint64_t* hash, uint32_t size, uint32_t flags)
+{
+	ImageCacheEntry* entry = cache->m_Buckets[imageCacheBucket(cache, hash)];
+	while (entry) {
+		if (entry->m_Hash[0] == hash[0] && entry->m_Hash[1] == hash[1] && entry->m_Size == size && entry->m_Flags == flags) {
+			return entry;
+		}
+
+		entry = entry->m_NextInBucket;
+	}
+
+	return nullptr;
+}
+
+static void imageCacheLRUUnlink(ImageCache* cache, ImageCacheEntry* entry)
+{
+	if (entry->m_PrevLRU) {
+		entry->m_PrevLRU->m_NextLRU = entry->m_NextLRU;
+	} else {
+		cache->m_LRUHead = entry->m_NextLRU;
+	}
+
+	if (entry->m_NextLRU) {
+		entry->m_NextLRU->m_PrevLRU = entry->m_PrevLRU;
+	} else {
+		cache->m_LRUTail = entry->m_PrevLRU;
+	}
+
+	entry->m_PrevLRU = nullptr;
+	entry->m_NextLRU = nullptr;
+}
+
+static void imageCacheLRUPushFront(ImageCache* cache, ImageCacheEntry* entry)
+{
+	entry->m_PrevLRU = nullptr;
+	entry->m_NextLRU = cache->m_LRUHead;
+	if (cache->m_LRUHead) {
+		cache->m_LRUHead->m_PrevLRU = entry;
+	} else {
+		cache->m_LRUTail = entry;
+	}
+	cache->m_LRUHead = entry;
+}
+
+static void imageCacheGrowBuckets(ImageCache* cache)
+{
+	bx::AllocatorI* allocator = cache->m_Context->m_Allocator;
+
+	const uint32_t oldNumBuckets = cache->m_BucketMask + 1;
+	const uint32_t newNumBuckets = oldNumBuckets * 2;
+	ImageCacheEntry** oldBuckets = cache->m_Buckets;
+	ImageCacheEntry** newBuckets = (ImageCacheEntry**)BX_ALLOC(allocator, sizeof(ImageCacheEntry*) * newNumBuckets);
+	bx::memSet(newBuckets, 0, sizeof(ImageCacheEntry*) * newNumBuckets);
+
+	cache->m_Buckets = newBuckets;
+	cache->m_BucketMask = newNumBuckets - 1;
+
+	for (uint32_t i = 0; i < oldNumBuckets; ++i) {
+		ImageCacheEntry* entry = oldBuckets[i];
+		while (entry) {
+			ImageCacheEntry* next = entry->m_NextInBucket;
+			const uint32_t bucket = imageCacheBucket(cache, &entry->m_Hash[0]);
+			entry->m_NextInBucket = newBuckets[bucket];
+			newBuckets[bucket] = entry;
+			entry = next;
+		}
+	}
+
+	BX_FREE(allocator, oldBuckets);
+}
+
+static void imageCacheInsert(ImageCache* cache, ImageCacheEntry* entry)
+{
+	if (cache->m_Stats.m_NumEntries > cache->m_BucketMask) {
+		imageCacheGrowBuckets(cache);
+	}
+
+	const uint32_t bucket = imageCacheBucket(cache, &entry->m_Hash[0]);
+	entry->m_NextInBucket = cache->m_Buckets[bucket];
+	cache->m_Buckets[bucket] = entry;
+
+	imageCacheLRUPushFront(cache, entry);
+
+	cache->m_Stats.m_NumEntries++;
+	cache->m_Stats.m_UsedBytes += entry->m_NumBytes;
+}
+
+// NOTE: The caller releases the cache's reference (outside the lock).
+static void imageCacheRemove(ImageCache* cache, ImageCacheEntry* entry)
+{
+	ImageCacheEntry** link = &cache->m_Buckets[imageCacheBucket(cache, &entry->m_Hash[0])];
+	while (*link != entry) {
+		link = &(*link)->m_NextInBucket;
+	}
+	*link = entry->m_NextInBucket;
+	entry->m_NextInBucket = nullptr;
+
+	imageCacheLRUUnlink(cache, entry);
+
+	cache->m_Stats.m_NumEntries--;
+	cache->m_Stats.m_UsedBytes -= entry->m_NumBytes;
+}
+
+// Evicts least recently used entries until numBytes more fit in the budget. Evicted entries are
+// chained through m_NextInBucket.
+static ImageCacheEntry* imageCacheEvict(ImageCache* cache, uint64_t numBytes)
+{
+	ImageCacheEntry* evicted = nullptr;
+	while (cache->m_LRUTail && cache->m_Stats.m_UsedBytes + numBytes > cache->m_Budget) {
+		ImageCacheEntry* entry = cache->m_LRUTail;
+		imageCacheRemove(cache, entry);
+		entry->m_NextInBucket = evicted;
+		evicted = entry;
+
+		cache->m_Stats.m_NumEvictions++;
+	}
+
+	return evicted;
+}
+
+static void imageCacheReleaseList(ImageCacheEntry* entry)
+{
+	while (entry) {
+		ImageCacheEntry* next = entry->m_NextInBucket;
+		imageCacheEntryRelease(entry);
+		entry = next;
+	}
+}
+
+ImageCache* imageCacheCreate(Context* ctx, const ShapeAttributes* baseAttrs, uint64_t budget)
+{
+	ctx = contextOrDefault(ctx);
+
+	bx::AllocatorI* allocator = ctx->m_Allocator;
+
+	ImageCache* cache = BX_NEW(allocator, ImageCache);
+	cache->m_Context = ctx;
+	bx::memCopy(&cache->m_BaseAttrs, baseAttrs, sizeof(ShapeAttributes));
+	cache->m_Buckets = (ImageCacheEntry**)BX_ALLOC(allocator, sizeof(ImageCacheEntry*) * kImageCacheMinBuckets);
+	bx::memSet(cache->m_Buckets, 0, sizeof(ImageCacheEntry*) * kImageCacheMinBuckets);
+	cache->m_BucketMask = kImageCacheMinBuckets - 1;
+	cache->m_LRUHead = nullptr;
+	cache->m_LRUTail = nullptr;
+	cache->m_Budget = budget;
+	bx::memSet(&cache->m_Stats, 0, sizeof(ImageCacheStats));
+
+	return cache;
+}
+
+void imageCacheDestroy(ImageCache* cache)
+{
+	imageCacheClear(cache);
+
+	bx::AllocatorI* allocator = cache->m_Context->m_Allocator;
+	BX_FREE(allocator, cache->m_Buckets);
+	BX_DELETE(allocator, cache);
+}
+
+void imageCacheClear(ImageCache* cache)
+{
+	ImageCacheEntry* evicted = nullptr;
+	{
+		bx::MutexScope lock(cache->m_Mutex);
+		while (cache->m_LRUHead) {
+			ImageCacheEntry* entry = cache->m_LRUHead;
+			imageCacheRemove(cache, entry);
+			entry->m_NextInBucket = evicted;
+			evicted = entry;
+		}
+	}
+
+	imageCacheReleaseList(evicted);
+}
+
+void imageCacheSetBudget(ImageCache* cache, uint64_t budget)
+{
+	ImageCacheEntry* evicted = nullptr;
+	{
+		bx::MutexScope lock(cache->m_Mutex);
+		cache->m_Budget = budget;
+		evicted = imageCacheEvict(cache, 0);
+	}
+
+	imageCacheReleaseList(evicted);
+}
+
+void imageCacheGetStats(ImageCache* cache, ImageCacheStats* stats)
+{
+	bx::MutexScope lock(cache->m_Mutex);
+	bx::memCopy(stats, &cache->m_Stats, sizeof(ImageCacheStats));
+}
+
+ImageCacheEntry* imageCacheLoad(ImageCache* cache, const char* xmlStr, uint32_t flags, const ImageLoadLimits* limits, ImageLoadError::Enum* error)
+{
+	if (error) {
+		*error = ImageLoadError::None;
+	}
+
+	// NOTE: Cached images outlive xmlStr, so they always own their strings.
+	flags &= ~ImageLoadFlags::BorrowStrings;
+
+	// NOTE: Hits aren't compared against the cached document. A match of the 128-bit hash, the size
+	// and the flags is trusted.
+	const uint32_t size = bx::strLen(xmlStr);
+	uint64_t hash[2];
+	hash128(xmlStr, size, 0, &hash[0]);
+
+	{
+		bx::MutexScope lock(cache->m_Mutex);
+		ImageCacheEntry* entry = imageCacheFind(cache, &hash[0], size, flags);
+		if (entry) {
+			imageCacheLRUUnlink(cache, entry);
+			imageCacheLRUPushFront(cache, entry);
+			cache->m_Stats.m_NumHits++;
+			return imageCacheEntryAcquire(entry);
+		}
+
+		cache->m_Stats.m_NumMisses++;
+	}
+
+	// NOTE: Parse without holding the lock. Threads missing on the same document at the same time
+	// all parse it; the first one to finish inserts it and the others return that entry.
+	Image* img = imageLoadWithLimits(xmlStr, flags, &cache->m_BaseAttrs, cache->m_Context, limits, error);
+	if (!img) {
+		return nullptr;
+	}
+
+	// NOTE: shapeHash() caches into Shape::m_Hash. Filling all of them before the entry is published
+	// leaves nothing for holders hashing the shared image to write.
+	imageHash(img);
+
+	// NOTE: Other threads might be allocating from the context's attribute pool, which isn't part of m_TotalBytes anyway.
+	ImageMemoryUsage usage;
+	imageCalcMemoryUsage(img, &usage, false);
+
+	bx::AllocatorI* allocator = cache->m_Context->m_Allocator;
+	ImageCacheEntry* entry = (ImageCacheEntry*)BX_ALLOC(allocator, sizeof(ImageCacheEntry));
+	bx::memSet(entry, 0, sizeof(ImageCacheEntry));
+	entry->m_Image = img;
+	entry->m_Allocator = allocator;
+	entry->m_Hash[0] = hash[0];
+	entry->m_Hash[1] = hash[1];
+	entry->m_Size = size;
+	entry->m_Flags = flags;
+	entry->m_NumBytes = usage.m_TotalBytes + sizeof(ImageCacheEntry);
+	entry->m_RefCount = 1;
+
+	ImageCacheEntry* evicted = nullptr;
+	ImageCacheEntry* existing = nullptr;
+	{
+		bx::MutexScope lock(cache->m_Mutex);
+		existing = imageCacheFind(cache, &hash[0], size, flags);
+		if (existing) {
+			imageCacheLRUUnlink(cache, existing);
+			imageCacheLRUPushFront(cache, existing);
+			imageCacheEntryAcquire(existing);
+		} else if (entry->m_NumBytes <= cache->m_Budget) {
+			evicted = imageCacheEvict(cache, entry->m_NumBytes);
+			imageCacheInsert(cache, imageCacheEntryAcquire(entry));
+		}
+	}
+
+	imageCacheReleaseList(evicted);
+
+	if (existing) {
+		imageCacheEntryRelease(entry);
+		return existing;
+	}
+
+	return entry;
+}
+
+const Image* imageCacheEntryGetImage(const ImageCacheEntry* entry)
+{
+	return entry->m_Image;
+}
+
+ImageCacheEntry* imageCacheEntryAcquire(ImageCacheEntry* entry)
+{
+	if (entry) {
+		bx::atomicInc(&entry->m_RefCount);
+	}
+
+	return entry;
+}
+
+void imageCacheEntryRelease(ImageCacheEntry* entry)
+{
+	if (entry == nullptr || bx::atomicDec(&entry->m_RefCount) != 0) {
+		return;
+	}
+
+	imageDestroy(entry->m_Image);
+	BX_FREE(entry->m_Allocator, entry);
+}
+}
@@ -0,0 +1,1204 @@
+#include <ssvg/ssvg.h>
+#include <bx/bx.h>
+#include <bx/allocator.h>
+#include <bx/readerwriter.h>
+#include <bx/string.h>
+#include <string.h> // memcmp, memcpy
+
+// Edit script layout. Integers are LEB128 varints, floats and hashes are stored raw (little endian hosts).
+// - Header: magic, imageHash() of the base and of the target image, DiffImageField mask, changed image fields.
+// - List script: ops terminated by DiffOp::End. Each op starts with (arg << 2) | op:
+//   - Copy: arg = number of shapes, followed by the base index of the first one (kept or moved shapes).
+//   - Modify: arg = base index, followed by a shape delta.
+//   - Insert: arg = shape type, followed by a shape delta against a new shape (see shapeListAllocShape()).
+//   Base shapes no op refers to are deleted.
+// - Shape delta: DiffField mask followed by the changed fields in bit order. The geometry of a group is the
+//   list script of its children. Paths and point lists send the changed range of commands/points.
+namespace ssvg
+{
+static const uint32_t kDiffMagic = 0x44475653; // "SVGD"
+
+struct DiffOp
+{
+	enum Enum : uint32_t
+	{
+		End = 0,
+		Copy,
+		Modify,
+		Insert
+	};
+};
+
+struct DiffField
+{
+	enum Enum : uint32_t
+	{
+		Flags            = 1 << 0,
+		StrokePaint      = 1 << 1,
+		FillPaint        = 1 << 2,
+		Transform        = 1 << 3,
+		StrokeMiterLimit = 1 << 4,
+		StrokeOpacity    = 1 << 5,
+		StrokeWidth      = 1 << 6,
+		FillOpacity      = 1 << 7,
+		FontSize         = 1 << 8,
+		Opacity          = 1 << 9,
+		StrokeLineJoin   = 1 << 10,
+		StrokeLineCap    = 1 << 11,
+		FillRule         = 1 << 12,
+		ID               = 1 << 13,
+		FontFamily       = 1 << 14,
+		Class            = 1 << 15,
+		Bounds           = 1 << 16,
+		Geometry         = 1 << 17,
+
+		AllAttrs         = (1 << 16) - 1,
+		All              = (1 << 18) - 1
+	};
+};
+
+struct DiffImageField
+{
+	enum Enum : uint32_t
+	{
+		Size      = 1 << 0, // width, height and viewBox
+		Profile   = 1 << 1, // baseProfile and version
+		BaseAttrs = 1 << 2,
+		Bounds    = 1 << 3,
+
+		All       = (1 << 4) - 1
+	};
+};
+
+// Path commands and point lists are sent either whole or as the range which differs from the base.
+struct DiffArrayMode
+{
+	enum Enum : uint32_t
+	{
+		Full = 0,
+		Range,
+		Packed // NOTE: Paths only
+	};
+};
+
+struct DiffState
+{
+	bx::WriterI* m_Writer;
+	bx::AllocatorI* m_Allocator;
+	bx::Error m_Error;
+};
+
+struct DiffReader
+{
+	const uint8_t* m_Ptr;
+	const uint8_t* m_End;
+	bool m_Error;
+	bool m_TrackDirty; // NOTE: The patched image tracks dirty regions (see imageTrackDirtyRegions())
+};
+
+static bool diffStringEqual(const bx::StringView& a, const bx::StringView& b)
+{
+	return a.getLength() == b.getLength()
+		&& 0 == memcmp(a.getPtr(), b.getPtr(), a.getLength())
+		;
+}
+
+static bool diffPaintEqual(const Paint* a, const Paint* b)
+{
+	return a->m_Type == b->m_Type
+		&& (a->m_Type != PaintType::Color || a->m_ColorABGR == b->m_ColorABGR)
+		;
+}
+
+// NOTE: Bitwise, so the patched image hashes exactly like the target.
+static bool diffFloatsEqual(const float* a, const float* b, uint32_t n)
+{
+	return 0 == memcmp(a, b, sizeof(float) * n);
+}
+
+// Same attributes shapeListAllocShape() starts with.
+static void diffInitAttrs(ShapeAttributes* attrs)
+{
+	bx::memSet(attrs, 0, sizeof(ShapeAttributes));
+	attrs->m_Flags = AttribFlags::InheritAll;
+	attrs->m_Opacity = 1.0f;
+	transformIdentity(&attrs->m_Transform[0]);
+}
+
+static uint32_t diffAttrsMask(const ShapeAttributes* a, const ShapeAttributes* b)
+{
+	uint32_t mask = 0;
+	if (a->m_Flags != b->m_Flags) {
+		mask |= DiffField::Flags;
+	}
+	if (!diffPaintEqual(&a->m_StrokePaint, &b->m_StrokePaint)) {
+		mask |= DiffField::StrokePaint;
+	}
+	if (!diffPaintEqual(&a->m_FillPaint, &b->m_FillPaint)) {
+		mask |= DiffField::FillPaint;
+	}
+	if (!diffFloatsEqual(&a->m_Transform[0], &b->m_Transform[0], 6)) {
+		mask |= DiffField::Transform;
+	}
+	if (!diffFloatsEqual(&a->m_StrokeMiterLimit, &b->m_StrokeMiterLimit, 1)) {
+		mask |= DiffField::StrokeMiterLimit;
+	}
+	if (!diffFloatsEqual(&a->m_StrokeOpacity, &b->m_StrokeOpacity, 1)) {
+		mask |= DiffField::StrokeOpacity;
+	}
+	if (!diffFloatsEqual(&a->m_StrokeWidth, &b->m_StrokeWidth, 1)) {
+		mask |= DiffField::StrokeWidth;
+	}
+	if (!diffFloatsEqual(&a->m_FillOpacity, &b->m_FillOpacity, 1)) {
+		mask |= DiffField::FillOpacity;
+	}
+	if (!diffFloatsEqual(&a->m_FontSize, &b->m_FontSize, 1)) {
+		mask |= DiffField::FontSize;
+	}
+	if (!diffFloatsEqual(&a->m_Opacity, &b->m_Opacity, 1)) {
+		mask |= DiffField::Opacity;
+	}
+	if (a->m_StrokeLineJoin != b->m_StrokeLineJoin) {
+		mask |= DiffField::StrokeLineJoin;
+	}
+	if (a->m_StrokeLineCap != b->m_StrokeLineCap) {
+		mask |= DiffField::StrokeLineCap;
+	}
+	if (a->m_FillRule != b->m_FillRule) {
+		mask |= DiffField::FillRule;
+	}
+	if (!diffStringEqual(shapeAttrsGetID(a), shapeAttrsGetID(b))) {
+		mask |= DiffField::ID;
+	}
+	if (!diffStringEqual(shapeAttrsGetFontFamily(a), shapeAttrsGetFontFamily(b))) {
+		mask |= DiffField::FontFamily;
+	}
+	if (!diffStringEqual(shapeAttrsGetClass(a), shapeAttrsGetClass(b))) {
+		mask |= DiffField::Class;
+	}
+
+	return mask;
+}
+
+// Hashes ignore ids and classes, so shapes with equal hashes are only identical if these match too.
+static bool diffNamesEqual(const Shape* a, const Shape* b)
+{
+	if (!diffStringEqual(shapeAttrsGetID(a->m_Attrs), shapeAttrsGetID(b->m_Attrs))
+	||  !diffStringEqual(shapeAttrsGetClass(a->m_Attrs), shapeAttrsGetClass(b->m_Attrs))) {
+		return false;
+	}
+
+	if (a->m_Type != ShapeType::Group || b->m_Type != ShapeType::Group) {
+		return true;
+	}
+
+	const ShapeList* listA = &a->m_ShapeList;
+	const ShapeList* listB = &b->m_ShapeList;
+	if (listA->m_NumShapes != listB->m_NumShapes) {
+		return false;
+	}
+
+	for (uint32_t i = 0; i < listA->m_NumShapes; ++i) {
+		if (!diffNamesEqual(listA->m_Shapes[i], listB->m_Shapes[i])) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool diffGeometryEqual(const Shape* a, const Shape* b)
+{
+	switch (b->m_Type) {
+	case ShapeType::Rect:
+		return diffFloatsEqual(&a->m_Rect.x, &b->m_Rect.x, sizeof(Rect) / sizeof(float));
+	case ShapeType::Circle:
+		return diffFloatsEqual(&a->m_Circle.cx, &b->m_Circle.cx, sizeof(Circle) / sizeof(float));
+	case ShapeType::Ellipse:
+		return diffFloatsEqual(&a->m_Ellipse.cx, &b->m_Ellipse.cx, sizeof(Ellipse) / sizeof(float));
+	case ShapeType::Line:
+		return diffFloatsEqual(&a->m_Line.x1, &b->m_Line.x1, sizeof(Line) / sizeof(float));
+	case ShapeType::Polyline:
+	case ShapeType::Polygon:
+		return a->m_PointList.m_NumPoints == b->m_PointList.m_NumPoints
+			&& diffFloatsEqual(a->m_PointList.m_Coords, b->m_PointList.m_Coords, a->m_PointList.m_NumPoints * 2)
+			;
+	case ShapeType::Path:
+	{
+		const Path* pathA = &a->m_Path;
+		const Path* pathB = &b->m_Path;
+		if ((pathA->m_Packed == nullptr) != (pathB->m_Packed == nullptr)) {
+			return false;
+		}
+
+		return pathB->m_Packed
+			? pathA->m_PackedSize == pathB->m_PackedSize && pathA->m_NumCommands == pathB->m_NumCommands && diffFloatsEqual(&pathA->m_PackedScale, &pathB->m_PackedScale, 1) && 0 == memcmp(pathA->m_Packed, pathB->m_Packed, pathB->m_PackedSize)
+			: pathA->m_NumCommands == pathB->m_NumCommands && 0 == memcmp(pathA->m_Commands, pathB->m_Commands, sizeof(PathCmd) * pathB->m_NumCommands)
+			;
+	}
+	case ShapeType::Text:
+	{
+		const Text* textA = &a->m_Text;
+		const Text* textB = &b->m_Text;
+		if (!diffFloatsEqual(&textA->x, &textB->x, 1) || !diffFloatsEqual(&textA->y, &textB->y, 1) || textA->m_Anchor != textB->m_Anchor) {
+			return false;
+		}
+
+		if (textA->m_String == nullptr || textB->m_String == nullptr) {
+			return textA->m_String == textB->m_String;
+		}
+
+		return 0 == bx::strCmp(textA->m_String, textB->m_String);
+	}
+	default:
+		break;
+	}
+
+	return false;
+}
+
+static void diffWrite(DiffState* state, const void* data, uint32_t size)
+{
+	if (size != 0) {
+		bx::write(state->m_Writer, data, (int32_t)size, &state->m_Error);
+	}
+}
+
+static void diffWriteVarint(DiffState* state, uint32_t val)
+{
+	uint8_t buf[5];
+	uint32_t n = 0;
+	while (val >= 0x80) {
+		buf[n++] = (uint8_t)(val | 0x80);
+		val >>= 7;
+	}
+	buf[n++] = (uint8_t)val;
+	diffWrite(state, &buf[0], n);
+}
+
+static void diffWriteString(DiffState* state, const bx::StringView& str)
+{
+	diffWriteVarint(state, (uint32_t)str.getLength());
+	diffWrite(state, str.getPtr(), (uint32_t)str.getLength());
+}
+
+static void diffWritePaint(DiffState* state, const Paint* paint)
+{
+	diffWriteVarint(state, paint->m_Type);
+	if (paint->m_Type == PaintType::Color) {
+		diffWrite(state, &paint->m_ColorABGR, sizeof(uint32_t));
+	}
+}
+
+static void diffWriteAttrs(DiffState* state, const ShapeAttributes* attrs, uint32_t mask)
+{
+	if (mask & DiffField::Flags) {
+		diffWriteVarint(state, attrs->m_Flags);
+	}
+	if (mask & DiffField::StrokePaint) {
+		diffWritePaint(state, &attrs->m_StrokePaint);
+	}
+	if (mask & DiffField::FillPaint) {
+		diffWritePaint(state, &attrs->m_FillPaint);
+	}
+	if (mask & DiffField::Transform) {
+		diffWrite(state, &attrs->m_Transform[0], sizeof(float) * 6);
+	}
+	if (mask & DiffField::StrokeMiterLimit) {
+		diffWrite(state, &attrs->m_StrokeMiterLimit, sizeof(float));
+	}
+	if (mask & DiffField::StrokeOpacity) {
+		diffWrite(state, &attrs->m_StrokeOpacity, sizeof(float));
+	}
+	if (mask & DiffField::StrokeWidth) {
+		diffWrite(state, &attrs->m_StrokeWidth, sizeof(float));
+	}
+	if (mask & DiffField::FillOpacity) {
+		diffWrite(state, &attrs->m_FillOpacity, sizeof(float));
+	}
+	if (mask & DiffField::FontSize) {
+		diffWrite(state, &attrs->m_FontSize, sizeof(float));
+	}
+	if (mask & DiffField::Opacity) {
+		diffWrite(state, &attrs->m_Opacity, sizeof(float));
+	}
+	if (mask & DiffField::StrokeLineJoin) {
+		diffWriteVarint(state, attrs->m_StrokeLineJoin);
+	}
+	if (mask & DiffField::StrokeLineCap) {
+		diffWriteVarint(state, attrs->m_StrokeLineCap);
+	}
+	if (mask & DiffField::FillRule) {
+		diffWriteVarint(state, attrs->m_FillRule);
+	}
+	if (mask & DiffField::ID) {
+		diffWriteString(state, shapeAttrsGetID(attrs));
+	}
+	if (mask & DiffField::FontFamily) {
+		diffWriteString(state, shapeAttrsGetFontFamily(attrs));
+	}
+	if (mask & DiffField::Class) {
+		diffWriteString(state, shapeAttrsGetClass(attrs));
+	}
+}
+
+// Sends the elements of b which differ from a (common prefix and suffix are kept). a may be nullptr.
+static void diffWriteArray(DiffState* state, const void* a, uint32_t numA, const void* b, uint32_t numB, uint32_t stride)
+{
+	if (a == nullptr) {
+		diffWriteVarint(state, DiffArrayMode::Full);
+		diffWriteVarint(state, numB);
+		diffWrite(state, b, numB * stride);
+		return;
+	}
+
+	const uint8_t* bytesA = (const uint8_t*)a;
+	const uint8_t* bytesB = (const uint8_t*)b;
+	const uint32_t maxCommon = bx::min<uint32_t>(numA, numB);
+
+	uint32_t prefix = 0;
+	while (prefix < maxCommon && 0 == memcmp(&bytesA[prefix * stride], &bytesB[prefix * stride], stride)) {
+		++prefix;
+	}
+
+	uint32_t suffix = 0;
+	while (suffix < maxCommon - prefix && 0 == memcmp(&bytesA[(numA - 1 - suffix) * stride], &bytesB[(numB - 1 - suffix) * stride], stride)) {
+		++suffix;
+	}
+
+	const uint32_t numInserted = numB - prefix - suffix;
+	diffWriteVarint(state, DiffArrayMode::Range);
+	diffWriteVarint(state, prefix);
+	diffWriteVarint(state, numA - prefix - suffix);
+	diffWriteVarint(state, numInserted);
+	diffWrite(state, &bytesB[prefix * stride], numInserted * stride);
+}
+
+static void diffWriteList(DiffState* state, ShapeList* listA, ShapeList* listB);
+
+// a is nullptr for inserted shapes. Otherwise it has the same type as b.
+static void diffWriteShape(DiffState* state, Shape* a, Shape* b)
+{
+	ShapeAttributes newAttrs;
+	if (a == nullptr) {
+		diffInitAttrs(&newAttrs);
+	}
+
+	static const float kNewBounds[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	const ShapeAttributes* baseAttrs = a ? a->m_Attrs : &newAttrs;
+	const float* baseBounds = a ? &a->m_BoundingRect[0] : &kNewBounds[0];
+
+	uint32_t mask = diffAttrsMask(baseAttrs, b->m_Attrs);
+	if (!diffFloatsEqual(baseBounds, &b->m_BoundingRect[0], 4)) {
+		mask |= DiffField::Bounds;
+	}
+	if (a == nullptr || b->m_Type == ShapeType::Group || !diffGeometryEqual(a, b)) {
+		mask |= DiffField::Geometry;
+	}
+
+	diffWriteVarint(state, mask);
+	diffWriteAttrs(state, b->m_Attrs, mask);
+	if (mask & DiffField::Bounds) {
+		diffWrite(state, &b->m_BoundingRect[0], sizeof(float) * 4);
+	}
+	if ((mask & DiffField::Geometry) == 0) {
+		return;
+	}
+
+	switch (b->m_Type) {
+	case ShapeType::Group:
+		diffWriteList(state, a ? &a->m_ShapeList : nullptr, &b->m_ShapeList);
+		break;
+	case ShapeType::Rect:
+		diffWrite(state, &b->m_Rect, sizeof(Rect));
+		break;
+	case ShapeType::Circle:
+		diffWrite(state, &b->m_Circle, sizeof(Circle));
+		break;
+	case ShapeType::Ellipse:
+		diffWrite(state, &b->m_Ellipse, sizeof(Ellipse));
+		break;
+	case ShapeType::Line:
+		diffWrite(state, &b->m_Line, sizeof(Line));
+		break;
+	case ShapeType::Polyline:
+	case ShapeType::Polygon:
+	{
+		const PointList* ptListA = a ? &a->m_PointList : nullptr;
+		const PointList* ptListB = &b->m_PointList;
+		diffWriteArray(state
+			, ptListA ? ptListA->m_Coords : nullptr
+			, ptListA ? ptListA->m_NumPoints : 0
+			, ptListB->m_Coords
+			, ptListB->m_NumPoints
+			, sizeof(float) * 2
+		);
+	}
+	break;
+	case ShapeType::Path:
+	{
+		const Path* pathA = a ? &a->m_Path : nullptr;
+		const Path* pathB = &b->m_Path;
+		if (pathB->m_Packed) {
+			diffWriteVarint(state, DiffArrayMode::Packed);
+			diffWrite(state, &pathB->m_PackedScale, sizeof(float));
+			diffWriteVarint(state, pathB->m_NumCommands);
+			diffWriteVarint(state, pathB->m_PackedSize);
+			diffWrite(state, pathB->m_Packed, pathB->m_PackedSize);
+		} else {
+			// NOTE: Commands are sent as stored (including their unused data) because that's what they hash.
+			const bool range = pathA && !pathA->m_Packed;
+			diffWriteArray(state
+				, range ? pathA->m_Commands : nullptr
+				, range ? pathA->m_NumCommands : 0
+				, pathB->m_Commands
+				, pathB->m_NumCommands
+				, sizeof(PathCmd)
+			);
+		}
+	}
+	break;
+	case ShapeType::Text:
+	{
+		const Text* text = &b->m_Text;
+		diffWrite(state, &text->x, sizeof(float));
+		diffWrite(state, &text->y, sizeof(float));
+		diffWriteVarint(state, text->m_Anchor);
+
+		// NOTE: 0 for no string, length + 1 otherwise.
+		const uint32_t len = text->m_String ? bx::strLen(text->m_String) : 0;
+		diffWriteVarint(state, text->m_String ? len + 1 : 0);
+		diffWrite(state, text->m_String, len);
+	}
+	break;
+	default:
+		SSVG_CHECK(false, "Unknown shape type");
+		break;
+	}
+}
+
+// Matches every shape of listB to a shape of listA it is identical to (Copy), a shape of the same type
+// it can be turned into (Modify), or nothing (Insert). listA may be nullptr.
+static void diffWriteList(DiffState* state, ShapeList* listA, ShapeList* listB)
+{
+	const uint32_t numA = listA ? listA->m_NumShapes : 0;
+	const uint32_t numB = listB->m_NumShapes;
+
+	uint32_t numBuckets = 1;
+	while (numBuckets < numA * 2) {
+		numBuckets <<= 1;
+	}
+
+	const uint32_t kNone = UINT32_MAX;
+	uint32_t* buckets = (uint32_t*)BX_ALLOC(state->m_Allocator, sizeof(uint32_t) * (numBuckets + numA + numB) + numA + numB);
+	uint32_t* next = &buckets[numBuckets];
+	uint32_t* src = &next[numA];
+	uint8_t* used = (uint8_t*)&src[numB];
+	uint8_t* exact = &used[numA];
+	bx::memSet(buckets, 0xFF, sizeof(uint32_t) * numBuckets);
+	bx::memSet(used, 0, numA + numB);
+
+	// NOTE: Chains are in list order, so runs of equal shapes are consumed from the head.
+	for (uint32_t i = numA; i-- > 0; ) {
+		const uint32_t bucket = (uint32_t)shapeHash(listA->m_Shapes[i]) & (numBuckets - 1);
+		next[i] = buckets[bucket];
+		buckets[bucket] = i;
+	}
+
+	// Exact matches. The shape after the previous match is tried first to keep runs together.
+	uint32_t lastSrc = kNone;
+	for (uint32_t i = 0; i < numB; ++i) {
+		Shape* b = listB->m_Shapes[i];
+		const uint64_t hash = shapeHash(b);
+
+		uint32_t match = kNone;
+		const uint32_t candidate = lastSrc + 1;
+		if (candidate < numA && !used[candidate] && shapeHash(listA->m_Shapes[candidate]) == hash && diffNamesEqual(listA->m_Shapes[candidate], b)) {
+			match = candidate;
+		} else if (numA != 0) {
+			uint32_t* head = &buckets[(uint32_t)hash & (numBuckets - 1)];
+			while (*head != kNone && used[*head]) {
+				*head = next[*head];
+			}
+
+			for (uint32_t j = *head; j != kNone; j = next[j]) {
+				if (!used[j] && shapeHash(listA->m_Shapes[j]) == hash && diffNamesEqual(listA->m_Shapes[j], b)) {
+					match = j;
+					break;
+				}
+			}
+		}
+
+		src[i] = match;
+		if (match != kNone) {
+			used[match] = 1;
+			exact[i] = 1;
+			lastSrc = match;
+		}
+	}
+
+	// Modified shapes: one which only differs in ids or classes, or the unused one after the previous match.
+	lastSrc = kNone;
+	for (uint32_t i = 0; i < numB; ++i) {
+		if (exact[i]) {
+			lastSrc = src[i];
+			continue;
+		}
+
+		Shape* b = listB->m_Shapes[i];
+		const uint64_t hash = shapeHash(b);
+
+		uint32_t match = kNone;
+		if (numA != 0) {
+			for (uint32_t j = buckets[(uint32_t)hash & (numBuckets - 1)]; j != kNone; j = next[j]) {
+				if (!used[j] && shapeHash(listA->m_Shapes[j]) == hash && listA->m_Shapes[j]->m_Type == b->m_Type) {
+					match = j;
+					break;
+				}
+			}
+		}
+
+		const uint32_t candidate = lastSrc + 1;
+		if (match == kNone && candidate < numA && !used[candidate] && listA->m_Shapes[candidate]->m_Type == b->m_Type) {
+			match = candidate;
+		}
+
+		src[i] = match;
+		if (match != kNone) {
+			used[match] = 1;
+			lastSrc = match;
+		}
+	}
+
+	for (uint32_t i = 0; i < numB; ) {
+		if (exact[i]) {
+			uint32_t count = 1;
+			while (i + count < numB && exact[i + count] && src[i + count] == src[i] + count) {
+				++count;
+			}
+
+			diffWriteVarint(state, (count << 2) | DiffOp::Copy);
+			diffWriteVarint(state, src[i]);
+			i += count;
+		} else if (src[i] != kNone) {
+			diffWriteVarint(state, (src[i] << 2) | DiffOp::Modify);
+			diffWriteShape(state, listA->m_Shapes[src[i]], listB->m_Shapes[i]);
+			++i;
+		} else {
+			diffWriteVarint(state, (listB->m_Shapes[i]->m_Type << 2) | DiffOp::Insert);
+			diffWriteShape(state, nullptr, listB->m_Shapes[i]);
+			++i;
+		}
+	}
+	diffWriteVarint(state, DiffOp::End);
+
+	BX_FREE(state->m_Allocator, buckets);
+}
+
+bool imageDiff(Image* a, Image* b, bx::WriterI* writer)
+{
+	DiffState state;
+	state.m_Writer = writer;
+	state.m_Allocator = a->m_Context->m_Allocator;
+
+	const uint64_t hashes[2] = { imageHash(a), imageHash(b) };
+	diffWrite(&state, &kDiffMagic, sizeof(uint32_t));
+	diffWrite(&state, &hashes[0], sizeof(hashes));
+
+	const uint32_t attrsMask = diffAttrsMask(&a->m_BaseAttrs, &b->m_BaseAttrs);
+
+	uint32_t mask = 0;
+	if (!diffFloatsEqual(&a->m_Width, &b->m_Width, 1) || !diffFloatsEqual(&a->m_Height, &b->m_Height, 1) || !diffFloatsEqual(&a->m_ViewBox[0], &b->m_ViewBox[0], 4)) {
+		mask |= DiffImageField::Size;
+	}
+	if (a->m_BaseProfile != b->m_BaseProfile || a->m_VerMajor != b->m_VerMajor || a->m_VerMinor != b->m_VerMinor) {
+		mask |= DiffImageField::Profile;
+	}
+	if (attrsMask != 0) {
+		mask |= DiffImageField::BaseAttrs;
+	}
+	if (!diffFloatsEqual(&a->m_BoundingRect[0], &b->m_BoundingRect[0], 4)) {
+		mask |= DiffImageField::Bounds;
+	}
+
+	diffWriteVarint(&state, mask);
+	if (mask & DiffImageField::Size) {
+		diffWrite(&state, &b->m_Width, sizeof(float));
+		diffWrite(&state, &b->m_Height, sizeof(float));
+		diffWrite(&state, &b->m_ViewBox[0], sizeof(float) * 4);
+	}
+	if (mask & DiffImageField::Profile) {
+		diffWriteVarint(&state, b->m_BaseProfile);
+		diffWriteVarint(&state, b->m_VerMajor);
+		diffWriteVarint(&state, b->m_VerMinor);
+	}
+	if (mask & DiffImageField::BaseAttrs) {
+		diffWriteVarint(&state, attrsMask);
+		diffWriteAttrs(&state, &b->m_BaseAttrs, attrsMask);
+	}
+	if (mask & DiffImageField::Bounds) {
+		diffWrite(&state, &b->m_BoundingRect[0], sizeof(float) * 4);
+	}
+
+	diffWriteList(&state, &a->m_ShapeList, &b->m_ShapeList);
+
+	return state.m_Error.isOk();
+}
+
+static const uint8_t* patchReadBytes(DiffReader* reader, uint32_t size)
+{
+	if (reader->m_Error || (uint32_t)(reader->m_End - reader->m_Ptr) < size) {
+		reader->m_Error = true;
+		return nullptr;
+	}
+
+	const uint8_t* ptr = reader->m_Ptr;
+	reader->m_Ptr += size;
+	return ptr;
+}
+
+static void patchRead(DiffReader* reader, void* data, uint32_t size)
+{
+	const uint8_t* ptr = patchReadBytes(reader, size);
+	if (ptr) {
+		memcpy(data, ptr, size);
+	}
+}
+
+static uint32_t patchReadVarint(DiffReader* reader)
+{
+	uint32_t val = 0;
+	for (uint32_t shift = 0; shift < 35; shift += 7) {
+		const uint8_t* byte = patchReadBytes(reader, 1);
+		if (!byte) {
+			return 0;
+		}
+
+		val |= (uint32_t)(*byte & 0x7F) << shift;
+		if ((*byte & 0x80) == 0) {
+			return val;
+		}
+	}
+
+	reader->m_Error = true;
+	return 0;
+}
+
+static uint32_t patchReadEnum(DiffReader* reader, uint32_t maxValue)
+{
+	const uint32_t val = patchReadVarint(reader);
+	if (val > maxValue) {
+		reader->m_Error = true;
+		return 0;
+	}
+
+	return val;
+}
+
+static bx::StringView patchReadString(DiffReader* reader)
+{
+	const uint32_t len = patchReadVarint(reader);
+	const uint8_t* ptr = patchReadBytes(reader, len);
+	return ptr
+		? bx::StringView((const char*)ptr, (int32_t)len)
+		: bx::StringView()
+		;
+}
+
+static void patchReadPaint(DiffReader* reader, Paint* paint)
+{
+	paint->m_Type = (PaintType::Enum)patchReadEnum(reader, PaintType::Color);
+	if (paint->m_Type == PaintType::Color) {
+		patchRead(reader, &paint->m_ColorABGR, sizeof(uint32_t));
+	}
+}
+
+static void patchReadAttrs(DiffReader* reader, ShapeAttributes* attrs, uint32_t mask)
+{
+	if (mask & DiffField::Flags) {
+		attrs->m_Flags = patchReadVarint(reader);
+	}
+	if (mask & DiffField::StrokePaint) {
+		patchReadPaint(reader, &attrs->m_StrokePaint);
+	}
+	if (mask & DiffField::FillPaint) {
+		patchReadPaint(reader, &attrs->m_FillPaint);
+	}
+	if (mask & DiffField::Transform) {
+		patchRead(reader, &attrs->m_Transform[0], sizeof(float) * 6);
+	}
+	if (mask & DiffField::StrokeMiterLimit) {
+		patchRead(reader, &attrs->m_StrokeMiterLimit, sizeof(float));
+	}
+	if (mask & DiffField::StrokeOpacity) {
+		patchRead(reader, &attrs->m_StrokeOpacity, sizeof(float));
+	}
+	if (mask & DiffField::StrokeWidth) {
+		patchRead(reader, &attrs->m_StrokeWidth, sizeof(float));
+	}
+	if (mask & DiffField::FillOpacity) {
+		patchRead(reader, &attrs->m_FillOpacity, sizeof(float));
+	}
+	if (mask & DiffField::FontSize) {
+		patchRead(reader, &attrs->m_FontSize, sizeof(float));
+	}
+	if (mask & DiffField::Opacity) {
+		patchRead(reader, &attrs->m_Opacity, sizeof(float));
+	}
+	if (mask & DiffField::StrokeLineJoin) {
+		attrs->m_StrokeLineJoin = (LineJoin::Enum)patchReadEnum(reader, LineJoin::Bevel);
+	}
+	if (mask & DiffField::StrokeLineCap) {
+		attrs->m_StrokeLineCap = (LineCap::Enum)patchReadEnum(reader, LineCap::Square);
+	}
+	if (mask & DiffField::FillRule) {
+		attrs->m_FillRule = (FillRule::Enum)patchReadEnum(reader, FillRule::EvenOdd);
+	}
+	if (mask & DiffField::ID) {
+		const bx::StringView str = patchReadString(reader);
+		if (!reader->m_Error) {
+			shapeAttrsSetID(attrs, str);
+		}
+	}
+	if (mask & DiffField::FontFamily) {
+		const bx::StringView str = patchReadString(reader);
+		if (!reader->m_Error) {
+			shapeAttrsSetFontFamily(attrs, str);
+		}
+	}
+	if (mask & DiffField::Class) {
+		const bx::StringView str = patchReadString(reader);
+		if (!reader->m_Error) {
+			shapeAttrsSetClass(attrs, str);
+		}
+	}
+}
+
+struct PatchArray
+{
+	uint32_t m_Mode;
+	uint32_t m_Begin;      // NOTE: First replaced element
+	uint32_t m_NumRemoved;
+	uint32_t m_NumInserted;
+	const uint8_t* m_Data; // NOTE: m_NumInserted elements
+};
+
+static bool patchReadArray(DiffReader* reader, PatchArray* arr, uint32_t numOld, uint32_t stride)
+{
+	arr->m_Mode = patchReadEnum(reader, DiffArrayMode::Range);
+	if (arr->m_Mode == DiffArrayMode::Full) {
+		arr->m_Begin = 0;
+		arr->m_NumRemoved = numOld;
+	} else {
+		arr->m_Begin = patchReadVarint(reader);
+		arr->m_NumRemoved = patchReadVarint(reader);
+	}
+	arr->m_NumInserted = patchReadVarint(reader);
+
+	if (reader->m_Error
+	||  arr->m_Begin > numOld
+	||  arr->m_NumRemoved > numOld - arr->m_Begin
+	||  arr->m_NumInserted > (uint32_t)(reader->m_End - reader->m_Ptr) / stride) {
+		reader->m_Error = true;
+		return false;
+	}
+
+	arr->m_Data = patchReadBytes(reader, arr->m_NumInserted * stride);
+	return arr->m_Data != nullptr;
+}
+
+static void patchPointList(PointList* ptList, const PatchArray* arr)
+{
+	const uint32_t stride = sizeof(float) * 2;
+	const uint32_t numOld = ptList->m_NumPoints;
+	const uint32_t tailBegin = arr->m_Begin + arr->m_NumRemoved;
+	if (arr->m_NumInserted > arr->m_NumRemoved) {
+		pointListAllocPoints(ptList, arr->m_NumInserted - arr->m_NumRemoved);
+	} else {
+		ptList->m_NumPoints -= arr->m_NumRemoved - arr->m_NumInserted;
+	}
+
+	uint8_t* coords = (uint8_t*)ptList->m_Coords;
+	if (tailBegin != numOld) {
+		bx::memMove(&coords[(arr->m_Begin + arr->m_NumInserted) * stride], &coords[tailBegin * stride], (numOld - tailBegin) * stride);
+	}
+	if (arr->m_NumInserted != 0) {
+		bx::memCopy(&coords[arr->m_Begin * stride], arr->m_Data, arr->m_NumInserted * stride);
+	}
+}
+
+static void patchPathCommands(Path* path, const PatchArray* arr)
+{
+	const uint32_t tailBegin = arr->m_Begin + arr->m_NumRemoved;
+	if (arr->m_NumInserted > arr->m_NumRemoved) {
+		pathInsertCommands(path, tailBegin, arr->m_NumInserted - arr->m_NumRemoved);
+	} else if (arr->m_NumInserted < arr->m_NumRemoved) {
+		const uint32_t numOld = path->m_NumCommands;
+		const uint32_t numRemoved = arr->m_NumRemoved - arr->m_NumInserted;
+		bx::memMove(&path->m_Commands[tailBegin - numRemoved], &path->m_Commands[tailBegin], sizeof(PathCmd) * (numOld - tailBegin));
+		path->m_NumCommands -= numRemoved;
+	}
+
+	if (arr->m_NumInserted != 0) {
+		bx::memCopy(&path->m_Commands[arr->m_Begin], arr->m_Data, sizeof(PathCmd) * arr->m_NumInserted);
+	}
+}
+
+// Walks a packed path (see pathPack()) so that corrupted scripts can't make pathIterNext() read past its end.
+static bool patchCheckPackedPath(const uint8_t* packed, uint32_t size, uint32_t numCommands)
+{
+	static const uint8_t kNumValues[] = { 2, 2, 6, 4, 5, 0 }; // NOTE: Varints per PathCmdType
+
+	const uint8_t* ptr = packed;
+	const uint8_t* end = packed + size;
+	for (uint32_t i = 0; i < numCommands; ++i) {
+		if (ptr == end || (*ptr & 0x07) > PathCmdType::ClosePath) {
+			return false;
+		}
+
+		const uint32_t numValues = kNumValues[*ptr++ & 0x07];
+		for (uint32_t j = 0; j < numValues; ++j) {
+			uint32_t numBytes = 1;
+			while (ptr != end && (*ptr & 0x80) != 0 && numBytes < 5) {
+				++ptr;
+				++numBytes;
+			}
+
+			if (ptr == end || (*ptr & 0x80) != 0) {
+				return false;
+			}
+			++ptr;
+		}
+	}
+
+	return ptr == end;
+}
+
+static bool patchList(DiffReader* reader, bx::AllocatorI* allocator, ShapeList* shapeList, const ShapeAttributes* parentAttrs);
+
+static bool patchShape(DiffReader* reader, bx::AllocatorI* allocator, Shape* shape)
+{
+	const uint32_t mask = patchReadVarint(reader);
+	if (mask & ~DiffField::All) {
+		reader->m_Error = true;
+	}
+
+	patchReadAttrs(reader, shape->m_Attrs, mask);
+	if (mask & DiffField::Bounds) {
+		patchRead(reader, &shape->m_BoundingRect[0], sizeof(float) * 4);
+	}
+
+	// NOTE: The shape no longer matches any source text (see imageReparse()).
+	shape->m_Hash = 0;
+	shape->m_SourceOffset = 0;
+	shape->m_SourceLength = 0;
+
+	if (reader->m_Error || (mask & DiffField::Geometry) == 0) {
+		return !reader->m_Error;
+	}
+
+	switch (shape->m_Type) {
+	case ShapeType::Group:
+		return patchList(reader, allocator, &shape->m_ShapeList, shape->m_Attrs);
+	case ShapeType::Rect:
+		patchRead(reader, &shape->m_Rect, sizeof(Rect));
+		break;
+	case ShapeType::Circle:
+		patchRead(reader, &shape->m_Circle, sizeof(Circle));
+		break;
+	case ShapeType::Ellipse:
+		patchRead(reader, &shape->m_Ellipse, sizeof(Ellipse));
+		break;
+	case ShapeType::Line:
+		patchRead(reader, &shape->m_Line, sizeof(Line));
+		break;
+	case ShapeType::Polyline:
+	case ShapeType::Polygon:
+	{
+		PatchArray arr;
+		if (patchReadArray(reader, &arr, shape->m_PointList.m_NumPoints, sizeof(float) * 2)) {
+			patchPointList(&shape->m_PointList, &arr);
+		}
+	}
+	break;
+	case ShapeType::Path:
+	{
+		Path* path = &shape->m_Path;
+
+		const uint8_t* modePtr = reader->m_Ptr;
+		if (patchReadEnum(reader, DiffArrayMode::Packed) == DiffArrayMode::Packed) {
+			float scale;
+			patchRead(reader, &scale, sizeof(float));
+			const uint32_t numCommands = patchReadVarint(reader);
+			const uint32_t packedSize = patchReadVarint(reader);
+			const uint8_t* packed = patchReadBytes(reader, packedSize);
+			if (!packed || !patchCheckPackedPath(packed, packedSize, numCommands)) {
+				reader->m_Error = true;
+				break;
+			}
+
+			pathFree(path);
+			if (packedSize != 0) {
+				path->m_Packed = (uint8_t*)BX_ALLOC(path->m_Allocator, packedSize);
+				bx::memCopy(path->m_Packed, packed, packedSize);
+			}
+			path->m_PackedSize = packedSize;
+			path->m_PackedScale = scale;
+			path->m_NumCommands = numCommands;
+			break;
+		}
+
+		if (reader->m_Error) {
+			break;
+		}
+		reader->m_Ptr = modePtr;
+
+		// NOTE: Ranges are only sent against unpacked paths.
+		const uint32_t numOld = path->m_Packed ? 0 : path->m_NumCommands;
+		PatchArray arr;
+		if (!patchReadArray(reader, &arr, numOld, sizeof(PathCmd))) {
+			break;
+		}
+
+		if (path->m_Packed && arr.m_Mode != DiffArrayMode::Full) {
+			reader->m_Error = true;
+			break;
+		}
+
+		for (uint32_t i = 0; i < arr.m_NumInserted; ++i) {
+			PathCmdType::Enum type;
+			memcpy(&type, &arr.m_Data[i * sizeof(PathCmd)], sizeof(PathCmdType::Enum));
+			if (type > PathCmdType::ClosePath) {
+				reader->m_Error = true;
+				break;
+			}
+		}
+
+		if (!reader->m_Error) {
+			if (path->m_Packed) {
+				pathFree(path);
+			}
+			patchPathCommands(path, &arr);
+		}
+	}
+	break;
+	case ShapeType::Text:
+	{
+		Text* text = &shape->m_Text;
+
+		float pos[2];
+		patchRead(reader, &pos[0], sizeof(pos));
+		const TextAnchor::Enum anchor = (TextAnchor::Enum)patchReadEnum(reader, TextAnchor::End);
+		const uint32_t lenPlusOne = patchReadVarint(reader);
+		const uint8_t* str = patchReadBytes(reader, lenPlusOne ? lenPlusOne - 1 : 0);
+		if (!str) {
+			break;
+		}
+
+		text->x = pos[0];
+		text->y = pos[1];
+		text->m_Anchor = anchor;
+
+		BX_FREE(text->m_Allocator, text->m_String);
+		text->m_String = nullptr;
+		if (lenPlusOne != 0) {
+			text->m_String = (char*)BX_ALLOC(text->m_Allocator, sizeof(char) * lenPlusOne);
+			bx::memCopy(text->m_String, str, lenPlusOne - 1);
+			text->m_String[lenPlusOne - 1] = '\0';
+		}
+	}
+	break;
+	default:
+		SSVG_CHECK(false, "Unknown shape type");
+		reader->m_Error = true;
+		break;
+	}
+
+	return !reader->m_Error;
+}
+
+// Builds the new drawing order from the ops, then deletes the base shapes no op referred to. On errors the
+// list keeps its old order plus any inserted shapes.
+static bool patchList(DiffReader* reader, bx::AllocatorI* allocator, ShapeList* shapeList, const ShapeAttributes* parentAttrs)
+{
+	// NOTE: Inserts may reallocate m_Shapes, so the base shapes are looked up in a copy.
+	const uint32_t numOld = shapeList->m_NumShapes;
+	Shape** oldShapes = (Shape**)BX_ALLOC(allocator, sizeof(Shape*) * numOld + numOld);
+	uint8_t* used = (uint8_t*)&oldShapes[numOld];
+	if (numOld != 0) {
+		bx::memCopy(oldShapes, shapeList->m_Shapes, sizeof(Shape*) * numOld);
+		bx::memSet(used, 0, numOld);
+	}
+
+	Shape** order = nullptr;
+	uint32_t numOrder = 0;
+	uint32_t orderCapacity = 0;
+
+	const bool trackDirty = reader->m_TrackDirty;
+	uint32_t lastOld = 0;
+
+	bool ok = true;
+	for (;;) {
+		const uint32_t tag = patchReadVarint(reader);
+		const uint32_t op = tag & 3;
+		const uint32_t arg = tag >> 2;
+		if (reader->m_Error) {
+			ok = false;
+			break;
+		}
+
+		if (op == DiffOp::End) {
+			break;
+		}
+
+		uint32_t first = arg;
+		uint32_t count = 1;
+		if (op == DiffOp::Copy) {
+			first = patchReadVarint(reader);
+			count = arg;
+		}
+
+		if (op != DiffOp::Insert && (count == 0 || first > numOld || count > numOld - first)) {
+			ok = false;
+			break;
+		}
+
+		if (op == DiffOp::Insert && arg >= ShapeType::NumTypes) {
+			ok = false;
+			break;
+		}
+
+		if (numOrder + count > orderCapacity) {
+			orderCapacity = bx::max<uint32_t>(orderCapacity ? (orderCapacity * 3) / 2 : 16, numOrder + count);
+			order = (Shape**)BX_REALLOC(allocator, order, sizeof(Shape*) * orderCapacity);
+		}
+
+		if (op == DiffOp::Insert) {
+			Shape* shape = shapeListAllocShape(shapeList, (ShapeType::Enum)arg, parentAttrs);
+			order[numOrder++] = shape;
+			if (!patchShape(reader, allocator, shape)) {
+				ok = false;
+				break;
+			}
+
+			if (trackDirty) {
+				shapeEndEdit(shape, shapeList);
+			}
+
+			continue;
+		}
+
+		for (uint32_t i = first; i < first + count; ++i) {
+			if (used[i]) {
+				ok = false;
+				break;
+			}
+
+			// NOTE: Shapes placed before ones which preceded them moved in front of those.
+			if (trackDirty && op == DiffOp::Copy && i < lastOld) {
+				shapeAddDirtyRegion(oldShapes[i], shapeList);
+			}
+			lastOld = bx::max<uint32_t>(lastOld, i);
+
+			used[i] = 1;
+			order[numOrder++] = oldShapes[i];
+		}
+
+		if (!ok) {
+			break;
+		}
+
+		if (op == DiffOp::Modify) {
+			Shape* shape = oldShapes[first];
+			if (trackDirty) {
+				shapeBeginEdit(shape, shapeList);
+			}
+
+			if (!patchShape(reader, allocator, shape)) {
+				ok = false;
+				break;
+			}
+
+			if (trackDirty) {
+				shapeEndEdit(shape, shapeList);
+			}
+		}
+	}
+
+	if (ok) {
+		// NOTE: Base shapes are still in their original places at the front, so deleting them back to
+		// front keeps the remaining indices valid.
+		for (uint32_t i = numOld; i-- > 0; ) {
+			if (!used[i]) {
+				shapeListDeleteShape(shapeList, i);
+			}
+		}
+
+		SSVG_CHECK(shapeList->m_NumShapes == numOrder, "Invalid shape list");
+		if (numOrder != 0) {
+			bx::memCopy(shapeList->m_Shapes, order, sizeof(Shape*) * numOrder);
+		}
+	}
+
+	shapeListInvalidateHash(shapeList);
+
+	BX_FREE(allocator, order);
+	BX_FREE(allocator, oldShapes);
+
+	return ok;
+}
+
+bool imagePatch(Image* img, const void* script, uint32_t size)
+{
+	DiffReader reader;
+	reader.m_Ptr = (const uint8_t*)script;
+	reader.m_End = reader.m_Ptr + size;
+	reader.m_Error = false;
+	reader.m_TrackDirty = img->m_ShapeList.m_DirtyRegions != nullptr;
+
+	uint32_t magic = 0;
+	uint64_t hashes[2] = { 0, 0 };
+	patchRead(&reader, &magic, sizeof(uint32_t));
+	patchRead(&reader, &hashes[0], sizeof(hashes));
+	if (reader.m_Error || magic != kDiffMagic || imageHash(img) != hashes[0]) {
+		return false;
+	}
+
+	const uint32_t mask = patchReadVarint(&reader);
+	if (mask & ~DiffImageField::All) {
+		return false;
+	}
+
+	if (mask & DiffImageField::Size) {
+		patchRead(&reader, &img->m_Width, sizeof(float));
+		patchRead(&reader, &img->m_Height, sizeof(float));
+		patchRead(&reader, &img->m_ViewBox[0], sizeof(float) * 4);
+	}
+	if (mask & DiffImageField::Profile) {
+		img->m_BaseProfile = (BaseProfile::Enum)patchReadEnum(&reader, BaseProfile::Tiny);
+		img->m_VerMajor = (uint16_t)patchReadEnum(&reader, UINT16_MAX);
+		img->m_VerMinor = (uint16_t)patchReadEnum(&reader, UINT16_MAX);
+	}
+	if (mask & DiffImageField::BaseAttrs) {
+		const uint32_t attrsMask = patchReadVarint(&reader);
+		if (attrsMask & ~DiffField::AllAttrs) {
+			return false;
+		}
+		patchReadAttrs(&reader, &img->m_BaseAttrs, attrsMask);
+	}
+	if (mask & DiffImageField::Bounds) {
+		patchRead(&reader, &img->m_BoundingRect[0], sizeof(float) * 4);
+	}
+	if (mask & (DiffImageField::Size | DiffImageField::BaseAttrs)) {
+		imageAddDirtyRegion(img, nullptr);
+	}
+
+	if (reader.m_Error || !patchList(&reader, img->m_Context->m_Allocator, &img->m_ShapeList, &img->m_BaseAttrs)) {
+		return false;
+	}
+
+	return reader.m_Ptr == reader.m_End
+		&& imageHash(img) == hashes[1]
+		;
+}
+}
@@ -0,0 +1,263 @@
+#include <ssvg/ssvg.h>
+#include <bx/bx.h>
+#include <bx/string.h>
+#include <stddef.h> // offsetof
+#include <string.h> // memcpy
+
+namespace ssvg
+{
+static const uint64_t kHashPrime1 = 0x9E3779B185EBCA87ull;
+static const uint64_t kHashPrime2 = 0xC2B2AE3D27D4EB4Full;
+static const uint64_t kHashPrime3 = 0x165667B19E3779F9ull;
+
+static inline uint64_t hashRead64(const uint8_t* ptr)
+{
+	uint64_t val;
+	memcpy(&val, ptr, sizeof(uint64_t));
+	return val;
+}
+
+static inline uint64_t hashRotl(uint64_t x, uint32_t r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t hashRound(uint64_t acc, uint64_t input)
+{
+	acc += input * kHashPrime2;
+	acc = hashRotl(acc, 31);
+	return acc * kHashPrime1;
+}
+
+static inline uint64_t hashAvalanche(uint64_t h)
+{
+	h ^= h >> 33;
+	h *= kHashPrime2;
+	h ^= h >> 29;
+	h *= kHashPrime3;
+	h ^= h >> 32;
+	return h;
+}
+
+// Two independent 64-bit lanes (xxHash64 rounds), 16 bytes per step, cross-mixed at the end.
+void hash128(const void* data, uint32_t size, uint64_t seed, uint64_t* hash)
+{
+	const uint8_t* ptr = (const uint8_t*)data;
+	const uint8_t* end = ptr + (size & ~15u);
+
+	uint64_t h0 = seed + kHashPrime1;
+	uint64_t h1 = (seed ^ kHashPrime3) - kHashPrime2;
+	while (ptr != end) {
+		h0 = hashRound(h0, hashRead64(ptr));
+		h1 = hashRound(h1, hashRead64(ptr + 8));
+		ptr += 16;
+	}
+
+	uint8_t tail[16] = {};
+	const uint32_t tailSize = size & 15u;
+	if (tailSize) {
+		memcpy(&tail[0], ptr, tailSize);
+		h0 = hashRound(h0, hashRead64(&tail[0]));
+		h1 = hashRound(h1, hashRead64(&tail[8]));
+	}
+
+	h0 ^= (uint64_t)size * kHashPrime3;
+	h1 ^= (uint64_t)size;
+	h0 += h1;
+	h1 += h0;
+	h0 = hashAvalanche(h0);
+	h1 = hashAvalanche(h1);
+	h0 += h1;
+	h1 += h0;
+
+	hash[0] = h0;
+	hash[1] = h1;
+}
+
+static inline uint32_t hashFloatBits(float v)
+{
+	uint32_t bits;
+	memcpy(&bits, &v, sizeof(uint32_t));
+	return bits;
+}
+
+static inline uint64_t hashBytes(const void* data, uint32_t size, uint64_t seed)
+{
+	uint64_t hash[2];
+	hash128(data, size, seed, &hash[0]);
+	return hash[0];
+}
+
+static inline void hashPaint(uint32_t* words, uint32_t* n, const Paint* paint)
+{
+	words[(*n)++] = paint->m_Type;
+	words[(*n)++] = paint->m_Type == PaintType::Color ? paint->m_ColorABGR : 0;
+}
+
+// NOTE: Only the attributes the shape sets itself. ids and classes don't affect rendering.
+static uint64_t shapeAttrsHash(const ShapeAttributes* attrs)
+{
+	uint32_t words[32];
+	uint32_t n = 0;
+
+	const uint32_t flags = attrs->m_Flags & AttribFlags::InheritAll;
+	words[n++] = flags;
+	if ((flags & AttribFlags::StrokePaintInherit) == 0) {
+		hashPaint(words, &n, &attrs->m_StrokePaint);
+	}
+	if ((flags & AttribFlags::StrokeMiterLimitInherit) == 0) {
+		words[n++] = hashFloatBits(attrs->m_StrokeMiterLimit);
+	}
+	if ((flags & AttribFlags::StrokeOpacityInherit) == 0) {
+		words[n++] = hashFloatBits(attrs->m_StrokeOpacity);
+	}
+	if ((flags & AttribFlags::StrokeWidthInherit) == 0) {
+		words[n++] = hashFloatBits(attrs->m_StrokeWidth);
+	}
+	if ((flags & AttribFlags::StrokeLineJoinInherit) == 0) {
+		words[n++] = attrs->m_StrokeLineJoin;
+	}
+	if ((flags & AttribFlags::StrokeLineCapInherit) == 0) {
+		words[n++] = attrs->m_StrokeLineCap;
+	}
+	if ((flags & AttribFlags::FillPaintInherit) == 0) {
+		hashPaint(words, &n, &attrs->m_FillPaint);
+	}
+	if ((flags & AttribFlags::FillOpacityInherit) == 0) {
+		words[n++] = hashFloatBits(attrs->m_FillOpacity);
+	}
+	if ((flags & AttribFlags::FillRuleInherit) == 0) {
+		words[n++] = attrs->m_FillRule;
+	}
+	if ((flags & AttribFlags::FontSizeInherit) == 0) {
+		words[n++] = hashFloatBits(attrs->m_FontSize);
+	}
+	for (uint32_t i = 0; i < 6; ++i) {
+		words[n++] = hashFloatBits(attrs->m_Transform[i]);
+	}
+	words[n++] = hashFloatBits(attrs->m_Opacity);
+
+	uint64_t hash = hashBytes(words, sizeof(uint32_t) * n, 0);
+	if ((flags & AttribFlags::FontFamilyInherit) == 0) {
+		const bx::StringView fontFamily = shapeAttrsGetFontFamily(attrs);
+		hash = hashBytes(fontFamily.getPtr(), (uint32_t)fontFamily.getLength(), hash);
+	}
+
+	return hash;
+}
+
+static uint64_t shapeCalcHash(Shape* shape)
+{
+	uint64_t hash = hashRound(kHashPrime3 ^ shape->m_Type, shapeAttrsHash(shape->m_Attrs));
+
+	switch (shape->m_Type) {
+	case ShapeType::Group:
+	{
+		const ShapeList* children = &shape->m_ShapeList;
+		const uint32_t numChildren = children->m_NumShapes;
+		for (uint32_t i = 0; i < numChildren; ++i) {
+			hash = hashRound(hash, shapeHash(children->m_Shapes[i]));
+		}
+		hash = hashRound(hash, numChildren);
+	}
+	break;
+	case ShapeType::Rect:
+		hash = hashBytes(&shape->m_Rect, sizeof(Rect), hash);
+		break;
+	case ShapeType::Circle:
+		hash = hashBytes(&shape->m_Circle, sizeof(Circle), hash);
+		break;
+	case ShapeType::Ellipse:
+		hash = hashBytes(&shape->m_Ellipse, sizeof(Ellipse), hash);
+		break;
+	case ShapeType::Line:
+		hash = hashBytes(&shape->m_Line, sizeof(Line), hash);
+		break;
+	case ShapeType::Polyline:
+	case ShapeType::Polygon:
+		hash = hashBytes(shape->m_PointList.m_Coords, sizeof(float) * 2 * shape->m_PointList.m_NumPoints, hash);
+		break;
+	case ShapeType::Path:
+	{
+		// NOTE: Unpacked commands are hashed as stored, including their unused data.
+		const Path* path = &shape->m_Path;
+		hash = path->m_Packed
+			? hashBytes(path->m_Packed, path->m_PackedSize, hashRound(hash, hashFloatBits(path->m_PackedScale)))
+			: hashBytes(path->m_Commands, sizeof(PathCmd) * path->m_NumCommands, hash)
+			;
+	}
+	break;
+	case ShapeType::Text:
+	{
+		const Text* text = &shape->m_Text;
+		const uint32_t words[3] = { hashFloatBits(text->x), hashFloatBits(text->y), text->m_Anchor };
+		hash = hashBytes(&words[0], sizeof(words), hash);
+		if (text->m_String) {
+			hash = hashBytes(text->m_String, bx::strLen(text->m_String), hashRound(hash, 1));
+		}
+	}
+	break;
+	default:
+		SSVG_CHECK(false, "Unknown shape type");
+		break;
+	}
+
+	hash = hashAvalanche(hash);
+
+	// NOTE: 0 marks invalid caches.
+	return hash != 0 ? hash : 1;
+}
+
+uint64_t shapeHash(Shape* shape)
+{
+	if (shape->m_Hash == 0) {
+		shape->m_Hash = shapeCalcHash(shape);
+	}
+
+	return shape->m_Hash;
+}
+
+uint64_t imageHash(Image* img)
+{
+	uint64_t hash = hashRound(kHashPrime1, shapeAttrsHash(&img->m_BaseAttrs));
+
+	const uint32_t words[6] = {
+		hashFloatBits(img->m_Width),
+		hashFloatBits(img->m_Height),
+		hashFloatBits(img->m_ViewBox[0]),
+		hashFloatBits(img->m_ViewBox[1]),
+		hashFloatBits(img->m_ViewBox[2]),
+		hashFloatBits(img->m_ViewBox[3])
+	};
+	hash = hashBytes(&words[0], sizeof(words), hash);
+
+	const ShapeList* shapeList = &img->m_ShapeList;
+	const uint32_t numShapes = shapeList->m_NumShapes;
+	for (uint32_t i = 0; i < numShapes; ++i) {
+		hash = hashRound(hash, shapeHash(shapeList->m_Shapes[i]));
+	}
+
+	return hashAvalanche(hashRound(hash, numShapes));
+}
+
+void shapeInvalidateHash(Shape* shape, ShapeList* shapeList)
+{
+	shape->m_Hash = 0;
+	shapeListInvalidateHash(shapeList);
+}
+
+// NOTE: Group hashes are only cached together with the hashes of their whole subtree, so the walk
+// can stop at the first group which is already invalid.
+void shapeListInvalidateHash(ShapeList* shapeList)
+{
+	while (shapeList->m_ParentList) {
+		Shape* group = (Shape*)((uint8_t*)shapeList - offsetof(Shape, m_ShapeList));
+		if (group->m_Hash == 0) {
+			break;
+		}
+
+		group->m_Hash = 0;
+		shapeList = shapeList->m_ParentList;
+	}
+}
+}
@@ -1,14 +1,18 @@
 #include <ssvg/ssvg.h>
 #include <bx/bx.h>
+#include <bx/allocator.h>
 #include <bx/string.h>
 #include <bx/math.h>
+#include <bx/cpu.h>
+#include <bx/hash.h>
+#include <bx/timer.h>
 #include <float.h> // FLT_MAX
+#include <stddef.h> // offsetof
 
 BX_PRAGMA_DIAGNOSTIC_IGNORED_MSVC(4127) // conditional expression is constant
 
 namespace ssvg
 {
-extern bx::AllocatorI* s_Allocator;
 
 struct ParseAttr
 {
@@ -20,13 +24,105 @@ struct ParseAttr
 	};
 };
 
+// Why pathFromStringLimited() stopped.
+struct ParsePath
+{
+	enum Result : uint32_t
+	{
+		OK = 0,
+		Fail = 1,
+		MaxCommands = 2,
+		Timeout = 3
+	};
+};
+
+struct ParserMemo;
+
+// Attributes without an inherit flag (see AttribFlags). Tracked in ParserState::m_AttrsSet so memoized
+// styles know which of them to apply.
+struct ParserAttrs
+{
+	enum Enum : uint32_t
+	{
+		Transform = 1 << 0,
+		Opacity   = 1 << 1,
+		ID        = 1 << 2,
+		Class     = 1 << 3,
+	};
+};
+
 struct ParserState
 {
 	const char* m_XMLString;
 	const char* m_Ptr;
 	uint32_t m_Flags;
+
+	// Resource limits (see ImageLoadLimits). Unlimited values are stored as the type's max.
+	uint64_t m_MaxBytes;
+	uint32_t m_MaxShapes;
+	uint32_t m_MaxPathCommands;
+	uint32_t m_MaxDepth;
+	int64_t m_Deadline;        // NOTE: bx::getHPCounter() value. 0 if there's no time limit.
+	uint64_t m_NumBytes;
+	uint32_t m_NumShapes;
+	uint32_t m_Depth;
+	ImageLoadError::Enum m_Error;
+	uint32_t m_NumThreads;     // NOTE: > 1 parses the top-level elements in parallel (see imageLoadParallel())
+	ParserMemo* m_Memo;        // NOTE: nullptr unless ImageLoadFlags::MemoizeAttributes is set. One per thread.
+	uint32_t m_AttrsSet;       // NOTE: ParserAttrs::Enum bits
+	uint32_t m_SourceBase;     // NOTE: Offset of the element holding the shapes being parsed (see Shape::m_SourceOffset)
+	const Image* m_Image;
+	ImageLoadShapeCallback m_ShapeCallback; // NOTE: See imageLoadProgressive()
+	void* m_ShapeCallbackUserData;
+};
+
+struct ParserMemoKind
+{
+	enum Enum : uint32_t
+	{
+		Style = 0,
+		Transform,
+		Path
+	};
+};
+
+// The effect of a style attribute: the properties whose inherit flag it clears, plus m_AttrsSet.
+struct ParserMemoStyle
+{
+	ShapeAttributes m_Attrs;
+	uint32_t m_AttrsSet;
+};
+
+// NOTE: The commands follow the struct.
+struct ParserMemoPath
+{
+	PathCmd* m_Commands;
+	uint32_t m_NumCommands;
 };
 
+struct ParserMemoEntry
+{
+	const char* m_Str;           // NOTE: Points into the source XML
+	uint32_t m_Length;
+	uint32_t m_Hash;
+	ParserMemoKind::Enum m_Kind;
+	void* m_Value;               // NOTE: ParserMemoStyle, float[6] or ParserMemoPath. nullptr for empty slots.
+};
+
+// Parsed values of the style, transform and d attributes of one load, keyed by the attribute value
+// (see ImageLoadFlags::MemoizeAttributes). Open addressing.
+struct ParserMemo
+{
+	bx::AllocatorI* m_Allocator;
+	ParserMemoEntry* m_Entries;
+	uint32_t m_Mask;
+	uint32_t m_NumEntries;
+};
+
+static const uint32_t kParserMemoMinEntries = 256;
+static const uint32_t kParserArcMaxCubics = 5; // NOTE: Same as kArcMaxCubics in ssvg_builder.cpp
+static const uint32_t kParserPathDeadlineInterval = 256;
+
 struct CSSColor
 {
 	bx::StringView m_Name;
@@ -76,8 +172,9 @@ static const CSSColor kCSSColors[] = {
 static const uint32_t kNumCSSColors = BX_COUNTOF(kCSSColors);
 
 static bool parseShapes(ParserState* parser, ShapeList* shapeList, const ShapeAttributes* parentAttrs, const char* closingTag, uint32_t closingTagLen);
+static ParsePath::Result pathFromStringLimited(Path* path, const bx::StringView& str, uint32_t flags, uint32_t maxCommands, int64_t deadline);
 static const char* parseCoord(const char* str, const char* end, float* coord);
-static ParseAttr::Result parseGenericShapeAttribute(const bx::StringView& name, const bx::StringView& value, ShapeAttributes* attrs);
+static ParseAttr::Result parseGenericShapeAttribute(ParserState* parser, const bx::StringView& name, const bx::StringView& value, ShapeAttributes* attrs);
 
 inline uint8_t charToNibble(char ch)
 {
@@ -284,6 +381,141 @@ static bool parserGetAttribute(ParserState* parser, bx::StringView* name, bx::St
 	return true;
 }
 
+// NOTE: Only valid as long as the source XML string is alive (ImageLoadFlags::BorrowStrings).
+inline void parserBorrowString(StringRef* ref, const bx::StringView& str)
+{
+	ref->m_Ptr = str.getPtr();
+	ref->m_Length = (uint32_t)str.getLength();
+}
+
+inline void parserPackPath(ParserState* parser, Path* path)
+{
+	if ((parser->m_Flags & ImageLoadFlags::PackPaths) != 0) {
+		// NOTE: Paths with coordinates outside the quantization range stay unpacked.
+		pathPack(path, SSVG_CONFIG_PATH_PACK_SCALE);
+	}
+}
+
+inline bool parserFail(ParserState* parser, ImageLoadError::Enum error)
+{
+	parser->m_Error = error;
+	return false;
+}
+
+// Accounts for the memory allocated for a parsed element and checks the byte budget.
+inline bool parserAddBytes(ParserState* parser, uint64_t numBytes)
+{
+	parser->m_NumBytes += numBytes;
+	if (parser->m_NumBytes > parser->m_MaxBytes) {
+		return parserFail(parser, ImageLoadError::MaxBytes);
+	}
+
+	return true;
+}
+
+// Called once per element.
+inline bool parserCheckLimits(ParserState* parser)
+{
+	if (parser->m_NumShapes > parser->m_MaxShapes) {
+		return parserFail(parser, ImageLoadError::MaxShapes);
+	}
+
+	if (parser->m_Deadline != 0 && bx::getHPCounter() > parser->m_Deadline) {
+		return parserFail(parser, ImageLoadError::Timeout);
+	}
+
+	return true;
+}
+
+static ParserMemo* parserMemoCreate(bx::AllocatorI* allocator)
+{
+	ParserMemo* memo = (ParserMemo*)BX_ALLOC(allocator, sizeof(ParserMemo));
+	memo->m_Allocator = allocator;
+	memo->m_Entries = (ParserMemoEntry*)BX_ALLOC(allocator, sizeof(ParserMemoEntry) * kParserMemoMinEntries);
+	bx::memSet(memo->m_Entries, 0, sizeof(ParserMemoEntry) * kParserMemoMinEntries);
+	memo->m_Mask = kParserMemoMinEntries - 1;
+	memo->m_NumEntries = 0;
+
+	return memo;
+}
+
+static void parserMemoDestroy(ParserMemo* memo)
+{
+	bx::AllocatorI* allocator = memo->m_Allocator;
+
+	const uint32_t numEntries = memo->m_Mask + 1;
+	for (uint32_t i = 0; i < numEntries; ++i) {
+		if (memo->m_Entries[i].m_Value) {
+			BX_FREE(allocator, memo->m_Entries[i].m_Value);
+		}
+	}
+
+	BX_FREE(allocator, memo->m_Entries);
+	BX_FREE(allocator, memo);
+}
+
+inline uint32_t parserMemoHash(ParserMemoKind::Enum kind, const bx::StringView& str)
+{
+	bx::HashMurmur2A hash;
+	hash.begin(kind);
+	hash.add(str.getPtr(), (int32_t)str.getLength());
+	return hash.end();
+}
+
+// Returns the entry holding str or the empty slot it would go into.
+static ParserMemoEntry* parserMemoFind(ParserMemo* memo, ParserMemoKind::Enum kind, const bx::StringView& str, uint32_t hash)
+{
+	const uint32_t len = (uint32_t)str.getLength();
+
+	uint32_t id = hash & memo->m_Mask;
+	for (;;) {
+		ParserMemoEntry* entry = &memo->m_Entries[id];
+		if (entry->m_Value == nullptr) {
+			return entry;
+		}
+
+		if (entry->m_Hash == hash && entry->m_Kind == kind && entry->m_Length == len && !bx::memCmp(entry->m_Str, str.getPtr(), len)) {
+			return entry;
+		}
+
+		id = (id + 1) & memo->m_Mask;
+	}
+}
+
+static void parserMemoInsert(ParserMemo* memo, ParserMemoKind::Enum kind, const bx::StringView& str, uint32_t hash, void* value)
+{
+	if ((memo->m_NumEntries + 1) * 2 > memo->m_Mask + 1) {
+		const uint32_t oldNumEntries = memo->m_Mask + 1;
+		ParserMemoEntry* oldEntries = memo->m_Entries;
+
+		memo->m_Mask = oldNumEntries * 2 - 1;
+		memo->m_Entries = (ParserMemoEntry*)BX_ALLOC(memo->m_Allocator, sizeof(ParserMemoEntry) * oldNumEntries * 2);
+		bx::memSet(memo->m_Entries, 0, sizeof(ParserMemoEntry) * oldNumEntries * 2);
+
+		for (uint32_t i = 0; i < oldNumEntries; ++i) {
+			const ParserMemoEntry* oldEntry = &oldEntries[i];
+			if (oldEntry->m_Value) {
+				uint32_t id = oldEntry->m_Hash & memo->m_Mask;
+				while (memo->m_Entries[id].m_Value) {
+					id = (id + 1) & memo->m_Mask;
+				}
+				bx::memCopy(&memo->m_Entries[id], oldEntry, sizeof(ParserMemoEntry));
+			}
+		}
+
+		BX_FREE(memo->m_Allocator, oldEntries);
+	}
+
+	ParserMemoEntry* entry = parserMemoFind(memo, kind, str, hash);
+	SSVG_CHECK(entry->m_Value == nullptr, "Value already memoized");
+	entry->m_Str = str.getPtr();
+	entry->m_Length = (uint32_t)str.getLength();
+	entry->m_Hash = hash;
+	entry->m_Kind = kind;
+	entry->m_Value = value;
+	memo->m_NumEntries++;
+}
+
 static bool parseVersion(const bx::StringView& verStr, uint16_t* maj, uint16_t* min)
 {
 	const float fver = (float)atof(verStr.getPtr());
@@ -561,7 +793,35 @@ static bool parseTransform(const bx::StringView& str, float* transform)
 	return true;
 }
 
+static bool parseTransformMemoized(ParserMemo* memo, const bx::StringView& str, float* transform)
+{
+	const uint32_t hash = parserMemoHash(ParserMemoKind::Transform, str);
+	const ParserMemoEntry* entry = parserMemoFind(memo, ParserMemoKind::Transform, str, hash);
+	if (entry->m_Value) {
+		bx::memCopy(transform, entry->m_Value, sizeof(float) * 6);
+		return true;
+	}
+
+	if (!parseTransform(str, transform)) {
+		return false;
+	}
+
+	float* value = (float*)BX_ALLOC(memo->m_Allocator, sizeof(float) * 6);
+	bx::memCopy(value, transform, sizeof(float) * 6);
+	parserMemoInsert(memo, ParserMemoKind::Transform, str, hash, value);
+
+	return true;
+}
+
 bool pathFromString(Path* path, const bx::StringView& str, uint32_t flags)
+{
+	return pathFromStringLimited(path, str, flags, UINT32_MAX, 0) == ParsePath::OK;
+}
+
+// Fails as soon as the path would have more than maxCommands commands (arcs converted to cubics count
+// as kParserArcMaxCubics) or, every kParserPathDeadlineInterval commands, once the deadline (a
+// bx::getHPCounter() value, 0 for none) has passed.
+static ParsePath::Result pathFromStringLimited(Path* path, const bx::StringView& str, uint32_t flags, uint32_t maxCommands, int64_t deadline)
 {
 	const char* ptr = str.getPtr();
 	const char* end = str.getTerm();
@@ -572,8 +832,18 @@ bool pathFromString(Path* path, const bx::StringView& str, uint32_t flags)
 	float lastCPX = 0.0f;
 	float lastCPY = 0.0f;
 	char lastCommand = 0;
+	uint32_t numParsed = 0;
 
 	while (ptr != end) {
+		if (path->m_NumCommands >= maxCommands) {
+			return ParsePath::MaxCommands;
+		}
+
+		if (deadline != 0 && (++numParsed % kParserPathDeadlineInterval) == 0 && bx::getHPCounter() > deadline) {
+			return ParsePath::Timeout;
+		}
+
+		const char* cmdPtr = ptr;
 		char ch = *ptr;
 
 		SSVG_CHECK(!bx::isSpace(ch) && ch != ',', "Parse error");
@@ -787,11 +1057,21 @@ bool pathFromString(Path* path, const bx::StringView& str, uint32_t flags)
 			lastY = cmd->m_Data[6];
 
 			if ((flags & ImageLoadFlags::ConvertArcToCubicBezier) != 0) {
+				if (path->m_NumCommands - 1 + kParserArcMaxCubics > maxCommands) {
+					return ParsePath::MaxCommands;
+				}
+
 				pathConvertCommand(path, (uint32_t)(cmd - path->m_Commands), PathCmdType::CubicTo);
 			}
 		} else {
 			SSVG_WARN(false, "Encountered unknown path command");
-			return false;
+			return ParsePath::Fail;
+		}
+
+		// NOTE: Garbage which isn't a command nor a coordinate would repeat the last command forever.
+		if (ptr == cmdPtr) {
+			SSVG_WARN(false, "Invalid path data");
+			return ParsePath::Fail;
 		}
 
 		lastCommand = ch;
@@ -799,7 +1079,44 @@ bool pathFromString(Path* path, const bx::StringView& str, uint32_t flags)
 
 	pathShrinkToFit(path);
 
-	return true;
+	return ParsePath::OK;
+}
+
+// NOTE: Hits which would exceed maxCommands are parsed again, so they fail the same way.
+static ParsePath::Result pathFromStringMemoized(ParserMemo* memo, Path* path, const bx::StringView& str, uint32_t flags, uint32_t maxCommands, int64_t deadline)
+{
+	const uint32_t hash = parserMemoHash(ParserMemoKind::Path, str);
+	const ParserMemoEntry* entry = parserMemoFind(memo, ParserMemoKind::Path, str, hash);
+	const ParserMemoPath* memoPath = (const ParserMemoPath*)entry->m_Value;
+	if (memoPath) {
+		if (path->m_NumCommands + memoPath->m_NumCommands > maxCommands) {
+			return pathFromStringLimited(path, str, flags, maxCommands, deadline);
+		}
+
+		if (memoPath->m_NumCommands != 0) {
+			PathCmd* cmds = pathAllocCommands(path, memoPath->m_NumCommands);
+			bx::memCopy(cmds, memoPath->m_Commands, sizeof(PathCmd) * memoPath->m_NumCommands);
+		}
+
+		return ParsePath::OK;
+	}
+
+	const uint32_t firstCmd = path->m_NumCommands;
+	const ParsePath::Result res = pathFromStringLimited(path, str, flags, maxCommands, deadline);
+	if (res != ParsePath::OK) {
+		return res;
+	}
+
+	const uint32_t numCommands = path->m_NumCommands - firstCmd;
+	ParserMemoPath* value = (ParserMemoPath*)BX_ALLOC(memo->m_Allocator, sizeof(ParserMemoPath) + sizeof(PathCmd) * numCommands);
+	value->m_Commands = (PathCmd*)(value + 1);
+	value->m_NumCommands = numCommands;
+	if (numCommands != 0) {
+		bx::memCopy(value->m_Commands, &path->m_Commands[firstCmd], sizeof(PathCmd) * numCommands);
+	}
+	parserMemoInsert(memo, ParserMemoKind::Path, str, hash, value);
+
+	return ParsePath::OK;
 }
 
 bool pointListFromString(PointList* ptList, const bx::StringView& str)
@@ -817,7 +1134,7 @@ bool pointListFromString(PointList* ptList, const bx::StringView& str)
 	return true;
 }
 
-static ParseAttr::Result parseStyle(const bx::StringView& str, ShapeAttributes* attrs)
+static ParseAttr::Result parseStyle(ParserState* parser, const bx::StringView& str, ShapeAttributes* attrs)
 {
 	const char* end = str.getTerm();
 	const char* ptr = skipWhitespace(str.getPtr(), end);
@@ -850,7 +1167,7 @@ static ParseAttr::Result parseStyle(const bx::StringView& str, ShapeAttributes*
 
 		ptr = skipWhitespace(ptr + (ptr != end ? 1 : 0), end);
 
-		if (parseGenericShapeAttribute(name, value, attrs) == ParseAttr::Fail) {
+		if (parseGenericShapeAttribute(parser, name, value, attrs) == ParseAttr::Fail) {
 			return ParseAttr::Fail;
 		}
 	}
@@ -858,10 +1175,117 @@ static ParseAttr::Result parseStyle(const bx::StringView& str, ShapeAttributes*
 	return ParseAttr::OK;
 }
 
-static ParseAttr::Result parseGenericShapeAttribute(const bx::StringView& name, const bx::StringView& value, ShapeAttributes* attrs)
+// Copies the properties a style sets, the same way parseGenericShapeAttribute() would have.
+static void parserApplyStyle(const ParserState* parser, const ParserMemoStyle* style, ShapeAttributes* attrs)
+{
+	const ShapeAttributes* src = &style->m_Attrs;
+	const bool borrowStrings = (parser->m_Flags & ImageLoadFlags::BorrowStrings) != 0;
+	const uint32_t set = ~src->m_Flags & AttribFlags::InheritAll;
+
+	if ((set & AttribFlags::StrokePaintInherit) != 0) {
+		bx::memCopy(&attrs->m_StrokePaint, &src->m_StrokePaint, sizeof(Paint));
+	}
+	if ((set & AttribFlags::StrokeMiterLimitInherit) != 0) {
+		attrs->m_StrokeMiterLimit = src->m_StrokeMiterLimit;
+	}
+	if ((set & AttribFlags::StrokeOpacityInherit) != 0) {
+		attrs->m_StrokeOpacity = src->m_StrokeOpacity;
+	}
+	if ((set & AttribFlags::StrokeWidthInherit) != 0) {
+		attrs->m_StrokeWidth = src->m_StrokeWidth;
+	}
+	if ((set & AttribFlags::StrokeLineJoinInherit) != 0) {
+		attrs->m_StrokeLineJoin = src->m_StrokeLineJoin;
+	}
+	if ((set & AttribFlags::StrokeLineCapInherit) != 0) {
+		attrs->m_StrokeLineCap = src->m_StrokeLineCap;
+	}
+	if ((set & AttribFlags::FillPaintInherit) != 0) {
+		bx::memCopy(&attrs->m_FillPaint, &src->m_FillPaint, sizeof(Paint));
+	}
+	if ((set & AttribFlags::FillOpacityInherit) != 0) {
+		attrs->m_FillOpacity = src->m_FillOpacity;
+	}
+	if ((set & AttribFlags::FillRuleInherit) != 0) {
+		attrs->m_FillRule = src->m_FillRule;
+	}
+	if ((set & AttribFlags::FontSizeInherit) != 0) {
+		attrs->m_FontSize = src->m_FontSize;
+	}
+	if ((set & AttribFlags::FontFamilyInherit) != 0) {
+		if (borrowStrings) {
+			attrs->m_FontFamilyRef = src->m_FontFamilyRef;
+		} else {
+			bx::memCopy(&attrs->m_FontFamily[0], &src->m_FontFamily[0], sizeof(attrs->m_FontFamily));
+		}
+	}
+	attrs->m_Flags &= ~set;
+
+	if ((style->m_AttrsSet & ParserAttrs::Transform) != 0) {
+		bx::memCopy(&attrs->m_Transform[0], &src->m_Transform[0], sizeof(float) * 6);
+	}
+	if ((style->m_AttrsSet & ParserAttrs::Opacity) != 0) {
+		attrs->m_Opacity = src->m_Opacity;
+	}
+	if ((style->m_AttrsSet & ParserAttrs::ID) != 0) {
+		if (borrowStrings) {
+			attrs->m_IDRef = src->m_IDRef;
+		} else {
+			bx::memCopy(&attrs->m_ID[0], &src->m_ID[0], sizeof(attrs->m_ID));
+		}
+	}
+	if ((style->m_AttrsSet & ParserAttrs::Class) != 0) {
+		if (borrowStrings) {
+			attrs->m_ClassRef = src->m_ClassRef;
+		} else {
+#if SSVG_CONFIG_CLASS_MAX_LEN
+			bx::memCopy(&attrs->m_Class[0], &src->m_Class[0], sizeof(attrs->m_Class));
+#endif
+		}
+	}
+}
+
+// A new style is parsed into blank attributes with all inherit flags set, so the flags it clears
+// tell which properties it sets.
+static ParseAttr::Result parseStyleMemoized(ParserState* parser, const bx::StringView& str, ShapeAttributes* attrs)
+{
+	ParserMemo* memo = parser->m_Memo;
+
+	const uint32_t hash = parserMemoHash(ParserMemoKind::Style, str);
+	const ParserMemoEntry* entry = parserMemoFind(memo, ParserMemoKind::Style, str, hash);
+	const ParserMemoStyle* style = (const ParserMemoStyle*)entry->m_Value;
+	if (!style) {
+		ParserMemoStyle* newStyle = (ParserMemoStyle*)BX_ALLOC(memo->m_Allocator, sizeof(ParserMemoStyle));
+		bx::memSet(newStyle, 0, sizeof(ParserMemoStyle));
+		newStyle->m_Attrs.m_Flags = AttribFlags::InheritAll;
+
+		const uint32_t attrsSet = parser->m_AttrsSet;
+		parser->m_AttrsSet = 0;
+		const ParseAttr::Result res = parseStyle(parser, str, &newStyle->m_Attrs);
+		newStyle->m_AttrsSet = parser->m_AttrsSet;
+		parser->m_AttrsSet = attrsSet;
+
+		if (res != ParseAttr::OK) {
+			// NOTE: Parse again so attrs end up exactly as without the memo.
+			BX_FREE(memo->m_Allocator, newStyle);
+			return parseStyle(parser, str, attrs);
+		}
+
+		// NOTE: Parsing the style might have grown the table, so entry can't be reused.
+		parserMemoInsert(memo, ParserMemoKind::Style, str, hash, newStyle);
+		style = newStyle;
+	}
+
+	parserApplyStyle(parser, style, attrs);
+	parser->m_AttrsSet |= style->m_AttrsSet;
+
+	return ParseAttr::OK;
+}
+
+static ParseAttr::Result parseGenericShapeAttribute(ParserState* parser, const bx::StringView& name, const bx::StringView& value, ShapeAttributes* attrs)
 {
 	if (!bx::strCmp(name, "style", 5)) {
-		return parseStyle(value, attrs);
+		return parser->m_Memo ? parseStyleMemoized(parser, value, attrs) : parseStyle(parser, value, attrs);
 	} else if (!bx::strCmp(name, "stroke", 6)) {
 		const bx::StringView partialName(name.getPtr() + 6, name.getLength() - 6);
 		if (partialName.getLength() == 0) {
@@ -927,23 +1351,43 @@ static ParseAttr::Result parseGenericShapeAttribute(const bx::StringView& name,
 		const bx::StringView partialName(name.getPtr() + 4, name.getLength() - 4);
 		if (!bx::strCmp(partialName, "-family", 7)) {
 			attrs->m_Flags &= ~AttribFlags::FontFamilyInherit;
-			shapeAttrsSetFontFamily(attrs, value);
+			if ((parser->m_Flags & ImageLoadFlags::BorrowStrings) != 0) {
+				parserBorrowString(&attrs->m_FontFamilyRef, value);
+			} else {
+				shapeAttrsSetFontFamily(attrs, value);
+			}
 			return ParseAttr::OK;
 		} else if (!bx::strCmp(partialName, "-size", 5)) {
 			attrs->m_Flags &= ~AttribFlags::FontSizeInherit;
 			return parseLength(value, &attrs->m_FontSize) ? ParseAttr::OK : ParseAttr::Fail;
 		}
 	} else if (!bx::strCmp(name, "transform", 9)) {
-		return parseTransform(value, &attrs->m_Transform[0]) ? ParseAttr::OK : ParseAttr::Fail;
+		parser->m_AttrsSet |= ParserAttrs::Transform;
+		const bool ok = parser->m_Memo
+			? parseTransformMemoized(parser->m_Memo, value, &attrs->m_Transform[0])
+			: parseTransform(value, &attrs->m_Transform[0])
+			;
+		return ok ? ParseAttr::OK : ParseAttr::Fail;
 	} else if (!bx::strCmp(name, "id", 2)) {
-		shapeAttrsSetID(attrs, value);
+		parser->m_AttrsSet |= ParserAttrs::ID;
+		if ((parser->m_Flags & ImageLoadFlags::BorrowStrings) != 0) {
+			parserBorrowString(&attrs->m_IDRef, value);
+		} else {
+			shapeAttrsSetID(attrs, value);
+		}
 		return ParseAttr::OK;
 	} else if (!bx::strCmp(name, "class", 5)) {
+		parser->m_AttrsSet |= ParserAttrs::Class;
+		if ((parser->m_Flags & ImageLoadFlags::BorrowStrings) != 0) {
+			parserBorrowString(&attrs->m_ClassRef, value);
+		} else {
 #if SSVG_CONFIG_CLASS_MAX_LEN
-		shapeAttrsSetClass(attrs, value);
+			shapeAttrsSetClass(attrs, value);
 #endif
+		}
 		return ParseAttr::OK;
 	} else if (!bx::strCmp(name, "opacity", 7)) {
+		parser->m_AttrsSet |= ParserAttrs::Opacity;
 		return parseNumber(value, &attrs->m_Opacity, 0.0f, 1.0f) ? ParseAttr::OK : ParseAttr::Fail;
 	}
 
@@ -964,7 +1408,7 @@ static bool parseShape_Group(ParserState* parser, Shape* group)
 			err = true;
 		} else {
 			// Check if this a generic attribute (i.e. styling)
-			ParseAttr::Result res = parseGenericShapeAttribute(name, value, group->m_Attrs);
+			ParseAttr::Result res = parseGenericShapeAttribute(parser, name, value, group->m_Attrs);
 			if (res == ParseAttr::Fail) {
 				err = true;
 			} else if (res == ParseAttr::Unknown) {
@@ -995,7 +1439,7 @@ static bool parseShape_Text(ParserState* parser, Shape* text)
 			err = true;
 		} else {
 			// Check if this a generic attribute (i.e. styling)
-			ParseAttr::Result res = parseGenericShapeAttribute(name, value, text->m_Attrs);
+			ParseAttr::Result res = parseGenericShapeAttribute(parser, name, value, text->m_Attrs);
 			if (res == ParseAttr::Fail) {
 				err = true;
 			} else if (res == ParseAttr::Unknown) {
@@ -1040,7 +1484,11 @@ static bool parseShape_Text(ParserState* parser, Shape* text)
 	}
 
 	const uint32_t txtLen = (uint32_t)(parser->m_Ptr - txtPtr);
-	text->m_Text.m_String = (char*)BX_ALLOC(s_Allocator, sizeof(char) * (txtLen + 1));
+	if (!parserAddBytes(parser, txtLen + 1)) {
+		return false;
+	}
+
+	text->m_Text.m_String = (char*)BX_ALLOC(text->m_Text.m_Allocator, sizeof(char) * (txtLen + 1));
 	bx::memCopy(text->m_Text.m_String, txtPtr, txtLen);
 	text->m_Text.m_String[txtLen] = 0;
 #endif
@@ -1067,13 +1515,30 @@ static bool parseShape_Path(ParserState* parser, Shape* path)
 			err = true;
 		} else {
 			// Check if this a generic attribute (i.e. styling)
-			ParseAttr::Result res = parseGenericShapeAttribute(name, value, path->m_Attrs);
+			ParseAttr::Result res = parseGenericShapeAttribute(parser, name, value, path->m_Attrs);
 			if (res == ParseAttr::Fail) {
 				err = true;
 			} else if (res == ParseAttr::Unknown) {
 				// Path specific attributes.
 				if (!bx::strCmp(name, "d", 1)) {
-					err = !pathFromString(&path->m_Path, value, parser->m_Flags);
+					// NOTE: The remaining byte budget also limits the number of commands, so huge
+					// paths are rejected before they are fully allocated.
+					const uint64_t maxBytesCommands = (parser->m_MaxBytes - parser->m_NumBytes) / sizeof(PathCmd);
+					const uint32_t maxCommands = (uint32_t)bx::min<uint64_t>(parser->m_MaxPathCommands, maxBytesCommands);
+
+					const ParsePath::Result pathRes = parser->m_Memo
+						? pathFromStringMemoized(parser->m_Memo, &path->m_Path, value, parser->m_Flags, maxCommands, parser->m_Deadline)
+						: pathFromStringLimited(&path->m_Path, value, parser->m_Flags, maxCommands, parser->m_Deadline)
+						;
+					err = pathRes != ParsePath::OK;
+					if (pathRes == ParsePath::MaxCommands) {
+						parserFail(parser, maxCommands == parser->m_MaxPathCommands ? ImageLoadError::MaxPathCommands : ImageLoadError::MaxBytes);
+					} else if (pathRes == ParsePath::Timeout) {
+						parserFail(parser, ImageLoadError::Timeout);
+					} else if (!err) {
+						err = !parserAddBytes(parser, sizeof(PathCmd) * path->m_Path.m_NumCommands);
+						parserPackPath(parser, &path->m_Path);
+					}
 				} else {
 					SSVG_WARN(false, "Ignoring path attribute: %.*s=\"%.*s\"", name.getLength(), name.getPtr(), value.getLength(), value.getPtr());
 				}
@@ -1109,7 +1574,7 @@ static bool parseShape_Rect(ParserState* parser, Shape* rect)
 			err = true;
 		} else {
 			// Check if this a generic attribute (i.e. styling)
-			ParseAttr::Result res = parseGenericShapeAttribute(name, value, rect->m_Attrs);
+			ParseAttr::Result res = parseGenericShapeAttribute(parser, name, value, rect->m_Attrs);
 			if (res == ParseAttr::Fail) {
 				err = true;
 			} else if (res == ParseAttr::Unknown) {
@@ -1161,7 +1626,7 @@ static bool parseShape_Circle(ParserState* parser, Shape* circle)
 			err = true;
 		} else {
 			// Check if this a generic attribute (i.e. styling)
-			ParseAttr::Result res = parseGenericShapeAttribute(name, value, circle->m_Attrs);
+			ParseAttr::Result res = parseGenericShapeAttribute(parser, name, value, circle->m_Attrs);
 			if (res == ParseAttr::Fail) {
 				err = true;
 			} else if (res == ParseAttr::Unknown) {
@@ -1207,7 +1672,7 @@ static bool parseShape_Line(ParserState* parser, Shape* line)
 			err = true;
 		} else {
 			// Check if this a generic attribute (i.e. styling)
-			ParseAttr::Result res = parseGenericShapeAttribute(name, value, line->m_Attrs);
+			ParseAttr::Result res = parseGenericShapeAttribute(parser, name, value, line->m_Attrs);
 			if (res == ParseAttr::Fail) {
 				err = true;
 			} else if (res == ParseAttr::Unknown) {
@@ -1255,7 +1720,7 @@ static bool parseShape_Ellipse(ParserState* parser, Shape* ellipse)
 			err = true;
 		} else {
 			// Check if this a generic attribute (i.e. styling)
-			ParseAttr::Result res = parseGenericShapeAttribute(name, value, ellipse->m_Attrs);
+			ParseAttr::Result res = parseGenericShapeAttribute(parser, name, value, ellipse->m_Attrs);
 			if (res == ParseAttr::Fail) {
 				err = true;
 			} else if (res == ParseAttr::Unknown) {
@@ -1303,14 +1768,15 @@ static bool parseShape_PointList(ParserState* parser, Shape* shape)
 			err = true;
 		} else {
 			// Check if this a generic attribute (i.e. styling)
-			ParseAttr::Result res = parseGenericShapeAttribute(name, value, shape->m_Attrs);
+			ParseAttr::Result res = parseGenericShapeAttribute(parser, name, value, shape->m_Attrs);
 			if (res == ParseAttr::Fail) {
 				err = true;
 			} else if (res == ParseAttr::Unknown) {
 				if (!bx::strCmp(name, "points", 6)) {
 					PointList ptList;
 					bx::memSet(&ptList, 0, sizeof(PointList));
-					err = !pointListFromString(&ptList, value);
+					ptList.m_Allocator = shape->m_PointList.m_Allocator;
+					err = !pointListFromString(&ptList, value) || !parserAddBytes(parser, sizeof(float) * 2 * ptList.m_NumPoints);
 
 					if (!err && ptList.m_NumPoints >= 2 &&
 						((shape->m_Type == ShapeType::Polygon && (parser->m_Flags & ImageLoadFlags::ConvertPolygonsToPaths) != 0) ||
@@ -1318,7 +1784,11 @@ static bool parseShape_PointList(ParserState* parser, Shape* shape)
 					{
 						const float* coords = ptList.m_Coords;
 
+						// NOTE: m_Path and m_PointList share the same memory.
 						Path* path = &shape->m_Path;
+						bx::memSet(path, 0, sizeof(Path));
+						path->m_Allocator = ptList.m_Allocator;
+
 						PathCmd* cmd = pathAllocCommand(path, PathCmdType::MoveTo);
 						cmd->m_Data[0] = *coords++;
 						cmd->m_Data[1] = *coords++;
@@ -1333,6 +1803,8 @@ static bool parseShape_PointList(ParserState* parser, Shape* shape)
 							pathAllocCommand(path, PathCmdType::ClosePath);
 						}
 
+						parserPackPath(parser, path);
+
 						pointListFree(&ptList);
 						shape->m_Type = ShapeType::Path;
 					} else {
@@ -1352,7 +1824,8 @@ static bool parseShape_PointList(ParserState* parser, Shape* shape)
 	return !err;
 }
 
-static bool parseShapes(ParserState* parser, ShapeList* shapeList, const ShapeAttributes* parentAttrs, const char* closingTag, uint32_t closingTagLen)
+// Parses the element at the current position into shapeList. Unknown elements are skipped.
+static bool parseShape(ParserState* parser, ShapeList* shapeList, const ShapeAttributes* parentAttrs)
 {
 	struct ParseFunc
 	{
@@ -1376,6 +1849,67 @@ static bool parseShapes(ParserState* parser, ShapeList* shapeList, const ShapeAt
 
 	SSVG_WARN(numParseFuncs == ShapeType::NumTypes, "Some shapes won't be parsed");
 
+	bx::StringView tag;
+	if (!parserGetTag(parser, &tag)) {
+		return false;
+	}
+
+	for (uint32_t i = 0; i < numParseFuncs; ++i) {
+		if (!bx::strCmp(tag, parseFuncs[i].tag, parseFuncs[i].tag.getLength())) {
+			parser->m_NumShapes++;
+			if (!parserCheckLimits(parser) || !parserAddBytes(parser, sizeof(Shape) + sizeof(Shape*) + sizeof(ShapeAttributes))) {
+				return false;
+			}
+
+			Shape* shape = shapeListAllocShape(shapeList, parseFuncs[i].type, parentAttrs);
+			SSVG_CHECK(shape != nullptr, "Shape allocation failed");
+
+			// NOTE: parserGetTag() skips comments and the whitespace between '<' and the tag name.
+			const char* elementPtr = tag.getPtr() - 1;
+			while (*elementPtr != '<') {
+				--elementPtr;
+			}
+
+			const uint32_t elementBegin = (uint32_t)(elementPtr - parser->m_XMLString);
+			const uint32_t parentBegin = parser->m_SourceBase;
+			shape->m_SourceOffset = elementBegin - parentBegin;
+
+			parser->m_SourceBase = elementBegin;
+			const bool ok = parseFuncs[i].parseFunc(parser, shape);
+			parser->m_SourceBase = parentBegin;
+
+			shape->m_SourceLength = (uint32_t)(parser->m_Ptr - parser->m_XMLString) - elementBegin;
+
+			return ok;
+		}
+	}
+
+	SSVG_WARN(false, "Ignoring element %.*s", tag.getLength(), tag.getPtr());
+	parserSkipTag(parser);
+
+	return true;
+}
+
+// Reports a fully parsed top-level shape, with its bounds in the image's coordinate system.
+static void parserNotifyShape(ParserState* parser, const ShapeList* shapeList, uint32_t shapeID)
+{
+	Shape* shape = shapeList->m_Shapes[shapeID];
+	shapeUpdateBounds(shape);
+
+	float bounds[4];
+	transformBoundingRect(&shape->m_Attrs->m_Transform[0], &shape->m_BoundingRect[0], &bounds[0]);
+
+	parser->m_ShapeCallback(parser->m_Image, shape, shapeID, &bounds[0], parser->m_ShapeCallbackUserData);
+}
+
+static bool parseShapes(ParserState* parser, ShapeList* shapeList, const ShapeAttributes* parentAttrs, const char* closingTag, uint32_t closingTagLen)
+{
+	// NOTE: The root shape list is at depth 0.
+	if (parser->m_Depth > parser->m_MaxDepth) {
+		return parserFail(parser, ImageLoadError::MaxDepth);
+	}
+	parser->m_Depth++;
+
 	bool err = false;
 
 	// Parse until the end-of-buffer
@@ -1384,42 +1918,297 @@ static bool parseShapes(ParserState* parser, ShapeList* shapeList, const ShapeAt
 			break;
 		}
 
-		bx::StringView tag;
-		if (!parserGetTag(parser, &tag)) {
+		const uint32_t numShapes = shapeList->m_NumShapes;
+		if (!parseShape(parser, shapeList, parentAttrs)) {
+			err = true;
+			break;
+		}
+
+		if (parser->m_ShapeCallback != nullptr && parser->m_Depth == 1 && shapeList->m_NumShapes != numShapes) {
+			parserNotifyShape(parser, shapeList, numShapes);
+		}
+	}
+
+	parser->m_Depth--;
+
+	if (err || parserDone(parser)) {
+		return false;
+	}
+
+	shapeListShrinkToFit(shapeList);
+
+	// Skip the closing tag.
+	return parserExpectingString(parser, closingTag, closingTagLen);
+}
+
+// A run of consecutive top-level elements, parsed independently into its own shape list.
+struct ParserChunk
+{
+	ShapeList m_ShapeList;
+	const char* m_Begin;
+	const char* m_End;
+	uint64_t m_NumBytes;
+	uint32_t m_NumShapes;
+	ImageLoadError::Enum m_Error;
+	bool m_Failed;
+};
+
+struct ParserParallelJob
+{
+	const ParserState* m_Parser;
+	const ShapeAttributes* m_ParentAttrs;
+	ParserChunk* m_Chunks;
+	uint32_t m_NumChunks;
+	volatile uint32_t m_FirstFailedChunk;
+};
+
+static const uint32_t kParallelChunksPerThread = 4;
+static const uint32_t kParallelMinChunkSize = 16 << 10;
+
+// Returns a pointer past the comment starting at ptr ("<!--"), or nullptr if the comment is never closed.
+static const char* prescanComment(const char* ptr)
+{
+	ptr += 4;
+	while (*ptr != '\0') {
+		if (ptr[0] == '-' && ptr[1] == '-' && ptr[2] == '>') {
+			return ptr + 3;
+		}
+
+		++ptr;
+	}
+
+	return nullptr;
+}
+
+// Returns a pointer past the element starting at ptr ('<'), or nullptr if the element is never closed.
+// Only tag nesting is tracked; comments and quoted attribute values are skipped.
+static const char* prescanElement(const char* ptr)
+{
+	uint32_t depth = 0;
+	while (*ptr != '\0') {
+		if (*ptr != '<') {
+			++ptr;
+			continue;
+		}
+
+		if (ptr[1] == '!' && ptr[2] == '-' && ptr[3] == '-') {
+			ptr = prescanComment(ptr);
+			if (ptr == nullptr) {
+				return nullptr;
+			}
+
+			continue;
+		}
+
+		const bool closing = ptr[1] == '/';
+
+		char quote = '\0';
+		++ptr;
+		while (*ptr != '\0' && (quote != '\0' || *ptr != '>')) {
+			if (quote != '\0') {
+				quote = *ptr == quote ? '\0' : quote;
+			} else if (*ptr == '\"' || *ptr == '\'') {
+				quote = *ptr;
+			}
+
+			++ptr;
+		}
+
+		if (*ptr == '\0') {
+			return nullptr;
+		}
+
+		const bool selfClosing = ptr[-1] == '/';
+		++ptr;
+
+		if (closing) {
+			if (depth == 0) {
+				return nullptr;
+			}
+			--depth;
+		} else if (!selfClosing) {
+			++depth;
+		}
+
+		if (depth == 0) {
+			return ptr;
+		}
+	}
+
+	return nullptr;
+}
+
+static void parserParseChunk(const ParserParallelJob* job, ParserChunk* chunk)
+{
+	ParserState parser;
+	bx::memCopy(&parser, job->m_Parser, sizeof(ParserState));
+	parser.m_Ptr = chunk->m_Begin;
+	parser.m_NumBytes = 0;
+	parser.m_NumShapes = 0;
+	parser.m_Depth = 1;
+	parser.m_Error = ImageLoadError::None;
+	parser.m_Memo = job->m_Parser->m_Memo ? parserMemoCreate(job->m_Parser->m_Memo->m_Allocator) : nullptr;
+
+	bool err = false;
+	while (parser.m_Ptr < chunk->m_End) {
+		if (!parseShape(&parser, &chunk->m_ShapeList, job->m_ParentAttrs)) {
 			err = true;
 			break;
 		}
+	}
+
+	// NOTE: Some element parsers also skip the whitespace following the closing tag. Other than that,
+	// they only disagree with the pre-scan on malformed documents.
+	if (parser.m_Ptr < chunk->m_End || parser.m_Ptr > skipWhitespace(chunk->m_End, nullptr)) {
+		err = true;
+	}
+
+	if (parser.m_Memo) {
+		parserMemoDestroy(parser.m_Memo);
+	}
+
+	chunk->m_NumBytes = parser.m_NumBytes;
+	chunk->m_NumShapes = parser.m_NumShapes;
+	chunk->m_Failed = err;
+	chunk->m_Error = err && parser.m_Error == ImageLoadError::None ? ImageLoadError::SyntaxError : parser.m_Error;
+}
+
+// NOTE: Chunks after the first failed one are skipped. The ones before it are always parsed, whatever
+// order the scheduler runs them in, so the error reported is the one a sequential parse would report.
+static void parserParallelChunks(uint32_t begin, uint32_t end, void* userData)
+{
+	ParserParallelJob* job = (ParserParallelJob*)userData;
+
+	for (uint32_t id = begin; id < end; ++id) {
+		if (id > job->m_FirstFailedChunk) {
+			break;
+		}
+
+		ParserChunk* chunk = &job->m_Chunks[id];
+		parserParseChunk(job, chunk);
+		if (!chunk->m_Failed) {
+			continue;
+		}
+
+		uint32_t firstFailed = job->m_FirstFailedChunk;
+		while (id < firstFailed) {
+			const uint32_t prev = bx::atomicCompareAndSwap<uint32_t>(&job->m_FirstFailedChunk, firstFailed, id);
+			firstFailed = prev == firstFailed ? id : prev;
+		}
+	}
+}
+
+// Splits the children of the <svg> element into chunks with a quick structural pre-scan, parses the
+// chunks in parallel and splices the resulting shape lists back into the image in document order.
+// Falls back to parseShapes() if there's nothing to split or the pre-scan can't make sense of the document.
+static bool parseShapesParallel(ParserState* parser, Image* img)
+{
+	Context* ctx = img->m_Context;
+	bx::AllocatorI* allocator = ctx->m_Allocator;
+
+	const uint32_t len = bx::strLen(parser->m_Ptr);
+	const uint32_t chunkSize = bx::max<uint32_t>(len / (parser->m_NumThreads * kParallelChunksPerThread), kParallelMinChunkSize);
+
+	ParserChunk* chunks = nullptr;
+	uint32_t numChunks = 0;
+	uint32_t chunkCapacity = 0;
+
+	bool prescanFailed = false;
+	const char* ptr = parser->m_Ptr;
+	for (;;) {
+		ptr = skipWhitespace(ptr, nullptr);
+		if (*ptr != '<') {
+			prescanFailed = true;
+			break;
+		}
 
-		bool found = false;
-		for (uint32_t i = 0; i < numParseFuncs; ++i) {
-			if (!bx::strCmp(tag, parseFuncs[i].tag, parseFuncs[i].tag.getLength())) {
-				Shape* shape = shapeListAllocShape(shapeList, parseFuncs[i].type, parentAttrs);
-				SSVG_CHECK(shape != nullptr, "Shape allocation failed");
+		if (!bx::strCmp(bx::StringView(ptr, 6), "</svg>", 6)) {
+			break;
+		}
 
-				err = !parseFuncs[i].parseFunc(parser, shape);
-				found = true;
+		if (ptr[1] == '!' && ptr[2] == '-' && ptr[3] == '-') {
+			ptr = prescanComment(ptr);
+			if (ptr == nullptr) {
+				prescanFailed = true;
 				break;
 			}
+
+			continue;
 		}
 
-		if (err) {
+		const char* end = prescanElement(ptr);
+		if (end == nullptr) {
+			prescanFailed = true;
 			break;
 		}
 
-		if (!found) {
-			SSVG_WARN(false, "Ignoring element %.*s", tag.getLength(), tag.getPtr());
-			parserSkipTag(parser);
+		if (numChunks == 0 || (uint32_t)(chunks[numChunks - 1].m_End - chunks[numChunks - 1].m_Begin) >= chunkSize) {
+			if (numChunks == chunkCapacity) {
+				chunkCapacity = chunkCapacity ? chunkCapacity * 2 : 16;
+				chunks = (ParserChunk*)BX_REALLOC(allocator, chunks, sizeof(ParserChunk) * chunkCapacity);
+			}
+
+			ParserChunk* chunk = &chunks[numChunks++];
+			bx::memSet(chunk, 0, sizeof(ParserChunk));
+			chunk->m_ShapeList.m_Context = ctx;
+			chunk->m_Begin = ptr;
 		}
+
+		chunks[numChunks - 1].m_End = end;
+		ptr = end;
 	}
 
-	if (err || parserDone(parser)) {
+	if (prescanFailed || numChunks < 2) {
+		BX_FREE(allocator, chunks);
+		return parseShapes(parser, &img->m_ShapeList, &img->m_BaseAttrs, "</svg>", 6);
+	}
+
+	ParserParallelJob job;
+	job.m_Parser = parser;
+	job.m_ParentAttrs = &img->m_BaseAttrs;
+	job.m_Chunks = chunks;
+	job.m_NumChunks = numChunks;
+	job.m_FirstFailedChunk = UINT32_MAX;
+
+	contextGetScheduler(ctx)->parallelFor(numChunks, 1, parserParallelChunks, &job);
+
+	// Splice in document order.
+	bool err = false;
+	for (uint32_t i = 0; i < numChunks; ++i) {
+		ParserChunk* chunk = &chunks[i];
+		if (!err && chunk->m_Failed) {
+			parserFail(parser, chunk->m_Error);
+			err = true;
+		}
+
+		if (!err) {
+			parser->m_NumShapes += chunk->m_NumShapes;
+			parser->m_NumBytes += chunk->m_NumBytes;
+			shapeListMoveShapes(&img->m_ShapeList, &chunk->m_ShapeList);
+		} else {
+			shapeListFree(&chunk->m_ShapeList);
+		}
+	}
+
+	BX_FREE(allocator, chunks);
+
+	if (err) {
 		return false;
 	}
 
-	shapeListShrinkToFit(shapeList);
+	if (parser->m_NumShapes > parser->m_MaxShapes) {
+		return parserFail(parser, ImageLoadError::MaxShapes);
+	}
 
-	// Skip the closing tag.
-	return parserExpectingString(parser, closingTag, closingTagLen);
+	if (parser->m_NumBytes > parser->m_MaxBytes) {
+		return parserFail(parser, ImageLoadError::MaxBytes);
+	}
+
+	shapeListShrinkToFit(&img->m_ShapeList);
+
+	parser->m_Ptr = ptr;
+
+	return parserExpectingString(parser, "</svg>", 6);
 }
 
 static bool parseTag_svg(ParserState* parser, Image* img)
@@ -1467,21 +2256,60 @@ static bool parseTag_svg(ParserState* parser, Image* img)
 		return false;
 	}
 
+	if (parser->m_NumThreads > 1) {
+		return parseShapesParallel(parser, img);
+	}
+
 	return parseShapes(parser, &img->m_ShapeList, &img->m_BaseAttrs, "</svg>", 6);
 }
 
-Image* imageLoad(const char* xmlStr, uint32_t flags, const ShapeAttributes* baseAttrs)
+static void parserInit(ParserState* parser, const char* xmlStr, uint32_t flags, const ImageLoadLimits* limits)
+{
+	bx::memSet(parser, 0, sizeof(ParserState));
+	parser->m_XMLString = xmlStr;
+	parser->m_Ptr = xmlStr;
+	parser->m_Flags = flags;
+	parser->m_MaxBytes = UINT64_MAX;
+	parser->m_MaxShapes = UINT32_MAX;
+	parser->m_MaxPathCommands = UINT32_MAX;
+	parser->m_MaxDepth = UINT32_MAX;
+	parser->m_Error = ImageLoadError::None;
+	parser->m_NumThreads = 1;
+	if (limits) {
+		parser->m_MaxBytes = limits->m_MaxBytes ? limits->m_MaxBytes : UINT64_MAX;
+		parser->m_MaxShapes = limits->m_MaxShapes ? limits->m_MaxShapes : UINT32_MAX;
+		parser->m_MaxPathCommands = limits->m_MaxPathCommands ? limits->m_MaxPathCommands : UINT32_MAX;
+		parser->m_MaxDepth = limits->m_MaxDepth ? limits->m_MaxDepth : UINT32_MAX;
+		if (limits->m_MaxTimeMsec) {
+			parser->m_Deadline = bx::getHPCounter() + (bx::getHPFrequency() * limits->m_MaxTimeMsec) / 1000;
+		}
+	}
+}
+
+static Image* imageLoadInternal(const char* xmlStr, uint32_t flags, const ShapeAttributes* baseAttrs, Context* ctx, const ImageLoadLimits* limits, uint32_t numThreads, ImageLoadShapeCallback callback, void* userData, ImageLoadError::Enum* error)
 {
 	if (!xmlStr || *xmlStr == 0) {
+		if (error) {
+			*error = ImageLoadError::InvalidInput;
+		}
 		return nullptr;
 	}
 
-	Image* img = imageCreate(baseAttrs);
-
 	ParserState parser;
-	parser.m_XMLString = xmlStr;
-	parser.m_Ptr = xmlStr;
-	parser.m_Flags = flags;
+	parserInit(&parser, xmlStr, flags, limits);
+	parser.m_NumThreads = numThreads;
+	parser.m_ShapeCallback = callback;
+	parser.m_ShapeCallbackUserData = userData;
+
+	Image* img = imageCreate(baseAttrs, ctx);
+	parser.m_Image = img;
+	if ((flags & ImageLoadFlags::BorrowStrings) != 0) {
+		img->m_Source = xmlStr;
+	}
+
+	if ((flags & ImageLoadFlags::MemoizeAttributes) != 0) {
+		parser.m_Memo = parserMemoCreate(img->m_Context->m_Allocator);
+	}
 
 	bool err = false;
 	while (!parserDone(&parser) && !err) {
@@ -1513,7 +2341,11 @@ Image* imageLoad(const char* xmlStr, uint32_t flags, const ShapeAttributes* base
 			} else if (!bx::strCmp(tag, "svg", 3)) {
 				err = !parseTag_svg(&parser, img);
 				if (!err && (parser.m_Flags & ImageLoadFlags::CalcShapeBounds) != 0) {
-					shapeListCalcBounds(&img->m_ShapeList, &img->m_BoundingRect[0]);
+					if (parser.m_NumThreads > 1) {
+						shapeListCalcBoundsParallel(&img->m_ShapeList, &img->m_BoundingRect[0]);
+					} else {
+						shapeListCalcBounds(&img->m_ShapeList, &img->m_BoundingRect[0]);
+					}
 				}
 			} else {
 				SSVG_WARN(false, "Ignoring unknown root tag %.*s", tag.getLength(), tag.getPtr());
@@ -1522,11 +2354,243 @@ Image* imageLoad(const char* xmlStr, uint32_t flags, const ShapeAttributes* base
 		}
 	}
 
+	if (parser.m_Memo) {
+		parserMemoDestroy(parser.m_Memo);
+	}
+
 	if (err) {
 		imageDestroy(img);
 		img = nullptr;
+
+		if (parser.m_Error == ImageLoadError::None) {
+			parser.m_Error = ImageLoadError::SyntaxError;
+		}
+	}
+
+	if (error) {
+		*error = parser.m_Error;
 	}
 
 	return img;
 }
-}
\ No newline at end of file
+
+Image* imageLoad(const char* xmlStr, uint32_t flags, const ShapeAttributes* baseAttrs, Context* ctx)
+{
+	return imageLoadInternal(xmlStr, flags, baseAttrs, ctx, nullptr, 1, nullptr, nullptr, nullptr);
+}
+
+// NOTE: limits and error can be nullptr.
+Image* imageLoadWithLimits(const char* xmlStr, uint32_t flags, const ShapeAttributes* baseAttrs, Context* ctx, const ImageLoadLimits* limits, ImageLoadError::Enum* error)
+{
+	return imageLoadInternal(xmlStr, flags, baseAttrs, ctx, limits, 1, nullptr, nullptr, error);
+}
+
+// Same as imageLoadWithLimits() but the top-level elements of the <svg> are split into chunks, parsed
+// in parallel on ctx's scheduler (see contextGetScheduler()), with the same result as a sequential load.
+// numThreads controls how many chunks the document is split into; 0 means the scheduler's thread count.
+// Pays off for large, wide documents; a document with a single top-level group is parsed on one thread.
+// NOTE: Shape and byte limits are checked per chunk while parsing and for the whole document afterwards.
+Image* imageLoadParallel(const char* xmlStr, uint32_t flags, const ShapeAttributes* baseAttrs, Context* ctx, const ImageLoadLimits* limits, uint32_t numThreads, ImageLoadError::Enum* error)
+{
+	if (numThreads == 0) {
+		numThreads = contextGetScheduler(ctx)->getNumThreads();
+	}
+
+	return imageLoadInternal(xmlStr, flags, baseAttrs, ctx, limits, numThreads, nullptr, nullptr, error);
+}
+
+// Same as imageLoadWithLimits() but callback is called on the calling thread as soon as each top-level
+// shape (or group, including all its children) has been parsed, so the image can be drawn progressively.
+// The shape's bounds are updated and passed in the image's coordinate system. The shape doesn't move
+// for the lifetime of the image but the rest of the image is still being built while in the callback.
+// NOTE: If the load fails, the image and all shapes reported so far are destroyed before returning nullptr.
+Image* imageLoadProgressive(const char* xmlStr, uint32_t flags, const ShapeAttributes* baseAttrs, Context* ctx, const ImageLoadLimits* limits, ImageLoadShapeCallback callback, void* userData, ImageLoadError::Enum* error)
+{
+	return imageLoadInternal(xmlStr, flags, baseAttrs, ctx, limits, 1, callback, userData, error);
+}
+
+// NOTE: Only valid for lists owned by a group (shapeList->m_ParentList != nullptr).
+inline Shape* reparseGetGroup(ShapeList* shapeList)
+{
+	return (Shape*)((uint8_t*)shapeList - offsetof(Shape, m_ShapeList));
+}
+
+// Recalculates the bounds of a list from the current bounds of its children.
+static void reparseCalcListBounds(const ShapeList* shapeList, float* bounds)
+{
+	const uint32_t numShapes = shapeList->m_NumShapes;
+	if (numShapes == 0) {
+		bounds[0] = bounds[1] = bounds[2] = bounds[3] = 0.0f;
+		return;
+	}
+
+	bounds[0] = FLT_MAX;
+	bounds[1] = FLT_MAX;
+	bounds[2] = -FLT_MAX;
+	bounds[3] = -FLT_MAX;
+	for (uint32_t i = 0; i < numShapes; ++i) {
+		const Shape* shape = shapeList->m_Shapes[i];
+
+		float childTransformedRect[4];
+		transformBoundingRect(&shape->m_Attrs->m_Transform[0], &shape->m_BoundingRect[0], &childTransformedRect[0]);
+
+		bounds[0] = bx::min<float>(bounds[0], childTransformedRect[0]);
+		bounds[1] = bx::min<float>(bounds[1], childTransformedRect[1]);
+		bounds[2] = bx::max<float>(bounds[2], childTransformedRect[2]);
+		bounds[3] = bx::max<float>(bounds[3], childTransformedRect[3]);
+	}
+}
+
+// Parses only the innermost element enclosing the edit and replaces its shape, keeping its place in
+// the draw order. xmlStr is the whole source after the edit and flags should be the ones img was loaded
+// with. img can't borrow strings from the old source (see imageDetachSource()).
+// Returns false, leaving img as it was, if the edit isn't strictly inside an element img has a shape
+// for (e.g. it touches the <svg> tag or the first or last byte of the element), or if the edited element
+// doesn't parse into a single shape ending where it should. The image has to be reloaded in that case.
+// NOTE: Handles to the replaced shape become invalid. Besides parsing the element, the source offsets
+// of the siblings of the element and of its ancestors are updated.
+bool imageReparse(Image* img, const char* xmlStr, uint32_t flags, const ImageSourceEdit* edit, ImageLoadError::Enum* error)
+{
+	if (!xmlStr || img->m_Source != nullptr) {
+		if (error) {
+			*error = ImageLoadError::InvalidInput;
+		}
+		return false;
+	}
+
+	const uint32_t editBegin = edit->m_Offset;
+	const uint32_t editEnd = edit->m_Offset + edit->m_OldLength;
+
+	// Find the innermost shape enclosing the edit, in the old source's offsets.
+	ShapeList* shapeList = &img->m_ShapeList;
+	ShapeList* targetList = nullptr;
+	uint32_t targetID = 0;
+	uint32_t targetParentBegin = 0;
+	uint32_t targetDepth = 0;
+	uint32_t parentBegin = 0;
+	uint32_t depth = 1;
+	while (shapeList != nullptr) {
+		ShapeList* childList = nullptr;
+
+		const uint32_t numShapes = shapeList->m_NumShapes;
+		for (uint32_t i = 0; i < numShapes; ++i) {
+			Shape* shape = shapeList->m_Shapes[i];
+			const uint32_t begin = parentBegin + shape->m_SourceOffset;
+			if (shape->m_SourceLength != 0 && begin < editBegin && editEnd < begin + shape->m_SourceLength) {
+				targetList = shapeList;
+				targetID = i;
+				targetParentBegin = parentBegin;
+				targetDepth = depth;
+
+				if (shape->m_Type == ShapeType::Group) {
+					childList = &shape->m_ShapeList;
+					parentBegin = begin;
+					++depth;
+				}
+				break;
+			}
+		}
+
+		shapeList = childList;
+	}
+
+	if (!targetList) {
+		if (error) {
+			*error = ImageLoadError::InvalidInput;
+		}
+		return false;
+	}
+
+	const Shape* oldShape = targetList->m_Shapes[targetID];
+	const uint32_t delta = edit->m_NewLength - edit->m_OldLength; // NOTE: Wraps around if the text got shorter
+	const uint32_t begin = targetParentBegin + oldShape->m_SourceOffset;
+	const uint32_t end = begin + oldShape->m_SourceLength + delta;
+	const ShapeAttributes* parentAttrs = targetList->m_ParentList
+		? reparseGetGroup(targetList)->m_Attrs
+		: &img->m_BaseAttrs
+		;
+
+	ParserState parser;
+	parserInit(&parser, xmlStr, flags & ~(ImageLoadFlags::BorrowStrings | ImageLoadFlags::MemoizeAttributes), nullptr);
+	parser.m_Ptr = xmlStr + begin;
+	parser.m_Depth = targetDepth;
+	parser.m_SourceBase = targetParentBegin;
+
+	// The new shape is appended to the list and moved into place once it has been parsed.
+	const uint32_t numShapes = targetList->m_NumShapes;
+	bool err = !parseShape(&parser, targetList, parentAttrs);
+	if (!err && (targetList->m_NumShapes != numShapes + 1 || parser.m_Ptr != xmlStr + end)) {
+		err = true;
+	}
+
+	if (err) {
+		if (targetList->m_NumShapes != numShapes) {
+			shapeListDeleteShape(targetList, numShapes);
+		}
+
+		if (error) {
+			*error = parser.m_Error != ImageLoadError::None ? parser.m_Error : ImageLoadError::SyntaxError;
+		}
+		return false;
+	}
+
+	shapeListDeleteShape(targetList, targetID);
+
+	Shape** shapes = targetList->m_Shapes;
+	Shape* newShape = shapes[numShapes - 1];
+	bx::memMove(&shapes[targetID + 1], &shapes[targetID], sizeof(Shape*) * (numShapes - 1 - targetID));
+	shapes[targetID] = newShape;
+
+	// Offsets are relative to the parent's element, so only the elements following the edited one
+	// in the same list and the ones following its ancestors move. The ancestors grow.
+	if (delta != 0) {
+		ShapeList* list = targetList;
+		const Shape* edited = newShape;
+		for (;;) {
+			const uint32_t n = list->m_NumShapes;
+			for (uint32_t i = 0; i < n; ++i) {
+				Shape* shape = list->m_Shapes[i];
+				if (shape->m_SourceLength != 0 && shape->m_SourceOffset > edited->m_SourceOffset) {
+					shape->m_SourceOffset += delta;
+				}
+			}
+
+			if (!list->m_ParentList) {
+				break;
+			}
+
+			Shape* group = reparseGetGroup(list);
+			group->m_SourceLength += delta;
+			edited = group;
+			list = list->m_ParentList;
+		}
+	}
+
+	if ((flags & ImageLoadFlags::CalcShapeBounds) != 0) {
+		shapeUpdateBounds(newShape);
+
+		ShapeList* list = targetList;
+		while (list->m_ParentList) {
+			reparseCalcListBounds(list, &reparseGetGroup(list)->m_BoundingRect[0]);
+			list = list->m_ParentList;
+		}
+
+		reparseCalcListBounds(&img->m_ShapeList, &img->m_BoundingRect[0]);
+	}
+
+	// NOTE: The old shape's region was added when it was deleted.
+	if (img->m_ShapeList.m_DirtyRegions) {
+		if ((flags & ImageLoadFlags::CalcShapeBounds) == 0) {
+			shapeUpdateBounds(newShape);
+		}
+
+		shapeAddDirtyRegion(newShape, targetList);
+	}
+
+	if (error) {
+		*error = ImageLoadError::None;
+	}
+
+	return true;
+}
+}
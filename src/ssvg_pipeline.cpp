@@ -0,0 +1,578 @@
+#include <ssvg/ssvg.h>
+#include <bx/bx.h>
+#include <bx/allocator.h>
+#include <bx/cpu.h>
+#include <bx/file.h>
+#include <bx/filepath.h>
+#include <bx/mutex.h>
+#include <bx/semaphore.h>
+#include <bx/thread.h>
+
+#if SSVG_CONFIG_USE_IO_URING && BX_PLATFORM_LINUX
+#	define SSVG_PIPELINE_IO_URING 1
+#	include <bx/os.h>
+#	include <errno.h>
+#	include <fcntl.h>
+#	include <linux/io_uring.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <sys/syscall.h>
+#	include <unistd.h>
+#else
+#	define SSVG_PIPELINE_IO_URING 0
+#endif
+
+namespace ssvg
+{
+struct PipelineSlotState
+{
+	enum Enum : uint32_t
+	{
+		Free = 0,
+		Reading,
+		Read,
+		Parsing,
+		Parsed,
+	};
+};
+
+struct LoadPipeline;
+
+// A file in flight. Slots are reused as files are delivered, which bounds the memory used by
+// the pipeline to maxInFlight files and their images.
+struct PipelineSlot
+{
+	LoadPipeline* m_Pipeline;
+	char* m_Buffer;
+	uint32_t m_FileSize;
+	uint32_t m_FileID;
+	Image* m_Image;
+	ImageLoadError::Enum m_Error;
+	volatile uint32_t m_State;
+#if SSVG_PIPELINE_IO_URING
+	int m_FD;
+#endif
+};
+
+#if SSVG_PIPELINE_IO_URING
+// Minimal io_uring (no liburing dependency). The submission queue is only touched by the thread
+// which called imageLoadFiles(), the completion queue only by the reader thread.
+struct PipelineRing
+{
+	int m_FD;
+	volatile uint32_t* m_SQTail;
+	uint32_t* m_SQArray;
+	uint32_t m_SQMask;
+	io_uring_sqe* m_SQEs;
+	volatile uint32_t* m_CQHead;
+	volatile uint32_t* m_CQTail;
+	uint32_t m_CQMask;
+	io_uring_cqe* m_CQEs;
+	void* m_SQRing;
+	void* m_CQRing;
+	size_t m_SQRingSize;
+	size_t m_CQRingSize;
+	size_t m_SQEsSize;
+	volatile uint32_t m_NumPending; // NOTE: Submitted reads whose completions haven't been handled yet
+	volatile uint32_t m_Stop;
+};
+#endif
+
+struct LoadPipeline
+{
+	const char* const* m_Paths;
+	const ShapeAttributes* m_BaseAttrs;
+	Context* m_Context;
+	const ImageLoadLimits* m_Limits;
+	uint32_t m_Flags;
+	PipelineSlot* m_Slots;
+	uint32_t m_NumSlots;
+	bx::Semaphore m_Wakeup;        // NOTE: Posted every time a slot becomes Read or Parsed
+	bx::Thread m_ReaderThread;
+	bx::Mutex m_ReadMutex;
+	bx::Semaphore m_ReadSemaphore; // NOTE: With io_uring, posted after every submitted read and on shutdown
+	uint32_t* m_ReadQueue;         // NOTE: Ring of slot IDs waiting for the reader thread
+	uint32_t m_ReadQueueHead;
+	uint32_t m_ReadQueueSize;
+#if SSVG_PIPELINE_IO_URING
+	PipelineRing m_Ring;
+	bool m_UseRing;
+#endif
+};
+
+static const uint32_t kPipelineShutdown = 0xFFFFFFFF;
+
+static inline uint32_t pipelineSlotGetState(PipelineSlot* slot)
+{
+	return bx::atomicFetchAndAdd<uint32_t>(&slot->m_State, 0);
+}
+
+// NOTE: Publishes everything written to the slot so far to the thread which picks it up in the new state.
+static void pipelineSlotSetState(PipelineSlot* slot, PipelineSlotState::Enum from, PipelineSlotState::Enum to)
+{
+	const uint32_t prev = bx::atomicCompareAndSwap<uint32_t>(&slot->m_State, from, to);
+	SSVG_CHECK(prev == from, "Unexpected pipeline slot state");
+	BX_UNUSED(prev);
+
+	if (to == PipelineSlotState::Read || to == PipelineSlotState::Parsed) {
+		slot->m_Pipeline->m_Wakeup.post();
+	}
+}
+
+static void pipelineReadFile(LoadPipeline* pipeline, PipelineSlot* slot)
+{
+	bx::AllocatorI* allocator = pipeline->m_Context->m_Allocator;
+
+	bx::Error err;
+	bx::FileReader reader;
+	if (!reader.open(bx::FilePath(pipeline->m_Paths[slot->m_FileID]), &err)) {
+		slot->m_Error = ImageLoadError::InvalidInput;
+	} else {
+		const int64_t fileSize = reader.seek(0, bx::Whence::End);
+		reader.seek(0, bx::Whence::Begin);
+
+		if (fileSize < 0 || fileSize >= INT32_MAX) {
+			slot->m_Error = ImageLoadError::InvalidInput;
+		} else {
+			slot->m_FileSize = (uint32_t)fileSize;
+			slot->m_Buffer = (char*)BX_ALLOC(allocator, slot->m_FileSize + 1);
+			if (reader.read(slot->m_Buffer, (int32_t)slot->m_FileSize, &err) != (int32_t)slot->m_FileSize) {
+				slot->m_Error = ImageLoadError::InvalidInput;
+			}
+			slot->m_Buffer[slot->m_FileSize] = '\0';
+		}
+
+		reader.close();
+	}
+
+	pipelineSlotSetState(slot, PipelineSlotState::Reading, PipelineSlotState::Read);
+}
+
+static int32_t pipelineReaderThread(bx::Thread* thread, void* userData)
+{
+	BX_UNUSED(thread);
+
+	LoadPipeline* pipeline = (LoadPipeline*)userData;
+	const uint32_t queueCapacity = pipeline->m_NumSlots + 1;
+
+	for (;;) {
+		pipeline->m_ReadSemaphore.wait();
+
+		uint32_t slotID;
+		{
+			bx::MutexScope lock(pipeline->m_ReadMutex);
+			slotID = pipeline->m_ReadQueue[pipeline->m_ReadQueueHead];
+			pipeline->m_ReadQueueHead = (pipeline->m_ReadQueueHead + 1) % queueCapacity;
+			pipeline->m_ReadQueueSize--;
+		}
+
+		if (slotID == kPipelineShutdown) {
+			break;
+		}
+
+		pipelineReadFile(pipeline, &pipeline->m_Slots[slotID]);
+	}
+
+	return 0;
+}
+
+static void pipelinePushRead(LoadPipeline* pipeline, uint32_t slotID)
+{
+	const uint32_t queueCapacity = pipeline->m_NumSlots + 1;
+	{
+		bx::MutexScope lock(pipeline->m_ReadMutex);
+		SSVG_CHECK(pipeline->m_ReadQueueSize < queueCapacity, "Pipeline read queue overflow");
+		pipeline->m_ReadQueue[(pipeline->m_ReadQueueHead + pipeline->m_ReadQueueSize) % queueCapacity] = slotID;
+		pipeline->m_ReadQueueSize++;
+	}
+
+	pipeline->m_ReadSemaphore.post();
+}
+
+#if SSVG_PIPELINE_IO_URING
+static bool pipelineRingInit(PipelineRing* ring, uint32_t numEntries)
+{
+	io_uring_params params;
+	bx::memSet(&params, 0, sizeof(io_uring_params));
+
+	const int fd = (int)syscall(__NR_io_uring_setup, numEntries, &params);
+	if (fd < 0) {
+		return false;
+	}
+
+	size_t sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+	size_t cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	const bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (singleMap) {
+		sqRingSize = bx::max<size_t>(sqRingSize, cqRingSize);
+		cqRingSize = sqRingSize;
+	}
+
+	void* sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (sqRing == MAP_FAILED) {
+		close(fd);
+		return false;
+	}
+
+	void* cqRing = sqRing;
+	if (!singleMap) {
+		cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (cqRing == MAP_FAILED) {
+			munmap(sqRing, sqRingSize);
+			close(fd);
+			return false;
+		}
+	}
+
+	const size_t sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+	void* sqes = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (sqes == MAP_FAILED) {
+		if (cqRing != sqRing) {
+			munmap(cqRing, cqRingSize);
+		}
+		munmap(sqRing, sqRingSize);
+		close(fd);
+		return false;
+	}
+
+	uint8_t* sq = (uint8_t*)sqRing;
+	uint8_t* cq = (uint8_t*)cqRing;
+
+	ring->m_FD = fd;
+	ring->m_SQTail = (volatile uint32_t*)(sq + params.sq_off.tail);
+	ring->m_SQArray = (uint32_t*)(sq + params.sq_off.array);
+	ring->m_SQMask = *(const uint32_t*)(sq + params.sq_off.ring_mask);
+	ring->m_SQEs = (io_uring_sqe*)sqes;
+	ring->m_CQHead = (volatile uint32_t*)(cq + params.cq_off.head);
+	ring->m_CQTail = (volatile uint32_t*)(cq + params.cq_off.tail);
+	ring->m_CQMask = *(const uint32_t*)(cq + params.cq_off.ring_mask);
+	ring->m_CQEs = (io_uring_cqe*)(cq + params.cq_off.cqes);
+	ring->m_SQRing = sqRing;
+	ring->m_CQRing = cqRing;
+	ring->m_SQRingSize = sqRingSize;
+	ring->m_CQRingSize = cqRingSize;
+	ring->m_SQEsSize = sqesSize;
+	ring->m_NumPending = 0;
+	ring->m_Stop = 0;
+
+	return true;
+}
+
+static void pipelineRingShutdown(PipelineRing* ring)
+{
+	munmap(ring->m_SQEs, ring->m_SQEsSize);
+	if (ring->m_CQRing != ring->m_SQRing) {
+		munmap(ring->m_CQRing, ring->m_CQRingSize);
+	}
+	munmap(ring->m_SQRing, ring->m_SQRingSize);
+	close(ring->m_FD);
+}
+
+// Retries interrupted calls and full queues. Returns -1 (with errno set) on any other error.
+static int pipelineRingEnter(PipelineRing* ring, uint32_t toSubmit, uint32_t minComplete, uint32_t flags)
+{
+	for (;;) {
+		const int res = (int)syscall(__NR_io_uring_enter, ring->m_FD, toSubmit, minComplete, flags, nullptr, 0);
+		if (res >= 0 || (errno != EINTR && errno != EAGAIN && errno != EBUSY)) {
+			return res;
+		}
+	}
+}
+
+// Returns false if the request couldn't be submitted, in which case it's taken back out of the ring.
+static bool pipelineRingSubmit(PipelineRing* ring, uint8_t opcode, int fd, void* data, uint32_t size, uint64_t userData)
+{
+	const uint32_t tail = *ring->m_SQTail;
+	const uint32_t index = tail & ring->m_SQMask;
+
+	io_uring_sqe* sqe = &ring->m_SQEs[index];
+	bx::memSet(sqe, 0, sizeof(io_uring_sqe));
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->addr = (uint64_t)(uintptr_t)data;
+	sqe->len = size;
+	sqe->off = 0;
+	sqe->user_data = userData;
+	ring->m_SQArray[index] = index;
+
+	// NOTE: The kernel must see the entry before the new tail.
+	bx::writeBarrier();
+	*ring->m_SQTail = tail + 1;
+
+	// NOTE: Without SQPOLL the kernel only consumes entries inside io_uring_enter, and a failed call
+	// consumed none, so the entry can be withdrawn.
+	if (pipelineRingEnter(ring, 1, 0, 0) < 0) {
+		*ring->m_SQTail = tail;
+		return false;
+	}
+
+	return true;
+}
+
+static void pipelineRingReadDone(PipelineSlot* slot, int32_t result)
+{
+	// NOTE: Short reads (and kernels without IORING_OP_READ) are finished with blocking reads.
+	uint32_t numRead = result > 0 ? (uint32_t)result : 0;
+	while (numRead < slot->m_FileSize) {
+		const ssize_t n = pread(slot->m_FD, slot->m_Buffer + numRead, slot->m_FileSize - numRead, numRead);
+		if (n <= 0) {
+			break;
+		}
+
+		numRead += (uint32_t)n;
+	}
+
+	close(slot->m_FD);
+	slot->m_FD = -1;
+
+	if (numRead != slot->m_FileSize) {
+		slot->m_Error = ImageLoadError::InvalidInput;
+	}
+	slot->m_Buffer[slot->m_FileSize] = '\0';
+
+	pipelineSlotSetState(slot, PipelineSlotState::Reading, PipelineSlotState::Read);
+}
+
+static int32_t pipelineRingThread(bx::Thread* thread, void* userData)
+{
+	BX_UNUSED(thread);
+
+	LoadPipeline* pipeline = (LoadPipeline*)userData;
+	PipelineRing* ring = &pipeline->m_Ring;
+
+	// NOTE: Submitted reads complete whether or not anyone waits for them, so if waiting fails the
+	// completion queue is polled instead. Their buffers can't be released before that.
+	bool polling = false;
+	for (;;) {
+		const uint32_t head = *ring->m_CQHead;
+		const uint32_t tail = *ring->m_CQTail;
+		bx::readBarrier();
+
+		if (head == tail) {
+			if (bx::atomicFetchAndAdd<uint32_t>(&ring->m_NumPending, 0) == 0) {
+				if (bx::atomicFetchAndAdd<uint32_t>(&ring->m_Stop, 0) != 0) {
+					break;
+				}
+
+				pipeline->m_ReadSemaphore.wait();
+				continue;
+			}
+
+			if (!polling && pipelineRingEnter(ring, 0, 1, IORING_ENTER_GETEVENTS) < 0) {
+				SSVG_WARN(false, "io_uring_enter() failed (errno %d); polling for completions", errno);
+				polling = true;
+			}
+
+			if (polling) {
+				bx::sleep(1);
+			}
+			continue;
+		}
+
+		const io_uring_cqe* cqe = &ring->m_CQEs[head & ring->m_CQMask];
+		const uint64_t id = cqe->user_data;
+		const int32_t result = cqe->res;
+
+		bx::memoryBarrier();
+		*ring->m_CQHead = head + 1;
+
+		pipelineRingReadDone(&pipeline->m_Slots[id], result);
+		bx::atomicFetchAndSub<uint32_t>(&ring->m_NumPending, 1);
+	}
+
+	return 0;
+}
+
+static void pipelineRingStartRead(LoadPipeline* pipeline, PipelineSlot* slot, uint32_t slotID)
+{
+	const int fd = open(pipeline->m_Paths[slot->m_FileID], O_RDONLY | O_CLOEXEC);
+
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) != 0 || st.st_size >= INT32_MAX) {
+		if (fd >= 0) {
+			close(fd);
+		}
+
+		slot->m_Error = ImageLoadError::InvalidInput;
+		pipelineSlotSetState(slot, PipelineSlotState::Reading, PipelineSlotState::Read);
+		return;
+	}
+
+	slot->m_FD = fd;
+	slot->m_FileSize = (uint32_t)st.st_size;
+	slot->m_Buffer = (char*)BX_ALLOC(pipeline->m_Context->m_Allocator, slot->m_FileSize + 1);
+
+	if (slot->m_FileSize == 0) {
+		pipelineRingReadDone(slot, 0);
+		return;
+	}
+
+	// NOTE: Counted before submitting, so the reader thread never waits on the semaphore while the read is in flight.
+	bx::atomicFetchAndAdd<uint32_t>(&pipeline->m_Ring.m_NumPending, 1);
+	if (!pipelineRingSubmit(&pipeline->m_Ring, IORING_OP_READ, fd, slot->m_Buffer, slot->m_FileSize, slotID)) {
+		bx::atomicFetchAndSub<uint32_t>(&pipeline->m_Ring.m_NumPending, 1);
+		pipelineRingReadDone(slot, 0);
+		return;
+	}
+
+	pipeline->m_ReadSemaphore.post();
+}
+#endif // SSVG_PIPELINE_IO_URING
+
+static void pipelineStartRead(LoadPipeline* pipeline, uint32_t slotID, uint32_t fileID)
+{
+	PipelineSlot* slot = &pipeline->m_Slots[slotID];
+	slot->m_Buffer = nullptr;
+	slot->m_FileSize = 0;
+	slot->m_FileID = fileID;
+	slot->m_Image = nullptr;
+	slot->m_Error = ImageLoadError::None;
+	pipelineSlotSetState(slot, PipelineSlotState::Free, PipelineSlotState::Reading);
+
+#if SSVG_PIPELINE_IO_URING
+	if (pipeline->m_UseRing) {
+		pipelineRingStartRead(pipeline, slot, slotID);
+		return;
+	}
+#endif
+
+	pipelinePushRead(pipeline, slotID);
+}
+
+static void pipelineParse(PipelineSlot* slot)
+{
+	LoadPipeline* pipeline = slot->m_Pipeline;
+
+	if (slot->m_Error == ImageLoadError::None) {
+		ImageLoadError::Enum err = ImageLoadError::None;
+		slot->m_Image = imageLoadWithLimits(slot->m_Buffer, pipeline->m_Flags, pipeline->m_BaseAttrs, pipeline->m_Context, pipeline->m_Limits, &err);
+		slot->m_Error = err;
+
+		// NOTE: The file buffer is recycled, so the image can't keep borrowing from it.
+		if (slot->m_Image != nullptr && (pipeline->m_Flags & ImageLoadFlags::BorrowStrings) != 0) {
+			imageDetachSource(slot->m_Image);
+		}
+	}
+
+	BX_FREE(pipeline->m_Context->m_Allocator, slot->m_Buffer);
+	slot->m_Buffer = nullptr;
+
+	pipelineSlotSetState(slot, PipelineSlotState::Parsing, PipelineSlotState::Parsed);
+}
+
+static void pipelineParseTask(void* userData)
+{
+	pipelineParse((PipelineSlot*)userData);
+}
+
+// Loads count files, reading the next ones while the current ones are parsed on ctx's scheduler. At most
+// maxInFlight files are being read, parsed or waiting for delivery at any time (0 = twice the scheduler's threads).
+// callback is called on the calling thread as files finish, in no particular order. Files are read on a
+// separate thread (or io_uring, see SSVG_CONFIG_USE_IO_URING), so ctx's allocator must be thread safe.
+// Returns the number of loaded images. If ctx is nullptr the default context is used.
+uint32_t imageLoadFiles(const char* const* paths, uint32_t count, uint32_t flags, const ShapeAttributes* baseAttrs, Context* ctx, const ImageLoadLimits* limits, uint32_t maxInFlight, ImageLoadFileCallback callback, void* userData)
+{
+	ctx = contextOrDefault(ctx);
+	if (count == 0) {
+		return 0;
+	}
+
+	bx::AllocatorI* allocator = ctx->m_Allocator;
+	SchedulerI* scheduler = contextGetScheduler(ctx);
+	const uint32_t numThreads = scheduler->getNumThreads();
+
+	if (maxInFlight == 0) {
+		maxInFlight = numThreads * 2;
+	}
+	maxInFlight = bx::min<uint32_t>(maxInFlight, count);
+
+	LoadPipeline pipeline;
+	pipeline.m_Paths = paths;
+	pipeline.m_BaseAttrs = baseAttrs;
+	pipeline.m_Context = ctx;
+	pipeline.m_Limits = limits;
+	pipeline.m_Flags = flags;
+	pipeline.m_NumSlots = maxInFlight;
+	pipeline.m_Slots = (PipelineSlot*)BX_ALLOC(allocator, sizeof(PipelineSlot) * maxInFlight);
+	bx::memSet(pipeline.m_Slots, 0, sizeof(PipelineSlot) * maxInFlight);
+	for (uint32_t i = 0; i < maxInFlight; ++i) {
+		pipeline.m_Slots[i].m_Pipeline = &pipeline;
+	}
+	pipeline.m_ReadQueue = (uint32_t*)BX_ALLOC(allocator, sizeof(uint32_t) * (maxInFlight + 1));
+	pipeline.m_ReadQueueHead = 0;
+	pipeline.m_ReadQueueSize = 0;
+
+#if SSVG_PIPELINE_IO_URING
+	pipeline.m_UseRing = pipelineRingInit(&pipeline.m_Ring, maxInFlight);
+	pipeline.m_ReaderThread.init(pipeline.m_UseRing ? pipelineRingThread : pipelineReaderThread, &pipeline, 0, "ssvg reader");
+#else
+	pipeline.m_ReaderThread.init(pipelineReaderThread, &pipeline, 0, "ssvg reader");
+#endif
+
+	uint32_t nextFileID = 0;
+	for (uint32_t i = 0; i < maxInFlight; ++i) {
+		pipelineStartRead(&pipeline, i, nextFileID++);
+	}
+
+	TaskGroup group;
+	bx::memSet(&group, 0, sizeof(TaskGroup));
+
+	uint32_t numDelivered = 0;
+	uint32_t numLoaded = 0;
+	while (numDelivered < count) {
+		pipeline.m_Wakeup.wait();
+
+		for (uint32_t i = 0; i < maxInFlight; ++i) {
+			PipelineSlot* slot = &pipeline.m_Slots[i];
+
+			const uint32_t state = pipelineSlotGetState(slot);
+			if (state == PipelineSlotState::Read) {
+				pipelineSlotSetState(slot, PipelineSlotState::Read, PipelineSlotState::Parsing);
+				if (numThreads == 1) {
+					pipelineParse(slot);
+				} else {
+					scheduler->submit(&group, pipelineParseTask, slot);
+				}
+			} else if (state == PipelineSlotState::Parsed) {
+				Image* img = slot->m_Image;
+				const ImageLoadError::Enum err = slot->m_Error;
+				const uint32_t fileID = slot->m_FileID;
+				pipelineSlotSetState(slot, PipelineSlotState::Parsed, PipelineSlotState::Free);
+
+				if (nextFileID < count) {
+					pipelineStartRead(&pipeline, i, nextFileID++);
+				}
+
+				numLoaded += img != nullptr ? 1 : 0;
+				numDelivered++;
+				callback(fileID, img, err, userData);
+			}
+		}
+	}
+
+	scheduler->wait(&group);
+
+#if SSVG_PIPELINE_IO_URING
+	if (pipeline.m_UseRing) {
+		bx::atomicCompareAndSwap<uint32_t>(&pipeline.m_Ring.m_Stop, 0, 1);
+		pipeline.m_ReadSemaphore.post();
+	} else {
+		pipelinePushRead(&pipeline, kPipelineShutdown);
+	}
+#else
+	pipelinePushRead(&pipeline, kPipelineShutdown);
+#endif
+	pipeline.m_ReaderThread.shutdown();
+
+#if SSVG_PIPELINE_IO_URING
+	if (pipeline.m_UseRing) {
+		pipelineRingShutdown(&pipeline.m_Ring);
+	}
+#endif
+
+	BX_FREE(allocator, pipeline.m_ReadQueue);
+	BX_FREE(allocator, pipeline.m_Slots);
+
+	return numLoaded;
+}
+} // namespace ssvg
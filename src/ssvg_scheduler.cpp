@@ -0,0 +1,388 @@
+#include <ssvg/ssvg.h>
+#include <bx/bx.h>
+#include <bx/allocator.h>
+#include <bx/cpu.h>
+#include <bx/mutex.h>
+#include <bx/os.h>
+#include <bx/semaphore.h>
+#include <bx/thread.h>
+
+#if BX_PLATFORM_WINDOWS
+#include <windows.h> // GetSystemInfo
+#elif BX_PLATFORM_POSIX
+#include <unistd.h> // sysconf
+#endif
+
+namespace ssvg
+{
+struct SchedulerTask
+{
+	TaskFunc m_Func;
+	void* m_UserData;
+	TaskGroup* m_Group;
+};
+
+// NOTE: Ring buffer of tasks. The owning worker pushes and pops at the back, other threads steal
+// from the front so they pick the oldest (usually largest) pieces of work. Padded so queues of
+// different workers don't share cache lines.
+struct SchedulerQueue
+{
+	bx::Mutex m_Mutex;
+	SchedulerTask* m_Tasks;
+	uint32_t m_Capacity;
+	uint32_t m_Head;
+	uint32_t m_NumTasks;
+	uint8_t m_Padding[BX_CACHE_LINE_SIZE];
+};
+
+struct SchedulerParallelFor
+{
+	ParallelForFunc m_Func;
+	void* m_UserData;
+	uint32_t m_Count;
+	uint32_t m_GrainSize;
+	volatile uint32_t m_NextBegin;
+};
+
+class WorkStealingScheduler;
+
+static BX_THREAD_LOCAL WorkStealingScheduler* s_WorkerScheduler = nullptr;
+static BX_THREAD_LOCAL uint32_t s_WorkerID = 0;
+
+static uint32_t getNumCPUs()
+{
+#if BX_PLATFORM_WINDOWS
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (uint32_t)info.dwNumberOfProcessors;
+#elif BX_PLATFORM_POSIX
+	const long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? (uint32_t)n : 1;
+#else
+	return 1;
+#endif
+}
+
+inline volatile uint32_t* taskGroupNumPending(TaskGroup* group)
+{
+	return (volatile uint32_t*)&group->m_Data[0];
+}
+
+// Fallback used when the application doesn't register its own scheduler. Each worker has its own
+// queue; tasks submitted from other threads go to a shared queue. Idle workers steal from the others
+// and sleep on a semaphore when there's nothing left. Threads waiting for a group run tasks too.
+class WorkStealingScheduler : public SchedulerI
+{
+public:
+	WorkStealingScheduler(bx::AllocatorI* allocator, uint32_t numWorkerThreads);
+	virtual ~WorkStealingScheduler();
+
+	virtual uint32_t getNumThreads() override;
+	virtual void submit(TaskGroup* group, TaskFunc func, void* userData) override;
+	virtual void wait(TaskGroup* group) override;
+	virtual void parallelFor(uint32_t count, uint32_t grainSize, ParallelForFunc func, void* userData) override;
+	virtual void destroy() override;
+
+	static int32_t workerThread(bx::Thread* thread, void* userData);
+	static void parallelForTask(void* userData);
+
+	void push(uint32_t queueID, const SchedulerTask& task);
+	bool pop(uint32_t queueID, SchedulerTask* task);
+	bool steal(uint32_t queueID, SchedulerTask* task);
+	bool runTask(uint32_t queueID);
+	uint32_t getQueueID();
+	bool isShuttingDown();
+
+	bx::AllocatorI* m_Allocator;
+	bx::Thread* m_Threads;
+	SchedulerQueue* m_Queues;  // NOTE: One per worker, plus the shared queue at m_NumWorkers.
+	uint32_t m_NumWorkers;
+	bx::Semaphore m_Semaphore;
+	volatile uint32_t m_NumSleeping;
+	volatile uint32_t m_Shutdown;
+};
+
+WorkStealingScheduler::WorkStealingScheduler(bx::AllocatorI* allocator, uint32_t numWorkerThreads)
+	: m_Allocator(allocator)
+	, m_Threads(nullptr)
+	, m_Queues(nullptr)
+	, m_NumWorkers(numWorkerThreads)
+	, m_NumSleeping(0)
+	, m_Shutdown(0)
+{
+	const uint32_t numQueues = m_NumWorkers + 1;
+	m_Queues = (SchedulerQueue*)BX_ALIGNED_ALLOC(m_Allocator, sizeof(SchedulerQueue) * numQueues, BX_CACHE_LINE_SIZE);
+	SSVG_CHECK(m_Queues != nullptr, "Failed to allocate scheduler queues");
+	for (uint32_t i = 0; i < numQueues; ++i) {
+		SchedulerQueue* queue = BX_PLACEMENT_NEW(&m_Queues[i], SchedulerQueue);
+		queue->m_Tasks = nullptr;
+		queue->m_Capacity = 0;
+		queue->m_Head = 0;
+		queue->m_NumTasks = 0;
+	}
+
+	if (m_NumWorkers != 0) {
+		m_Threads = (bx::Thread*)BX_ALLOC(m_Allocator, sizeof(bx::Thread) * m_NumWorkers);
+		SSVG_CHECK(m_Threads != nullptr, "Failed to allocate scheduler threads");
+		for (uint32_t i = 0; i < m_NumWorkers; ++i) {
+			bx::Thread* thread = BX_PLACEMENT_NEW(&m_Threads[i], bx::Thread);
+			thread->init(workerThread, this, 0, "ssvg worker");
+		}
+	}
+}
+
+WorkStealingScheduler::~WorkStealingScheduler()
+{
+	bx::atomicCompareAndSwap<uint32_t>(&m_Shutdown, 0, 1);
+	m_Semaphore.post(m_NumWorkers);
+
+	for (uint32_t i = 0; i < m_NumWorkers; ++i) {
+		m_Threads[i].shutdown();
+		m_Threads[i].~Thread();
+	}
+	BX_FREE(m_Allocator, m_Threads);
+
+	const uint32_t numQueues = m_NumWorkers + 1;
+	for (uint32_t i = 0; i < numQueues; ++i) {
+		SchedulerQueue* queue = &m_Queues[i];
+		SSVG_CHECK(queue->m_NumTasks == 0, "Scheduler destroyed with pending tasks");
+		BX_FREE(m_Allocator, queue->m_Tasks);
+		queue->~SchedulerQueue();
+	}
+	BX_ALIGNED_FREE(m_Allocator, m_Queues, BX_CACHE_LINE_SIZE);
+}
+
+uint32_t WorkStealingScheduler::getNumThreads()
+{
+	return m_NumWorkers + 1;
+}
+
+void WorkStealingScheduler::submit(TaskGroup* group, TaskFunc func, void* userData)
+{
+	bx::atomicFetchAndAdd<uint32_t>(taskGroupNumPending(group), 1);
+
+	SchedulerTask task;
+	task.m_Func = func;
+	task.m_UserData = userData;
+	task.m_Group = group;
+	push(getQueueID(), task);
+
+	// NOTE: Pairs with the increment in workerThread(); a worker going to sleep either sees
+	// the task or is counted in m_NumSleeping.
+	bx::memoryBarrier();
+	if (m_NumSleeping != 0) {
+		m_Semaphore.post();
+	}
+}
+
+void WorkStealingScheduler::wait(TaskGroup* group)
+{
+	const uint32_t queueID = getQueueID();
+
+	// NOTE: Read with an atomic op so everything the group's tasks wrote is visible once it hits 0.
+	volatile uint32_t* numPending = taskGroupNumPending(group);
+	while (bx::atomicFetchAndAdd<uint32_t>(numPending, 0) != 0) {
+		if (!runTask(queueID)) {
+			// NOTE: The remaining tasks of the group are running on other threads.
+			bx::yield();
+		}
+	}
+}
+
+void WorkStealingScheduler::parallelFor(uint32_t count, uint32_t grainSize, ParallelForFunc func, void* userData)
+{
+	if (count == 0) {
+		return;
+	}
+
+	grainSize = bx::max<uint32_t>(grainSize, 1);
+
+	const uint32_t numRanges = (count + grainSize - 1) / grainSize;
+	if (numRanges == 1 || m_NumWorkers == 0) {
+		func(0, count, userData);
+		return;
+	}
+
+	// NOTE: One task per thread; each one grabs ranges until there are none left, so the number of
+	// tasks doesn't depend on the grain size.
+	SchedulerParallelFor pf;
+	pf.m_Func = func;
+	pf.m_UserData = userData;
+	pf.m_Count = count;
+	pf.m_GrainSize = grainSize;
+	pf.m_NextBegin = 0;
+
+	TaskGroup group;
+	bx::memSet(&group, 0, sizeof(TaskGroup));
+
+	const uint32_t numTasks = bx::min<uint32_t>(numRanges, getNumThreads());
+	for (uint32_t i = 0; i < numTasks; ++i) {
+		submit(&group, parallelForTask, &pf);
+	}
+
+	wait(&group);
+}
+
+int32_t WorkStealingScheduler::workerThread(bx::Thread* thread, void* userData)
+{
+	WorkStealingScheduler* scheduler = (WorkStealingScheduler*)userData;
+
+	s_WorkerScheduler = scheduler;
+	s_WorkerID = (uint32_t)(thread - scheduler->m_Threads);
+
+	while (!scheduler->isShuttingDown()) {
+		if (scheduler->runTask(s_WorkerID)) {
+			continue;
+		}
+
+		bx::atomicFetchAndAdd<uint32_t>(&scheduler->m_NumSleeping, 1);
+
+		// NOTE: Check once more after announcing we're going to sleep; a task pushed before the
+		// increment wouldn't post the semaphore.
+		if (!scheduler->runTask(s_WorkerID) && !scheduler->isShuttingDown()) {
+			scheduler->m_Semaphore.wait();
+		}
+
+		bx::atomicFetchAndSub<uint32_t>(&scheduler->m_NumSleeping, 1);
+	}
+
+	s_WorkerScheduler = nullptr;
+
+	return 0;
+}
+
+void WorkStealingScheduler::parallelForTask(void* userData)
+{
+	SchedulerParallelFor* pf = (SchedulerParallelFor*)userData;
+
+	for (;;) {
+		const uint32_t begin = bx::atomicFetchAndAdd<uint32_t>(&pf->m_NextBegin, pf->m_GrainSize);
+		if (begin >= pf->m_Count) {
+			break;
+		}
+
+		pf->m_Func(begin, bx::min<uint32_t>(begin + pf->m_GrainSize, pf->m_Count), pf->m_UserData);
+	}
+}
+
+void WorkStealingScheduler::push(uint32_t queueID, const SchedulerTask& task)
+{
+	SchedulerQueue* queue = &m_Queues[queueID];
+
+	bx::MutexScope lock(queue->m_Mutex);
+
+	if (queue->m_NumTasks == queue->m_Capacity) {
+		const uint32_t oldCapacity = queue->m_Capacity;
+		const uint32_t newCapacity = oldCapacity ? oldCapacity * 2 : 64;
+
+		SchedulerTask* tasks = (SchedulerTask*)BX_ALLOC(m_Allocator, sizeof(SchedulerTask) * newCapacity);
+		SSVG_CHECK(tasks != nullptr, "Failed to allocate scheduler queue");
+		for (uint32_t i = 0; i < queue->m_NumTasks; ++i) {
+			tasks[i] = queue->m_Tasks[(queue->m_Head + i) % oldCapacity];
+		}
+
+		BX_FREE(m_Allocator, queue->m_Tasks);
+		queue->m_Tasks = tasks;
+		queue->m_Capacity = newCapacity;
+		queue->m_Head = 0;
+	}
+
+	queue->m_Tasks[(queue->m_Head + queue->m_NumTasks) % queue->m_Capacity] = task;
+	queue->m_NumTasks++;
+}
+
+bool WorkStealingScheduler::pop(uint32_t queueID, SchedulerTask* task)
+{
+	SchedulerQueue* queue = &m_Queues[queueID];
+
+	bx::MutexScope lock(queue->m_Mutex);
+	if (queue->m_NumTasks == 0) {
+		return false;
+	}
+
+	queue->m_NumTasks--;
+	*task = queue->m_Tasks[(queue->m_Head + queue->m_NumTasks) % queue->m_Capacity];
+
+	return true;
+}
+
+bool WorkStealingScheduler::steal(uint32_t queueID, SchedulerTask* task)
+{
+	SchedulerQueue* queue = &m_Queues[queueID];
+
+	bx::MutexScope lock(queue->m_Mutex);
+	if (queue->m_NumTasks == 0) {
+		return false;
+	}
+
+	*task = queue->m_Tasks[queue->m_Head];
+	queue->m_Head = (queue->m_Head + 1) % queue->m_Capacity;
+	queue->m_NumTasks--;
+
+	return true;
+}
+
+// Runs one task: the newest one from the thread's own queue or the oldest one from another queue,
+// starting with the shared one. Returns false if all queues are empty.
+bool WorkStealingScheduler::runTask(uint32_t queueID)
+{
+	SchedulerTask task;
+
+	bool found = queueID != m_NumWorkers && pop(queueID, &task);
+	found = found || steal(m_NumWorkers, &task);
+
+	const uint32_t numQueues = m_NumWorkers + 1;
+	for (uint32_t i = 1; i < numQueues && !found; ++i) {
+		const uint32_t victimID = (queueID + i) % numQueues;
+		found = victimID != m_NumWorkers && steal(victimID, &task);
+	}
+
+	if (!found) {
+		return false;
+	}
+
+	task.m_Func(task.m_UserData);
+
+	// NOTE: The group's owner might return from wait() and reuse its memory right after this.
+	bx::atomicFetchAndSub<uint32_t>(taskGroupNumPending(task.m_Group), 1);
+
+	return true;
+}
+
+// Workers use their own queue, all other threads share the last one.
+uint32_t WorkStealingScheduler::getQueueID()
+{
+	return s_WorkerScheduler == this ? s_WorkerID : m_NumWorkers;
+}
+
+bool WorkStealingScheduler::isShuttingDown()
+{
+	return bx::atomicFetchAndAdd<uint32_t>(&m_Shutdown, 0) != 0;
+}
+
+void WorkStealingScheduler::destroy()
+{
+	bx::AllocatorI* allocator = m_Allocator;
+	BX_DELETE(allocator, this);
+}
+
+SchedulerI* schedulerCreate(bx::AllocatorI* allocator, uint32_t numWorkerThreads)
+{
+	if (numWorkerThreads == 0) {
+		numWorkerThreads = SSVG_CONFIG_SCHEDULER_NUM_THREADS != 0 ? SSVG_CONFIG_SCHEDULER_NUM_THREADS : getNumCPUs() - 1;
+	}
+
+	// NOTE: Leave room for the threads waiting for work to finish (see SSVG_CONFIG_CONTEXT_MAX_THREADS).
+	numWorkerThreads = bx::min<uint32_t>(numWorkerThreads, SSVG_CONFIG_CONTEXT_MAX_THREADS / 2);
+
+	return BX_NEW(allocator, WorkStealingScheduler)(allocator, numWorkerThreads);
+}
+
+// NOTE: Dispatched through SchedulerI::destroy(), so schedulers which weren't created by schedulerCreate() are never freed here.
+void schedulerDestroy(SchedulerI* scheduler)
+{
+	if (scheduler != nullptr) {
+		scheduler->destroy();
+	}
+}
+} // namespace ssvg
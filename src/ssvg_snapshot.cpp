@@ -0,0 +1,548 @@
+#include <ssvg/ssvg.h>
+#include <bx/bx.h>
+#include <bx/allocator.h>
+#include <bx/cpu.h>
+#include <bx/os.h>
+#include <bx/string.h>
+
+namespace ssvg
+{
+// Attributes shared by all snapshot nodes with identical attributes and parents. Borrowed strings
+// are copied right after the block.
+struct SnapshotAttrs
+{
+	ShapeAttributes m_Attrs; // NOTE: Must be first. Snapshot shapes point to it.
+	volatile uint32_t m_RefCount;
+};
+
+// Immutable copy of a shape. Shared by all snapshots in which neither the shape nor the attributes
+// of its ancestors changed.
+struct SnapshotNode
+{
+	Shape m_Shape;         // NOTE: Must be first. Group shape lists point to it and hold a reference to each child.
+	const Shape* m_Source; // NOTE: The shape the node was copied from. Only used to pair shapes with nodes; might dangle.
+	volatile uint32_t m_RefCount;
+};
+
+struct ImageSnapshot
+{
+	Image m_Image;              // NOTE: m_ShapeList holds a reference to each top-level node
+	SnapshotAttrs* m_BaseAttrs; // NOTE: Parent of the top-level nodes
+	volatile uint32_t m_RefCount;
+};
+
+// Pairs the shapes of a list with the nodes of the matching list in the previous snapshot.
+struct SnapshotLookup
+{
+	const ShapeList* m_Nodes;
+	uint32_t* m_Table; // NOTE: Open addressing, indices into m_Nodes->m_Shapes. Built on the first miss.
+	uint32_t m_Mask;
+};
+
+static const uint32_t kSnapshotLookupEmpty = 0xFFFFFFFF;
+
+static inline SnapshotNode* snapshotNode(const Shape* shape)
+{
+	return (SnapshotNode*)shape;
+}
+
+static inline SnapshotAttrs* snapshotNodeAttrs(const SnapshotNode* node)
+{
+	return (SnapshotAttrs*)node->m_Shape.m_Attrs;
+}
+
+static inline uint32_t snapshotLookupHash(const Shape* shape)
+{
+	return (uint32_t)((uintptr_t)shape >> 4) * 2654435761u;
+}
+
+static SnapshotNode* snapshotLookupFind(SnapshotLookup* lookup, bx::AllocatorI* allocator, uint32_t index, const Shape* shape)
+{
+	const ShapeList* nodes = lookup->m_Nodes;
+	if (nodes == nullptr) {
+		return nullptr;
+	}
+
+	// NOTE: Most edits leave the order of the remaining shapes alone.
+	if (index < nodes->m_NumShapes && snapshotNode(nodes->m_Shapes[index])->m_Source == shape) {
+		return snapshotNode(nodes->m_Shapes[index]);
+	}
+
+	if (lookup->m_Table == nullptr) {
+		uint32_t tableSize = 16;
+		while (tableSize < nodes->m_NumShapes * 2) {
+			tableSize <<= 1;
+		}
+
+		lookup->m_Table = (uint32_t*)BX_ALLOC(allocator, sizeof(uint32_t) * tableSize);
+		lookup->m_Mask = tableSize - 1;
+		bx::memSet(lookup->m_Table, 0xFF, sizeof(uint32_t) * tableSize);
+
+		for (uint32_t i = 0; i < nodes->m_NumShapes; ++i) {
+			uint32_t slot = snapshotLookupHash(snapshotNode(nodes->m_Shapes[i])->m_Source) & lookup->m_Mask;
+			while (lookup->m_Table[slot] != kSnapshotLookupEmpty) {
+				slot = (slot + 1) & lookup->m_Mask;
+			}
+
+			lookup->m_Table[slot] = i;
+		}
+	}
+
+	uint32_t slot = snapshotLookupHash(shape) & lookup->m_Mask;
+	while (lookup->m_Table[slot] != kSnapshotLookupEmpty) {
+		SnapshotNode* node = snapshotNode(nodes->m_Shapes[lookup->m_Table[slot]]);
+		if (node->m_Source == shape) {
+			return node;
+		}
+
+		slot = (slot + 1) & lookup->m_Mask;
+	}
+
+	return nullptr;
+}
+
+static SnapshotAttrs* snapshotAttrsCreate(bx::AllocatorI* allocator, const ShapeAttributes* attrs, const ShapeAttributes* parentAttrs)
+{
+	const StringRef* refs[] = {
+		&attrs->m_IDRef,
+		&attrs->m_FontFamilyRef,
+		&attrs->m_ClassRef
+	};
+
+	uint32_t poolSize = 0;
+	for (uint32_t i = 0; i < BX_COUNTOF(refs); ++i) {
+		poolSize += refs[i]->m_Ptr ? refs[i]->m_Length + 1 : 0;
+	}
+
+	SnapshotAttrs* block = (SnapshotAttrs*)BX_ALLOC(allocator, sizeof(SnapshotAttrs) + poolSize);
+	bx::memCopy(&block->m_Attrs, attrs, sizeof(ShapeAttributes));
+	block->m_Attrs.m_Parent = parentAttrs;
+	block->m_RefCount = 1;
+
+	StringRef* dstRefs[] = {
+		&block->m_Attrs.m_IDRef,
+		&block->m_Attrs.m_FontFamilyRef,
+		&block->m_Attrs.m_ClassRef
+	};
+
+	char* pool = (char*)(block + 1);
+	for (uint32_t i = 0; i < BX_COUNTOF(dstRefs); ++i) {
+		StringRef* ref = dstRefs[i];
+		if (ref->m_Ptr == nullptr) {
+			continue;
+		}
+
+		bx::memCopy(pool, ref->m_Ptr, ref->m_Length);
+		pool[ref->m_Length] = '\0';
+		ref->m_Ptr = pool;
+		pool += ref->m_Length + 1;
+	}
+
+	return block;
+}
+
+static inline SnapshotAttrs* snapshotAttrsAcquire(SnapshotAttrs* block)
+{
+	bx::atomicInc(&block->m_RefCount);
+	return block;
+}
+
+static void snapshotAttrsRelease(bx::AllocatorI* allocator, SnapshotAttrs* block)
+{
+	if (bx::atomicDec(&block->m_RefCount) == 0) {
+		BX_FREE(allocator, block);
+	}
+}
+
+// Compares the contents of attrs (incl. the strings they borrow) with those of a block.
+static bool snapshotAttrsEqual(const SnapshotAttrs* block, const ShapeAttributes* attrs, const ShapeAttributes* parentAttrs)
+{
+	if (block->m_Attrs.m_Parent != parentAttrs) {
+		return false;
+	}
+
+	ShapeAttributes tmp;
+	bx::memCopy(&tmp, attrs, sizeof(ShapeAttributes));
+	tmp.m_Parent = parentAttrs;
+
+	StringRef* refs[] = {
+		&tmp.m_IDRef,
+		&tmp.m_FontFamilyRef,
+		&tmp.m_ClassRef
+	};
+
+	const StringRef* blockRefs[] = {
+		&block->m_Attrs.m_IDRef,
+		&block->m_Attrs.m_FontFamilyRef,
+		&block->m_Attrs.m_ClassRef
+	};
+
+	for (uint32_t i = 0; i < BX_COUNTOF(refs); ++i) {
+		const StringRef* ref = refs[i];
+		const StringRef* blockRef = blockRefs[i];
+		if ((ref->m_Ptr == nullptr) != (blockRef->m_Ptr == nullptr)) {
+			return false;
+		}
+
+		if (ref->m_Ptr != nullptr) {
+			if (ref->m_Length != blockRef->m_Length || bx::memCmp(ref->m_Ptr, blockRef->m_Ptr, ref->m_Length) != 0) {
+				return false;
+			}
+
+			bx::memCopy(refs[i], blockRef, sizeof(StringRef));
+		}
+	}
+
+	return bx::memCmp(&tmp, &block->m_Attrs, sizeof(ShapeAttributes)) == 0;
+}
+
+// Compares everything but the attributes of two non-group shapes.
+static bool snapshotShapeEqual(const Shape* node, const Shape* shape)
+{
+	if (node->m_Type != shape->m_Type || bx::memCmp(&node->m_BoundingRect[0], &shape->m_BoundingRect[0], sizeof(float) * 4) != 0) {
+		return false;
+	}
+
+	switch (shape->m_Type) {
+	case ShapeType::Rect:
+		return bx::memCmp(&node->m_Rect, &shape->m_Rect, sizeof(Rect)) == 0;
+	case ShapeType::Circle:
+		return bx::memCmp(&node->m_Circle, &shape->m_Circle, sizeof(Circle)) == 0;
+	case ShapeType::Ellipse:
+		return bx::memCmp(&node->m_Ellipse, &shape->m_Ellipse, sizeof(Ellipse)) == 0;
+	case ShapeType::Line:
+		return bx::memCmp(&node->m_Line, &shape->m_Line, sizeof(Line)) == 0;
+	case ShapeType::Polyline:
+	case ShapeType::Polygon:
+		return node->m_PointList.m_NumPoints == shape->m_PointList.m_NumPoints
+			&& bx::memCmp(node->m_PointList.m_Coords, shape->m_PointList.m_Coords, sizeof(float) * 2 * shape->m_PointList.m_NumPoints) == 0;
+	case ShapeType::Path:
+	{
+		const Path* nodePath = &node->m_Path;
+		const Path* path = &shape->m_Path;
+		if (nodePath->m_NumCommands != path->m_NumCommands || (nodePath->m_Packed == nullptr) != (path->m_Packed == nullptr)) {
+			return false;
+		}
+
+		if (path->m_Packed) {
+			return nodePath->m_PackedSize == path->m_PackedSize
+				&& nodePath->m_PackedScale == path->m_PackedScale
+				&& bx::memCmp(nodePath->m_Packed, path->m_Packed, path->m_PackedSize) == 0;
+		}
+
+		return bx::memCmp(nodePath->m_Commands, path->m_Commands, sizeof(PathCmd) * path->m_NumCommands) == 0;
+	}
+	case ShapeType::Text:
+	{
+		const Text* nodeText = &node->m_Text;
+		const Text* text = &shape->m_Text;
+		if ((nodeText->m_String == nullptr) != (text->m_String == nullptr)) {
+			return false;
+		}
+
+		return nodeText->x == text->x
+			&& nodeText->y == text->y
+			&& nodeText->m_Anchor == text->m_Anchor
+			&& (text->m_String == nullptr || bx::strCmp(nodeText->m_String, text->m_String) == 0);
+	}
+	default:
+		break;
+	}
+
+	return false;
+}
+
+static inline SnapshotNode* snapshotNodeAcquire(SnapshotNode* node)
+{
+	bx::atomicInc(&node->m_RefCount);
+	return node;
+}
+
+static void snapshotNodeRelease(bx::AllocatorI* allocator, SnapshotNode* node)
+{
+	if (bx::atomicDec(&node->m_RefCount) != 0) {
+		return;
+	}
+
+	Shape* shape = &node->m_Shape;
+	switch (shape->m_Type) {
+	case ShapeType::Group:
+	{
+		ShapeList* children = &shape->m_ShapeList;
+		for (uint32_t i = 0; i < children->m_NumShapes; ++i) {
+			snapshotNodeRelease(allocator, snapshotNode(children->m_Shapes[i]));
+		}
+
+		BX_FREE(allocator, children->m_Shapes);
+	}
+	break;
+	case ShapeType::Path:
+		pathFree(&shape->m_Path);
+		break;
+	case ShapeType::Polygon:
+	case ShapeType::Polyline:
+		pointListFree(&shape->m_PointList);
+		break;
+	case ShapeType::Text:
+		BX_FREE(allocator, shape->m_Text.m_String);
+		break;
+	default:
+		break;
+	}
+
+	snapshotAttrsRelease(allocator, snapshotNodeAttrs(node));
+	BX_FREE(allocator, node);
+}
+
+static void snapshotNodeListRelease(bx::AllocatorI* allocator, Shape** nodes, uint32_t numNodes)
+{
+	for (uint32_t i = 0; i < numNodes; ++i) {
+		snapshotNodeRelease(allocator, snapshotNode(nodes[i]));
+	}
+
+	BX_FREE(allocator, nodes);
+}
+
+static SnapshotNode* snapshotNodeAlloc(bx::AllocatorI* allocator, const Shape* shape, SnapshotAttrs* attrs)
+{
+	SnapshotNode* node = (SnapshotNode*)BX_ALLOC(allocator, sizeof(SnapshotNode));
+	bx::memSet(node, 0, sizeof(SnapshotNode));
+	node->m_Shape.m_Type = shape->m_Type;
+	node->m_Shape.m_Attrs = &attrs->m_Attrs;
+	node->m_Source = shape;
+	node->m_RefCount = 1;
+
+	return node;
+}
+
+static Shape** snapshotBuildList(Context* ctx, const ShapeList* shapeList, const ShapeList* prevNodes, SnapshotAttrs* parentAttrs, bool* unchanged);
+
+// Returns a new reference to the node of shape. prev is the node shape was copied to by the previous snapshot
+// (if any) and is reused if nothing changed. Its attributes are reused if only the geometry changed, which
+// lets the children of modified groups be reused too.
+static SnapshotNode* snapshotBuildNode(Context* ctx, const Shape* shape, SnapshotNode* prev, SnapshotAttrs* parentAttrs)
+{
+	bx::AllocatorI* allocator = ctx->m_Allocator;
+
+	SnapshotAttrs* prevAttrs = prev ? snapshotNodeAttrs(prev) : nullptr;
+	SnapshotAttrs* attrs = prevAttrs && snapshotAttrsEqual(prevAttrs, shape->m_Attrs, &parentAttrs->m_Attrs)
+		? snapshotAttrsAcquire(prevAttrs)
+		: snapshotAttrsCreate(allocator, shape->m_Attrs, &parentAttrs->m_Attrs)
+		;
+
+	if (shape->m_Type == ShapeType::Group) {
+		const bool prevIsGroup = prev && prev->m_Shape.m_Type == ShapeType::Group;
+
+		bool unchanged = false;
+		const ShapeList* children = &shape->m_ShapeList;
+		Shape** nodes = snapshotBuildList(ctx, children, prevIsGroup ? &prev->m_Shape.m_ShapeList : nullptr, attrs, &unchanged);
+
+		if (unchanged && attrs == prevAttrs && bx::memCmp(&prev->m_Shape.m_BoundingRect[0], &shape->m_BoundingRect[0], sizeof(float) * 4) == 0) {
+			snapshotNodeListRelease(allocator, nodes, children->m_NumShapes);
+			snapshotAttrsRelease(allocator, attrs);
+			return snapshotNodeAcquire(prev);
+		}
+
+		SnapshotNode* node = snapshotNodeAlloc(allocator, shape, attrs);
+		bx::memCopy(&node->m_Shape.m_BoundingRect[0], &shape->m_BoundingRect[0], sizeof(float) * 4);
+
+		ShapeList* nodeList = &node->m_Shape.m_ShapeList;
+		nodeList->m_Shapes = nodes;
+		nodeList->m_NumShapes = children->m_NumShapes;
+		nodeList->m_Capacity = children->m_NumShapes;
+		nodeList->m_Context = ctx;
+
+		return node;
+	}
+
+	if (attrs == prevAttrs && snapshotShapeEqual(&prev->m_Shape, shape)) {
+		snapshotAttrsRelease(allocator, attrs);
+		return snapshotNodeAcquire(prev);
+	}
+
+	SnapshotNode* node = snapshotNodeAlloc(allocator, shape, attrs);
+	switch (shape->m_Type) {
+	case ShapeType::Path:
+		node->m_Shape.m_Path.m_Allocator = allocator;
+		break;
+	case ShapeType::Polyline:
+	case ShapeType::Polygon:
+		node->m_Shape.m_PointList.m_Allocator = allocator;
+		break;
+	case ShapeType::Text:
+		node->m_Shape.m_Text.m_Allocator = allocator;
+		break;
+	default:
+		break;
+	}
+
+	if (shape->m_Type == ShapeType::Text && shape->m_Text.m_String == nullptr) {
+		// NOTE: shapeCopy() would turn it into an empty string.
+		bx::memCopy(&node->m_Shape.m_BoundingRect[0], &shape->m_BoundingRect[0], sizeof(float) * 4);
+		node->m_Shape.m_Text.x = shape->m_Text.x;
+		node->m_Shape.m_Text.y = shape->m_Text.y;
+		node->m_Shape.m_Text.m_Anchor = shape->m_Text.m_Anchor;
+	} else {
+		shapeCopy(&node->m_Shape, shape, false);
+	}
+
+	return node;
+}
+
+// Returns an array with a new reference to the node of each shape in shapeList. *unchanged is set if
+// it's identical to prevNodes (the matching list of the previous snapshot, if any).
+static Shape** snapshotBuildList(Context* ctx, const ShapeList* shapeList, const ShapeList* prevNodes, SnapshotAttrs* parentAttrs, bool* unchanged)
+{
+	bx::AllocatorI* allocator = ctx->m_Allocator;
+
+	const uint32_t numShapes = shapeList->m_NumShapes;
+	Shape** nodes = numShapes ? (Shape**)BX_ALLOC(allocator, sizeof(Shape*) * numShapes) : nullptr;
+
+	SnapshotLookup lookup;
+	lookup.m_Nodes = prevNodes;
+	lookup.m_Table = nullptr;
+	lookup.m_Mask = 0;
+
+	bool same = prevNodes != nullptr && prevNodes->m_NumShapes == numShapes;
+	for (uint32_t i = 0; i < numShapes; ++i) {
+		const Shape* shape = shapeList->m_Shapes[i];
+		SnapshotNode* prev = snapshotLookupFind(&lookup, allocator, i, shape);
+		nodes[i] = &snapshotBuildNode(ctx, shape, prev, parentAttrs)->m_Shape;
+		same = same && prevNodes->m_Shapes[i] == nodes[i];
+	}
+
+	BX_FREE(allocator, lookup.m_Table);
+
+	*unchanged = same;
+
+	return nodes;
+}
+
+static bool snapshotImageEqual(const Image* snapshotImg, const Image* img)
+{
+	return snapshotImg->m_Width == img->m_Width
+		&& snapshotImg->m_Height == img->m_Height
+		&& bx::memCmp(&snapshotImg->m_ViewBox[0], &img->m_ViewBox[0], sizeof(float) * 4) == 0
+		&& bx::memCmp(&snapshotImg->m_BoundingRect[0], &img->m_BoundingRect[0], sizeof(float) * 4) == 0
+		&& snapshotImg->m_BaseProfile == img->m_BaseProfile
+		&& snapshotImg->m_VerMajor == img->m_VerMajor
+		&& snapshotImg->m_VerMinor == img->m_VerMinor
+		;
+}
+
+// Copies the image into a tree of immutable, reference counted nodes. Nodes of the previous snapshot
+// are paired with shapes by identity and reused if their contents (compared in full, so direct edits of
+// shape members are picked up too) and the attributes of their ancestors are unchanged. The cost is a
+// pass over the image; memory is only allocated for the modified shapes and their ancestors.
+ImageSnapshot* imageSnapshot(Image* img)
+{
+	Context* ctx = img->m_Context;
+	bx::AllocatorI* allocator = ctx->m_Allocator;
+	ImageSnapshot* prev = img->m_LastSnapshot;
+
+	const ShapeAttributes* baseParentAttrs = img->m_BaseAttrs.m_Parent;
+	SnapshotAttrs* baseAttrs = prev && snapshotAttrsEqual(prev->m_BaseAttrs, &img->m_BaseAttrs, baseParentAttrs)
+		? snapshotAttrsAcquire(prev->m_BaseAttrs)
+		: snapshotAttrsCreate(allocator, &img->m_BaseAttrs, baseParentAttrs)
+		;
+
+	bool unchanged = false;
+	const uint32_t numShapes = img->m_ShapeList.m_NumShapes;
+	Shape** nodes = snapshotBuildList(ctx, &img->m_ShapeList, prev ? &prev->m_Image.m_ShapeList : nullptr, baseAttrs, &unchanged);
+
+	if (unchanged && baseAttrs == prev->m_BaseAttrs && snapshotImageEqual(&prev->m_Image, img)) {
+		snapshotNodeListRelease(allocator, nodes, numShapes);
+		snapshotAttrsRelease(allocator, baseAttrs);
+		return imageSnapshotAcquire(prev);
+	}
+
+	ImageSnapshot* snapshot = (ImageSnapshot*)BX_ALLOC(allocator, sizeof(ImageSnapshot));
+	bx::memSet(snapshot, 0, sizeof(ImageSnapshot));
+	snapshot->m_BaseAttrs = baseAttrs;
+	snapshot->m_RefCount = 1;
+
+	Image* snapshotImg = &snapshot->m_Image;
+	bx::memCopy(&snapshotImg->m_BaseAttrs, &baseAttrs->m_Attrs, sizeof(ShapeAttributes));
+	snapshotImg->m_Width = img->m_Width;
+	snapshotImg->m_Height = img->m_Height;
+	bx::memCopy(&snapshotImg->m_ViewBox[0], &img->m_ViewBox[0], sizeof(float) * 4);
+	bx::memCopy(&snapshotImg->m_BoundingRect[0], &img->m_BoundingRect[0], sizeof(float) * 4);
+	snapshotImg->m_BaseProfile = img->m_BaseProfile;
+	snapshotImg->m_VerMajor = img->m_VerMajor;
+	snapshotImg->m_VerMinor = img->m_VerMinor;
+	snapshotImg->m_Context = ctx;
+	snapshotImg->m_ShapeList.m_Shapes = nodes;
+	snapshotImg->m_ShapeList.m_NumShapes = numShapes;
+	snapshotImg->m_ShapeList.m_Capacity = numShapes;
+	snapshotImg->m_ShapeList.m_Context = ctx;
+
+	img->m_LastSnapshot = imageSnapshotAcquire(snapshot);
+	imageSnapshotRelease(prev);
+
+	return snapshot;
+}
+
+const Image* imageSnapshotGetImage(const ImageSnapshot* snapshot)
+{
+	return &snapshot->m_Image;
+}
+
+ImageSnapshot* imageSnapshotAcquire(ImageSnapshot* snapshot)
+{
+	if (snapshot) {
+		bx::atomicInc(&snapshot->m_RefCount);
+	}
+
+	return snapshot;
+}
+
+void imageSnapshotRelease(ImageSnapshot* snapshot)
+{
+	if (snapshot == nullptr || bx::atomicDec(&snapshot->m_RefCount) != 0) {
+		return;
+	}
+
+	bx::AllocatorI* allocator = snapshot->m_Image.m_Context->m_Allocator;
+
+	snapshotNodeListRelease(allocator, snapshot->m_Image.m_ShapeList.m_Shapes, snapshot->m_Image.m_ShapeList.m_NumShapes);
+	snapshotAttrsRelease(allocator, snapshot->m_BaseAttrs);
+	BX_FREE(allocator, snapshot);
+}
+
+void imageSnapshotPublish(ImageSnapshotSlot* slot, ImageSnapshot* snapshot)
+{
+	ImageSnapshot* prev = (ImageSnapshot*)bx::atomicExchangePtr((void**)&slot->m_Snapshot, snapshot);
+
+	// NOTE: Grace period. Readers which might have loaded prev registered under the current epoch
+	// before the exchange. Readers arriving from now on register under the next one, so this can't starve.
+	// A second publisher flipping the epoch in between would let such readers go unwaited, hence one
+	// publisher per slot.
+	const uint32_t epoch = bx::atomicFetchAndAdd<uint32_t>(&slot->m_Epoch, 1);
+	volatile uint32_t* numReaders = &slot->m_NumReaders[epoch & 1];
+	while (bx::atomicFetchAndAdd<uint32_t>(numReaders, 0) != 0) {
+		bx::yield();
+	}
+
+	imageSnapshotRelease(prev);
+}
+
+ImageSnapshot* imageSnapshotAcquireLatest(ImageSnapshotSlot* slot)
+{
+	for (;;) {
+		const uint32_t epoch = bx::atomicFetchAndAdd<uint32_t>(&slot->m_Epoch, 0);
+		volatile uint32_t* numReaders = &slot->m_NumReaders[epoch & 1];
+		bx::atomicInc(numReaders);
+
+		// NOTE: A publish which flipped the epoch in between might not wait for this reader. Retry under the new one.
+		if (bx::atomicFetchAndAdd<uint32_t>(&slot->m_Epoch, 0) == epoch) {
+			// NOTE: Atomic load (only swaps if the slot is already empty).
+			ImageSnapshot* latest = bx::atomicCompareAndSwap<ImageSnapshot*>(&slot->m_Snapshot, nullptr, nullptr);
+			ImageSnapshot* snapshot = imageSnapshotAcquire(latest);
+			bx::atomicDec(numReaders);
+			return snapshot;
+		}
+
+		bx::atomicDec(numReaders);
+	}
+}
+}
@@ -0,0 +1,546 @@
+#include <ssvg/ssvg.h>
+#include <bx/bx.h>
+#include <bx/allocator.h>
+#include <bx/math.h>
+#include <float.h> // FLT_MAX
+
+namespace ssvg
+{
+static const uint32_t kNumTypeColumns[ShapeType::NumTypes] = {
+	0,                                                        // Group
+	RectColumn::Count - ShapeTableColumn::FirstTypeColumn,    // Rect
+	CircleColumn::Count - ShapeTableColumn::FirstTypeColumn,  // Circle
+	EllipseColumn::Count - ShapeTableColumn::FirstTypeColumn, // Ellipse
+	LineColumn::Count - ShapeTableColumn::FirstTypeColumn,    // Line
+	0,                                                        // Polyline
+	0,                                                        // Polygon
+	0,                                                        // Path
+	TextColumn::Count - ShapeTableColumn::FirstTypeColumn,    // Text
+};
+
+// NOTE: 64-bit counters, so the 1st pass can detect images which don't fit the 32-bit table indices.
+struct ShapeTablesBuilder
+{
+	ShapeTables* m_Tables;
+	uint64_t m_NumRows[ShapeType::NumTypes];
+	uint64_t m_NumOrder;
+	uint64_t m_NumTransforms;
+	uint64_t m_NumCommands;
+	uint64_t m_NumPoints;
+};
+
+inline float* shapeTableColumn(const ShapeTable* table, uint32_t column)
+{
+	SSVG_CHECK(column < table->m_NumColumns, "Invalid column");
+	return &table->m_Columns[(size_t)column * table->m_NumRows];
+}
+
+inline uint64_t layoutReserve(uint64_t* offset, uint64_t size)
+{
+	const uint64_t o = (*offset + 15) & ~UINT64_C(15);
+	*offset = o + size;
+	return o;
+}
+
+static void shapeTablesCount(ShapeTablesBuilder* builder, const ShapeList* shapeList)
+{
+	const uint32_t numShapes = shapeList->m_NumShapes;
+	for (uint32_t i = 0; i < numShapes; ++i) {
+		const Shape* shape = shapeList->m_Shapes[i];
+		const ShapeType::Enum type = shape->m_Type;
+
+		builder->m_NumRows[type]++;
+		builder->m_NumOrder++;
+		if (!transformIsIdentity(&shape->m_Attrs->m_Transform[0])) {
+			builder->m_NumTransforms++;
+		}
+
+		switch (type) {
+		case ShapeType::Group:
+			shapeTablesCount(builder, &shape->m_ShapeList);
+			builder->m_NumOrder++; // ShapeTableOrder::GroupEnd
+			break;
+		case ShapeType::Polyline:
+		case ShapeType::Polygon:
+			builder->m_NumPoints += shape->m_PointList.m_NumPoints;
+			break;
+		case ShapeType::Path:
+			builder->m_NumCommands += shape->m_Path.m_NumCommands;
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+static void shapeTablesFill(ShapeTablesBuilder* builder, const ShapeList* shapeList, uint32_t parentTransformID)
+{
+	ShapeTables* tables = builder->m_Tables;
+
+	const uint32_t numShapes = shapeList->m_NumShapes;
+	for (uint32_t i = 0; i < numShapes; ++i) {
+		const Shape* shape = shapeList->m_Shapes[i];
+		const ShapeType::Enum type = shape->m_Type;
+
+		ShapeTable* table = &tables->m_Tables[type];
+		const uint32_t row = (uint32_t)builder->m_NumRows[type]++;
+
+		uint32_t transformID = parentTransformID;
+		if (!transformIsIdentity(&shape->m_Attrs->m_Transform[0])) {
+			transformID = (uint32_t)builder->m_NumTransforms++;
+
+			float* world = &tables->m_Transforms[transformID * 6];
+			bx::memCopy(world, &tables->m_Transforms[parentTransformID * 6], sizeof(float) * 6);
+			transformMultiply(world, &shape->m_Attrs->m_Transform[0]);
+		}
+
+		table->m_Shapes[row] = shape;
+		table->m_TransformID[row] = transformID;
+		table->m_FirstElement[row] = 0;
+		table->m_NumElements[row] = 0;
+		tables->m_Order[builder->m_NumOrder++] = ((uint32_t)type << ShapeTableOrder::TypeShift) | row;
+
+		switch (type) {
+		case ShapeType::Group:
+		{
+			const uint32_t firstChild = (uint32_t)builder->m_NumOrder;
+			shapeTablesFill(builder, &shape->m_ShapeList, transformID);
+			tables->m_Order[builder->m_NumOrder++] = ShapeTableOrder::GroupEnd;
+
+			table->m_FirstElement[row] = firstChild;
+			table->m_NumElements[row] = (uint32_t)builder->m_NumOrder - firstChild;
+		}
+		break;
+		case ShapeType::Rect:
+			shapeTableColumn(table, RectColumn::X)[row] = shape->m_Rect.x;
+			shapeTableColumn(table, RectColumn::Y)[row] = shape->m_Rect.y;
+			shapeTableColumn(table, RectColumn::Width)[row] = shape->m_Rect.width;
+			shapeTableColumn(table, RectColumn::Height)[row] = shape->m_Rect.height;
+			shapeTableColumn(table, RectColumn::RX)[row] = shape->m_Rect.rx;
+			shapeTableColumn(table, RectColumn::RY)[row] = shape->m_Rect.ry;
+			break;
+		case ShapeType::Circle:
+			shapeTableColumn(table, CircleColumn::CX)[row] = shape->m_Circle.cx;
+			shapeTableColumn(table, CircleColumn::CY)[row] = shape->m_Circle.cy;
+			shapeTableColumn(table, CircleColumn::R)[row] = shape->m_Circle.r;
+			break;
+		case ShapeType::Ellipse:
+			shapeTableColumn(table, EllipseColumn::CX)[row] = shape->m_Ellipse.cx;
+			shapeTableColumn(table, EllipseColumn::CY)[row] = shape->m_Ellipse.cy;
+			shapeTableColumn(table, EllipseColumn::RX)[row] = shape->m_Ellipse.rx;
+			shapeTableColumn(table, EllipseColumn::RY)[row] = shape->m_Ellipse.ry;
+			break;
+		case ShapeType::Line:
+			shapeTableColumn(table, LineColumn::X1)[row] = shape->m_Line.x1;
+			shapeTableColumn(table, LineColumn::Y1)[row] = shape->m_Line.y1;
+			shapeTableColumn(table, LineColumn::X2)[row] = shape->m_Line.x2;
+			shapeTableColumn(table, LineColumn::Y2)[row] = shape->m_Line.y2;
+			break;
+		case ShapeType::Polyline:
+		case ShapeType::Polygon:
+		{
+			const uint32_t numPoints = shape->m_PointList.m_NumPoints;
+			table->m_FirstElement[row] = (uint32_t)builder->m_NumPoints;
+			table->m_NumElements[row] = numPoints;
+			bx::memCopy(&tables->m_Points[builder->m_NumPoints * 2], shape->m_PointList.m_Coords, sizeof(float) * 2 * numPoints);
+			builder->m_NumPoints += numPoints;
+		}
+		break;
+		case ShapeType::Path:
+		{
+			const uint32_t numCommands = shape->m_Path.m_NumCommands;
+			table->m_FirstElement[row] = (uint32_t)builder->m_NumCommands;
+			table->m_NumElements[row] = numCommands;
+
+			PathIterator iter;
+			pathIterInit(&iter, &shape->m_Path);
+			for (uint32_t iCmd = 0; iCmd < numCommands; ++iCmd) {
+				bx::memCopy(&tables->m_Commands[builder->m_NumCommands + iCmd], pathIterNext(&iter), sizeof(PathCmd));
+			}
+			builder->m_NumCommands += numCommands;
+		}
+		break;
+		case ShapeType::Text:
+			shapeTableColumn(table, TextColumn::X)[row] = shape->m_Text.x;
+			shapeTableColumn(table, TextColumn::Y)[row] = shape->m_Text.y;
+			break;
+		default:
+			SSVG_CHECK(false, "Unknown shape type");
+			break;
+		}
+	}
+}
+
+ShapeTables* shapeTablesCreate(const Image* img)
+{
+	// 1st pass: Count rows, commands, points, etc. so everything fits in a single allocation.
+	ShapeTablesBuilder builder;
+	bx::memSet(&builder, 0, sizeof(ShapeTablesBuilder));
+	builder.m_NumTransforms = 1; // Root transform
+	shapeTablesCount(&builder, &img->m_ShapeList);
+
+	// NOTE: Rows are packed next to the shape type in m_Order, and everything else is indexed with 32 bits.
+	for (uint32_t i = 0; i < ShapeType::NumTypes; ++i) {
+		if (builder.m_NumRows[i] > ShapeTableOrder::RowMask) {
+			SSVG_WARN(false, "Too many shapes of one type for shape tables");
+			return nullptr;
+		}
+	}
+
+	if (builder.m_NumOrder > UINT32_MAX || builder.m_NumTransforms > UINT32_MAX || builder.m_NumCommands > UINT32_MAX || builder.m_NumPoints > UINT32_MAX) {
+		SSVG_WARN(false, "Image too large for shape tables");
+		return nullptr;
+	}
+
+	uint64_t size = 0;
+	const uint64_t tablesOffset = layoutReserve(&size, sizeof(ShapeTables));
+	const uint64_t orderOffset = layoutReserve(&size, sizeof(uint32_t) * builder.m_NumOrder);
+	const uint64_t transformsOffset = layoutReserve(&size, sizeof(float) * 6 * builder.m_NumTransforms);
+	const uint64_t commandsOffset = layoutReserve(&size, sizeof(PathCmd) * builder.m_NumCommands);
+	const uint64_t pointsOffset = layoutReserve(&size, sizeof(float) * 2 * builder.m_NumPoints);
+
+	uint64_t columnsOffset[ShapeType::NumTypes];
+	uint64_t shapesOffset[ShapeType::NumTypes];
+	uint64_t rowDataOffset[ShapeType::NumTypes];
+	for (uint32_t i = 0; i < ShapeType::NumTypes; ++i) {
+		const uint64_t numRows = builder.m_NumRows[i];
+		const uint64_t numColumns = ShapeTableColumn::FirstTypeColumn + kNumTypeColumns[i];
+		columnsOffset[i] = layoutReserve(&size, sizeof(float) * numColumns * numRows);
+		shapesOffset[i] = layoutReserve(&size, sizeof(Shape*) * numRows);
+		rowDataOffset[i] = layoutReserve(&size, sizeof(uint32_t) * 3 * numRows);
+	}
+
+	if ((size_t)size != size) {
+		return nullptr;
+	}
+
+	bx::AllocatorI* allocator = img->m_Context->m_Allocator;
+	uint8_t* mem = (uint8_t*)BX_ALLOC(allocator, (size_t)size);
+	if (!mem) {
+		return nullptr;
+	}
+
+	ShapeTables* tables = (ShapeTables*)(mem + tablesOffset);
+	bx::memSet(tables, 0, sizeof(ShapeTables));
+	tables->m_Order = (uint32_t*)(mem + orderOffset);
+	tables->m_Transforms = (float*)(mem + transformsOffset);
+	tables->m_Commands = (PathCmd*)(mem + commandsOffset);
+	tables->m_Points = (float*)(mem + pointsOffset);
+	tables->m_NumOrder = (uint32_t)builder.m_NumOrder;
+	tables->m_NumTransforms = (uint32_t)builder.m_NumTransforms;
+	tables->m_NumCommands = (uint32_t)builder.m_NumCommands;
+	tables->m_NumPoints = (uint32_t)builder.m_NumPoints;
+	tables->m_Allocator = allocator;
+
+	for (uint32_t i = 0; i < ShapeType::NumTypes; ++i) {
+		const uint32_t numRows = (uint32_t)builder.m_NumRows[i];
+
+		ShapeTable* table = &tables->m_Tables[i];
+		table->m_Columns = (float*)(mem + columnsOffset[i]);
+		table->m_Shapes = (const Shape**)(mem + shapesOffset[i]);
+		table->m_TransformID = (uint32_t*)(mem + rowDataOffset[i]);
+		table->m_FirstElement = table->m_TransformID + numRows;
+		table->m_NumElements = table->m_FirstElement + numRows;
+		table->m_NumRows = numRows;
+		table->m_NumColumns = ShapeTableColumn::FirstTypeColumn + kNumTypeColumns[i];
+	}
+
+	// 2nd pass: Fill the tables
+	bx::memSet(&builder, 0, sizeof(ShapeTablesBuilder));
+	builder.m_Tables = tables;
+	builder.m_NumTransforms = 1;
+	transformIdentity(&tables->m_Transforms[0]);
+	shapeTablesFill(&builder, &img->m_ShapeList, 0);
+
+	return tables;
+}
+
+void shapeTablesDestroy(ShapeTables* tables)
+{
+	// NOTE: The ShapeTables struct is the first thing in the allocated block.
+	BX_FREE(tables->m_Allocator, tables);
+}
+
+float* shapeTablesGetColumn(const ShapeTables* tables, ShapeType::Enum type, uint32_t column)
+{
+	return shapeTableColumn(&tables->m_Tables[type], column);
+}
+
+static void shapeTableLocalBounds(ShapeTables* tables, ShapeType::Enum type)
+{
+	const ShapeTable* table = &tables->m_Tables[type];
+	const uint32_t n = table->m_NumRows;
+
+	float* minX = shapeTableColumn(table, ShapeTableColumn::MinX);
+	float* minY = shapeTableColumn(table, ShapeTableColumn::MinY);
+	float* maxX = shapeTableColumn(table, ShapeTableColumn::MaxX);
+	float* maxY = shapeTableColumn(table, ShapeTableColumn::MaxY);
+
+	switch (type) {
+	case ShapeType::Group:
+		for (uint32_t i = 0; i < n; ++i) {
+			minX[i] = minY[i] = FLT_MAX;
+			maxX[i] = maxY[i] = -FLT_MAX;
+		}
+		break;
+	case ShapeType::Rect:
+	{
+		const float* x = shapeTableColumn(table, RectColumn::X);
+		const float* y = shapeTableColumn(table, RectColumn::Y);
+		const float* w = shapeTableColumn(table, RectColumn::Width);
+		const float* h = shapeTableColumn(table, RectColumn::Height);
+		for (uint32_t i = 0; i < n; ++i) {
+			minX[i] = x[i];
+			minY[i] = y[i];
+			maxX[i] = x[i] + w[i];
+			maxY[i] = y[i] + h[i];
+		}
+	}
+	break;
+	case ShapeType::Circle:
+	{
+		const float* cx = shapeTableColumn(table, CircleColumn::CX);
+		const float* cy = shapeTableColumn(table, CircleColumn::CY);
+		const float* r = shapeTableColumn(table, CircleColumn::R);
+		for (uint32_t i = 0; i < n; ++i) {
+			minX[i] = cx[i] - r[i];
+			minY[i] = cy[i] - r[i];
+			maxX[i] = cx[i] + r[i];
+			maxY[i] = cy[i] + r[i];
+		}
+	}
+	break;
+	case ShapeType::Ellipse:
+	{
+		const float* cx = shapeTableColumn(table, EllipseColumn::CX);
+		const float* cy = shapeTableColumn(table, EllipseColumn::CY);
+		const float* rx = shapeTableColumn(table, EllipseColumn::RX);
+		const float* ry = shapeTableColumn(table, EllipseColumn::RY);
+		for (uint32_t i = 0; i < n; ++i) {
+			minX[i] = cx[i] - rx[i];
+			minY[i] = cy[i] - ry[i];
+			maxX[i] = cx[i] + rx[i];
+			maxY[i] = cy[i] + ry[i];
+		}
+	}
+	break;
+	case ShapeType::Line:
+	{
+		const float* x1 = shapeTableColumn(table, LineColumn::X1);
+		const float* y1 = shapeTableColumn(table, LineColumn::Y1);
+		const float* x2 = shapeTableColumn(table, LineColumn::X2);
+		const float* y2 = shapeTableColumn(table, LineColumn::Y2);
+		for (uint32_t i = 0; i < n; ++i) {
+			minX[i] = bx::min<float>(x1[i], x2[i]);
+			minY[i] = bx::min<float>(y1[i], y2[i]);
+			maxX[i] = bx::max<float>(x1[i], x2[i]);
+			maxY[i] = bx::max<float>(y1[i], y2[i]);
+		}
+	}
+	break;
+	case ShapeType::Polyline:
+	case ShapeType::Polygon:
+		for (uint32_t i = 0; i < n; ++i) {
+			PointList ptList;
+			ptList.m_Coords = &tables->m_Points[table->m_FirstElement[i] * 2];
+			ptList.m_NumPoints = table->m_NumElements[i];
+			ptList.m_Capacity = 0;
+
+			float bounds[4];
+			pointListCalcBounds(&ptList, &bounds[0]);
+			minX[i] = bounds[0];
+			minY[i] = bounds[1];
+			maxX[i] = bounds[2];
+			maxY[i] = bounds[3];
+		}
+		break;
+	case ShapeType::Path:
+		for (uint32_t i = 0; i < n; ++i) {
+			Path path;
+			bx::memSet(&path, 0, sizeof(Path));
+			path.m_Commands = &tables->m_Commands[table->m_FirstElement[i]];
+			path.m_NumCommands = table->m_NumElements[i];
+
+			float bounds[4];
+			pathCalcBounds(&path, &bounds[0]);
+			minX[i] = bounds[0];
+			minY[i] = bounds[1];
+			maxX[i] = bounds[2];
+			maxY[i] = bounds[3];
+		}
+		break;
+	case ShapeType::Text:
+		// TODO: Same as shapeUpdateBounds()
+		for (uint32_t i = 0; i < n; ++i) {
+			minX[i] = minY[i] = maxX[i] = maxY[i] = 0.0f;
+		}
+		break;
+	default:
+		SSVG_CHECK(false, "Unknown shape type");
+		break;
+	}
+}
+
+// Transforms all 4 corners of each local bounding rect.
+static void shapeTableWorldBounds(ShapeTables* tables, ShapeType::Enum type)
+{
+	const ShapeTable* table = &tables->m_Tables[type];
+	const uint32_t n = table->m_NumRows;
+	const uint32_t* transformID = table->m_TransformID;
+	const float* transforms = tables->m_Transforms;
+
+	float* minX = shapeTableColumn(table, ShapeTableColumn::MinX);
+	float* minY = shapeTableColumn(table, ShapeTableColumn::MinY);
+	float* maxX = shapeTableColumn(table, ShapeTableColumn::MaxX);
+	float* maxY = shapeTableColumn(table, ShapeTableColumn::MaxY);
+
+	for (uint32_t i = 0; i < n; ++i) {
+		if (minX[i] > maxX[i] || minY[i] > maxY[i]) {
+			continue;
+		}
+
+		const float* mtx = &transforms[transformID[i] * 6];
+		const float x0a = mtx[0] * minX[i], x1a = mtx[0] * maxX[i];
+		const float y0a = mtx[1] * minX[i], y1a = mtx[1] * maxX[i];
+		const float x0b = mtx[2] * minY[i], x1b = mtx[2] * maxY[i];
+		const float y0b = mtx[3] * minY[i], y1b = mtx[3] * maxY[i];
+
+		minX[i] = bx::min<float>(x0a, x1a) + bx::min<float>(x0b, x1b) + mtx[4];
+		maxX[i] = bx::max<float>(x0a, x1a) + bx::max<float>(x0b, x1b) + mtx[4];
+		minY[i] = bx::min<float>(y0a, y1a) + bx::min<float>(y0b, y1b) + mtx[5];
+		maxY[i] = bx::max<float>(y0a, y1a) + bx::max<float>(y0b, y1b) + mtx[5];
+	}
+}
+
+inline void shapeTableGetBounds(const ShapeTable* table, uint32_t row, float* bounds)
+{
+	const uint32_t n = table->m_NumRows;
+	bounds[0] = table->m_Columns[ShapeTableColumn::MinX * n + row];
+	bounds[1] = table->m_Columns[ShapeTableColumn::MinY * n + row];
+	bounds[2] = table->m_Columns[ShapeTableColumn::MaxX * n + row];
+	bounds[3] = table->m_Columns[ShapeTableColumn::MaxY * n + row];
+}
+
+// Grows the bounds of a group row to include the bounds of another row.
+inline void shapeTableUnionBounds(ShapeTable* groups, uint32_t groupRow, const ShapeTable* table, uint32_t row)
+{
+	float bounds[4];
+	shapeTableGetBounds(table, row, &bounds[0]);
+
+	const uint32_t n = groups->m_NumRows;
+	float* minX = &groups->m_Columns[ShapeTableColumn::MinX * n + groupRow];
+	float* minY = &groups->m_Columns[ShapeTableColumn::MinY * n + groupRow];
+	float* maxX = &groups->m_Columns[ShapeTableColumn::MaxX * n + groupRow];
+	float* maxY = &groups->m_Columns[ShapeTableColumn::MaxY * n + groupRow];
+	*minX = bx::min<float>(*minX, bounds[0]);
+	*minY = bx::min<float>(*minY, bounds[1]);
+	*maxX = bx::max<float>(*maxX, bounds[2]);
+	*maxY = bx::max<float>(*maxY, bounds[3]);
+}
+
+void shapeTablesCalcBounds(ShapeTables* tables, float* bounds)
+{
+	for (uint32_t i = 0; i < ShapeType::NumTypes; ++i) {
+		shapeTableLocalBounds(tables, (ShapeType::Enum)i);
+		if (i != ShapeType::Group) {
+			shapeTableWorldBounds(tables, (ShapeType::Enum)i);
+		}
+	}
+
+	// Reduce the bounds of the children into their parent group. Group bounds are
+	// already in world space so no transform is applied.
+	bounds[0] = bounds[1] = FLT_MAX;
+	bounds[2] = bounds[3] = -FLT_MAX;
+
+	ShapeTable* groups = &tables->m_Tables[ShapeType::Group];
+	uint32_t* stack = groups->m_NumRows != 0
+		? (uint32_t*)BX_ALLOC(tables->m_Allocator, sizeof(uint32_t) * groups->m_NumRows)
+		: nullptr
+		;
+	uint32_t stackSize = 0;
+
+	const uint32_t numOrder = tables->m_NumOrder;
+	for (uint32_t i = 0; i < numOrder; ++i) {
+		const uint32_t entry = tables->m_Order[i];
+
+		const ShapeTable* table = groups;
+		uint32_t row;
+		if (entry == ShapeTableOrder::GroupEnd) {
+			SSVG_CHECK(stackSize != 0, "Unbalanced group end");
+			row = stack[--stackSize];
+		} else {
+			const uint32_t type = entry >> ShapeTableOrder::TypeShift;
+			row = entry & ShapeTableOrder::RowMask;
+			if (type == ShapeType::Group) {
+				stack[stackSize++] = row;
+				continue;
+			}
+
+			table = &tables->m_Tables[type];
+		}
+
+		if (stackSize != 0) {
+			shapeTableUnionBounds(groups, stack[stackSize - 1], table, row);
+		} else {
+			float rowBounds[4];
+			shapeTableGetBounds(table, row, &rowBounds[0]);
+			bounds[0] = bx::min<float>(bounds[0], rowBounds[0]);
+			bounds[1] = bx::min<float>(bounds[1], rowBounds[1]);
+			bounds[2] = bx::max<float>(bounds[2], rowBounds[2]);
+			bounds[3] = bx::max<float>(bounds[3], rowBounds[3]);
+		}
+	}
+
+	BX_FREE(tables->m_Allocator, stack);
+}
+
+void shapeTablesTransform(ShapeTables* tables, const float* transform)
+{
+	// NOTE: Bounds are not updated. Call shapeTablesCalcBounds() afterwards.
+	const uint32_t numTransforms = tables->m_NumTransforms;
+	for (uint32_t i = 0; i < numTransforms; ++i) {
+		float* world = &tables->m_Transforms[i * 6];
+
+		float res[6];
+		bx::memCopy(&res[0], transform, sizeof(float) * 6);
+		transformMultiply(&res[0], world);
+		bx::memCopy(world, &res[0], sizeof(float) * 6);
+	}
+}
+
+uint32_t shapeTablesCull(const ShapeTables* tables, const float* rect, uint32_t* visibleOrder)
+{
+	uint32_t numVisible = 0;
+
+	const uint32_t numOrder = tables->m_NumOrder;
+	for (uint32_t i = 0; i < numOrder; ++i) {
+		const uint32_t entry = tables->m_Order[i];
+		if (entry == ShapeTableOrder::GroupEnd) {
+			visibleOrder[numVisible++] = entry;
+			continue;
+		}
+
+		const uint32_t type = entry >> ShapeTableOrder::TypeShift;
+		const uint32_t row = entry & ShapeTableOrder::RowMask;
+		const ShapeTable* table = &tables->m_Tables[type];
+
+		float bounds[4];
+		shapeTableGetBounds(table, row, &bounds[0]);
+		const bool visible = true
+			&& bounds[0] <= rect[2]
+			&& bounds[1] <= rect[3]
+			&& bounds[2] >= rect[0]
+			&& bounds[3] >= rect[1]
+			;
+
+		if (visible) {
+			visibleOrder[numVisible++] = entry;
+		} else if (type == ShapeType::Group) {
+			// Skip the whole subtree (including the group end marker).
+			i += table->m_NumElements[row];
+		}
+	}
+
+	return numVisible;
+}
+}
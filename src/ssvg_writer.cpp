@@ -1,4 +1,5 @@
 #include <ssvg/ssvg.h>
+#include <bx/allocator.h>
 #include <bx/readerwriter.h>
 #include <bx/string.h>
 
@@ -106,16 +107,6 @@ static const char* fillRuleToString(FillRule::Enum rule)
 	return "nonzero";
 }
 
-static bool transformIsIdentity(const float* transform)
-{
-	return transform[0] == 1.0f
-		&& transform[1] == 0.0f
-		&& transform[2] == 0.0f
-		&& transform[3] == 1.0f
-		&& transform[4] == 0.0f
-		&& transform[5] == 0.0f;
-}
-
 static void colorToHexString(char* str, uint32_t len, uint32_t abgr)
 {
 	const uint32_t r = abgr & 0x000000FF;
@@ -143,10 +134,11 @@ bool pathToString(const Path* path, bx::WriterI* writer)
 
 	// TODO: Extra minification can be achieved by using relative commands 
 	// (because adjacent commands/coords are usually close to the last position).
-	const uint32_t numCommands = path->m_NumCommands;
-	for (uint32_t iCmd = 0; iCmd < numCommands; ++iCmd) {
-		const PathCmd* cmd = &path->m_Commands[iCmd];
+	PathIterator iter;
+	pathIterInit(&iter, path);
 
+	const PathCmd* cmd;
+	while ((cmd = pathIterNext(&iter)) != nullptr) {
 		const PathCmdType::Enum type = cmd->m_Type;
 		const float* data = &cmd->m_Data[0];
 		switch (type) {
@@ -183,15 +175,19 @@ static bool writeShapeAttributes(bx::WriterI* writer, const ShapeAttributes* att
 
 	const bool conditionalPaints = (flags & SaveAttr::ConditionalPaints) != 0;
 
-	if ((flags & SaveAttr::ID) != 0 && attrs->m_ID[0] != '\0') {
-		bx::write(writer, &err, "id=\"%s\" ", attrs->m_ID);
+	if ((flags & SaveAttr::ID) != 0) {
+		const bx::StringView id = shapeAttrsGetID(attrs);
+		if (!id.isEmpty()) {
+			bx::write(writer, &err, "id=\"%.*s\" ", id.getLength(), id.getPtr());
+		}
 	}
 
-#if SSVG_CONFIG_CLASS_MAX_LEN
-	if ((flags & SaveAttr::Class) != 0 && attrs->m_Class[0] != '\0') {
-		bx::write(writer, &err, "class=\"%s\" ", attrs->m_Class);
+	if ((flags & SaveAttr::Class) != 0) {
+		const bx::StringView c = shapeAttrsGetClass(attrs);
+		if (!c.isEmpty()) {
+			bx::write(writer, &err, "class=\"%.*s\" ", c.getLength(), c.getPtr());
+		}
 	}
-#endif
 
 	if ((flags & SaveAttr::Transform) != 0 && !transformIsIdentity(&attrs->m_Transform[0])) {
 		bx::write(writer, &err, "transform=\"matrix(%g,%g,%g,%g,%g,%g)\" "
@@ -280,9 +276,9 @@ static bool writeShapeAttributes(bx::WriterI* writer, const ShapeAttributes* att
 	}
 
 	if ((flags & SaveAttr::Font) != 0) {
-		const char* fontFamily = attrs->m_FontFamily;
-		if (fontFamily[0] != '\0' && bx::strCmp(fontFamily, parentAttrs->m_FontFamily)) {
-			bx::write(writer, &err, "font-family=\"%s\" ", fontFamily);
+		const bx::StringView fontFamily = shapeAttrsGetFontFamily(attrs);
+		if (!fontFamily.isEmpty() && bx::strCmp(fontFamily, shapeAttrsGetFontFamily(parentAttrs))) {
+			bx::write(writer, &err, "font-family=\"%.*s\" ", fontFamily.getLength(), fontFamily.getPtr());
 		}
 
 		const float fontSize = attrs->m_FontSize;
@@ -322,27 +318,45 @@ bool writePath(bx::WriterI* writer, const Path* path)
 	return true;
 }
 
-bool writeShapeList(bx::WriterI* writer, const ShapeList* shapeList, const ShapeAttributes* parentAttrs, uint32_t indentation)
+static bool writeGroupBegin(bx::WriterI* writer, const Shape* group, const ShapeAttributes* parentAttrs, uint32_t indentation)
 {
 	bx::Error err;
-	const uint32_t numShapes = shapeList->m_NumShapes;
-	for (uint32_t iShape = 0; iShape < numShapes; ++iShape) {
-		const Shape* shape = &shapeList->m_Shapes[iShape];
+	bx::write(writer, &err, "%*s<g ", indentation, "");
+	if (!writeShapeAttributes(writer, group->m_Attrs, parentAttrs, SaveAttr::All)) {
+		return false;
+	}
+	bx::write(writer, &err, ">\n");
+
+	return true;
+}
+
+static void writeGroupEnd(bx::WriterI* writer, uint32_t indentation)
+{
+	bx::Error err;
+	bx::write(writer, &err, "%*s</g>\n", indentation, "");
+}
+
+bool writeShapeList(bx::WriterI* writer, const ShapeList* shapeList, const ShapeAttributes* parentAttrs, uint32_t indentation);
+
+// Writes shapes [firstShape, lastShape) of the list.
+static bool writeShapes(bx::WriterI* writer, const ShapeList* shapeList, uint32_t firstShape, uint32_t lastShape, const ShapeAttributes* parentAttrs, uint32_t indentation)
+{
+	bx::Error err;
+	for (uint32_t iShape = firstShape; iShape < lastShape; ++iShape) {
+		const Shape* shape = shapeList->m_Shapes[iShape];
 
 		const ShapeType::Enum shapeType = shape->m_Type;
 		switch (shapeType) {
 		case ShapeType::Group:
-			bx::write(writer, &err, "%*s<g ", indentation, "");
-			if (!writeShapeAttributes(writer, shape->m_Attrs, parentAttrs, SaveAttr::All)) {
+			if (!writeGroupBegin(writer, shape, parentAttrs, indentation)) {
 				return false;
 			}
-			bx::write(writer, &err, ">\n");
 
 			if (!writeShapeList(writer, &shape->m_ShapeList, shape->m_Attrs, indentation + 2)) {
 				return false;
 			}
 
-			bx::write(writer, &err, "%*s</g>\n", indentation, "");
+			writeGroupEnd(writer, indentation);
 			break;
 		case ShapeType::Rect:
 			bx::write(writer, &err, "%*s<rect ", indentation, "");
@@ -444,10 +458,15 @@ bool writeShapeList(bx::WriterI* writer, const ShapeList* shapeList, const Shape
 	return true;
 }
 
-bool imageSave(const Image* img, bx::WriterI* writer)
+bool writeShapeList(bx::WriterI* writer, const ShapeList* shapeList, const ShapeAttributes* parentAttrs, uint32_t indentation)
+{
+	return writeShapes(writer, shapeList, 0, shapeList->m_NumShapes, parentAttrs, indentation);
+}
+
+static void writeImageBegin(bx::WriterI* writer, const Image* img)
 {
 	bx::Error err;
-	
+
 	bx::write(writer, &err, "<svg ");
 	if (img->m_Width != 0.0f) {
 		bx::write(writer, &err, "width=\"%g\" ", img->m_Width);
@@ -465,12 +484,246 @@ bool imageSave(const Image* img, bx::WriterI* writer)
 		bx::write(writer, &err, "viewBox=\"%g %g %g %g\" ", img->m_ViewBox[0], img->m_ViewBox[1], img->m_ViewBox[2], img->m_ViewBox[3]);
 	}
 	bx::write(writer, &err, "xmlns=\"http://www.w3.org/2000/svg\">\n");
+}
+
+static void writeImageEnd(bx::WriterI* writer)
+{
+	bx::Error err;
+	bx::write(writer, &err, "</svg>\n");
+}
+
+bool imageSave(const Image* img, bx::WriterI* writer)
+{
+	writeImageBegin(writer, img);
 
 	if (!writeShapeList(writer, &img->m_ShapeList, &img->m_BaseAttrs, 1)) {
 		return false;
 	}
 
-	bx::write(writer, &err, "</svg>\n");
+	writeImageEnd(writer);
+
+	return true;
+}
+
+struct SaveItemType
+{
+	enum Enum : uint32_t
+	{
+		Shapes,     // NOTE: Shapes [m_FirstShape, m_LastShape) of the list
+		GroupBegin, // NOTE: Opening tag of group m_FirstShape. Its children follow as separate items.
+		GroupEnd,
+	};
+};
+
+// A piece of the output, serialized into its own buffer by one task.
+struct SaveItem
+{
+	const ShapeList* m_ShapeList;
+	const ShapeAttributes* m_ParentAttrs;
+	uint32_t m_FirstShape;
+	uint32_t m_LastShape;
+	uint32_t m_Indentation;
+	SaveItemType::Enum m_Type;
+	uint8_t* m_Data;
+	uint32_t m_Size;
+	uint32_t m_Capacity;
+	bool m_Failed;
+};
+
+struct SaveJob
+{
+	SaveItem* m_Items;
+	uint32_t m_NumItems;
+	uint32_t m_Capacity;
+	uint64_t m_ItemWeight;
+	bx::AllocatorI* m_Allocator;
+};
+
+static const uint32_t kSaveItemsPerThread = 4;
+static const uint64_t kSaveMinItemWeight = 4096;
+
+class SaveItemWriter : public bx::WriterI
+{
+public:
+	SaveItemWriter(SaveItem* item, bx::AllocatorI* allocator)
+		: m_Item(item)
+		, m_Allocator(allocator)
+	{
+	}
+
+	virtual int32_t write(const void* data, int32_t size, bx::Error* err) override
+	{
+		BX_UNUSED(err);
+
+		SaveItem* item = m_Item;
+		if (item->m_Size + size > item->m_Capacity) {
+			item->m_Capacity = bx::max<uint32_t>(bx::max<uint32_t>(item->m_Capacity * 2, item->m_Size + size), 4096);
+			item->m_Data = (uint8_t*)BX_REALLOC(m_Allocator, item->m_Data, item->m_Capacity);
+		}
+
+		bx::memCopy(&item->m_Data[item->m_Size], data, size);
+		item->m_Size += size;
+
+		return size;
+	}
+
+	SaveItem* m_Item;
+	bx::AllocatorI* m_Allocator;
+};
+
+// Rough measure of the time it takes to serialize a shape. Stops counting at limit.
+static uint64_t shapeCalcSaveWeight(const Shape* shape, uint64_t limit)
+{
+	switch (shape->m_Type) {
+	case ShapeType::Group:
+	{
+		uint64_t weight = 1;
+		const ShapeList* children = &shape->m_ShapeList;
+		for (uint32_t i = 0; i < children->m_NumShapes && weight < limit; ++i) {
+			weight += shapeCalcSaveWeight(children->m_Shapes[i], limit - weight);
+		}
+
+		return weight;
+	}
+	case ShapeType::Path:
+		return 1 + shape->m_Path.m_NumCommands;
+	case ShapeType::Polyline:
+	case ShapeType::Polygon:
+		return 1 + shape->m_PointList.m_NumPoints;
+	default:
+		break;
+	}
+
+	return 1;
+}
+
+static void saveJobAddItem(SaveJob* job, SaveItemType::Enum type, const ShapeList* shapeList, uint32_t firstShape, uint32_t lastShape, const ShapeAttributes* parentAttrs, uint32_t indentation)
+{
+	if (job->m_NumItems == job->m_Capacity) {
+		job->m_Capacity = job->m_Capacity ? job->m_Capacity * 2 : 64;
+		job->m_Items = (SaveItem*)BX_REALLOC(job->m_Allocator, job->m_Items, sizeof(SaveItem) * job->m_Capacity);
+	}
+
+	SaveItem* item = &job->m_Items[job->m_NumItems++];
+	bx::memSet(item, 0, sizeof(SaveItem));
+	item->m_ShapeList = shapeList;
+	item->m_ParentAttrs = parentAttrs;
+	item->m_FirstShape = firstShape;
+	item->m_LastShape = lastShape;
+	item->m_Indentation = indentation;
+	item->m_Type = type;
+}
+
+// Splits the list into runs of consecutive shapes of roughly m_ItemWeight each. Groups heavier than
+// that are split up recursively, with their tags as separate items.
+static void saveJobCollect(SaveJob* job, const ShapeList* shapeList, const ShapeAttributes* parentAttrs, uint32_t indentation)
+{
+	const uint64_t itemWeight = job->m_ItemWeight;
+	const uint32_t numShapes = shapeList->m_NumShapes;
+
+	uint32_t firstShape = 0;
+	uint64_t weight = 0;
+	for (uint32_t i = 0; i < numShapes; ++i) {
+		const Shape* shape = shapeList->m_Shapes[i];
+		const uint64_t shapeWeight = shapeCalcSaveWeight(shape, itemWeight);
+		if (shape->m_Type == ShapeType::Group && shapeWeight >= itemWeight) {
+			if (firstShape < i) {
+				saveJobAddItem(job, SaveItemType::Shapes, shapeList, firstShape, i, parentAttrs, indentation);
+			}
+
+			saveJobAddItem(job, SaveItemType::GroupBegin, shapeList, i, i + 1, parentAttrs, indentation);
+			saveJobCollect(job, &shape->m_ShapeList, shape->m_Attrs, indentation + 2);
+			saveJobAddItem(job, SaveItemType::GroupEnd, shapeList, i, i + 1, parentAttrs, indentation);
+
+			firstShape = i + 1;
+			weight = 0;
+			continue;
+		}
+
+		weight += shapeWeight;
+		if (weight >= itemWeight) {
+			saveJobAddItem(job, SaveItemType::Shapes, shapeList, firstShape, i + 1, parentAttrs, indentation);
+			firstShape = i + 1;
+			weight = 0;
+		}
+	}
+
+	if (firstShape < numShapes) {
+		saveJobAddItem(job, SaveItemType::Shapes, shapeList, firstShape, numShapes, parentAttrs, indentation);
+	}
+}
+
+static void saveJobRun(uint32_t begin, uint32_t end, void* userData)
+{
+	SaveJob* job = (SaveJob*)userData;
+	for (uint32_t i = begin; i < end; ++i) {
+		SaveItem* item = &job->m_Items[i];
+		SaveItemWriter writer(item, job->m_Allocator);
+
+		switch (item->m_Type) {
+		case SaveItemType::Shapes:
+			item->m_Failed = !writeShapes(&writer, item->m_ShapeList, item->m_FirstShape, item->m_LastShape, item->m_ParentAttrs, item->m_Indentation);
+			break;
+		case SaveItemType::GroupBegin:
+			item->m_Failed = !writeGroupBegin(&writer, item->m_ShapeList->m_Shapes[item->m_FirstShape], item->m_ParentAttrs, item->m_Indentation);
+			break;
+		case SaveItemType::GroupEnd:
+			writeGroupEnd(&writer, item->m_Indentation);
+			break;
+		}
+	}
+}
+
+// Serializes pieces of the shape tree into memory buffers on the context's scheduler and writes them
+// out in document order. The output is identical to imageSave()'s.
+bool imageSaveParallel(const Image* img, bx::WriterI* writer)
+{
+	SchedulerI* scheduler = contextGetScheduler(img->m_Context);
+	const uint32_t numThreads = scheduler->getNumThreads();
+	if (numThreads == 1) {
+		return imageSave(img, writer);
+	}
+
+	uint64_t totalWeight = 0;
+	const ShapeList* shapeList = &img->m_ShapeList;
+	for (uint32_t i = 0; i < shapeList->m_NumShapes; ++i) {
+		totalWeight += shapeCalcSaveWeight(shapeList->m_Shapes[i], UINT64_MAX);
+	}
+
+	SaveJob job;
+	bx::memSet(&job, 0, sizeof(SaveJob));
+	job.m_ItemWeight = bx::max<uint64_t>(totalWeight / (numThreads * kSaveItemsPerThread), kSaveMinItemWeight);
+	job.m_Allocator = img->m_Context->m_Allocator;
+	saveJobCollect(&job, shapeList, &img->m_BaseAttrs, 1);
+
+	if (job.m_NumItems < 2) {
+		BX_FREE(job.m_Allocator, job.m_Items);
+		return imageSave(img, writer);
+	}
+
+	scheduler->parallelFor(job.m_NumItems, 1, saveJobRun, &job);
+
+	// NOTE: On failure, write everything up to the failed item, like imageSave() would.
+	bool failed = false;
+	bx::Error err;
+	writeImageBegin(writer, img);
+	for (uint32_t i = 0; i < job.m_NumItems; ++i) {
+		SaveItem* item = &job.m_Items[i];
+		if (!failed) {
+			bx::write(writer, item->m_Data, (int32_t)item->m_Size, &err);
+			failed = item->m_Failed;
+		}
+
+		BX_FREE(job.m_Allocator, item->m_Data);
+	}
+
+	BX_FREE(job.m_Allocator, job.m_Items);
+
+	if (failed) {
+		return false;
+	}
+
+	writeImageEnd(writer);
 
 	return true;
 }